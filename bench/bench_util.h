@@ -0,0 +1,121 @@
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "binary_protocol.h"
+
+// 单调时钟，单位纳秒
+static inline uint64_t bench_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// 压测期间服务器各模块会向 stdout 打印大量日志，
+// 这里把 stdout 重定向到 /dev/null，返回一个指向原始 stdout 的流用于输出测量结果
+static inline FILE *bench_silence_stdout()
+{
+    fflush(stdout);
+    int out = dup(STDOUT_FILENO);
+    if (NULL == freopen("/dev/null", "w", stdout))
+        return stderr;
+    return fdopen(out, "w");
+}
+
+// 以阻塞方式连接本机端口
+static inline int bench_connect(uint16_t port)
+{
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (0 > sockfd)
+        return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 > connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)))
+    {
+        close(sockfd);
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sockfd;
+}
+
+static inline int bench_write_all(int sockfd, const char *buf, size_t len)
+{
+    size_t have_write = 0;
+    while (have_write < len)
+    {
+        ssize_t n = write(sockfd, buf + have_write, len - have_write);
+        if (n <= 0)
+        {
+            if (n < 0 && EINTR == errno)
+                continue;
+            return -1;
+        }
+        have_write += n;
+    }
+    return 0;
+}
+
+static inline int bench_read_all(int sockfd, char *buf, size_t len)
+{
+    size_t have_read = 0;
+    while (have_read < len)
+    {
+        ssize_t n = read(sockfd, buf + have_read, len - have_read);
+        if (n <= 0)
+        {
+            if (n < 0 && EINTR == errno)
+                continue;
+            return -1;
+        }
+        have_read += n;
+    }
+    return 0;
+}
+
+// 按照服务器下发的格式（header.length 包含消息头）读取一个完整的消息，返回消息体长度
+static inline int bench_read_frame(int sockfd, MessageHeader *header, char *body, size_t body_cap)
+{
+    if (0 > bench_read_all(sockfd, (char *)header, sizeof(MessageHeader)))
+        return -1;
+    size_t body_len = header->length - sizeof(MessageHeader);
+    if (body_len > body_cap)
+        return -1;
+    if (0 > bench_read_all(sockfd, body, body_len))
+        return -1;
+    return (int)body_len;
+}
+
+// 按照客户端上行的格式（header.length 只包含消息体）把一个消息追加到 buf 中，返回写入的字节数
+static inline size_t bench_pack_upstream(char *buf, MessageType type, const void *body, uint16_t body_len)
+{
+    MessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = type;
+    header.length = body_len;
+    memcpy(buf, &header, sizeof(header));
+    if (body_len > 0)
+        memcpy(buf + sizeof(header), body, body_len);
+    return sizeof(header) + body_len;
+}
+
+#endif
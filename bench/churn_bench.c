@@ -0,0 +1,125 @@
+/**
+ * churn_bench：连接反复建立又断开时，服务器能否及时回收玩家注册表中的 slot 和 fd。
+ *
+ * 在进程内拉起完整的服务器（reactor + handler + sender worker），一个客户端顺序地建立 -n 个连接
+ * （默认 MAX_CONNECTION_NUM 的两倍多），每个连接都不发送 PLAYER_INFO_CERT：
+ * 偶数号的连接收到 RESPONSE_UUID 之后关闭，奇数号的连接建立之后立即关闭（服务器可能还没有发出 UUID）。
+ * 注册表只有 MAX_CONNECTION_NUM 个 slot，如果断开的连接没有被回收，之后的连接就再也收不到 RESPONSE_UUID。
+ * 最后等待注册表清空，输出每秒完成的连接数；有连接没有收到 UUID 或者注册表没有在 -w 毫秒内清空时以失败退出。
+ *
+ * 用法：churn_bench [-b epoll|uring] [-p port] [-n conns] [-w wait_ms]
+ * 例如：./churn_bench && ./churn_bench -b uring
+ */
+#include <boost_up.h>
+#include <getopt.h>
+#include "bench_util.h"
+
+#define BENCH_RECV_TIMEOUT_MS 2000
+
+static uint16_t bench_port = 18753;
+static int bench_conn_num = 2 * MAX_CONNECTION_NUM + 100;
+static int bench_wait_ms = 5000;
+
+/* 建立一个连接，wait_uuid 时读到 RESPONSE_UUID 再关闭，返回 -1 表示连接失败或者没有收到 UUID */
+static int bench_churn_one(bool wait_uuid)
+{
+    int sockfd = bench_connect(bench_port);
+    if (0 > sockfd)
+        return -1;
+    int result = 0;
+    if (wait_uuid)
+    {
+        struct timeval timeout = {.tv_sec = BENCH_RECV_TIMEOUT_MS / 1000, .tv_usec = 0};
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        MessageHeader header;
+        char body[UNIT_BUFFER_SIZE];
+        if (0 > bench_read_frame(sockfd, &header, body, sizeof(body)) || RESPONSE_UUID != header.type)
+            result = -1;
+    }
+    close(sockfd);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    g_pconf = (pconf_t *)malloc(sizeof(pconf_t));
+    init_config(g_pconf);
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "b:p:n:w:")))
+    {
+        switch (opt)
+        {
+        case 'b':
+            if (0 == strcmp(optarg, "uring"))
+            {
+#ifdef HAVE_IO_URING
+                g_pconf->io_backend = IO_BACKEND_URING;
+#else
+                fprintf(stderr, "io_uring backend is not compiled in\n");
+                return -1;
+#endif
+            }
+            else
+                g_pconf->io_backend = IO_BACKEND_EPOLL;
+            break;
+        case 'p':
+            bench_port = atoi(optarg);
+            break;
+        case 'n':
+            bench_conn_num = atoi(optarg);
+            break;
+        case 'w':
+            bench_wait_ms = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b epoll|uring] [-p port] [-n conns] [-w wait_ms]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (bench_conn_num < 1 || bench_wait_ms < 0)
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return -1;
+    }
+
+    FILE *report = bench_silence_stdout();
+    if (0 != load_config(g_pconf, bench_port) || 0 != init_main())
+    {
+        fprintf(report, "can't start server components\n");
+        return -1;
+    }
+
+    pthread_t handler_pid;
+    if (0 != pthread_create(&handler_pid, NULL, event_handler_main, NULL) || 0 != start_workers() ||
+        0 != start_reactors())
+        return -1;
+
+    uint64_t begin = bench_now_ns();
+    for (int i = 0; i < bench_conn_num; i++)
+    {
+        if (0 > bench_churn_one(0 == i % 2))
+        {
+            fprintf(report, "connection %d (registered players %d) did not get RESPONSE_UUID\n", i,
+                    get_player_info_array_length());
+            fflush(report);
+            _exit(EXIT_FAILURE);
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    // 所有连接都已经断开，注册表应该很快清空
+    uint64_t deadline = bench_now_ns() + bench_wait_ms * 1000000ull;
+    int remain;
+    while (0 != (remain = get_player_info_array_length()) && bench_now_ns() < deadline)
+        usleep(1000);
+    uint64_t drained = bench_now_ns() - begin - elapsed;
+
+    fprintf(report, "backend=%s conns=%d slots=%d conn_rate=%.0f conn/s registered_after=%d drain=%.1f ms\n",
+            io_backend_name(g_pconf->io_backend), bench_conn_num, MAX_CONNECTION_NUM, bench_conn_num * 1e9 / elapsed,
+            remain, drained / 1e6);
+    fflush(report);
+
+    g_over = true;
+    _exit(0 == remain ? 0 : EXIT_FAILURE);
+}
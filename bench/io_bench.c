@@ -0,0 +1,185 @@
+/**
+ * io_bench：在回环地址上比较 epoll 与 io_uring 两种 I/O 后端的广播吞吐量和每条消息的系统调用数。
+ *
+ * 在进程内拉起完整的服务器（reactor + handler + sender worker），若干个客户端线程平均分到 rooms 个房间中
+ * （第 i 个客户端进入 i % rooms 号房间），按轮次同步发送：每一轮每个客户端发送 batch 条 GAME_UPDATE，
+ * 然后等待收齐同一个房间中其他客户端这一轮广播过来的 batch * (clients / rooms - 1) 条，
+ * 这样每个连接的发送队列中最多只有两轮的帧，不会因为队列满而丢帧。
+ *
+ * 系统调用数只统计服务器一侧（COUNT_SYSCALL 标记的调用点），客户端的读写不计入。
+ *
+ * 用法：io_bench [-b epoll|uring] [-r reactor_num] [-W worker_num] [-g rooms] [-p port] [-c clients] [-n rounds] [-k batch]
+ * 例如：./io_bench -b epoll && ./io_bench -b uring，或者 ./io_bench -W 4 -g 4 -c 32 比较多个房间分摊到多个 worker 上的效果
+ */
+#include <boost_up.h>
+#include <getopt.h>
+#include <stdatomic.h>
+#include "bench_util.h"
+
+#define BENCH_PAYLOAD_LEN (PLAYER_ID_LEN + 52)
+
+static uint16_t bench_port = 17753;
+static int bench_client_num = 8;
+static int bench_round_num = 500;
+static int bench_batch = 8;
+static int bench_room_num = 1;
+
+static pthread_barrier_t bench_barrier;
+static atomic_int bench_failed;
+
+static void *bench_client_main(void *arg)
+{
+    uint32_t room = (uint32_t)(uintptr_t)arg % bench_room_num;
+    MessageHeader header;
+    char body[UNIT_BUFFER_SIZE];
+    char cert[sizeof(MessageHeader) + sizeof(room)];
+    bench_pack_upstream(cert, PLAYER_INFO_CERT, &room, sizeof(room));
+    // 收到 UUID 之后带上房间号认证，收到 GLOBAL_PLAYER_INFO 说明已经进入房间
+    int sockfd = bench_connect(bench_port);
+    if (0 > sockfd || 0 > bench_read_frame(sockfd, &header, body, sizeof(body)) ||
+        0 > bench_write_all(sockfd, cert, sizeof(cert)) || 0 > bench_read_frame(sockfd, &header, body, sizeof(body)) ||
+        GLOBAL_PLAYER_INFO != header.type)
+    {
+        perror("bench connect");
+        exit(EXIT_FAILURE);
+    }
+
+    char payload[BENCH_PAYLOAD_LEN];
+    memset(payload, 'x', sizeof(payload));
+    size_t frame_len = sizeof(MessageHeader) + BENCH_PAYLOAD_LEN;
+    char *batch = malloc(bench_batch * frame_len);
+    for (int i = 0; i < bench_batch; i++)
+        bench_pack_upstream(batch + i * frame_len, GAME_UPDATE, payload, sizeof(payload));
+
+    // 所有客户端连接完成之后同时开始，保证每个 GAME_UPDATE 都会广播给其他所有客户端
+    pthread_barrier_wait(&bench_barrier);
+
+    int expect_per_round = bench_batch * (bench_client_num / bench_room_num - 1);
+    for (int round = 0; round < bench_round_num; round++)
+    {
+        if (0 > bench_write_all(sockfd, batch, bench_batch * frame_len))
+            break;
+        for (int i = 0; i < expect_per_round; i++)
+        {
+            if (0 > bench_read_frame(sockfd, &header, body, sizeof(body)) || GAME_UPDATE != header.type)
+            {
+                atomic_store(&bench_failed, 1);
+                free(batch);
+                return NULL;
+            }
+        }
+    }
+    free(batch);
+    pthread_barrier_wait(&bench_barrier);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    g_pconf = (pconf_t *)malloc(sizeof(pconf_t));
+    init_config(g_pconf);
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "b:r:W:g:p:c:n:k:")))
+    {
+        switch (opt)
+        {
+        case 'b':
+            if (0 == strcmp(optarg, "uring"))
+            {
+#ifdef HAVE_IO_URING
+                g_pconf->io_backend = IO_BACKEND_URING;
+#else
+                fprintf(stderr, "io_uring backend is not compiled in\n");
+                return -1;
+#endif
+            }
+            else
+                g_pconf->io_backend = IO_BACKEND_EPOLL;
+            break;
+        case 'r':
+            g_pconf->reactor_num = atoi(optarg);
+            break;
+        case 'W':
+            g_pconf->worker_num = atoi(optarg);
+            break;
+        case 'g':
+            bench_room_num = atoi(optarg);
+            break;
+        case 'p':
+            bench_port = atoi(optarg);
+            break;
+        case 'c':
+            bench_client_num = atoi(optarg);
+            break;
+        case 'n':
+            bench_round_num = atoi(optarg);
+            break;
+        case 'k':
+            bench_batch = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b epoll|uring] [-r reactor_num] [-W worker_num] [-g rooms] [-p port] [-c clients] [-n rounds] [-k batch]\n", argv[0]);
+            return -1;
+        }
+    }
+    // 落后一轮的客户端的发送队列中最多同时有两轮的帧
+    if (g_pconf->reactor_num < 1 || g_pconf->reactor_num > MAX_REACTOR_NUM || g_pconf->worker_num < 1 ||
+        g_pconf->worker_num > MAX_WORKER_NUM || bench_room_num < 1 || bench_room_num > MAX_ROOM_NUM ||
+        0 != bench_client_num % bench_room_num || bench_client_num / bench_room_num < 2 || bench_round_num < 1 ||
+        bench_batch < 1 || 2 * bench_batch * (bench_client_num / bench_room_num - 1) > OUT_QUEUE_FRAME_NUM)
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return -1;
+    }
+
+    FILE *report = bench_silence_stdout();
+    if (0 != load_config(g_pconf, bench_port) || 0 != init_main())
+    {
+        fprintf(report, "can't start server components\n");
+        return -1;
+    }
+
+    pthread_t handler_pid;
+    if (0 != pthread_create(&handler_pid, NULL, event_handler_main, NULL) || 0 != start_workers() ||
+        0 != start_reactors())
+        return -1;
+
+    pthread_barrier_init(&bench_barrier, NULL, bench_client_num + 1);
+    pthread_t client_pids[bench_client_num];
+    for (int i = 0; i < bench_client_num; i++)
+        pthread_create(&client_pids[i], NULL, bench_client_main, (void *)(uintptr_t)i);
+
+    // 等待所有客户端连接完成、服务器下发完 UUID，再开始计时
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t syscall_begin = atomic_load(&g_syscall_count);
+    uint64_t begin = bench_now_ns();
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t elapsed = bench_now_ns() - begin;
+    uint64_t syscall_num = atomic_load(&g_syscall_count) - syscall_begin;
+    for (int i = 0; i < bench_client_num; i++)
+        pthread_join(client_pids[i], NULL);
+
+    if (atomic_load(&bench_failed))
+    {
+        fprintf(report, "client lost connection or received an unexpected frame\n");
+        fflush(report);
+        _exit(EXIT_FAILURE);
+    }
+
+    double inbound = (double)bench_client_num * bench_round_num * bench_batch;
+    double delivered = inbound * (bench_client_num / bench_room_num - 1);
+    fprintf(report, "backend=%s reactors=%d workers=%d rooms=%d clients=%d rounds=%d batch=%d inbound=%.0f delivered=%.0f\n",
+            io_backend_name(g_pconf->io_backend), g_reactor_num, g_worker_num, bench_room_num, bench_client_num,
+            bench_round_num, bench_batch, inbound, delivered);
+    fprintf(report, "  msg_rate=%.0f msg/s (delivered) syscalls=%" PRIu64 " syscalls/inbound_msg=%.3f syscalls/delivered_msg=%.3f\n",
+            delivered * 1e9 / elapsed, syscall_num, syscall_num / inbound, syscall_num / delivered);
+    fprintf(report, "  payload_slab=%zu KB (CQuery pool %zu x %zu B)\n",
+            slab_resident_bytes(&g_payload_slab) / 1024, g_query_num, sizeof(CQuery));
+    fprintf(report, "  io_buffer_slab=%zu KB (player_info %zu B x %d slots)\n",
+            slab_resident_bytes(&g_io_buffer_slab) / 1024, sizeof(player_info), MAX_CONNECTION_NUM);
+    fflush(report);
+
+    g_over = true;
+    _exit(0);
+}
@@ -0,0 +1,146 @@
+/**
+ * log_bench：比较热路径上一条调试日志的开销。
+ *
+ * - printf：原先的做法，行缓冲的 stdout（重定向到 /dev/null），每条日志一次格式化 + 一次 write；
+ * - disabled：LOG_DEBUG，但日志级别为 info，调用处只有一次 relaxed 读和一次比较；
+ * - async：LOG_DEBUG 开启，写日志的线程只把参数追加到自己的缓冲区中，由日志线程格式化之后写到 /dev/null。
+ *
+ * 每种模式用 -t 个线程各写 -n 条和 `minus_message_count` 中一样的日志（一个 UUID 字符串参数），
+ * 输出每条日志在写日志的线程上的平均耗时。日志每 -b 条为一批，async 模式下每批写完之后等日志线程把缓冲区取空，
+ * 等待的时间不计入耗时，这样测到的是缓冲区放得下时的开销；日志线程跟不上时日志会被丢弃，一并输出丢弃的条数。
+ *
+ * 用法：log_bench [-n logs] [-t threads] [-b burst]
+ */
+#include <boost_up.h>
+#include <getopt.h>
+#include "bench_util.h"
+
+typedef enum
+{
+    LOG_MODE_PRINTF,
+    LOG_MODE_DISABLED,
+    LOG_MODE_ASYNC,
+} log_mode_t;
+
+static const char *log_mode_names[] = {"printf", "disabled", "async"};
+
+static int bench_log_num = 200000;
+static int bench_thread_num = 1;
+static int bench_burst_num = 2000;
+static log_mode_t bench_mode;
+static const char *bench_id = "6f1c2f0e-8d7b-4c3e-9a51-2b7d9e4c1a30";
+
+/* 等日志线程把所有缓冲区取空 */
+static void bench_wait_drained()
+{
+    for (int i = 0; i < atomic_load(&g_log.ring_num); i++)
+    {
+        log_ring_t *ring = g_log.rings[i];
+        while (atomic_load(&ring->head) != atomic_load(&ring->tail))
+            usleep(1000);
+    }
+}
+
+static void *bench_log_main(void *arg)
+{
+    uint64_t *elapsed = (uint64_t *)arg;
+    *elapsed = 0;
+    for (int done = 0; done < bench_log_num; done += bench_burst_num)
+    {
+        int burst = bench_log_num - done < bench_burst_num ? bench_log_num - done : bench_burst_num;
+        uint64_t begin = bench_now_ns();
+        for (int i = 0; i < burst; i++)
+        {
+            if (LOG_MODE_PRINTF == bench_mode)
+                printf("(debug) \033[33m%s\033[0m message count --\n", bench_id);
+            else
+                LOG_DEBUG("%s message count --", bench_id);
+        }
+        *elapsed += bench_now_ns() - begin;
+        if (LOG_MODE_ASYNC == bench_mode)
+            bench_wait_drained();
+    }
+    return NULL;
+}
+
+/* 拉起 bench_thread_num 个线程写日志，返回每条日志的平均耗时 */
+static double bench_run(log_mode_t mode)
+{
+    bench_mode = mode;
+    pthread_t pids[bench_thread_num];
+    uint64_t elapsed[bench_thread_num];
+    for (int i = 0; i < bench_thread_num; i++)
+        pthread_create(&pids[i], NULL, bench_log_main, &elapsed[i]);
+    uint64_t total = 0;
+    for (int i = 0; i < bench_thread_num; i++)
+    {
+        pthread_join(pids[i], NULL);
+        total += elapsed[i];
+    }
+    return (double)total / ((double)bench_log_num * bench_thread_num);
+}
+
+/* 所有线程缓冲区中丢弃的日志条数 */
+static uint64_t bench_dropped()
+{
+    uint64_t dropped = atomic_load(&g_log.dropped);
+    for (int i = 0; i < atomic_load(&g_log.ring_num); i++)
+        dropped += atomic_load(&g_log.rings[i]->dropped);
+    return dropped;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "n:t:b:")))
+    {
+        switch (opt)
+        {
+        case 'n':
+            bench_log_num = atoi(optarg);
+            break;
+        case 't':
+            bench_thread_num = atoi(optarg);
+            break;
+        case 'b':
+            bench_burst_num = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n logs] [-t threads] [-b burst]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (bench_log_num < 1 || bench_thread_num < 1 || bench_thread_num >= LOG_MAX_THREAD_NUM || bench_burst_num < 1)
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return -1;
+    }
+
+    FILE *report = bench_silence_stdout();
+    // 和终端上一样按行刷出
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    FILE *sink = fopen("/dev/null", "w");
+    if (NULL == sink || 0 != init_log(LOG_LEVEL_INFO, sink))
+    {
+        fprintf(report, "can't start log thread\n");
+        return -1;
+    }
+
+    fprintf(report, "threads=%d logs=%d burst=%d ring=%d\n", bench_thread_num, bench_log_num, bench_burst_num, LOG_RING_SIZE);
+    for (int mode = LOG_MODE_PRINTF; mode <= LOG_MODE_ASYNC; mode++)
+    {
+        if (LOG_MODE_ASYNC == mode)
+            atomic_store(&g_log_level, LOG_LEVEL_DEBUG);
+        uint64_t dropped_begin = bench_dropped();
+        double ns = bench_run(mode);
+        fprintf(report, "  %s: %.1f ns/log", log_mode_names[mode], ns);
+        if (LOG_MODE_ASYNC == mode)
+            fprintf(report, " dropped=%" PRIu64, bench_dropped() - dropped_begin);
+        fprintf(report, "\n");
+    }
+    fflush(report);
+
+    destroy_log();
+    fclose(sink);
+    return 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * queue_bench：比较 ready/work 队列的几种实现在多生产者竞争下的吞吐量。
+ *
+ * - mutex_list：原先 add_gready_list/get_gready_query 的做法，一把全局互斥锁 + 双向链表重新链接；
+ * - mpsc_ring / spsc_ring：现在使用的无锁环形队列，逐个入队出队；
+ * - *_batch：无锁环形队列的批量入队出队。
+ *
+ * 每个生产者线程各自入队 n 个元素，单个消费者线程全部取出后计时结束。
+ *
+ * 用法：queue_bench [-p max_producers] [-n items_per_producer] [-b batch]
+ */
+#include <boost_up.h>
+#include <getopt.h>
+#include <sched.h>
+#include "bench_util.h"
+
+#define BENCH_RING_CAPACITY 8192
+
+typedef enum
+{
+    IMPL_MUTEX_LIST = 0,
+    IMPL_MPSC_RING,
+    IMPL_MPSC_RING_BATCH,
+    IMPL_SPSC_RING,
+    IMPL_SPSC_RING_BATCH
+} queue_impl;
+
+static const char *impl_names[] = {"mutex_list", "mpsc_ring", "mpsc_ring_batch", "spsc_ring", "spsc_ring_batch"};
+
+// 与 CQuery 中的 p_pre_query/p_next_query 一致的双向链表节点
+typedef struct _bench_node
+{
+    struct _bench_node *pre;
+    struct _bench_node *next;
+} bench_node;
+
+static pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bench_node *list_head = NULL;
+static bench_node *list_tail = NULL;
+
+static mpsc_ring bench_mpsc;
+static spsc_ring bench_spsc;
+
+static queue_impl bench_impl;
+static size_t bench_item_num = 1000000;
+static size_t bench_batch = 32;
+static atomic_int bench_start;
+
+/* 与原先 add_gready_list 相同的逻辑 */
+static void list_push(bench_node *node)
+{
+    pthread_mutex_lock(&list_mutex);
+    if (NULL == list_head)
+    {
+        node->pre = NULL;
+        node->next = NULL;
+        list_head = node;
+        list_tail = node;
+    }
+    else
+    {
+        node->pre = list_tail;
+        node->next = NULL;
+        list_tail->next = node;
+        list_tail = node;
+    }
+    pthread_mutex_unlock(&list_mutex);
+}
+
+/* 与原先 get_gready_query 相同的逻辑 */
+static bench_node *list_pop()
+{
+    pthread_mutex_lock(&list_mutex);
+    if (NULL == list_head)
+    {
+        pthread_mutex_unlock(&list_mutex);
+        return NULL;
+    }
+    bench_node *node = list_head;
+    list_head = node->next;
+    if (NULL != list_head)
+        list_head->pre = NULL;
+    pthread_mutex_unlock(&list_mutex);
+
+    node->pre = NULL;
+    node->next = NULL;
+    return node;
+}
+
+static void *producer_main(void *arg)
+{
+    bench_node *nodes = (bench_node *)arg;
+    while (!atomic_load(&bench_start))
+        ;
+
+    for (size_t i = 0; i < bench_item_num;)
+    {
+        size_t num;
+        void *batch[bench_batch];
+        switch (bench_impl)
+        {
+        case IMPL_MUTEX_LIST:
+            list_push(&nodes[i++]);
+            break;
+        case IMPL_MPSC_RING:
+            if (0 == mpsc_ring_push(&bench_mpsc, &nodes[i]))
+                i++;
+            else
+                sched_yield();
+            break;
+        case IMPL_MPSC_RING_BATCH:
+        case IMPL_SPSC_RING_BATCH:
+            num = (bench_item_num - i < bench_batch) ? bench_item_num - i : bench_batch;
+            for (size_t j = 0; j < num; j++)
+                batch[j] = &nodes[i + j];
+            num = (IMPL_MPSC_RING_BATCH == bench_impl) ? mpsc_ring_push_batch(&bench_mpsc, batch, num)
+                                                       : spsc_ring_push_batch(&bench_spsc, batch, num);
+            if (0 == num)
+                sched_yield();
+            i += num;
+            break;
+        case IMPL_SPSC_RING:
+            if (0 == spsc_ring_push(&bench_spsc, &nodes[i]))
+                i++;
+            else
+                sched_yield();
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void consume(size_t total)
+{
+    void *batch[QUERY_BATCH_NUM];
+    size_t count = 0;
+    while (count < total)
+    {
+        size_t num = 0;
+        switch (bench_impl)
+        {
+        case IMPL_MUTEX_LIST:
+            num = (NULL != list_pop()) ? 1 : 0;
+            break;
+        case IMPL_MPSC_RING:
+            num = (NULL != mpsc_ring_pop(&bench_mpsc)) ? 1 : 0;
+            break;
+        case IMPL_MPSC_RING_BATCH:
+            num = mpsc_ring_pop_batch(&bench_mpsc, batch, QUERY_BATCH_NUM);
+            break;
+        case IMPL_SPSC_RING:
+            num = (NULL != spsc_ring_pop(&bench_spsc)) ? 1 : 0;
+            break;
+        case IMPL_SPSC_RING_BATCH:
+            num = spsc_ring_pop_batch(&bench_spsc, batch, QUERY_BATCH_NUM);
+            break;
+        }
+        if (0 == num)
+            sched_yield();
+        count += num;
+    }
+}
+
+static void run(queue_impl impl, int producer_num, bench_node **nodes)
+{
+    bench_impl = impl;
+    atomic_store(&bench_start, 0);
+
+    pthread_t pids[producer_num];
+    for (int i = 0; i < producer_num; i++)
+        pthread_create(&pids[i], NULL, producer_main, nodes[i]);
+
+    uint64_t begin = bench_now_ns();
+    atomic_store(&bench_start, 1);
+    consume(bench_item_num * producer_num);
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    for (int i = 0; i < producer_num; i++)
+        pthread_join(pids[i], NULL);
+
+    double ops = (double)bench_item_num * producer_num;
+    printf("%-16s producers=%d ops=%.0f ops/s=%.0f ns/op=%.1f\n",
+           impl_names[impl], producer_num, ops, ops * 1e9 / elapsed, elapsed / ops);
+}
+
+int main(int argc, char *argv[])
+{
+    int max_producer_num = 4;
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "p:n:b:")))
+    {
+        switch (opt)
+        {
+        case 'p':
+            max_producer_num = atoi(optarg);
+            break;
+        case 'n':
+            bench_item_num = atol(optarg);
+            break;
+        case 'b':
+            bench_batch = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p max_producers] [-n items_per_producer] [-b batch]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (max_producer_num < 1 || 0 == bench_item_num || 0 == bench_batch)
+        return -1;
+
+    bench_node *nodes[max_producer_num];
+    for (int i = 0; i < max_producer_num; i++)
+        nodes[i] = calloc(bench_item_num, sizeof(bench_node));
+    mpsc_ring_init(&bench_mpsc, BENCH_RING_CAPACITY);
+    spsc_ring_init(&bench_spsc, BENCH_RING_CAPACITY);
+
+    // reactor -> handler：多生产者
+    for (int producer_num = 1; producer_num <= max_producer_num; producer_num *= 2)
+    {
+        run(IMPL_MUTEX_LIST, producer_num, nodes);
+        run(IMPL_MPSC_RING, producer_num, nodes);
+        run(IMPL_MPSC_RING_BATCH, producer_num, nodes);
+    }
+
+    // handler -> sender：单生产者
+    run(IMPL_MUTEX_LIST, 1, nodes);
+    run(IMPL_SPSC_RING, 1, nodes);
+    run(IMPL_SPSC_RING_BATCH, 1, nodes);
+    return 0;
+}
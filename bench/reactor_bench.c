@@ -0,0 +1,239 @@
+/**
+ * reactor_bench：测量接收 reactor 数量对 accept 速率和上行消息吞吐量的影响。
+ *
+ * 在进程内拉起 init_main 创建的所有 reactor，用若干个“排空线程”代替 handler/sender：
+ * 收到 RESPONSE_UUID 时把 UUID 回给客户端（玩家在 accept 时已经登记），收到其他消息时只计数并归还 CQuery。
+ * 这样测到的就是 accept + CQuery_recv_message 这一段的能力，不受广播开销影响。
+ *
+ * 用法：reactor_bench [-r reactor_num] [-m reuseport|exclusive] [-p port] [-c conns] [-n msgs] [-t threads]
+ * 例如：for r in 1 2 4 8; do ./reactor_bench -r $r; done
+ */
+#include <boost_up.h>
+#include <getopt.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include "bench_util.h"
+
+#define BENCH_DRAIN_THREAD_NUM 2
+#define BENCH_MAX_FD 65536
+// 每个连接最多允许在途的消息数，保证 reactor 侧的接收缓冲区和 CQuery 池都不会被压爆
+#define BENCH_WINDOW 16
+#define BENCH_BATCH 8
+#define BENCH_PAYLOAD_LEN (PLAYER_ID_LEN + 52)
+
+typedef struct
+{
+    int first_conn;
+    int conn_num;
+} client_range;
+
+static uint16_t bench_port = 16753;
+static int bench_conn_num = 128;
+static int bench_msg_num = 2000;
+static int bench_client_thread_num = 4;
+
+static int *bench_socks = NULL;
+static int *bench_ports = NULL;
+// 服务器端 fd 与客户端本地端口是两套编号，这里用客户端端口作为连接的统一标识
+static uint16_t bench_port_by_server_fd[BENCH_MAX_FD];
+static atomic_int bench_recv_by_port[65536];
+
+/* 代替 handler + sender 的排空线程 */
+static void *bench_drain_main(void *arg)
+{
+    (void)arg;
+    CQuery *query;
+    while (!g_over)
+    {
+        // 单核机器上空转会抢走 reactor 的时间片，取不到消息时主动让出 CPU
+        if (NULL == (query = get_gready_query()))
+        {
+            sched_yield();
+            continue;
+        }
+
+        if (RESPONSE_UUID == query->m_header.type)
+        {
+            struct sockaddr_in peer;
+            socklen_t peer_len = sizeof(peer);
+            getpeername(query->m_socket_fd, (struct sockaddr *)&peer, &peer_len);
+            bench_port_by_server_fd[query->m_socket_fd] = ntohs(peer.sin_port);
+
+            CQuery_pack_message(query);
+            bench_write_all(query->m_socket_fd, query->m_byte_Query, query->m_query_len);
+        }
+        else if (query->m_socket_fd >= 0 && query->m_socket_fd < BENCH_MAX_FD)
+        {
+            uint16_t port = bench_port_by_server_fd[query->m_socket_fd];
+            atomic_fetch_add_explicit(&bench_recv_by_port[port], 1, memory_order_relaxed);
+        }
+        add_free_list(query);
+    }
+    return NULL;
+}
+
+/* 连接阶段：建立连接并等待服务器下发 UUID */
+static void *bench_connect_main(void *arg)
+{
+    client_range *range = (client_range *)arg;
+    MessageHeader header;
+    char body[UNIT_BUFFER_SIZE];
+    for (int i = range->first_conn; i < range->first_conn + range->conn_num; i++)
+    {
+        if (0 > (bench_socks[i] = bench_connect(bench_port)) ||
+            0 > bench_read_frame(bench_socks[i], &header, body, sizeof(body)))
+        {
+            perror("bench connect");
+            exit(EXIT_FAILURE);
+        }
+        struct sockaddr_in local;
+        socklen_t local_len = sizeof(local);
+        getsockname(bench_socks[i], (struct sockaddr *)&local, &local_len);
+        bench_ports[i] = ntohs(local.sin_port);
+    }
+    return NULL;
+}
+
+/* 吞吐阶段：每个连接以 BENCH_WINDOW 为窗口持续发送 GAME_UPDATE */
+static void *bench_send_main(void *arg)
+{
+    client_range *range = (client_range *)arg;
+    char payload[BENCH_PAYLOAD_LEN];
+    memset(payload, 'x', sizeof(payload));
+
+    char batch[BENCH_BATCH * (sizeof(MessageHeader) + BENCH_PAYLOAD_LEN)];
+    size_t batch_len = 0;
+    for (int i = 0; i < BENCH_BATCH; i++)
+        batch_len += bench_pack_upstream(batch + batch_len, GAME_UPDATE, payload, sizeof(payload));
+
+    int *sent = calloc(range->conn_num, sizeof(int));
+    int finished = 0;
+    while (finished < range->conn_num)
+    {
+        int progress = 0;
+        finished = 0;
+        for (int i = 0; i < range->conn_num; i++)
+        {
+            int sockfd = bench_socks[range->first_conn + i];
+            int port = bench_ports[range->first_conn + i];
+            if (sent[i] >= bench_msg_num)
+            {
+                finished++;
+                continue;
+            }
+            int in_flight = sent[i] - atomic_load_explicit(&bench_recv_by_port[port], memory_order_relaxed);
+            if (in_flight + BENCH_BATCH > BENCH_WINDOW)
+                continue;
+            if (0 > bench_write_all(sockfd, batch, batch_len))
+            {
+                perror("bench write");
+                exit(EXIT_FAILURE);
+            }
+            sent[i] += BENCH_BATCH;
+            progress++;
+        }
+        if (0 == progress)
+            sched_yield();
+    }
+    free(sent);
+    return NULL;
+}
+
+static void bench_run_clients(void *(*routine)(void *), client_range *ranges)
+{
+    pthread_t pids[bench_client_thread_num];
+    for (int i = 0; i < bench_client_thread_num; i++)
+        pthread_create(&pids[i], NULL, routine, &ranges[i]);
+    for (int i = 0; i < bench_client_thread_num; i++)
+        pthread_join(pids[i], NULL);
+}
+
+int main(int argc, char *argv[])
+{
+    g_pconf = (pconf_t *)malloc(sizeof(pconf_t));
+    init_config(g_pconf);
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "r:m:p:c:n:t:")))
+    {
+        switch (opt)
+        {
+        case 'r':
+            g_pconf->reactor_num = atoi(optarg);
+            break;
+        case 'm':
+            g_pconf->listen_mode = (0 == strcmp(optarg, "exclusive")) ? LISTEN_EXCLUSIVE : LISTEN_REUSEPORT;
+            break;
+        case 'p':
+            bench_port = atoi(optarg);
+            break;
+        case 'c':
+            bench_conn_num = atoi(optarg);
+            break;
+        case 'n':
+            bench_msg_num = atoi(optarg) / BENCH_BATCH * BENCH_BATCH;
+            break;
+        case 't':
+            bench_client_thread_num = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r reactor_num] [-m reuseport|exclusive] [-p port] [-c conns] [-n msgs] [-t threads]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (g_pconf->reactor_num < 1 || g_pconf->reactor_num > MAX_REACTOR_NUM || bench_client_thread_num < 1 ||
+        bench_conn_num < bench_client_thread_num || bench_conn_num * BENCH_WINDOW >= (int)g_query_num)
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return -1;
+    }
+
+    FILE *report = bench_silence_stdout();
+    if (0 != load_config(g_pconf, bench_port) || 0 != init_main())
+    {
+        fprintf(report, "can't start server components\n");
+        return -1;
+    }
+
+    pthread_t drain_pids[BENCH_DRAIN_THREAD_NUM];
+    for (int i = 0; i < BENCH_DRAIN_THREAD_NUM; i++)
+        pthread_create(&drain_pids[i], NULL, bench_drain_main, NULL);
+    if (0 != start_reactors())
+        return -1;
+
+    bench_socks = calloc(bench_conn_num, sizeof(int));
+    bench_ports = calloc(bench_conn_num, sizeof(int));
+    client_range ranges[bench_client_thread_num];
+    for (int i = 0; i < bench_client_thread_num; i++)
+    {
+        ranges[i].first_conn = i * (bench_conn_num / bench_client_thread_num);
+        ranges[i].conn_num = (i == bench_client_thread_num - 1)
+                                 ? bench_conn_num - ranges[i].first_conn
+                                 : bench_conn_num / bench_client_thread_num;
+    }
+
+    // 连接阶段
+    uint64_t begin = bench_now_ns();
+    bench_run_clients(bench_connect_main, ranges);
+    uint64_t accept_ns = bench_now_ns() - begin;
+
+    // 吞吐阶段：等待所有 reactor 解析出的消息数达到预期
+    uint64_t expect = (uint64_t)bench_conn_num * bench_msg_num + get_reactors_recv_msg_count();
+    begin = bench_now_ns();
+    bench_run_clients(bench_send_main, ranges);
+    while (get_reactors_recv_msg_count() < expect)
+        usleep(100);
+    uint64_t recv_ns = bench_now_ns() - begin;
+
+    fprintf(report, "reactors=%d mode=%s conns=%d accept_rate=%.0f conn/s msgs=%" PRIu64 " msg_rate=%.0f msg/s\n",
+            g_reactor_num, LISTEN_EXCLUSIVE == g_pconf->listen_mode ? "exclusive" : "reuseport",
+            bench_conn_num, bench_conn_num * 1e9 / accept_ns,
+            (uint64_t)bench_conn_num * bench_msg_num, (double)bench_conn_num * bench_msg_num * 1e9 / recv_ns);
+    for (int i = 0; i < g_reactor_num; i++)
+        fprintf(report, "  reactor %d: accepted %" PRIu64 ", messages %" PRIu64 "\n", i,
+                (uint64_t)atomic_load(&g_reactors[i].accept_count), (uint64_t)atomic_load(&g_reactors[i].recv_msg_count));
+    fflush(report);
+
+    g_over = true;
+    _exit(0);
+}
@@ -0,0 +1,208 @@
+/**
+ * snapshot_bench：比较 tick 模式下完整快照（GAME_SNAPSHOT）和增量快照（GAME_SNAPSHOT_DELTA）每个 tick 下发给一个客户端的字节数。
+ *
+ * 模拟 players 个玩家，其中 moving% 的玩家每个 tick 都在移动（位置变化，每 4 个 tick 转一次身），其余玩家站着不动；
+ * 客户端的确认落后 lag 个 tick（模拟往返延迟），服务器以它确认的快照为基线编码。
+ * 完整快照模式下客户端每个物理帧都会上报状态，所以每个 tick 包含所有玩家的完整记录。
+ *
+ * 两种快照都分别按旧格式（记录中带 UUID）和紧凑 id 模式（记录中带 2 字节的 slot id）统计。
+ * 每个增量快照都会按客户端的方式解码，并和服务器的快照逐字节比较，保证编码是正确的。
+ *
+ * 用法：snapshot_bench [-p players] [-m moving_percent] [-n ticks] [-l ack_lag]
+ * 不指定 -m 时依次测量 0%、10%、50%、100% 的玩家在移动。
+ */
+#include <boost_up.h>
+#include <getopt.h>
+#include <math.h>
+#include "bench_util.h"
+
+static int bench_player_num = 64;
+static int bench_tick_num = 2000;
+static int bench_ack_lag = 3;
+
+/* 和 Godot var_to_bytes(Transform3D) 的布局一致：4 字节类型 + 3x3 基 + 原点，全部是 float */
+typedef struct
+{
+    uint32_t type;
+    float basis[9];
+    float origin[3];
+} bench_transform;
+
+static void bench_move(bench_transform *transform, int tick)
+{
+    transform->origin[0] += 0.05f;
+    transform->origin[2] -= 0.03f;
+    if (0 == tick % 4)
+    {
+        float angle = tick * 0.01f;
+        transform->basis[0] = cosf(angle);
+        transform->basis[2] = -sinf(angle);
+        transform->basis[6] = sinf(angle);
+        transform->basis[8] = cosf(angle);
+    }
+}
+
+/* 客户端的解码：以基线快照为参照重建出完整的记录列表，返回记录数，格式错误返回 -1 */
+static int bench_decode(const char *msg, int len, const snapshot_t *base, bool compact, snapshot_record_t *out)
+{
+    const char *p = msg + header_size + 8;
+    const char *end = msg + len;
+    int num = 0;
+    while (p < end)
+    {
+        int tag = *p++;
+        if (SNAPSHOT_RECORD_FULL == tag && compact)
+        {
+            uint16_t slot_id;
+            memcpy(&slot_id, p, SLOT_ID_LEN);
+            out[num].slot = slot_id;
+            memcpy(out[num++].transform, p + SLOT_ID_LEN, TRANSFORM_LEN);
+            p += COMPACT_UPDATE_LEN;
+            continue;
+        }
+        if (SNAPSHOT_RECORD_FULL == tag)
+        {
+            memcpy(out[num].id, p, PLAYER_ID_LEN);
+            memcpy(out[num++].transform, p + PLAYER_ID_LEN, TRANSFORM_LEN);
+            p += GAME_UPDATE_LEN;
+            continue;
+        }
+        uint16_t index, value;
+        memcpy(&index, p, sizeof(index));
+        memcpy(&value, p + 2, sizeof(value));
+        p += 4;
+        if (NULL == base)
+            return -1;
+        if (SNAPSHOT_RECORD_SAME == tag)
+        {
+            for (int i = 0; i < value; i++)
+                out[num++] = base->records[index + i];
+            continue;
+        }
+        out[num] = base->records[index];
+        for (int w = 0; w < SNAPSHOT_WORD_NUM; w++)
+        {
+            if (value & (1u << w))
+            {
+                memcpy(out[num].transform + w * 4, p, 4);
+                p += 4;
+            }
+        }
+        num++;
+    }
+    return num;
+}
+
+static void bench_run(int moving_percent)
+{
+    snapshot_history_t history;
+    if (0 != snapshot_history_init(&history))
+    {
+        fprintf(stderr, "snapshot_history_init failed\n");
+        exit(EXIT_FAILURE);
+    }
+    bench_transform *transforms = calloc(bench_player_num, sizeof(bench_transform));
+    char (*ids)[PLAYER_ID_LEN + 1] = malloc((size_t)bench_player_num * (PLAYER_ID_LEN + 1));
+    snapshot_record_t *decoded = malloc(sizeof(snapshot_record_t) * SNAPSHOT_MAX_RECORDS);
+    static char buffer[UINT16_MAX];
+    for (int i = 0; i < bench_player_num; i++)
+    {
+        snprintf(ids[i], PLAYER_ID_LEN + 1, "%08x-0000-4000-8000-%012x", i, i);
+        transforms[i].type = 18;
+        transforms[i].basis[0] = transforms[i].basis[4] = transforms[i].basis[8] = 1.0f;
+        transforms[i].origin[0] = (float)i;
+    }
+    int moving_num = bench_player_num * moving_percent / 100;
+
+    uint64_t delta_bytes[2] = {0, 0}, encode_ns = 0;
+    uint32_t acked = 0;
+    for (int tick = 1; tick <= bench_tick_num; tick++)
+    {
+        for (int i = 0; i < moving_num; i++)
+            bench_move(&transforms[i], tick);
+        snapshot_t *snapshot = snapshot_begin(&history);
+        for (int i = 0; i < bench_player_num; i++)
+            snapshot_add(snapshot, i, ids[i], (const char *)&transforms[i]);
+
+        const snapshot_t *base = snapshot_find(&history, acked);
+        for (int compact = 0; compact < 2; compact++)
+        {
+            uint64_t begin = bench_now_ns();
+            int len = snapshot_encode(snapshot, base, compact, buffer);
+            if (!compact)
+                encode_ns += bench_now_ns() - begin;
+            delta_bytes[compact] += len;
+
+            bool match = snapshot->record_num == bench_decode(buffer, len, base, compact, decoded);
+            for (int i = 0; match && i < snapshot->record_num; i++)
+                match = (compact ? decoded[i].slot == snapshot->records[i].slot
+                                 : 0 == memcmp(decoded[i].id, snapshot->records[i].id, PLAYER_ID_LEN)) &&
+                        0 == memcmp(decoded[i].transform, snapshot->records[i].transform, TRANSFORM_LEN);
+            if (!match)
+            {
+                fprintf(stderr, "decoded snapshot %u (compact=%d) does not match\n", snapshot->seq, compact);
+                exit(EXIT_FAILURE);
+            }
+        }
+        // 客户端在 lag 个 tick 之后才确认这个快照
+        if (tick > bench_ack_lag)
+            acked = tick - bench_ack_lag;
+    }
+
+    double full_bytes = header_size + (double)bench_player_num * GAME_UPDATE_LEN;
+    double compact_full_bytes = header_size + (double)bench_player_num * COMPACT_UPDATE_LEN;
+    double delta_avg = (double)delta_bytes[0] / bench_tick_num;
+    double compact_delta_avg = (double)delta_bytes[1] / bench_tick_num;
+    printf("players=%d moving=%d%% ticks=%d ack_lag=%d  full=%.0f B/tick  delta=%.1f B/tick  ratio=%.3f  encode=%.0f ns/snapshot\n",
+           bench_player_num, moving_percent, bench_tick_num, bench_ack_lag, full_bytes, delta_avg, delta_avg / full_bytes,
+           (double)encode_ns / bench_tick_num);
+    printf("  compact ids: full=%.0f B/tick  delta=%.1f B/tick\n", compact_full_bytes, compact_delta_avg);
+
+    free(decoded);
+    free(ids);
+    free(transforms);
+    snapshot_history_destroy(&history);
+}
+
+int main(int argc, char *argv[])
+{
+    int moving_percent = -1;
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "p:m:n:l:")))
+    {
+        switch (opt)
+        {
+        case 'p':
+            bench_player_num = atoi(optarg);
+            break;
+        case 'm':
+            moving_percent = atoi(optarg);
+            break;
+        case 'n':
+            bench_tick_num = atoi(optarg);
+            break;
+        case 'l':
+            bench_ack_lag = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p players] [-m moving_percent] [-n ticks] [-l ack_lag]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (bench_player_num < 1 || bench_player_num > SNAPSHOT_MAX_RECORDS || moving_percent > 100 || bench_tick_num < 1 ||
+        bench_ack_lag < 1 || bench_ack_lag >= SNAPSHOT_HISTORY_NUM)
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return -1;
+    }
+
+    if (0 <= moving_percent)
+        bench_run(moving_percent);
+    else
+    {
+        int percents[] = {0, 10, 50, 100};
+        for (size_t i = 0; i < sizeof(percents) / sizeof(percents[0]); i++)
+            bench_run(percents[i]);
+    }
+    return 0;
+}
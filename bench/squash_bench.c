@@ -0,0 +1,439 @@
+/**
+ * squash_bench：单独测量服务器热路径上几个基本操作的开销，以 JSON 输出，用来比较每次改动前后的数字。
+ *
+ * - free_list：`get_free_query` + `add_free_list` 一对操作，1 到 -t 个线程同时争用空闲链表；
+ * - player_lookup：`get_player_info_by_sock`，注册表中分别有 10、100、MAX_CONNECTION_NUM 个玩家，按随机顺序查找；
+ * - pack_message：把 GAME_UPDATE 大小和 GLOBAL_PLAYER_INFO 大小的消息体打包成帧；
+ * - recv_message：`CQuery_recv_message` 从 socketpair 中读取并解析 GAME_UPDATE 流，对端每次只写入 fragment 个字节，
+ *   写完一段调用一次，模拟被拆散的 TCP 流；recv_buffer 是同样的数据经 `CQuery_recv_buffer`（io_uring 后端的入口）
+ *   直接解析，不经过系统调用。每条消息的耗时包括把解析出的 CQuery 从 ready 队列取出并还回空闲链表；
+ * - global_player_info：`package_global_player_info`，房间中分别有 10、100、MAX_CONNECTION_NUM 个玩家，
+ *   后者超出一个帧的部分会被略去。
+ *
+ * 每项先预热一轮，再测量 -r 轮，ns_per_op 和 ops_per_sec 取各轮的中位数。多线程的 free_list 中 ns_per_op
+ * 是每个线程看到的单次耗时（墙钟时间 x 线程数 / 总操作数），ops_per_sec 是所有线程合计的吞吐量。
+ * 链接时用 --wrap 把 malloc / calloc / realloc / free 转到这里计数，allocs_per_op 是测量期间每次操作的平均分配次数，
+ * 只统计 squash_core 和压测程序自己的调用。
+ *
+ * 用法：squash_bench [-s scale] [-r repetitions] [-t max_threads] [-f filter]
+ * -s 按比例调整每项的操作次数，-f 只运行名称中包含 filter 的项。
+ */
+#include <boost_up.h>
+#include <getopt.h>
+#include "bench_util.h"
+
+#define BENCH_MAX_THREAD_NUM 16
+#define BENCH_MAX_REPETITION_NUM 31
+#define BENCH_LOOKUP_NUM 4096   /*随机查找顺序的长度，必须是 2 的幂*/
+#define BENCH_FD_BASE 64        /*模拟玩家的 fd 从这里开始连续分配*/
+
+static double bench_scale = 1.0;
+static int bench_repetition_num = 5;
+static int bench_max_thread_num = 4;
+static const char *bench_filter = NULL;
+static bool bench_first_result = true;
+
+// ---------------------------------------------------
+// 分配计数
+
+static atomic_uint_fast64_t bench_alloc_count = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t num, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&bench_alloc_count, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t num, size_t size)
+{
+    atomic_fetch_add_explicit(&bench_alloc_count, 1, memory_order_relaxed);
+    return __real_calloc(num, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&bench_alloc_count, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    __real_free(ptr);
+}
+
+// ---------------------------------------------------
+// 测量框架
+
+typedef struct
+{
+    uint64_t ops;       // 本轮完成的操作数
+    uint64_t elapsed;   // 本轮的耗时（纳秒），多线程时为墙钟时间 x 线程数
+    uint64_t wall;      // 本轮的墙钟时间（纳秒）
+} bench_round_t;
+
+// 一项测量：run 执行一轮并返回结果，arg 为该项的参数
+typedef bench_round_t (*bench_fn)(int arg);
+
+static int bench_compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static uint64_t bench_ops(uint64_t base)
+{
+    uint64_t ops = (uint64_t)(base * bench_scale);
+    return ops > 0 ? ops : 1;
+}
+
+/* 预热一轮之后测量 bench_repetition_num 轮，输出一条 JSON 结果 */
+static void bench_run(const char *name, const char *param_name, int arg, bench_fn fn)
+{
+    if (NULL != bench_filter && NULL == strstr(name, bench_filter))
+        return;
+    fn(arg);
+
+    double ns_per_op[BENCH_MAX_REPETITION_NUM];
+    double ops_per_sec[BENCH_MAX_REPETITION_NUM];
+    uint64_t total_ops = 0;
+    uint64_t alloc_begin = atomic_load(&bench_alloc_count);
+    for (int i = 0; i < bench_repetition_num; i++)
+    {
+        bench_round_t round = fn(arg);
+        ns_per_op[i] = (double)round.elapsed / round.ops;
+        ops_per_sec[i] = round.ops * 1e9 / round.wall;
+        total_ops += round.ops;
+    }
+    uint64_t allocs = atomic_load(&bench_alloc_count) - alloc_begin;
+    qsort(ns_per_op, bench_repetition_num, sizeof(double), bench_compare_double);
+    qsort(ops_per_sec, bench_repetition_num, sizeof(double), bench_compare_double);
+
+    printf("%s\n    {\"name\": \"%s\", \"params\": {\"%s\": %d}, \"iterations\": %" PRIu64 ", "
+           "\"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, \"allocs_per_op\": %.4f}",
+           bench_first_result ? "" : ",", name, param_name, arg, total_ops / bench_repetition_num,
+           ns_per_op[bench_repetition_num / 2], ops_per_sec[bench_repetition_num / 2], (double)allocs / total_ops);
+    fflush(stdout);
+    bench_first_result = false;
+}
+
+// ---------------------------------------------------
+// free_list
+
+static uint64_t bench_free_list_ops;
+static pthread_barrier_t bench_barrier;
+
+static void *bench_free_list_main(void *arg)
+{
+    (void)arg;
+    pthread_barrier_wait(&bench_barrier);
+    for (uint64_t i = 0; i < bench_free_list_ops; i++)
+    {
+        CQuery *query = get_free_query();
+        if (NULL != query)
+            add_free_list(query);
+    }
+    pthread_barrier_wait(&bench_barrier);
+    return NULL;
+}
+
+static bench_round_t bench_free_list(int thread_num)
+{
+    pthread_t pids[BENCH_MAX_THREAD_NUM];
+    bench_free_list_ops = bench_ops(1000000) / thread_num;
+    pthread_barrier_init(&bench_barrier, NULL, thread_num + 1);
+    for (int i = 0; i < thread_num; i++)
+        pthread_create(&pids[i], NULL, bench_free_list_main, NULL);
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t begin = bench_now_ns();
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t wall = bench_now_ns() - begin;
+    for (int i = 0; i < thread_num; i++)
+        pthread_join(pids[i], NULL);
+    pthread_barrier_destroy(&bench_barrier);
+
+    bench_round_t round = {bench_free_list_ops * thread_num, wall * thread_num, wall};
+    return round;
+}
+
+// ---------------------------------------------------
+// 模拟玩家
+
+/* 向注册表中加入 num 个就绪的玩家，fd 从 BENCH_FD_BASE 开始连续分配，都在 0 号房间 */
+static int bench_add_players(int num)
+{
+    char id[PLAYER_ID_LEN + 1];
+    char name[MAX_PLAYER_NAME_LEN + 1];
+    for (int i = 0; i < num; i++)
+    {
+        snprintf(id, sizeof(id), "00000000-0000-4000-8000-%012d", i);
+        player_info *info = add_player_info(id, BENCH_FD_BASE + i);
+        if (NULL == info)
+            return -1;
+        snprintf(name, sizeof(name), "player%d", i);
+        strcpy(info->name, name);
+        info->ready = true;
+        info->room = 0;
+    }
+    return 0;
+}
+
+static void bench_clear_players()
+{
+    for (size_t i = 0; i < player_infos.length; i++)
+        player_infos.slots[player_infos.active[i]].room = -1;
+    clear_player_info_array();
+}
+
+// ---------------------------------------------------
+// player_lookup
+
+static bench_round_t bench_player_lookup(int player_num)
+{
+    static int fds[BENCH_LOOKUP_NUM];
+    unsigned seed = 1;
+    for (int i = 0; i < BENCH_LOOKUP_NUM; i++)
+        fds[i] = BENCH_FD_BASE + rand_r(&seed) % player_num;
+    bench_add_players(player_num);
+
+    uint64_t ops = bench_ops(10000000);
+    uintptr_t sink = 0;
+    uint64_t begin = bench_now_ns();
+    for (uint64_t i = 0; i < ops; i++)
+        sink += (uintptr_t)get_player_info_by_sock(fds[i & (BENCH_LOOKUP_NUM - 1)]);
+    uint64_t elapsed = bench_now_ns() - begin;
+    __asm__ volatile("" : : "r"(sink));
+
+    bench_clear_players();
+    bench_round_t round = {ops, elapsed, elapsed};
+    return round;
+}
+
+// ---------------------------------------------------
+// pack_message
+
+static bench_round_t bench_pack_message(int body_len)
+{
+    static char data[MAX_QUERY_LEN];
+    static char buffer[MAX_QUERY_LEN];
+    memset(data, 'x', body_len);
+
+    // 每一轮拷贝的总字节数相同
+    uint64_t ops = bench_ops(1000000000ull / (body_len + sizeof(MessageHeader)));
+    uint64_t begin = bench_now_ns();
+    for (uint64_t i = 0; i < ops; i++)
+    {
+        uint16_t len = body_len;
+        pack_message(GAME_UPDATE, data, &len, buffer);
+        __asm__ volatile("" : : "r"(buffer) : "memory");
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+    bench_round_t round = {ops, elapsed, elapsed};
+    return round;
+}
+
+// ---------------------------------------------------
+// recv_message / recv_buffer
+
+#define BENCH_STREAM_MSG_NUM 64 /*一段 GAME_UPDATE 流中的消息数*/
+
+static char bench_stream[BENCH_STREAM_MSG_NUM * (sizeof(MessageHeader) + GAME_UPDATE_LEN)];
+
+/* 把 ready 队列中解析出的消息还回空闲链表，返回消息数 */
+static int bench_drain_ready()
+{
+    CQuery *queries[QUERY_BATCH_NUM];
+    int num = 0;
+    size_t got;
+    while (0 < (got = get_gready_queries(queries, QUERY_BATCH_NUM)))
+    {
+        for (size_t i = 0; i < got; i++)
+            add_free_list(queries[i]);
+        num += got;
+    }
+    return num;
+}
+
+static void bench_init_stream(const char *id)
+{
+    char body[GAME_UPDATE_LEN];
+    memcpy(body, id, PLAYER_ID_LEN);
+    memset(body + PLAYER_ID_LEN, 0, TRANSFORM_LEN);
+    size_t len = 0;
+    for (int i = 0; i < BENCH_STREAM_MSG_NUM; i++)
+        len += bench_pack_upstream(bench_stream + len, GAME_UPDATE, body, GAME_UPDATE_LEN);
+}
+
+/* 每一轮喂入的消息流段数：按每条消息被拆成的段数缩减，让各种 fragment 的耗时在同一个量级 */
+static uint64_t bench_stream_num(uint64_t base, int fragment)
+{
+    uint64_t msg_len = sizeof(MessageHeader) + GAME_UPDATE_LEN;
+    uint64_t pieces = (msg_len + fragment - 1) / fragment;
+    uint64_t streams = bench_ops(base) / pieces / BENCH_STREAM_MSG_NUM;
+    return streams > 0 ? streams : 1;
+}
+
+static bench_round_t bench_recv_message(int fragment)
+{
+    int fds[2];
+    bench_round_t round = {1, 0, 1};
+    if (0 != socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds))
+        return round;
+    player_info *info = add_player_info("00000000-0000-4000-8000-000000000000", fds[0]);
+    bench_init_stream(info->id);
+
+    uint64_t streams = bench_stream_num(100000, fragment);
+    uint64_t msgs = 0;
+    uint64_t begin = bench_now_ns();
+    for (uint64_t s = 0; s < streams; s++)
+    {
+        for (size_t p = 0; p < sizeof(bench_stream); p += fragment)
+        {
+            size_t len = sizeof(bench_stream) - p < (size_t)fragment ? sizeof(bench_stream) - p : (size_t)fragment;
+            if (0 > bench_write_all(fds[1], bench_stream + p, len))
+                break;
+            CQuery_recv_message(info, -1, EPOLLIN);
+            msgs += bench_drain_ready();
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    bench_clear_players();
+    close(fds[0]);
+    close(fds[1]);
+    round.ops = msgs > 0 ? msgs : 1;
+    round.elapsed = elapsed;
+    round.wall = elapsed;
+    return round;
+}
+
+static bench_round_t bench_recv_buffer(int fragment)
+{
+    player_info *info = add_player_info("00000000-0000-4000-8000-000000000000", BENCH_FD_BASE);
+    bench_init_stream(info->id);
+
+    uint64_t streams = bench_stream_num(2000000, fragment);
+    uint64_t msgs = 0;
+    uint64_t begin = bench_now_ns();
+    for (uint64_t s = 0; s < streams; s++)
+    {
+        for (size_t p = 0; p < sizeof(bench_stream); p += fragment)
+        {
+            int len = sizeof(bench_stream) - p < (size_t)fragment ? sizeof(bench_stream) - p : (size_t)fragment;
+            CQuery_recv_buffer(info, bench_stream + p, len);
+            msgs += bench_drain_ready();
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    bench_clear_players();
+    bench_round_t round = {msgs > 0 ? msgs : 1, elapsed, elapsed};
+    return round;
+}
+
+// ---------------------------------------------------
+// global_player_info
+
+static bench_round_t bench_global_player_info(int player_num)
+{
+    bench_add_players(player_num);
+    uint64_t ops = bench_ops(200000) / player_num + 1;
+    uint64_t begin = bench_now_ns();
+    for (uint64_t i = 0; i < ops; i++)
+    {
+        int len = 0;
+        free(package_global_player_info(BENCH_FD_BASE, 0, false, &len));
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    bench_clear_players();
+    bench_round_t round = {ops, elapsed, elapsed};
+    return round;
+}
+
+// ---------------------------------------------------
+
+/* 只初始化被测函数用到的组件：CQuery 池和空闲链表、slab、ready 队列和玩家注册表，不拉起任何线程 */
+static int bench_init()
+{
+    static const size_t payload_sizes[] = {128, 512, 2048, 8192, 65536};
+    static const size_t io_buffer_sizes[] = {OUT_QUEUE_FRAMES_SIZE, RECV_BUFFER_SIZE};
+    slab_init(&g_payload_slab, payload_sizes, sizeof(payload_sizes) / sizeof(payload_sizes[0]));
+    slab_init(&g_io_buffer_slab, io_buffer_sizes, sizeof(io_buffer_sizes) / sizeof(io_buffer_sizes[0]));
+
+    CQuery *queries = (CQuery *)malloc(sizeof(CQuery) * g_query_num);
+    if (NULL == queries)
+        return -1;
+    init_query_list_lock();
+    for (size_t i = 0; i < g_query_num; i++)
+    {
+        CQuery_init(&queries[i]);
+        add_free_list(&queries[i]);
+    }
+    if (0 != init_query_list_ring(g_query_num) || 0 != init_query_list_wakeup(WAIT_POLICY_PARK, 0))
+        return -1;
+    if (0 != player_info_array_init())
+        return -1;
+    init_player_info_array_lock();
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "s:r:t:f:")))
+    {
+        switch (opt)
+        {
+        case 's':
+            bench_scale = atof(optarg);
+            break;
+        case 'r':
+            bench_repetition_num = atoi(optarg);
+            break;
+        case 't':
+            bench_max_thread_num = atoi(optarg);
+            break;
+        case 'f':
+            bench_filter = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s scale] [-r repetitions] [-t max_threads] [-f filter]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (!(bench_scale > 0) || bench_repetition_num < 1 || bench_repetition_num > BENCH_MAX_REPETITION_NUM ||
+        bench_max_thread_num < 1 || bench_max_thread_num > BENCH_MAX_THREAD_NUM)
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return -1;
+    }
+    if (0 != bench_init())
+    {
+        fprintf(stderr, "can't initialize server components\n");
+        return -1;
+    }
+
+    printf("{\n  \"benchmark\": \"squash_bench\",\n  \"repetitions\": %d,\n  \"scale\": %g,\n  \"results\": [",
+           bench_repetition_num, bench_scale);
+    for (int threads = 1; threads <= bench_max_thread_num; threads *= 2)
+        bench_run("free_list", "threads", threads, bench_free_list);
+    const int player_nums[] = {10, 100, MAX_CONNECTION_NUM};
+    for (int i = 0; i < 3; i++)
+        bench_run("player_lookup", "players", player_nums[i], bench_player_lookup);
+    bench_run("pack_message", "body_len", GAME_UPDATE_LEN, bench_pack_message);
+    bench_run("pack_message", "body_len", MAX_QUERY_LEN - (int)sizeof(MessageHeader), bench_pack_message);
+    const int fragments[] = {1, 7, sizeof(MessageHeader) + GAME_UPDATE_LEN, sizeof(bench_stream)};
+    for (int i = 0; i < 4; i++)
+        bench_run("recv_message", "fragment", fragments[i], bench_recv_message);
+    for (int i = 0; i < 4; i++)
+        bench_run("recv_buffer", "fragment", fragments[i], bench_recv_buffer);
+    for (int i = 0; i < 3; i++)
+        bench_run("global_player_info", "players", player_nums[i], bench_global_player_info);
+    printf("\n  ]\n}\n");
+    return 0;
+}
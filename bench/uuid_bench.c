@@ -0,0 +1,216 @@
+/**
+ * uuid_bench：比较两种 UUID 生成方式在 accept 路径上的开销。
+ *
+ * - proc：原先的实现，每个 UUID 都 fopen + fscanf + fclose 一次 /proc/sys/kernel/random/uuid；
+ * - pool：`generate_uuid`，从线程自己的随机数池中取随机字节，池空时一次 getrandom 取出 UUID_POOL_NUM 个。
+ *
+ * 先单线程连续生成 -n 个 UUID 测量单次生成的耗时，再在进程内拉起 reactor，用 -c 个连接制造连接风暴，
+ * 测量每个 accept（从 connect 到客户端收到 UUID）的平均耗时。
+ * 链接时用 --wrap=generate_uuid 把 accept 路径上的调用转到 `__wrap_generate_uuid`，由它按当前模式选择实现，
+ * 服务器本身的代码不需要为压测做任何改动。两种模式各自使用一批新的连接，连接风暴结束之后不断开。
+ *
+ * 用法：uuid_bench [-p port] [-c conns] [-n uuids] [-t threads]
+ */
+#include <boost_up.h>
+#include <getopt.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include "bench_util.h"
+
+#define BENCH_DRAIN_THREAD_NUM 2
+
+typedef enum
+{
+    UUID_MODE_PROC,
+    UUID_MODE_POOL,
+} uuid_mode_t;
+
+static const char *uuid_mode_names[] = {"proc", "pool"};
+
+static uint16_t bench_port = 18753;
+static int bench_conn_num = 1000;
+static int bench_uuid_num = 100000;
+static int bench_client_thread_num = 4;
+static atomic_int bench_uuid_mode = UUID_MODE_POOL;
+
+int __real_generate_uuid(char *uuid);
+
+/* 原先的实现，失败时直接退出进程 */
+static int proc_generate_uuid(char *uuid)
+{
+    COUNT_SYSCALL(3);   // open + read + close
+    FILE *file = fopen("/proc/sys/kernel/random/uuid", "r");
+    if (file == NULL)
+    {
+        perror("Error opening /proc/sys/kernel/random/uuid");
+        exit(EXIT_FAILURE);
+    }
+
+    if (fscanf(file, "%36s", uuid) != 1)
+    {
+        perror("Error reading UUID");
+        fclose(file);
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(file);
+    return 0;
+}
+
+int __wrap_generate_uuid(char *uuid)
+{
+    if (UUID_MODE_PROC == atomic_load_explicit(&bench_uuid_mode, memory_order_relaxed))
+        return proc_generate_uuid(uuid);
+    return __real_generate_uuid(uuid);
+}
+
+/* 检查是否是 8-4-4-4-12 形式的 v4 UUID */
+static bool uuid_well_formed(const char *uuid)
+{
+    if (PLAYER_ID_LEN != strlen(uuid) || '4' != uuid[14] || NULL == strchr("89ab", uuid[19]))
+        return false;
+    for (int i = 0; i < PLAYER_ID_LEN; i++)
+    {
+        bool dash = (8 == i || 13 == i || 18 == i || 23 == i);
+        if (dash != ('-' == uuid[i]) || (!dash && NULL == strchr("0123456789abcdef", uuid[i])))
+            return false;
+    }
+    return true;
+}
+
+/* 代替 handler + sender 的排空线程：把 UUID 回给客户端，其余消息直接归还 */
+static void *bench_drain_main(void *arg)
+{
+    (void)arg;
+    CQuery *query;
+    while (!g_over)
+    {
+        if (NULL == (query = get_gready_query()))
+        {
+            sched_yield();
+            continue;
+        }
+        if (RESPONSE_UUID == query->m_header.type && 0 == CQuery_pack_message(query))
+            bench_write_all(query->m_socket_fd, query->m_byte_Query, query->m_query_len);
+        add_free_list(query);
+    }
+    return NULL;
+}
+
+static void *bench_connect_main(void *arg)
+{
+    int conn_num = (int)(intptr_t)arg;
+    MessageHeader header;
+    char body[UNIT_BUFFER_SIZE];
+    for (int i = 0; i < conn_num; i++)
+    {
+        int sockfd = bench_connect(bench_port);
+        if (0 > sockfd || 0 > bench_read_frame(sockfd, &header, body, sizeof(body)) ||
+            RESPONSE_UUID != header.type || !uuid_well_formed(body))
+        {
+            perror("bench connect");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return NULL;
+}
+
+/* 单线程连续生成 bench_uuid_num 个 UUID，返回每个的平均耗时 */
+static double bench_generate(uuid_mode_t mode)
+{
+    char uuid[PLAYER_ID_LEN + 1];
+    atomic_store(&bench_uuid_mode, mode);
+    uint64_t begin = bench_now_ns();
+    int failed = 0;
+    for (int i = 0; i < bench_uuid_num; i++)
+        failed |= __wrap_generate_uuid(uuid);
+    uint64_t elapsed = bench_now_ns() - begin;
+    if (0 != failed || !uuid_well_formed(uuid))
+    {
+        fprintf(stderr, "bad uuid: %s\n", uuid);
+        exit(EXIT_FAILURE);
+    }
+    return (double)elapsed / bench_uuid_num;
+}
+
+/* 用一批新连接制造连接风暴，返回每个 accept 的平均耗时 */
+static double bench_storm(uuid_mode_t mode)
+{
+    atomic_store(&bench_uuid_mode, mode);
+    pthread_t pids[bench_client_thread_num];
+    uint64_t begin = bench_now_ns();
+    for (int i = 0; i < bench_client_thread_num; i++)
+    {
+        int conn_num = bench_conn_num / bench_client_thread_num + (i < bench_conn_num % bench_client_thread_num);
+        pthread_create(&pids[i], NULL, bench_connect_main, (void *)(intptr_t)conn_num);
+    }
+    for (int i = 0; i < bench_client_thread_num; i++)
+        pthread_join(pids[i], NULL);
+    return (double)(bench_now_ns() - begin) / bench_conn_num;
+}
+
+int main(int argc, char *argv[])
+{
+    g_pconf = (pconf_t *)malloc(sizeof(pconf_t));
+    init_config(g_pconf);
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "p:c:n:t:")))
+    {
+        switch (opt)
+        {
+        case 'p':
+            bench_port = atoi(optarg);
+            break;
+        case 'c':
+            bench_conn_num = atoi(optarg);
+            break;
+        case 'n':
+            bench_uuid_num = atoi(optarg);
+            break;
+        case 't':
+            bench_client_thread_num = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p port] [-c conns] [-n uuids] [-t threads]\n", argv[0]);
+            return -1;
+        }
+    }
+    // 两轮连接风暴的连接都不断开，总数不能超过注册表容量
+    if (bench_client_thread_num < 1 || bench_conn_num < bench_client_thread_num ||
+        2 * bench_conn_num > MAX_CONNECTION_NUM || bench_uuid_num < 1)
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return -1;
+    }
+
+    FILE *report = bench_silence_stdout();
+    double generate_ns[2];
+    for (int mode = UUID_MODE_PROC; mode <= UUID_MODE_POOL; mode++)
+        generate_ns[mode] = bench_generate(mode);
+
+    if (0 != load_config(g_pconf, bench_port) || 0 != init_main())
+    {
+        fprintf(report, "can't start server components\n");
+        return -1;
+    }
+    pthread_t drain_pids[BENCH_DRAIN_THREAD_NUM];
+    for (int i = 0; i < BENCH_DRAIN_THREAD_NUM; i++)
+        pthread_create(&drain_pids[i], NULL, bench_drain_main, NULL);
+    if (0 != start_reactors())
+        return -1;
+
+    fprintf(report, "reactors=%d conns=%d uuids=%d pool=%d\n", g_reactor_num, bench_conn_num, bench_uuid_num, UUID_POOL_NUM);
+    for (int mode = UUID_MODE_PROC; mode <= UUID_MODE_POOL; mode++)
+    {
+        uint64_t syscall_begin = atomic_load(&g_syscall_count);
+        double accept_ns = bench_storm(mode);
+        uint64_t syscall_num = atomic_load(&g_syscall_count) - syscall_begin;
+        fprintf(report, "  %s: generate=%.0f ns/uuid accept=%.0f ns/conn (%.0f conn/s) syscalls/accept=%.2f\n",
+                uuid_mode_names[mode], generate_ns[mode], accept_ns, 1e9 / accept_ns, (double)syscall_num / bench_conn_num);
+    }
+    fflush(report);
+
+    g_over = true;
+    _exit(0);
+}
@@ -0,0 +1,148 @@
+/**
+ * wakeup_bench：比较 handler/sender 线程几种等待策略的空闲 CPU 占用和唤醒延迟。
+ *
+ * 消费者线程使用与 event_handler_main 相同的逻辑：从 MPSC 队列批量取任务，取不到时调用 wakeup_idle。
+ *
+ * - 空闲阶段：队列中没有任何任务，统计消费者线程在 -i 毫秒内消耗的 CPU 时间；
+ * - 延迟阶段：生产者每隔 -g 微秒入队一个带时间戳的任务，消费者取到时记录“入队 -> 取出”的延迟。
+ *
+ * 用法：wakeup_bench [-i idle_ms] [-n samples] [-g gap_us] [-s spin_num]
+ */
+#include <boost_up.h>
+#include <getopt.h>
+#include <time.h>
+#include "bench_util.h"
+
+static mpsc_ring bench_ring;
+static wakeup_t bench_wakeup;
+static atomic_int bench_stop;
+static uint64_t *bench_stamps = NULL;
+static uint64_t *bench_latency = NULL;
+static atomic_size_t bench_done;
+
+static bool bench_has_work(void *)
+{
+    return 0 < mpsc_ring_size(&bench_ring);
+}
+
+static void *bench_consumer_main(void *)
+{
+    void *batch[QUERY_BATCH_NUM];
+    int idle_rounds = 0;
+    while (!atomic_load(&bench_stop))
+    {
+        size_t num = mpsc_ring_pop_batch(&bench_ring, batch, QUERY_BATCH_NUM);
+        if (0 == num)
+        {
+            wakeup_idle(&bench_wakeup, &idle_rounds, bench_has_work, NULL, WAIT_TIMEOUT_MS);
+            continue;
+        }
+        idle_rounds = 0;
+        uint64_t now = bench_now_ns();
+        for (size_t i = 0; i < num; i++)
+        {
+            uint64_t *stamp = (uint64_t *)batch[i];
+            bench_latency[stamp - bench_stamps] = now - *stamp;
+        }
+        atomic_fetch_add(&bench_done, num);
+    }
+    return NULL;
+}
+
+static uint64_t thread_cpu_ns(pthread_t pid)
+{
+    clockid_t clock;
+    struct timespec ts;
+    pthread_getcpuclockid(pid, &clock);
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(wait_policy_t policy, int spin_num, int idle_ms, size_t sample_num, int gap_us)
+{
+    wakeup_init(&bench_wakeup, policy, spin_num);
+    atomic_store(&bench_stop, 0);
+    atomic_store(&bench_done, 0);
+
+    pthread_t pid;
+    pthread_create(&pid, NULL, bench_consumer_main, NULL);
+
+    // 空闲阶段
+    usleep(10000);
+    uint64_t cpu_begin = thread_cpu_ns(pid);
+    uint64_t wall_begin = bench_now_ns();
+    usleep(idle_ms * 1000);
+    double idle_cpu = (double)(thread_cpu_ns(pid) - cpu_begin) / (bench_now_ns() - wall_begin);
+
+    // 延迟阶段
+    struct timespec gap = {gap_us / 1000000, (gap_us % 1000000) * 1000};
+    for (size_t i = 0; i < sample_num; i++)
+    {
+        nanosleep(&gap, NULL);
+        bench_stamps[i] = bench_now_ns();
+        while (0 != mpsc_ring_push(&bench_ring, &bench_stamps[i]))
+            ;
+        wakeup_notify(&bench_wakeup);
+    }
+    while (atomic_load(&bench_done) < sample_num)
+        usleep(100);
+
+    atomic_store(&bench_stop, 1);
+    wakeup_notify(&bench_wakeup);
+    pthread_join(pid, NULL);
+
+    qsort(bench_latency, sample_num, sizeof(uint64_t), cmp_u64);
+    printf("%-9s idle_cpu=%5.1f%% wakeup_p50=%.1fus p99=%.1fus max=%.1fus notifies=%" PRIu64 " parks=%" PRIu64 "\n",
+           wait_policy_name(policy), idle_cpu * 100,
+           bench_latency[sample_num / 2] / 1e3, bench_latency[sample_num * 99 / 100] / 1e3,
+           bench_latency[sample_num - 1] / 1e3,
+           (uint64_t)atomic_load(&bench_wakeup.notify_count), (uint64_t)atomic_load(&bench_wakeup.park_count));
+    wakeup_destroy(&bench_wakeup);
+}
+
+int main(int argc, char *argv[])
+{
+    int idle_ms = 1000;
+    size_t sample_num = 2000;
+    int gap_us = 200;
+    int spin_num = DEFAULT_SPIN_NUM;
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "i:n:g:s:")))
+    {
+        switch (opt)
+        {
+        case 'i':
+            idle_ms = atoi(optarg);
+            break;
+        case 'n':
+            sample_num = atol(optarg);
+            break;
+        case 'g':
+            gap_us = atoi(optarg);
+            break;
+        case 's':
+            spin_num = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-i idle_ms] [-n samples] [-g gap_us] [-s spin_num]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (idle_ms < 1 || 0 == sample_num || gap_us < 0 || spin_num < 1)
+        return -1;
+
+    bench_stamps = calloc(sample_num, sizeof(uint64_t));
+    bench_latency = calloc(sample_num, sizeof(uint64_t));
+    mpsc_ring_init(&bench_ring, sample_num);
+
+    run(WAIT_POLICY_SPIN, spin_num, idle_ms, sample_num, gap_us);
+    run(WAIT_POLICY_PARK, spin_num, idle_ms, sample_num, gap_us);
+    run(WAIT_POLICY_ADAPTIVE, spin_num, idle_ms, sample_num, gap_us);
+    return 0;
+}
@@ -14,7 +14,13 @@ enum messageType {
 	SOME_ONE_QUIT,      # 有玩家退出, 用于客户端初始化其他玩家的相关信息
 	GAME_UPDATE,        # 游戏更新, 用于客户端更新游戏状态
 	PLAYER_INFO_CERT,   # 玩家信息认证, 用于客户端向服务器端认证玩家信息
-	CLIENT_READY        # 客户端准备就绪, 用于客户端通知服务器自己已经准备就绪
+	CLIENT_READY,       # 客户端准备就绪, 用于客户端通知服务器自己已经准备就绪
+	GAME_SNAPSHOT,      # 游戏快照, tick 模式下服务器把一个 tick 内所有玩家最新的 GAME_UPDATE 合并成一条下发
+	GAME_SNAPSHOT_DELTA,# 增量快照, 相对于客户端已确认的快照只下发变化的部分
+	SNAPSHOT_ACK,       # 快照确认, 客户端通知服务器自己已经收到并重建了某个序号的快照
+	UDP_BIND,           # UDP 通道绑定, 客户端通过 UDP 发送, 服务器原样回复
+	PING,               # 服务器定期发送, 消息体为服务器的发送时刻
+	PONG                # 收到 PING 之后立即原样回复消息体, 服务器据此估计往返时间
 }
 
 @export var HOST: String = "127.0.0.1"
@@ -23,6 +29,12 @@ const RECONNECT_TIMEOUT: float = 3.0
 const UUID_LEN: int = 36
 const TRANSFORM_SIZE: int = 52
 const BORN_TIMEOUT: float = 3.0
+const SNAPSHOT_HISTORY_NUM: int = 32
+const SLOT_ID_SIZE: int = 2
+const PROTOCOL_FLAG_COMPACT_ID: int = 1
+const UDP_TOKEN_SIZE: int = 4
+const UDP_HEADER_SIZE: int = 12 # 令牌 + slot id + 保留的 2 字节 + 序号
+const UDP_BIND_INTERVAL: float = 0.2
 
 var is_header_handled: bool = false
 var header_size: int = 8
@@ -30,8 +42,20 @@ var prepare_to_read: int = header_size
 
 var myId: String
 var myName: String
+var myRoom: int = 0 # 认证时请求进入的房间号, 只和同一个房间的玩家同步
+@export var compactIds: bool = true # 认证时协商紧凑 id 模式: 逐帧的消息中用 2 字节的 slot id 代替 36 字节的 UUID
+var mySlot: int = -1 # 服务器在 RESPONSE_UUID 中分配的 slot id
+var _slotToId: Dictionary # 紧凑 id 模式下 slot id -> UUID, 由玩家列表和加入消息建立
+@export var useUdp: bool = true # 服务器开启了 UDP 通道时, GAME_UPDATE 改为通过 UDP 收发
+var udpToken: int = 0 # 服务器在 RESPONSE_UUID 中下发的令牌, 0 表示服务器没有开启 UDP 通道
+var udpBound: bool = false # 收到了 UDP_BIND 的回复, 之后通过 UDP 上报 GAME_UPDATE
+var _udp: PacketPeerUDP = null
+var _udpSendSeq: int = 0
+var _udpRecvSeq: int = 0 # 最近一次收到的数据报序号, 更旧的直接丢弃
+var _udpBindElapsed: float = 0.0
 var playerInstanceName: String
 var _allPlayers: Dictionary
+var _snapshots: Dictionary # 增量快照的历史: 序号 -> 重建出来的记录列表, 作为之后增量快照的基线
 var playerMessageQueue: Dictionary
 var isGameStarted: bool = false 
 var isOnline: bool = false
@@ -52,6 +76,80 @@ func _ready() -> void:
 	playerInstanceName = ""
 	playerMessageQueue = Dictionary()
 	_allPlayers = Dictionary()
+	_snapshots = Dictionary()
+	_slotToId = Dictionary()
+
+func _process(delta: float) -> void:
+	if _udp == null:
+		return
+	# UDP_BIND 的请求或回复都可能丢失, 绑定之前定期重发
+	if !udpBound:
+		_udpBindElapsed += delta
+		if _udpBindElapsed >= UDP_BIND_INTERVAL:
+			_udpBindElapsed = 0.0
+			_send_udp(messageType.UDP_BIND, PackedByteArray())
+	var received: bool = false
+	while _udp.get_available_packet_count() > 0:
+		var packet: PackedByteArray = _udp.get_packet()
+		if packet.size() < UDP_HEADER_SIZE + header_size or packet.decode_u32(0) != udpToken:
+			continue
+		var type: int = packet.decode_s32(UDP_HEADER_SIZE)
+		var length: int = packet.decode_u16(UDP_HEADER_SIZE + 4) # 下行的消息头中的长度包含消息头
+		if length != packet.size() - UDP_HEADER_SIZE:
+			continue
+		if type == messageType.UDP_BIND:
+			udpBound = true
+			continue
+		var seq: int = packet.decode_u32(8)
+		var ahead: int = (seq - _udpRecvSeq) & 0xffffffff # 序号回绕之后仍然按差值判断新旧
+		if _udpRecvSeq != 0 and (ahead == 0 or ahead >= 0x80000000):
+			continue
+		_udpRecvSeq = seq
+		var message: Dictionary = Dictionary()
+		message["type"] = type
+		message["length"] = length
+		message["data"] = packet.slice(UDP_HEADER_SIZE + header_size)
+		MessageParser.wait_queue.append(message)
+		received = true
+	if received:
+		emit_signal("parse_and_exe")
+
+# 打开和 TCP 连接同一个服务器端口的 UDP 通道, 绑定由 _process 完成
+func start_udp(token: int) -> void:
+	if _udp != null: # 重连之后令牌和 slot id 都换了, 重新绑定
+		_udp.close()
+		_udp = null
+	udpToken = token
+	udpBound = false
+	_udpSendSeq = 0
+	_udpRecvSeq = 0
+	if !useUdp or token == 0:
+		return
+	_udp = PacketPeerUDP.new()
+	_udp.connect_to_host(HOST, PORT)
+	_udpBindElapsed = UDP_BIND_INTERVAL # 下一帧立即发送 UDP_BIND
+
+func _send_udp(type: int, body: PackedByteArray) -> void:
+	_udpSendSeq = (_udpSendSeq + 1) & 0xffffffff
+	var packet: PackedByteArray = PackedByteArray()
+	packet.resize(UDP_HEADER_SIZE + header_size)
+	packet.encode_u32(0, udpToken)
+	packet.encode_u16(4, mySlot)
+	packet.encode_u32(8, _udpSendSeq)
+	packet.encode_s32(UDP_HEADER_SIZE, type)
+	packet.encode_u16(UDP_HEADER_SIZE + 4, body.size()) # 上行的消息头中的长度只包含消息体
+	packet.append_array(body)
+	_udp.put_packet(packet)
+
+# 通过 UDP 通道上报自己的 Transform3D, 丢失了由下一条覆盖
+func send_udp_update(update_transform: Transform3D) -> void:
+	if _udp == null:
+		return
+	var body: PackedByteArray = PackedByteArray()
+	if !compactIds:
+		body.append_array(myId.to_ascii_buffer())
+	body.append_array(var_to_bytes(update_transform))
+	_send_udp(messageType.GAME_UPDATE, body)
 
 func connect_after_timeout(timeout: float) -> void:
 	if !isGameStarted:
@@ -120,13 +218,14 @@ func _handle_client_error() -> void:
 		emit_signal("disconnected")
 	# _connect_after_timeout(RECONNECT_TIMEOUT) # Try to reconnect after 3 seconds
 
-func joinGame(player_name: String, ip: String, port: int):
+func joinGame(player_name: String, ip: String, port: int, room: int = 0):
 	var root = get_tree().root
 	var current_scene = root.get_child(root.get_child_count() - 1)
 	_byteArraySendTimer = current_scene.get_node("ByteArraySendTimer")
 	_byteArraySendTimer.connect("timeout", Callable(self, "_send_data"))
 	
 	myName = player_name
+	myRoom = room
 	
 	_client = Client.new()
 	_client.connect("connected", Callable(self, "_handle_client_connected"))
@@ -145,6 +244,38 @@ func _send_data():
 	var message = MessagePacker.packaged_byte_messages.pop_back()
 	_client.send(message)
 
+# GAME_UPDATE 和快照记录开头的玩家标识的长度
+func record_id_size() -> int:
+	return SLOT_ID_SIZE if compactIds else UUID_LEN
+
+# 取出 GAME_UPDATE 或快照记录中的玩家 UUID, 紧凑 id 模式下通过 slot id 查找, 不认识的 slot id 返回空串
+func record_player_id(record: PackedByteArray) -> String:
+	if compactIds:
+		return _slotToId.get(record.decode_u16(0), "")
+	return record.slice(0, UUID_LEN).get_string_from_ascii()
+
+# 快照确认直接发送, 不经过 MessagePacker 的队列, 以免排在 GAME_UPDATE 后面让基线过期
+func send_snapshot_ack(seq: int) -> void:
+	if _client == null:
+		return
+	var message: PackedByteArray = PackedByteArray()
+	message.resize(header_size + 4)
+	message.encode_s32(0, messageType.SNAPSHOT_ACK)
+	message.encode_u16(4, 4)
+	message.encode_u32(header_size, seq)
+	_client.send(message)
+
+# PONG 和快照确认一样直接发送, 排在队列后面会把客户端的排队时间算进往返时间
+func send_pong(body: PackedByteArray) -> void:
+	if _client == null:
+		return
+	var message: PackedByteArray = PackedByteArray()
+	message.resize(header_size)
+	message.encode_s32(0, messageType.PONG)
+	message.encode_u16(4, body.size())
+	message.append_array(body)
+	_client.send(message)
+
 func resetNetwork() -> void:
 	print_debug("reset")
 	isGameStarted = false
@@ -155,7 +286,16 @@ func resetNetwork() -> void:
 		_client.disconnect_from_host()
 		_client.queue_free()
 		_client = null
+	if _udp != null:
+		_udp.close()
+		_udp = null
+	udpToken = 0
+	udpBound = false
+	_udpSendSeq = 0
+	_udpRecvSeq = 0
 	_allPlayers.clear()
+	_snapshots.clear()
+	_slotToId.clear()
 	
 func sizeof(param) -> void:
 	var sizeof = 0
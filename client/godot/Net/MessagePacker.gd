@@ -23,6 +23,8 @@ func _pack_messages():
 			for data in raw_message["data"]:
 				if typeof(data) == TYPE_STRING:
 					data_byte_array.append_array(data.to_ascii_buffer())
+				elif typeof(data) == TYPE_PACKED_BYTE_ARRAY:
+					data_byte_array.append_array(data)
 				else:
 					data_byte_array.append_array(var_to_bytes(data))
 			
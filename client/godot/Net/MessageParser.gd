@@ -10,6 +10,12 @@ signal global_player_info_got
 
 var wait_queue: Array = []
 
+enum snapshotRecord {
+	SAME,   # 从基线的某一条起连续若干条没有变化
+	DELTA,  # 基线中的某一条, 只带变化的字
+	FULL    # 完整的 UUID (紧凑 id 模式下为 slot id) + Transform3D
+}
+
 func _ready():
 # warning-ignore:return_value_discarded
 	GameState.connect("parse_and_exe", Callable(self, "_parse_and_exe"))
@@ -21,6 +27,10 @@ func _parse_and_exe():
 		match message["type"]:
 			GameState.messageType.GAME_UPDATE:
 				_handle_game_update(message)
+			GameState.messageType.GAME_SNAPSHOT:
+				_handle_game_snapshot(message)
+			GameState.messageType.GAME_SNAPSHOT_DELTA:
+				_handle_game_snapshot_delta(message)
 			GameState.messageType.RESPONSE_UUID:
 				_handle_response_uuid(message)
 			GameState.messageType.GLOBAL_PLAYER_INFO:
@@ -29,36 +39,67 @@ func _parse_and_exe():
 				_handle_some_one_join(message)
 			GameState.messageType.SOME_ONE_QUIT:
 				_handle_some_on_quit(message)
+			GameState.messageType.PING:
+				GameState.send_pong(message["data"])
 			_:
 				print_debug("fatal error!")
 
 func _handle_response_uuid(message: Dictionary):
 	# print_debug("response UUID: ", message["data"].get_string_from_ascii())
-	GameState.myId = message["data"].get_string_from_ascii()
+	# UUID 以 '\0' 结尾, 后面是服务器分配的 slot id
+	var data: PackedByteArray = message["data"]
+	GameState.myId = data.get_string_from_ascii()
+	if data.size() >= GameState.UUID_LEN + 1 + GameState.SLOT_ID_SIZE:
+		GameState.mySlot = data.decode_u16(GameState.UUID_LEN + 1)
+		# 服务器开启了 UDP 通道时 slot id 之后是令牌
+		if data.size() >= GameState.UUID_LEN + 1 + GameState.SLOT_ID_SIZE + GameState.UDP_TOKEN_SIZE:
+			GameState.start_udp(data.decode_u32(GameState.UUID_LEN + 1 + GameState.SLOT_ID_SIZE))
+	else:
+		GameState.compactIds = false # 旧服务器不支持紧凑 id 模式
 	
 	message["type"] = GameState.messageType.PLAYER_INFO_CERT
-	message["data"] = []
+	var room_byte_array: PackedByteArray = PackedByteArray()
+	room_byte_array.resize(8 if GameState.compactIds else 4)
+	room_byte_array.encode_u32(0, GameState.myRoom) # 小端的 4 字节房间号
+	if GameState.compactIds:
+		room_byte_array.encode_u32(4, GameState.PROTOCOL_FLAG_COMPACT_ID) # 协议标志
+	message["data"] = [room_byte_array]
 	MessagePacker.raw_messages.append(message)
 	emit_signal("gen_message")
 	emit_signal("uuid_got")
 
+func _add_player(id: String, name: String):
+	var info_dict: Dictionary = Dictionary()
+	var game_update_queue: Array = []
+	info_dict["name"] = name
+	info_dict["game_update_queue"] = game_update_queue
+	info_dict["is_alive"] = false
+	GameState._allPlayers[id] = info_dict
+
 func _handle_global_player_info(message: Dictionary):
-	if not message["data"].is_empty():
-		var global_player_info_str: String = message["data"].get_string_from_ascii()
+	var data: PackedByteArray = message["data"]
+	if not data.is_empty() and GameState.compactIds:
+		# 每个玩家为 slot id + UUID + 名称, 以 '@' 分隔; slot id 中可能出现 '@', 所以按位置解析
+		var offset: int = 0
+		while offset + GameState.SLOT_ID_SIZE + GameState.UUID_LEN <= data.size():
+			var slot: int = data.decode_u16(offset)
+			var name_begin: int = offset + GameState.SLOT_ID_SIZE + GameState.UUID_LEN
+			var id: String = data.slice(offset + GameState.SLOT_ID_SIZE, name_begin).get_string_from_ascii()
+			var name_end: int = name_begin
+			while name_end < data.size() and data[name_end] != 0x40: # '@'
+				name_end += 1
+			GameState._slotToId[slot] = id
+			_add_player(id, data.slice(name_begin, name_end).get_string_from_ascii())
+			offset = name_end + 1
+	elif not data.is_empty():
+		var global_player_info_str: String = data.get_string_from_ascii()
 		# print_debug("gloal player info: ", global_player_info_str)
 	
 		var global_player_infos = global_player_info_str.split("@")
 		for player_info in global_player_infos:
 			var id: String = player_info.substr(0, GameState.UUID_LEN)
 			var name: String = player_info.substr(GameState.UUID_LEN, -1)
-		
-			var info_dict: Dictionary = Dictionary()
-			var game_update_queue: Array = []
-			info_dict["name"] = name
-			info_dict["game_update_queue"] = game_update_queue
-			info_dict["is_alive"] = false
-		
-			GameState._allPlayers[id] = info_dict
+			_add_player(id, name)
 	
 	message.clear()
 	message["type"] = GameState.messageType.CLIENT_READY
@@ -75,33 +116,40 @@ func _handle_global_player_info(message: Dictionary):
 	emit_signal("global_player_info_got")
 
 func _handle_some_one_join(message: Dictionary):
-	var player_info_str: String = message["data"].get_string_from_ascii()
+	var data: PackedByteArray = message["data"]
+	# 紧凑 id 模式下开头是新玩家的 slot id
+	var offset: int = GameState.SLOT_ID_SIZE if GameState.compactIds else 0
+	var player_info_str: String = data.slice(offset).get_string_from_ascii()
 	print_debug(player_info_str)
 	
 	var id: String = player_info_str.substr(0, GameState.UUID_LEN)
 	var name: String = player_info_str.substr(GameState.UUID_LEN, -1)
-	
-	var info_dict: Dictionary = Dictionary()
-	var game_update_queue: Array = []
-	info_dict["name"] = name
-	info_dict["game_update_queue"] = game_update_queue
-	info_dict["is_alive"] = false
-	GameState._allPlayers[id] = info_dict
+	if GameState.compactIds:
+		GameState._slotToId[data.decode_u16(0)] = id
+	_add_player(id, name)
 	
 	emit_signal("some_one_join", id, name)
 
 func _handle_some_on_quit(message: Dictionary):
 	print_debug("start to handle some one on quit.")
-	var player_id: String = message["data"].get_string_from_ascii()
+	var player_id: String
+	if GameState.compactIds:
+		var slot: int = message["data"].decode_u16(0)
+		player_id = GameState._slotToId.get(slot, "")
+		GameState._slotToId.erase(slot)
+	else:
+		player_id = message["data"].get_string_from_ascii()
 	print_debug(player_id)
 	emit_signal("some_one_quit", player_id)
 
 func _handle_game_update(message: Dictionary):
 	if !GameState.isGameReady:
 		return
-	var player_id: String = message["data"].subarray(0, GameState.UUID_LEN - 1).get_string_from_ascii()
-	var transform_bytes: PackedByteArray = message["data"].subarray(GameState.UUID_LEN, 
-		GameState.UUID_LEN + GameState.TRANSFORM_SIZE - 1)
+	var player_id: String = GameState.record_player_id(message["data"])
+	if !GameState._allPlayers.has(player_id):
+		return
+	var id_size: int = GameState.record_id_size()
+	var transform_bytes: PackedByteArray = message["data"].slice(id_size, id_size + GameState.TRANSFORM_SIZE)
 	# print_debug(transform_bytes.size())
 	var update_transform: Transform3D = bytes_to_var(transform_bytes)
 	
@@ -113,3 +161,72 @@ func _handle_game_update(message: Dictionary):
 	
 	GameState._allPlayers[player_id]["game_update_queue"].append(update_transform)
 
+# 快照由若干条定长记录（UUID 或 slot id + Transform3D）组成，每条记录按一条 GAME_UPDATE 处理
+func _handle_game_snapshot(message: Dictionary):
+	if !GameState.isGameReady:
+		return
+	var record_size: int = GameState.record_id_size() + GameState.TRANSFORM_SIZE
+	var data: PackedByteArray = message["data"]
+	var offset: int = 0
+	while offset + record_size <= data.size():
+		_apply_snapshot_record(data.slice(offset, offset + record_size))
+		offset += record_size
+
+# 增量快照: 以已经确认的快照为基线重建出完整的记录列表, 只应用有变化的记录, 然后回复确认
+func _handle_game_snapshot_delta(message: Dictionary):
+	if !GameState.isGameReady:
+		return
+	var id_size: int = GameState.record_id_size()
+	var record_size: int = id_size + GameState.TRANSFORM_SIZE
+	var data: PackedByteArray = message["data"]
+	var seq: int = data.decode_u32(0)
+	var base_seq: int = data.decode_u32(4)
+	var base: Array = []
+	if base_seq != 0:
+		# 基线已经被丢弃, 不确认这个快照, 服务器发现确认过期之后会回退到完整状态
+		if !GameState._snapshots.has(base_seq):
+			return
+		base = GameState._snapshots[base_seq]
+
+	var records: Array = []
+	var offset: int = 8
+	while offset < data.size():
+		var tag: int = data[offset]
+		var index: int = data.decode_u16(offset + 1)
+		match tag:
+			snapshotRecord.SAME:
+				var count: int = data.decode_u16(offset + 3)
+				records.append_array(base.slice(index, index + count))
+				offset += 5
+			snapshotRecord.DELTA:
+				var mask: int = data.decode_u16(offset + 3)
+				var record: PackedByteArray = base[index].duplicate()
+				offset += 5
+				for word in range(GameState.TRANSFORM_SIZE / 4):
+					if mask & (1 << word):
+						for i in range(4):
+							record[id_size + word * 4 + i] = data[offset + i]
+						offset += 4
+				records.append(record)
+				_apply_snapshot_record(record)
+			_:
+				var record: PackedByteArray = data.slice(offset + 1, offset + 1 + record_size)
+				offset += 1 + record_size
+				records.append(record)
+				_apply_snapshot_record(record)
+
+	GameState._snapshots[seq] = records
+	for old_seq in GameState._snapshots.keys():
+		if old_seq <= seq - GameState.SNAPSHOT_HISTORY_NUM:
+			GameState._snapshots.erase(old_seq)
+	GameState.send_snapshot_ack(seq)
+
+func _apply_snapshot_record(record: PackedByteArray):
+	var player_id: String = GameState.record_player_id(record)
+	# 快照里也包含自己的状态，以及还没有收到 SOME_ONE_JOIN 的玩家，直接跳过
+	if player_id == GameState.myId or !GameState._allPlayers.has(player_id):
+		return
+	var update: Dictionary = Dictionary()
+	update["type"] = GameState.messageType.GAME_UPDATE
+	update["data"] = record
+	_handle_game_update(update)
@@ -36,9 +36,15 @@ func _game_update():
 	if playerId == GameState.myId:
 		# print_debug("true player")
 		var update_transform: Transform3D = self.get_global_transform()
+		if GameState.udpBound:
+			GameState.send_udp_update(update_transform)
+			emit_signal("game_update")
+			return
 		var message: Dictionary = Dictionary()
 		var data: Array = []
-		data.append(GameState.myId)
+		# 紧凑 id 模式下服务器根据连接就知道是谁, 只上报 Transform3D
+		if !GameState.compactIds:
+			data.append(GameState.myId)
 		data.append(update_transform)
 		message["type"] = GameState.messageType.GAME_UPDATE
 		message["data"] = data
@@ -16,9 +16,18 @@ typedef enum
     SOME_ONE_QUIT,      // 有玩家退出, 用于客户端初始化其他玩家的相关信息
     GAME_UPDATE,        // 游戏更新, 用于客户端更新游戏状态
     PLAYER_INFO_CERT,   // 玩家信息认证, 用于客户端向服务器端认证玩家信息
-    CLIENT_READY        // 客户端准备就绪, 用于客户端通知服务器自己已经准备就绪
+    CLIENT_READY,       // 客户端准备就绪, 用于客户端通知服务器自己已经准备就绪
+    GAME_SNAPSHOT,      // 游戏快照, tick 模式下服务器把一个 tick 内所有玩家最新的 GAME_UPDATE 合并成一条下发
+    GAME_SNAPSHOT_DELTA,// 增量快照, 相对于客户端已确认的快照只下发变化的部分
+    SNAPSHOT_ACK,       // 快照确认, 客户端通知服务器自己已经收到并重建了某个序号的快照
+    UDP_BIND,           // UDP 绑定, 客户端通过 UDP 通道发送, 服务器原样回复, 用于确认 UDP 通道可用
+    PING,               // 服务器定期发给房间中的玩家, 消息体为服务器的发送时刻
+    PONG                // 客户端收到 PING 之后立即原样回复消息体, 服务器据此估计往返时间和抖动
 } MessageType;
 
+// PLAYER_INFO_CERT 消息体中房间号之后可选的 4 字节协议标志（小端）
+#define PROTOCOL_FLAG_COMPACT_ID 0x1 // 紧凑 id 模式：逐帧的消息中用 2 字节的 slot id 代替 36 字节的 UUID
+
 // 定义消息头
 typedef struct
 {
@@ -26,6 +35,20 @@ typedef struct
     uint16_t length;  // 消息长度
 } MessageHeader;
 
+/*
+ * UDP 通道（`-u`）中每个数据报开头的头部，之后是和 TCP 上相同的消息头 + 消息体。
+ * token 和 slot 来自 RESPONSE_UUID，seq 为发送方在这个通道上逐个递增的序号，接收方丢弃比已经收到的更旧的数据报。
+ */
+typedef struct
+{
+    uint32_t token;    // 连接的 UDP 令牌
+    uint16_t slot;     // 连接的 slot id
+    uint16_t reserved;
+    uint32_t seq;      // 数据报序号，会回绕
+} UdpHeader;
+
+#define UDP_HEADER_SIZE ((int)sizeof(UdpHeader))
+
 extern int header_size;
 
 // 从字节流之中提取出消息头
@@ -12,101 +12,110 @@
 #include "handler.h"
 #include "send_req.h"
 #include "recv_res.h"
+#include "reactor.h"
 #include "handler.h"
 #include "player_info_array.h"
+#include "uring_backend.h"
+#include "worker.h"
+#include "room.h"
+#include "udp_channel.h"
 
 // 全局变量定义
-player_info_array player_infos;    /*玩家信息链表*/
+player_info_array player_infos;    /*玩家注册表*/
 pconf_t *g_pconf = NULL;           /*服务器配置*/
 CQuery *g_pfree_list = NULL;       /*无数据的CQuery队列*/
-CQuery *g_pready_list = NULL;      /*有数据准备建立连接的CQuery队列*/
-CQuery *g_pwork_list = NULL;       /*发送或接收结果状态的CQuery队列*/
-CQuery *g_pwork_list_tail = NULL;  /*发送或接收结果状态的CQuery队列尾*/
-CQuery *g_pready_list_tail = NULL; /*有数据准备建立连接的CQuery队列尾*/
-int g_send_epoll_fd;               /*发送epoll*/
-int g_recv_epoll_fd;               /*接收epoll*/
+slab_t g_payload_slab;             /*CQuery 消息体的 slab 分配器*/
+slab_t g_io_buffer_slab;           /*连接收发缓冲区的 slab 分配器*/
+mpsc_ring g_ready_ring;            /*有数据准备处理的CQuery队列（reactor -> handler）*/
+wakeup_t g_ready_wakeup;           /*ready 队列的唤醒器*/
+reactor_t g_reactors[MAX_REACTOR_NUM]; /*接收 reactor*/
+int g_reactor_num = 0;             /*接收 reactor 数量*/
+worker_t g_workers[MAX_WORKER_NUM]; /*发送 worker*/
+int g_worker_num = 0;              /*发送 worker 数量*/
+room_t g_rooms[MAX_ROOM_NUM];      /*房间*/
+udp_channel_t g_udp = {.socket = -1}; /*可选的 UDP 通道（-u）*/
 bool g_over = false;
-bool g_is_write_eagain = false;
-size_t g_query_num = MAX_QUERY_NUM;
+size_t g_query_num = MAX_QUERY_NUM + MAX_CONNECTION_NUM; /*每个连接额外预留一个给 SOME_ONE_QUIT*/
 int header_size = sizeof(MessageHeader);
+atomic_uint_fast64_t g_syscall_count = 0;  /*热路径上的系统调用次数*/
+log_t g_log;                       /*异步日志*/
+atomic_int g_log_level = LOG_LEVEL_OFF; /*日志级别，日志线程启动之前不记录任何日志*/
+stats_segment_t *g_stats = NULL;   /*统计共享内存段，squash_stat 从外部读取*/
 
 int init_main()
 {
-    /*初始化CQuery队列*/
-    g_pfree_list = (CQuery *)malloc(sizeof(struct _CQuery) * g_query_num);
-    if (NULL == g_pfree_list)
+    /*启动日志线程，之后各个组件的日志都写入线程自己的缓冲区，由日志线程格式化输出*/
+    if (0 != init_log(g_pconf->log_level, stdout))
+        return -1;
+    /*创建统计共享内存段，各个线程启动时在其中登记自己的计数器和直方图*/
+    if (0 != init_stats(g_pconf->port))
         return -1;
 
-    for (size_t i = 0; i < g_query_num; i++)
-        CQuery_init(&g_pfree_list[i]);
+    /*初始化CQuery队列：CQuery 本身只有消息头和指针，消息体在收到消息时才从 g_payload_slab 中按长度申请*/
+    // GAME_UPDATE 这样的小消息落在第一级，最后一级能放下一条最长的消息（MAX_QUERY_LEN）
+    static const size_t payload_sizes[] = {128, 512, 2048, 8192, 65536};
+    slab_init(&g_payload_slab, payload_sizes, sizeof(payload_sizes) / sizeof(payload_sizes[0]));
+    // 连接只在有数据在途时才借用发送队列的帧引用数组和接收环形缓冲区
+    static const size_t io_buffer_sizes[] = {OUT_QUEUE_FRAMES_SIZE, RECV_BUFFER_SIZE};
+    slab_init(&g_io_buffer_slab, io_buffer_sizes, sizeof(io_buffer_sizes) / sizeof(io_buffer_sizes[0]));
+    CQuery *queries = (CQuery *)malloc(sizeof(struct _CQuery) * g_query_num);
+    if (NULL == queries)
+        return -1;
 
-    CQuery_set_pre_query(&g_pfree_list[0], NULL);
-    CQuery_set_next_query(&g_pfree_list[0], &g_pfree_list[1]);
-    for (size_t i = 1; i < g_query_num - 1; i++)
+    // 经由 add_free_list 放入空闲列表，空闲数量和预留数量由 query_list 维护
+    init_query_list_lock();
+    for (size_t i = 0; i < g_query_num; i++)
     {
-        CQuery_set_pre_query(&g_pfree_list[i], &g_pfree_list[i - 1]);
-        CQuery_set_next_query(&g_pfree_list[i], &g_pfree_list[i + 1]);
+        CQuery_init(&queries[i]);
+        add_free_list(&queries[i]);
     }
-    CQuery_set_pre_query(&g_pfree_list[g_query_num - 1], &g_pfree_list[g_query_num - 2]);
-    CQuery_set_next_query(&g_pfree_list[g_query_num - 1], NULL);
-
-    /* init epoll list */
-    // epoll_create 是 Linux 提供的一个系统调用，专门用于创建一个 epoll 实例。
-    // epoll 是一种高效的 I/O 事件通知机制，用于处理大量文件描述符的 I/O 事件，如网络连接、文件等。
-    // 参数 size 表示初始监听的文件描述符的数量，虽然现代系统会忽略这个值，但它曾经用于分配内部数据结构的大小。
-    if (0 > (g_send_epoll_fd = epoll_create(g_query_num)))
-        return -2;
 
-    if (0 > (g_recv_epoll_fd = epoll_create(g_query_num)))
+    // 每个接收 reactor 拥有自己的 epoll 实例和监听套接字，
+    // 监听套接字以边缘触发（EPOLLET）的方式注册到对应 reactor 的 epoll 中，详见 init_reactors
+    if (0 > init_reactors())
         return -2;
 
-    // epoll_event 之中包含有两个主要字段：
-    // 1. events：表示感兴趣的时间类型
-    // 2. data：通常用于存储用户数据，比如文件描述符（fd）
-    struct epoll_event ep_evt;
-
-    // EPOLLIN：表示监听文件描述符是否有可读事件（也就是数据可以从文件描述符读取，比如新的网络链接或者接收到的数据）
-    // EPOLLET：表示启用边缘触发（Edge Triggered，ET）模式
-    ep_evt.events = EPOLLIN | EPOLLET;
+    /*初始化 ready 无锁队列及其唤醒器*/
+    if (0 != init_query_list_ring(g_query_num))
+        return -1;
+    if (0 != init_query_list_wakeup(g_pconf->wait_policy, g_pconf->spin_num))
+        return -2;
 
-    // 存储与事件相关的文件描述符，在这里意味着监听这个套接字的读事件，并在事件发生时能够识别出是哪个文件描述符触发的。
-    ep_evt.data.fd = g_pconf->listen_socket;
+    /*开启 -u 时在同一个端口上绑定 UDP 通道的套接字，worker 为它准备各自的数据报批次*/
+    if (g_pconf->udp_enabled && 0 != init_udp_channel(g_pconf->port))
+        return -3;
 
-    // epoll_ctl 是 epoll 用于控制文件描述符和 epoll 实例之间关系的系统调用，它有三个主要操作：
-    // EPOLL_CTL_ADD: 将指定的文件描述符添加到 epoll 实例中。
-    // EPOLL_CTL_MOD: 修改已经在 epoll 实例中的文件描述符。
-    // EPOLL_CTL_DEL: 从 epoll 实例中删除文件描述符。
-    // 
-    // 这个调用的含义是，将监听套接字（g_pconf->listen_socket）注册到 g_recv_epoll_fd 这个 epoll 实例中，
-    // 并监听可读事件（EPOLLIN），同时启用边缘触发（EPOLLET）。
-    epoll_ctl(g_recv_epoll_fd, EPOLL_CTL_ADD, g_pconf->listen_socket, &ep_evt);
+    /*初始化发送 worker：每个 worker 有自己的 work 队列、发送 epoll / io_uring 和 tick，详见 init_workers*/
+    int result = init_workers();
+    if (0 != result)
+        return result;
+    init_rooms(g_worker_num);
 
-    player_info_array_init();
+    /*初始化玩家注册表*/
+    if (0 != player_info_array_init())
+        return -1;
     /*初始化共享锁*/
     init_player_info_array_lock();
-    init_query_list_lock();
 
     return 0;
 }
 
 int clean_main()
 {
-    CQuery *tp = g_pwork_list;
+    CQuery *tp = NULL;
     CQuery *tdel = NULL;
-    while (NULL != tp)
+    for (int i = 0; i < g_worker_num; i++)
     {
-        CQuery_close_socket(tp);
-        tdel = tp;
-        tp = CQuery_get_next_query(tp);
-        CQuery_destroy(tdel);
+        while (NULL != (tp = get_gwork_query(&g_workers[i])))
+        {
+            CQuery_close_socket(tp);
+            CQuery_destroy(tp);
+        }
     }
-    tp = g_pready_list;
-    while (NULL != tp)
+    while (NULL != (tp = get_gready_query()))
     {
         CQuery_close_socket(tp);
-        tdel = tp;
-        tp = CQuery_get_next_query(tp);
-        CQuery_destroy(tdel);
+        CQuery_destroy(tp);
     }
     tp = g_pfree_list;
     while (NULL != tp)
@@ -118,11 +127,20 @@ int clean_main()
     }
 
     /*关闭epoll socket*/
-    close(g_send_epoll_fd);
-    close(g_recv_epoll_fd);
+    destroy_reactors();
+    destroy_workers();
+    destroy_udp_channel();
 
-    /*销毁共享锁*/
+    /*销毁共享锁与无锁队列*/
     destroy_query_list_lock();
+    destroy_query_list_ring();
+    destroy_query_list_wakeup();
+    destroy_rooms();
+    player_info_array_destroy();
+    slab_destroy(&g_payload_slab);
+    slab_destroy(&g_io_buffer_slab);
+    destroy_stats();
+    destroy_log();
 
     return 0;
 }
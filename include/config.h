@@ -1,24 +1,85 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-#define MAX_PLAYER_NUM 10
+#define MAX_CONNECTION_NUM 4096
+#define MAX_FD_NUM 65536
+#define OUT_QUEUE_FRAME_NUM 256
+#define OUT_QUEUE_IOV_NUM 64
+#define DEFAULT_SEND_QUEUE_KB 128 /*每个连接发送队列中尚未写出的字节数上限，超出后丢弃新的状态帧*/
+#define MAX_SEND_QUEUE_KB 65536
+#define DEFAULT_SEND_LAG_MS 5000  /*发送队列持续非空超过这么久的连接被断开，0 表示不检查*/
+#define MAX_SEND_LAG_MS 600000
+#define DEFAULT_PING_INTERVAL_MS 1000 /*服务器向房间中的玩家发送 PING 的间隔，0 表示不发送*/
+#define MAX_PING_INTERVAL_MS 60000
+#define MAX_PING_RTT_MS 60000 /*超过这么久才回复的 PONG（或者伪造的时间戳）不计入往返时间*/
 #define MAX_QUERY_NUM 5000
 #define INET_ADDRSTRLEN 16
 
 #define UNIT_BUFFER_SIZE 1024
-#define QUERY_BUFFER_LEN 512
+#define RECV_BUFFER_SIZE 16384 /*每个连接的接收环形缓冲区容量，必须是 2 的幂*/
+#define MAX_QUERY_LEN 65535 /*一条消息（消息头 + 消息体）的最大长度，消息头中的长度字段为 16 位*/
+#define SLAB_MAX_CLASS_NUM 8
+#define SLAB_CHUNK_SIZE (64 * 1024)
 
 #define MAX_PLAYER_NAME_LEN 32
 #define PLAYER_ID_LEN 36
+#define UUID_POOL_NUM 256 /*每次 getrandom 预先取出的 UUID 个数*/
 
 #define MAX_EPOLL_EVENT 500
 
+#define DEFAULT_REACTOR_NUM 1
+#define MAX_REACTOR_NUM 16
+#define LISTEN_BACKLOG 1024
+
+#define DEFAULT_WORKER_NUM 1
+#define MAX_WORKER_NUM 16
+#define MAX_ROOM_NUM 1024
+
+#define DEFAULT_SPIN_NUM 1000
+#define WAIT_TIMEOUT_MS 100
+
+#define DEFAULT_TICK_RATE 0
+#define MAX_TICK_RATE 1000
+#define TRANSFORM_LEN 52
+#define GAME_UPDATE_LEN (PLAYER_ID_LEN + TRANSFORM_LEN)
+#define SLOT_ID_LEN 2 /*紧凑 id 模式下代替 UUID 的 slot id（uint16，小端）*/
+#define COMPACT_UPDATE_LEN (SLOT_ID_LEN + TRANSFORM_LEN)
+#define UDP_TOKEN_LEN 4 /*RESPONSE_UUID 中 slot id 之后的 UDP 令牌（uint32，小端），只在开启 UDP 通道时下发*/
+#define PING_LEN 8 /*PING / PONG 的消息体：服务器发送 PING 时的单调时钟（uint64 纳秒，小端），客户端原样回复*/
+#define SNAPSHOT_HISTORY_NUM 32
+#define INTEREST_BUCKET_NUM 4096
+#define SNAPSHOT_MAX_RECORDS 736 /*(65535 - 消息头 8 - 序号 8) / 完整记录 89，保证增量快照总能放进一个帧*/
+
+#define LOG_RING_SIZE (256 * 1024) /*每个线程的日志环形缓冲区容量，必须是 2 的幂*/
+#define LOG_MAX_THREAD_NUM 64
+#define LOG_MAX_ARG_NUM 8
+#define LOG_MAX_STRING_LEN 256 /*字符串参数最多拷贝的字节数，超出部分被截断*/
+#define LOG_FLUSH_INTERVAL_MS 10
+
+#define STATS_MAX_THREAD_NUM 40 /*共享内存统计段中的线程数上限，reactor + handler + worker 之外留出压测程序的线程*/
+
+#define TIMER_WHEEL_TICK_MS 100   /*时间轮一格的长度*/
+#define TIMER_WHEEL_SLOT_BITS 6   /*每层 64 个槽*/
+#define TIMER_WHEEL_LEVEL_NUM 4   /*64^4 格，约 19 天*/
+#define HANDSHAKE_TIMEOUT_MS 10000 /*从 accept 到收到 CLIENT_READY 的最长时间*/
+#define DEFAULT_IDLE_TIMEOUT 30   /*连接多少秒没有收到任何数据（包括 PONG 和 UDP 数据报）就被断开，0 表示不检查*/
+#define MAX_IDLE_TIMEOUT 3600
+
+#define UDP_BATCH_NUM 64          /*UDP 通道一次 recvmmsg / sendmmsg 的数据报个数*/
+#define UDP_DATAGRAM_SIZE 512     /*UDP 通道接收缓冲区中一个数据报的容量，足够放下一条 GAME_UPDATE*/
+#define UDP_SOCKET_BUFFER (1024 * 1024) /*UDP 套接字的内核收发缓冲区*/
+
+#define URING_ENTRIES 256
+#define URING_RECV_BUFFER_NUM 256
+#define URING_RECV_BUFFER_SIZE 2048
+
 #define NO_ERROR 0
 #define RESOURCE_TEMPOREARILY_UNAVAILABLE -1
 #define RESOURCE_UNAVAILABLE -2
 #define SOCKET_CONFIGUE_ERROR -3
 #define SOCKET_ACCEPT_ERROR -4
 #define EPOLL_ERROR -5
+#define MESSAGE_TOO_LONG -6
 
 #define KEEP_IDLE 60
 #define KEEP_INTERVAL 5
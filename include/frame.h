@@ -0,0 +1,25 @@
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*
+ * 编码完成、只读、带引用计数的消息帧。
+ *
+ * 一条需要群发的消息只编码一次，所有接收者的发送队列共享同一个 frame_t，
+ * 每个持有者各自持有一个引用，最后一个持有者发送完毕（或放弃发送）时释放内存。
+ * 帧创建之后内容不再修改，所以多个持有者读取时不需要加锁。
+ */
+typedef struct _frame
+{
+    atomic_int refcount; // 引用计数
+    uint16_t len;        // 帧长度（消息头 + 消息体）
+    char data[];         // 编码好的字节流
+} frame_t;
+
+frame_t *frame_create(const char *data, uint16_t len);
+frame_t *frame_ref(frame_t *frame);
+void frame_release(frame_t *frame);
+
+#endif
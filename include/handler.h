@@ -8,7 +8,6 @@
 #include "server_conf.h"
 #include "config.h"
 
-extern int g_send_epoll_fd;
 extern pconf_t *g_pconf;
 extern bool g_over;
 
@@ -20,5 +19,7 @@ void handle_some_one_quit(CQuery *query);
 void handle_game_update(CQuery *query);
 void handle_player_info_cert(CQuery *query);
 void handle_client_ready(CQuery *query);
+void handle_snapshot_ack(CQuery *query);
+void handle_pong(CQuery *query);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef __INTEREST_H__
+#define __INTEREST_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "config.h"
+
+/*
+ * 兴趣管理（`-i radius`）：GAME_UPDATE 只转发给半径 radius 以内的玩家，SOME_ONE_JOIN / SOME_ONE_QUIT 仍然发给所有人。
+ *
+ * 玩家的位置取自 GAME_UPDATE 中 Transform3D 的原点（只看水平面上的 x、z），
+ * 存放在以 radius 为边长的均匀网格中，网格按房间号和格子坐标哈希到 INTEREST_BUCKET_NUM 个桶里（空间哈希），
+ * 每个桶是一条以 slot 下标串起来的双向链表。查询时只需要扫描自己所在格子周围的 3x3 个格子，
+ * 再按房间和真实距离过滤，每条 GAME_UPDATE 的代价只和附近的玩家数有关，而不是在线玩家总数。
+ * 每个发送 worker 一个网格，其中的玩家来自它负责的所有房间，不同房间的玩家即使坐标相同也互不可见。
+ *
+ * 还没有上报过位置的玩家不在网格中，收不到别人的 GAME_UPDATE，直到它发出第一条 GAME_UPDATE。
+ * 只由所属 worker 的发送线程访问（计数器除外）。
+ */
+typedef struct
+{
+    char id[PLAYER_ID_LEN];         // 登记时玩家的 UUID，slot 被复用之后用来识别陈旧的条目
+    int room;                       // 玩家所在的房间
+    float x, z;                     // 最新的位置
+    int cell_x, cell_z;             // 所在的格子
+    int bucket;                     // 所在的桶，-1 表示不在网格中
+    int prev, next;                 // 桶内链表，存放 slot 下标
+} interest_entry_t;
+
+typedef struct
+{
+    float radius;                   // 兴趣半径，0 表示关闭
+    float radius2;
+    int *buckets;                   // 每个桶链表头的 slot 下标，-1 表示空
+    interest_entry_t *entries;      // 以 slot 为下标，容量为 MAX_CONNECTION_NUM
+    atomic_uint_fast64_t relayed_count;  // 按兴趣范围转发出去的 GAME_UPDATE 份数
+    atomic_uint_fast64_t filtered_count; // 因为超出兴趣范围而没有转发的份数
+} interest_grid_t;
+
+int interest_grid_init(interest_grid_t *grid, float radius);
+void interest_grid_destroy(interest_grid_t *grid);
+
+bool interest_position_from_transform(const char *transform, float *x, float *z);
+void interest_grid_update(interest_grid_t *grid, int slot, int room, const char *id, float x, float z);
+void interest_grid_remove(interest_grid_t *grid, int slot);
+bool interest_grid_contains(const interest_grid_t *grid, int slot, const char *id);
+int interest_grid_query(const interest_grid_t *grid, int slot, int *slots, int max_num);
+
+static inline bool interest_enabled(const interest_grid_t *grid)
+{
+    return grid->radius > 0;
+}
+
+#endif
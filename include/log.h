@@ -0,0 +1,146 @@
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "config.h"
+
+// 日志级别，低于 g_log_level 的日志在调用处就被跳过，不会求值参数
+typedef enum
+{
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_OFF,
+} log_level_t;
+
+/*
+ * 异步二进制日志。
+ *
+ * 每个调用处有一个静态的 `log_site_t`（级别、格式串、文件和行号），它的地址就是这条日志的格式 id。
+ * 写日志的线程只把格式 id、时间戳和参数的原始值（字符串参数拷贝内容）追加到自己的环形缓冲区中，
+ * 不做任何格式化、不加锁、不进行系统调用；后台日志线程定期把所有线程的缓冲区取空，按格式串格式化之后写到 stdout。
+ *
+ * 每个线程的缓冲区是单生产者单消费者的字节环，第一次写日志时分配并登记。缓冲区满时丢弃这条日志并计数，
+ * 日志线程会在输出中报告丢弃的条数，写日志的线程永远不会因为日志而阻塞。
+ * 不同线程的日志按照取出的顺序输出，只保证同一个线程内的顺序。
+ */
+typedef struct
+{
+    log_level_t level;
+    const char *format;
+    const char *file;
+    int line;
+} log_site_t;
+
+// 参数的类型，由调用处的 _Generic 根据参数的静态类型选择
+typedef enum
+{
+    LOG_ARG_INT,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,
+} log_arg_type_t;
+
+typedef struct
+{
+    log_arg_type_t type;
+    union
+    {
+        uint64_t i;
+        double d;
+        const void *p;
+        const char *s;
+    };
+} log_arg_t;
+
+// 一个线程的日志环形缓冲区，tail 只由写日志的线程推进，head 只由日志线程推进
+typedef struct
+{
+    char *buffer;                       // LOG_RING_SIZE 字节
+    _Atomic uint64_t head;              // 日志线程已经取出的字节数
+    _Atomic uint64_t tail;              // 已经写入的字节数
+    atomic_uint_fast64_t dropped;       // 缓冲区满时丢弃的日志条数
+    uint64_t reported;                  // 日志线程已经报告过的丢弃条数
+} log_ring_t;
+
+typedef struct
+{
+    log_ring_t *rings[LOG_MAX_THREAD_NUM]; // 已经登记的线程缓冲区
+    atomic_int ring_num;                   // 已经登记的线程数
+    pthread_mutex_t ring_lock;             // 只在线程第一次写日志、登记缓冲区时使用
+    atomic_uint_fast64_t dropped;          // 线程数超过 LOG_MAX_THREAD_NUM 时丢弃的日志条数
+    pthread_t pid;                         // 日志线程
+    bool started;                          // 日志线程已经启动
+    atomic_bool over;                      // 通知日志线程取空缓冲区之后退出
+    FILE *out;                             // 输出流
+} log_t;
+
+extern log_t g_log;
+extern atomic_int g_log_level;
+
+int init_log(log_level_t level, FILE *out);
+void destroy_log();
+
+void log_write(const log_site_t *site, const log_arg_t *args, int arg_num);
+void log_check_format(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+int log_level_parse(const char *name);
+const char *log_level_name(log_level_t level);
+
+static inline log_arg_t log_arg_int(uint64_t value) { return (log_arg_t){.type = LOG_ARG_INT, .i = value}; }
+static inline log_arg_t log_arg_double(double value) { return (log_arg_t){.type = LOG_ARG_DOUBLE, .d = value}; }
+static inline log_arg_t log_arg_ptr(const void *value) { return (log_arg_t){.type = LOG_ARG_PTR, .p = value}; }
+static inline log_arg_t log_arg_str(const char *value) { return (log_arg_t){.type = LOG_ARG_STR, .s = value}; }
+
+#define LOG_ARG(x) _Generic((x),                        \
+    char *: log_arg_str, const char *: log_arg_str,     \
+    float: log_arg_double, double: log_arg_double,      \
+    void *: log_arg_ptr, const void *: log_arg_ptr,     \
+    default: log_arg_int)(x)
+
+// 格式串之后的参数个数，最多 LOG_MAX_ARG_NUM（8）个
+#define LOG_NARG(...) LOG_NARG_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARG_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+#define LOG_CAT(a, b) LOG_CAT_(a, b)
+#define LOG_CAT_(a, b) a##b
+#define LOG_ARGS_0(f)
+#define LOG_ARGS_1(f, a) , LOG_ARG(a)
+#define LOG_ARGS_2(f, a, ...) , LOG_ARG(a) LOG_ARGS_1(f, __VA_ARGS__)
+#define LOG_ARGS_3(f, a, ...) , LOG_ARG(a) LOG_ARGS_2(f, __VA_ARGS__)
+#define LOG_ARGS_4(f, a, ...) , LOG_ARG(a) LOG_ARGS_3(f, __VA_ARGS__)
+#define LOG_ARGS_5(f, a, ...) , LOG_ARG(a) LOG_ARGS_4(f, __VA_ARGS__)
+#define LOG_ARGS_6(f, a, ...) , LOG_ARG(a) LOG_ARGS_5(f, __VA_ARGS__)
+#define LOG_ARGS_7(f, a, ...) , LOG_ARG(a) LOG_ARGS_6(f, __VA_ARGS__)
+#define LOG_ARGS_8(f, a, ...) , LOG_ARG(a) LOG_ARGS_7(f, __VA_ARGS__)
+#define LOG_FORMAT(f, ...) f
+
+/**
+ * 写一条日志：`LOG_AT(level, format, args...)`，format 必须是字符串字面量。
+ *
+ * 级别被关闭时只有一次 relaxed 读和一次比较；格式串和参数的类型在编译时由 `log_check_format` 检查，
+ * 它本身永远不会被调用。参数数组的第一个元素只是占位，保证没有参数时数组也不为空。
+ */
+#define LOG_AT(level, ...)                                                                          \
+    do                                                                                              \
+    {                                                                                               \
+        if ((int)(level) >= atomic_load_explicit(&g_log_level, memory_order_relaxed))               \
+        {                                                                                           \
+            static const log_site_t log_site_ = {(level), LOG_FORMAT(__VA_ARGS__, ), __FILE__, __LINE__}; \
+            const log_arg_t log_args_[] = {{0} LOG_CAT(LOG_ARGS_, LOG_NARG(__VA_ARGS__))(__VA_ARGS__)}; \
+            log_write(&log_site_, log_args_ + 1, LOG_NARG(__VA_ARGS__));                           \
+        }                                                                                           \
+        if (0)                                                                                      \
+            log_check_format(__VA_ARGS__);                                                          \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif
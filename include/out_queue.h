@@ -0,0 +1,56 @@
+#ifndef __OUT_QUEUE_H__
+#define __OUT_QUEUE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "frame.h"
+#include "config.h"
+#include "slab.h"
+
+/*
+ * 每个连接一个的发送队列，保存等待发送的帧引用。
+ *
+ * 发送线程先把一批消息对应的帧全部追加到各个接收者的队列中，再对每个队列调用一次
+ * `out_queue_flush`，用一次 writev 把队列里所有的帧一起写出去。
+ * io_uring 后端不调用 writev，而是用 `out_queue_peek_iov` 取出待发送的片段提交给内核，
+ * 完成之后再用 `out_queue_consume` 按发送出去的字节数出队。
+ * 连接消费得太慢时，发送线程按背压策略用 `out_queue_supersede` 替换掉被取代的状态帧，见 send_req.c 中的 `queue_frame`。
+ * 帧引用数组只在队列非空时从 g_io_buffer_slab 中借用，队列清空时立即归还，空闲的连接不占用这部分内存。
+ * 只由发送线程访问，不需要加锁。
+ */
+typedef struct
+{
+    frame_t **frames;                     // 帧引用的环形队列（OUT_QUEUE_FRAME_NUM 个），NULL 表示没有借用
+    uint32_t head;                        // 队头下标
+    uint32_t num;                         // 队列中的帧数
+    uint32_t offset;                      // 队头帧已经写出去的字节数
+    size_t bytes;                         // 队列中尚未写出的字节数
+    uint32_t inflight;                    // io_uring 后端：已经提交给内核、还没有完成的发送请求数
+} out_queue_t;
+
+// 帧引用数组的字节数，g_io_buffer_slab 中有一个正好这么大的等级
+#define OUT_QUEUE_FRAMES_SIZE (OUT_QUEUE_FRAME_NUM * sizeof(frame_t *))
+
+// out_queue_flush 的返回值
+#define OUT_QUEUE_DRAINED 0  // 队列已经写空
+#define OUT_QUEUE_BLOCKED 1  // 内核发送缓冲区已满（EAGAIN），需要等待可写事件
+#define OUT_QUEUE_ERROR -1   // 发生了其他写错误
+
+extern slab_t g_io_buffer_slab;
+
+void out_queue_init(out_queue_t *queue);
+int out_queue_push(out_queue_t *queue, frame_t *frame);
+int out_queue_supersede(out_queue_t *queue, frame_t *frame, uint32_t key_offset, uint32_t key_len);
+int out_queue_flush(out_queue_t *queue, int sockfd);
+int out_queue_peek_iov(const out_queue_t *queue, struct iovec *iov, int max_num);
+void out_queue_consume(out_queue_t *queue, size_t bytes);
+void out_queue_clear(out_queue_t *queue);
+
+static inline bool out_queue_empty(const out_queue_t *queue)
+{
+    return 0 == queue->num;
+}
+
+#endif
@@ -3,45 +3,109 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include "query.h"
+#include "out_queue.h"
+#include "timer_wheel.h"
+
+/*
+ * 连接的状态机，只由接收该连接的 reactor 推进：
+ * - CONN_OPEN：正常收发；
+ * - CONN_DRAINING：对端已经关闭写端（EPOLLRDHUP / EPOLLHUP，或者 read 返回 0），内核中剩下的数据读完、
+ *   解析出其中完整的消息之后关闭；
+ * - CONN_CLOSED：已经拆除，`available` 随之置为 false，SOME_ONE_QUIT 已经入队，之后的读事件直接忽略。
+ * 拆除只在第一次进入 CONN_CLOSED 时进行一次，见 `CQuery_notify_quit`。
+ */
+typedef enum
+{
+    CONN_OPEN,
+    CONN_DRAINING,
+    CONN_CLOSED,
+} conn_state_t;
 
 typedef struct info_table {
-    char *id;                     // 玩家ID，指向存储玩家唯一标识符的字符串。
-    char *name;                   // 玩家名称，指向存储玩家昵称的字符串。
+    char id[PLAYER_ID_LEN + 1];           // 玩家ID，存储玩家唯一标识符的字符串。
+    char name[MAX_PLAYER_NAME_LEN + 1];   // 玩家名称，存储玩家昵称的字符串（CLIENT_READY 之前为空串）。
     int socketfd;                 // 与玩家对应的套接字文件描述符，用于网络通信。
     
-    char rcv_buffer[UNIT_BUFFER_SIZE * 10]; // 接收缓冲区，存储从网络读取的未处理数据。
-    CQuery *query;                // 指向当前与该玩家相关联的查询对象，用于处理玩家的请求。
+    char *rcv_buffer;             // 接收环形缓冲区（RECV_BUFFER_SIZE 字节），有未处理的数据时才从 g_io_buffer_slab 中借用，NULL 表示没有借用。
+    uint32_t rcv_head;            // 读游标：已经解析（拷贝出去）的字节数，单调递增，对容量取模得到下标。
+    uint32_t rcv_tail;            // 写游标：已经写入的字节数，rcv_tail - rcv_head 为缓冲区中未处理的字节数。
+    CQuery *query;                // 正在接收消息体的查询对象，消息头解析之后申请，消息体收全之后放入 ready 队列。
     bool is_header_handled;       // 指示当前消息的头部是否已处理（`true` 表示已处理）。
-    int prepare_to_handle;        // 指示准备处理的字节数，用于确定下一步应处理多少数据。
-    int havent_handle;            // 接收缓冲区中未处理的字节数，表示从接收到的数据中还有多少需要处理。
-
-    char snd_buffer[UNIT_BUFFER_SIZE * 10]; // 发送缓冲区，存储即将发送的数据。
-    int havent_send;              // 发送缓冲区中尚未发送的字节数，用于追踪部分发送的消息。
-
-    bool available;               // 标志玩家是否在线可用（`true` 表示在线，`false` 表示离线）。
+    uint32_t body_received;       // 当前消息体已经拷贝进 `query` 的字节数。
+
+    out_queue_t out_queue;        // 发送队列，保存等待发送的帧引用，只由发送线程访问。
+    bool wait_writable;           // 发送队列被 EAGAIN 阻塞，正在发送 epoll 上等待可写事件。
+    bool in_flush_list;           // 已经登记在发送线程本轮待 flush 的列表中。
+    uint64_t send_backlog_ns;     // 发送队列最近一次从空变为非空的时刻，只由发送线程访问。
+    bool send_kicked;             // 发送队列积压太久，发送线程已经断开了连接，之后的帧直接丢弃。
+    CQuery *pending_update;       // tick 模式下本 tick 内最新的 GAME_UPDATE，只由发送线程访问，持有一个消息计数。
+    bool in_tick_list;            // 已经登记在发送线程本 tick 待合并的列表中。
+    _Atomic uint32_t snapshot_ack; // 客户端最后确认的快照序号，由 handler 写入、发送线程读取，0 表示没有确认过。
+    int tick_next;                // 所在房间本 tick 待合并链表中的下一个 slot，只由房间的 worker 访问。
+
+    _Atomic uint32_t udp_token;   // UDP 通道的令牌，在 RESPONSE_UUID 中下发，0 表示没有令牌（没有开启 `-u`）。
+    _Atomic uint64_t udp_addr;    // 客户端通过 UDP 发来 GAME_UPDATE 的地址（IPv4 地址 << 16 | 端口），0 表示还没有绑定，由 UDP 线程写入。
+    _Atomic uint64_t udp_recv_ms; // 最近一次通过 UDP 收到数据的时刻，接收该连接的 reactor 做空闲检查时一并考虑。
+    uint32_t udp_recv_seq;        // 最近一次收到的数据报序号，只由 UDP 线程访问。
+    uint32_t udp_send_seq;        // 最近一次发出的数据报序号，只由发送队列所属的 worker 访问。
+
+    _Atomic uint32_t rtt_us;      // 平滑后的往返时间（微秒），由 handler 在收到 PONG 时写入，0 表示还没有样本。
+    _Atomic uint32_t rtt_jitter_us; // 往返时间的平均偏差（微秒），和 rtt_us 一起由 handler 写入。
+
+    int room;                     // 所在的房间号，PLAYER_INFO_CERT 之前为 -1，由 handler 写入一次。
+    bool compact_id;              // 客户端在 PLAYER_INFO_CERT 中协商了紧凑 id 模式，和 room 一起由 handler 写入一次。
+    _Atomic int worker;           // 发送队列当前所属的发送 worker，连接建立时为大厅 worker（0），迁移时由原来的 worker 写入。
+    bool in_room;                 // 已经加入房间的成员链表。
+    int room_prev, room_next;     // 房间成员链表中的前后 slot，和 in_room 一起由房间锁保护。
+
+    _Atomic int conn_state;       // 连接状态（conn_state_t），由接收该连接的 reactor 推进。
+    timer_node_t timer;           // 握手 / 空闲超时的定时器，挂在接收该连接的 reactor 的时间轮上，只由该 reactor 访问。
+    uint64_t last_recv_ms;        // 最近一次收到数据的时刻（时间轮的缓存时间），只由接收该连接的 reactor 访问。
+    bool handshake_done;          // 已经收到 CLIENT_READY，只由接收该连接的 reactor 访问。
+    bool available;               // 标志玩家是否在线可用（`true` 表示在线，`false` 表示离线），连接拆除时置为 false。
     bool ready;                   // 标志玩家是否已准备好（可能与游戏逻辑相关，`true` 表示准备好）。
     int message_count;            // 玩家收到的消息计数，记录接收到的消息数量。
-    pthread_mutex_t *msg_count_mutex; // 消息计数的互斥锁，确保多线程环境下对 `message_count` 的安全更新。
+    pthread_mutex_t msg_count_mutex; // 消息计数的互斥锁，确保多线程环境下对 `message_count` 的安全更新。
 
-    struct info_table *next;      // 指向下一个玩家的指针，形成一个链表结构。
+    int slot;                     // 玩家在稠密数组中的下标，终身不变。
+    int active_index;             // 玩家在活跃列表中的位置，用于 O(1) 删除。
 } player_info;
 
+/*
+ * 玩家注册表。
+ *
+ * 所有 player_info 都存放在一次性分配好的稠密数组 slots 之中，删除玩家只是把 slot 还给空闲栈，
+ * 内存永远不会被释放，所以其他线程手里的 player_info 指针始终是可以安全访问的。
+ * - by_fd：以 socket fd 为下标的直接索引，读操作无锁；
+ * - id_table：以 UUID 为键的开放寻址哈希表（线性探测），存放 slot 下标；
+ * - active：当前在线玩家 slot 下标的紧凑列表，群发时按顺序遍历。
+ */
 typedef struct {
-    size_t length;               // 玩家信息表的长度，存储当前玩家数。
-    player_info *head;           // 指向玩家链表的头节点。
+    size_t length;                // 玩家信息表的长度，存储当前玩家数。
+    player_info *slots;           // 玩家信息稠密数组，容量为 MAX_CONNECTION_NUM。
+    int *free_slots;              // 空闲 slot 下标栈。
+    int free_num;                 // 空闲 slot 的数量。
+    int *active;                  // 在线玩家 slot 下标的紧凑列表，前 length 个有效。
+    _Atomic(player_info *) *by_fd; // fd -> player_info 的直接索引，容量为 MAX_FD_NUM。
+    int *id_table;                // UUID -> slot 下标的哈希表，-1 表示空位。
+    uint32_t id_table_mask;       // 哈希表容量减一（容量为 2 的幂）。
 } player_info_array;
 
 extern player_info_array player_infos;
 
 void init_player_info_array_lock();
 
-void player_info_array_init();
+int player_info_array_init();
+
+void player_info_array_destroy();
 
 int get_player_info_array_length();
 
-int add_player_info(const char *id, int socketfd);
+player_info *add_player_info(const char *id, int socketfd);
 
 int set_player_name(char *id, char *name);
 
@@ -53,15 +117,30 @@ int clear_player_info_array();
 
 player_info *get_player_info_by_sock(int socketfd);
 
-int *get_player_info_sockfds();
+player_info *get_player_info_by_id(const char *id);
 
-char *package_global_player_info(int except_socketfd);
+int get_player_info_snapshot(player_info **players, int max_num);
+
+char *package_global_player_info(int except_socketfd, int room, bool compact, int *len);
 
 int scan_and_delete_unavailable_player_info();
 
 void plus_message_count(player_info *info);
 
+bool try_plus_message_count(player_info *info);
+
 void minus_message_count(player_info *info);
 
 int get_message_count(player_info *info);
-#endif
\ No newline at end of file
+
+/*
+ * 客户端确认一批数据大约需要的时间：平滑往返时间 + 4 倍抖动（和 TCP 的 RTO 一样），还没有样本时为 0。
+ * 发送线程据此放宽远端玩家的发送队列积压时间，见 `queue_frame`。
+ */
+static inline uint64_t player_rtt_slack_ns(const player_info *info)
+{
+    uint64_t rtt = atomic_load_explicit(&info->rtt_us, memory_order_relaxed);
+    uint64_t jitter = atomic_load_explicit(&info->rtt_jitter_us, memory_order_relaxed);
+    return (rtt + 4 * jitter) * 1000;
+}
+#endif
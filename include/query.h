@@ -17,23 +17,30 @@
 #include "binary_protocol.h"
 #include "util.h"
 #include "config.h"
+#include "slab.h"
+#include "stats.h"
 
 /*接收数据的缓冲大小*/
 #define TIME_OUT 1000
 
+struct info_table;
+
 typedef struct _CQuery
 {
     MessageHeader m_header; // 消息头
     int m_socket_fd;        // socket fd
 
-    char m_byte_Query[QUERY_BUFFER_LEN]; // 携带的数据
+    char *m_byte_Query;                  // 携带的数据，从 g_payload_slab 中按需申请，NULL 表示还没有分配
+    size_t m_query_cap;                  // m_byte_Query 的容量
     uint16_t m_query_len;                //  query长度
+    uint64_t m_recv_ns;                  // 放入 ready 队列的时刻，统计各阶段耗时使用，见 stats.h
+    uint64_t m_ready_ns;                 // handler 取出的时刻
+    uint64_t m_handled_ns;               // handler 处理完放入 work 队列的时刻
+    struct info_table *m_pinned;         // 入队之前已经为之持有一个消息计数的玩家，handler 不再增加计数；NULL 表示由 handler 按 fd 查找
     struct _CQuery *p_pre_query;         // 上一个req
     struct _CQuery *p_next_query;        // 下一个req
 } CQuery;
 
-extern int g_send_epoll_fd; /*发送epoll*/
-extern int g_recv_epoll_fd; /*接收epoll*/
 
 extern int header_size;
 
@@ -41,9 +48,13 @@ CQuery *CQuery_create();
 void CQuery_init(CQuery *query);
 void CQuery_destroy(CQuery *query);
 
-int CQuery_accept_tcp_connect(int listen_socket);
+int CQuery_accept_tcp_connect(int listen_socket, int epoll_fd);
 int CQuery_send_query(CQuery *query);
-int CQuery_recv_message(int socketfd);
+int CQuery_init_connection(CQuery *query, int socketfd, struct sockaddr_in *addr, struct info_table **info);
+int CQuery_recv_message(struct info_table *info, int epoll_fd, uint32_t events);
+int CQuery_recv_buffer(struct info_table *info, const char *data, int len);
+int CQuery_parse_message(struct info_table *info);
+bool CQuery_notify_quit(struct info_table *info);
 
 int CQuery_close_socket(CQuery *query);
 
@@ -54,6 +65,8 @@ int CQuery_check_socket_err(const CQuery *query);
 int CQuery_set_query_sock(CQuery *query, int sock);
 int CQuery_get_socket(CQuery *query);
 
+int CQuery_reserve(CQuery *query, size_t len);
+void CQuery_release_buffer(CQuery *query);
 int CQuery_set_query_buffer(CQuery *query, const char *pBuf, int buf_len);
 char *CQuery_get_query_buffer(CQuery *query);
 
@@ -65,7 +78,8 @@ CQuery *CQuery_get_pre_query(CQuery *query);
 int CQuery_set_next_query(CQuery *query, CQuery *pQuery);
 CQuery *CQuery_get_next_query(CQuery *query);
 
-void CQuery_pack_message(CQuery *query);
+int CQuery_pack_message(CQuery *query);
 extern pconf_t *g_pconf;
+extern slab_t g_payload_slab;
 
 #endif
\ No newline at end of file
@@ -3,25 +3,43 @@
 
 #include <pthread.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include "query.h"
+#include "ring_queue.h"
+#include "wakeup.h"
 #include "player_info_array.h"
+#include "worker.h"
+
+// 一次批量出队/入队的最大 CQuery 数
+#define QUERY_BATCH_NUM 64
 
 int init_query_list_lock();
 int destroy_query_list_lock();
 
+int init_query_list_ring(size_t capacity);
+void destroy_query_list_ring();
+
+int init_query_list_wakeup(wait_policy_t policy, int spin_num);
+void destroy_query_list_wakeup();
+
 CQuery *get_free_query();
 int add_free_list(CQuery *pQuery);
+bool reserve_free_query();
+void unreserve_free_query();
+CQuery *get_reserved_query();
 
 CQuery *get_gready_query();
+size_t get_gready_queries(CQuery **queries, size_t max_num);
 int add_gready_list(CQuery *pQuery);
-CQuery *get_gwork_query();
+int add_gready_list_batch(CQuery **queries, size_t num);
+
+CQuery *get_gwork_query(worker_t *worker);
+size_t get_gwork_queries(worker_t *worker, CQuery **queries, size_t max_num);
 int add_gwork_list(CQuery *pQuery);
-int del_gwork_list(CQuery *pQuery);
+int add_gwork_list_batch(worker_t *worker, CQuery **queries, size_t num);
 
 extern CQuery *g_pfree_list;
-extern CQuery *g_pready_list;
-extern CQuery *g_pwork_list;
-extern CQuery *g_pwork_list_tail;  /*发送或接收结果状态的CQuery队列尾*/
-extern CQuery *g_pready_list_tail; /*有数据准备建立连接的CQuery队列尾*/
+extern mpsc_ring g_ready_ring; /*有数据准备处理的CQuery队列（reactor -> handler）*/
+extern wakeup_t g_ready_wakeup; /*ready 队列的唤醒器，handler 线程在上面睡眠*/
 
-#endif
\ No newline at end of file
+#endif
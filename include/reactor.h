@@ -0,0 +1,45 @@
+#ifndef __REACTOR_H__
+#define __REACTOR_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include "server_conf.h"
+#include "config.h"
+#include "timer_wheel.h"
+
+// 一个接收 reactor：独立的 epoll 实例 + 监听套接字 + 接收线程，
+// 负责自己 accept 进来的所有连接的读事件
+typedef struct
+{
+    int id;                              // reactor 编号
+    int epoll_fd;                        // 该 reactor 独占的 epoll 实例（io_uring 后端下为 -1）
+    int listen_socket;                   // 该 reactor 监听的套接字
+    pthread_t pid;                       // 运行 recv_res_main 的线程
+    atomic_uint_fast64_t accept_count;   // 已经 accept 的连接数
+    atomic_uint_fast64_t recv_msg_count; // 已经解析出的完整消息数
+    timer_wheel_t timers;                // 该 reactor 上所有连接的握手 / 空闲定时器，只由接收线程访问
+} reactor_t;
+
+struct info_table;
+
+extern reactor_t g_reactors[MAX_REACTOR_NUM];
+extern int g_reactor_num;
+extern pconf_t *g_pconf;
+extern _Thread_local reactor_t *tls_reactor;
+
+int init_reactors();
+int start_reactors();
+void join_reactors();
+void destroy_reactors();
+
+void reactor_conn_open(struct info_table *info);
+void reactor_conn_ready(struct info_table *info);
+void reactor_conn_closed(struct info_table *info);
+int reactor_expire_timers(reactor_t *reactor);
+
+uint64_t get_reactors_accept_count();
+uint64_t get_reactors_recv_msg_count();
+
+#endif
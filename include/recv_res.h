@@ -8,14 +8,14 @@
 #include "query.h"
 #include "query_list.h"
 #include "handler.h"
+#include "reactor.h"
 
 typedef int (*CALL_BACK)(char *, int);
 
 void *recv_res_main(void *);
 
 extern size_t g_query_num;
-extern int g_recv_epoll_fd;
 extern pconf_t *g_pconf;
 extern bool g_over;
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,56 @@
+#ifndef __RING_QUEUE_H__
+#define __RING_QUEUE_H__
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define CACHE_LINE_SIZE 64
+
+// MPSC 环形队列中的一个槽位，seq 用来标记该槽位当前轮次是否可写/可读
+typedef struct
+{
+    atomic_size_t seq;
+    void *data;
+} ring_cell;
+
+/*
+ * 有界无锁 MPSC 环形队列（多生产者单消费者）。
+ * 用于 reactor -> handler 的交接：多个接收 reactor 并发入队，只有 handler 线程出队。
+ */
+typedef struct
+{
+    size_t mask;                                  // 容量 - 1，容量总是 2 的幂
+    ring_cell *cells;                             // 槽位数组
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail; // 下一个入队位置，生产者之间通过 CAS 竞争
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head; // 下一个出队位置，只有消费者修改
+} mpsc_ring;
+
+/*
+ * 有界无锁 SPSC 环形队列（单生产者单消费者）。
+ * 用于 handler -> sender 的交接：只有 handler 入队，只有 sender 出队。
+ */
+typedef struct
+{
+    size_t mask;                                  // 容量 - 1，容量总是 2 的幂
+    void **cells;                                 // 槽位数组
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail; // 下一个入队位置，只有生产者修改
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head; // 下一个出队位置，只有消费者修改
+} spsc_ring;
+
+int mpsc_ring_init(mpsc_ring *ring, size_t capacity);
+void mpsc_ring_destroy(mpsc_ring *ring);
+int mpsc_ring_push(mpsc_ring *ring, void *item);
+size_t mpsc_ring_push_batch(mpsc_ring *ring, void **items, size_t num);
+void *mpsc_ring_pop(mpsc_ring *ring);
+size_t mpsc_ring_pop_batch(mpsc_ring *ring, void **items, size_t max_num);
+size_t mpsc_ring_size(mpsc_ring *ring);
+
+int spsc_ring_init(spsc_ring *ring, size_t capacity);
+void spsc_ring_destroy(spsc_ring *ring);
+int spsc_ring_push(spsc_ring *ring, void *item);
+size_t spsc_ring_push_batch(spsc_ring *ring, void **items, size_t num);
+void *spsc_ring_pop(spsc_ring *ring);
+size_t spsc_ring_pop_batch(spsc_ring *ring, void **items, size_t max_num);
+size_t spsc_ring_size(spsc_ring *ring);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef __ROOM_H__
+#define __ROOM_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include "config.h"
+#include "snapshot.h"
+#include "player_info_array.h"
+
+/*
+ * 房间：一局独立的比赛。
+ *
+ * 客户端在 PLAYER_INFO_CERT 中带上房间号（[0, MAX_ROOM_NUM)），之后 GLOBAL_PLAYER_INFO、SOME_ONE_JOIN、
+ * SOME_ONE_QUIT、GAME_UPDATE 以及 tick 快照都只在同一个房间的玩家之间转发。
+ * 房间固定由 `worker` 号发送 worker 负责，成员链表之外的内容只由这个 worker 访问。
+ *
+ * 成员链表以 slot 下标串起来（`player_info.room_prev / room_next`），由 `lock` 保护：
+ * 负责的 worker 在发送 GLOBAL_PLAYER_INFO 时把玩家加入房间，玩家从注册表中删除时在持有注册表锁的情况下离开房间，
+ * 加锁顺序为注册表锁 -> 房间锁。
+ */
+typedef struct
+{
+    int id;                             // 房间号
+    int worker;                         // 负责该房间的发送 worker
+    pthread_mutex_t lock;               // 保护成员链表
+    int member_head;                    // 成员链表头的 slot 下标，-1 表示空
+    int member_num;                     // 成员数
+    int tick_head;                      // 本 tick 内有 GAME_UPDATE 的玩家链表（`player_info.tick_next`），-1 表示空
+    bool in_tick_list;                  // 已经登记在 worker 本 tick 待合并的房间列表中
+    snapshot_history_t *snapshots;      // 增量快照的历史，第一次用到时分配
+} room_t;
+
+extern room_t g_rooms[MAX_ROOM_NUM];
+
+int init_rooms(int worker_num);
+void destroy_rooms();
+
+room_t *get_room(int room_id);
+void room_join(room_t *room, player_info *player);
+void room_leave(player_info *player);
+int room_snapshot(room_t *room, player_info **players, int max_num);
+int room_member_num(room_t *room);
+
+#endif
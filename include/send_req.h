@@ -4,19 +4,25 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <sys/epoll.h>
+#include <sched.h>
 #include "query.h"
 #include "query_list.h"
+#include "frame.h"
+#include "player_info_array.h"
+#include "uring_backend.h"
+#include "tick.h"
+#include "snapshot.h"
+#include "interest.h"
+#include "worker.h"
+#include "room.h"
 
-static int not_right;
+void *send_req_main(void *arg);
+void handle_group_send(worker_t *worker, room_t *room, player_info *player, CQuery *query);
+void handle_send(worker_t *worker, int target_sock, CQuery *query);
+void handle_interest_send(worker_t *worker, room_t *room, player_info *player, CQuery *query);
+void handle_send_frame(worker_t *worker, player_info *player, frame_t *frame);
 
-void *send_req_main(void *);
-void handle_group_send(CQuery *query);
-void handle_send(int target_sock, CQuery *query);
-
-extern int g_send_epoll_fd;
-extern int g_recv_epoll_fd;
 extern bool g_over;
-extern bool g_is_write_eagain;
 extern size_t g_query_num;
 
 #endif
\ No newline at end of file
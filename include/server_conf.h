@@ -2,6 +2,8 @@
 #define POINT_CONF_H
 
 #include "config.h"
+#include "wakeup.h"
+#include "log.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <sys/socket.h>
@@ -10,12 +12,48 @@
 #include <errno.h>
 #include <error.h>
 
+// 多个接收 reactor 之间分摊监听套接字的方式
+typedef enum
+{
+    LISTEN_REUSEPORT = 0, // 每个 reactor 拥有独立的监听套接字（SO_REUSEPORT），由内核对新连接做负载均衡
+    LISTEN_EXCLUSIVE      // 所有 reactor 共享同一个监听套接字，注册时带上 EPOLLEXCLUSIVE 避免惊群
+} listen_mode_t;
+
+// 收发网络数据使用的 I/O 后端
+typedef enum
+{
+    IO_BACKEND_EPOLL = 0, // 每个 reactor 一个接收 epoll + 一个发送 epoll，就绪之后由线程自己 read / writev
+    IO_BACKEND_URING      // io_uring：multishot accept / recv + provided buffer ring，发送使用链接在一起的 send
+} io_backend_t;
+
 typedef struct
 {
-    int listen_socket; /*服务器监听socket*/
-    uint16_t port;     /*服务器挂载端口*/
+    int listen_socket;                   /*服务器监听socket（第一个 reactor 使用的监听socket）*/
+    uint16_t port;                       /*服务器挂载端口*/
+    int reactor_num;                     /*接收 reactor 的数量*/
+    int worker_num;                      /*发送 worker 的数量，房间按房间号分配给各个 worker*/
+    listen_mode_t listen_mode;           /*多 reactor 的监听方式*/
+    int listen_sockets[MAX_REACTOR_NUM]; /*每个 reactor 对应的监听socket*/
+    wait_policy_t wait_policy;           /*handler/sender 线程队列为空时的等待策略*/
+    int spin_num;                        /*自适应等待策略下进入睡眠前的空转轮数*/
+    io_backend_t io_backend;             /*收发使用的 I/O 后端*/
+    int tick_rate;                       /*服务器 tick 频率（Hz），0 表示收到 GAME_UPDATE 立即转发*/
+    bool delta_snapshot;                 /*tick 模式下以客户端确认的快照为基线下发增量快照*/
+    float interest_radius;               /*兴趣半径，GAME_UPDATE 只转发给这个距离以内的玩家，0 表示转发给所有人*/
+    int idle_timeout;                    /*连接多少秒没有收到任何数据就被断开，0 表示不检查*/
+    int send_queue_kb;                   /*每个连接发送队列中尚未写出的字节数上限（KB），超出后丢弃新的状态帧*/
+    int send_lag_ms;                     /*发送队列持续非空超过这么多毫秒的连接被断开，0 表示不检查*/
+    bool udp_enabled;                    /*在同一个端口上开启 UDP 通道，GAME_UPDATE 可以改走 UDP*/
+    int ping_interval_ms;                /*向房间中的玩家发送 PING 的间隔（毫秒），0 表示不发送*/
+    log_level_t log_level;               /*日志级别，低于该级别的日志不会被记录*/
 } pconf_t;
 
+void init_config(pconf_t *pconf);
+
+int parse_config_args(pconf_t *pconf, int argc, char *argv[]);
+
+const char *io_backend_name(io_backend_t io_backend);
+
 int load_config(pconf_t *pconf, uint16_t port);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,51 @@
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "config.h"
+
+/*
+ * 按大小分级的 slab 分配器，为 CQuery 的消息体（g_payload_slab）以及连接的收发缓冲区（g_io_buffer_slab）提供存储。
+ *
+ * 每个大小等级维护一个空闲块链表；链表为空时才向系统申请一整块 slab（SLAB_CHUNK_SIZE 字节），切成等长的块挂到链表上，
+ * 所以没有流量时不占用任何内存，之后占用的内存只取决于同时在途的消息数和消息大小。
+ * 块归还之后留在链表中复用，slab 直到 `slab_destroy` 才还给系统。
+ * 一条消息只会被一个线程持有，但申请（reactor、handler）和归还（worker）发生在不同的线程上，每个等级各用一把锁保护。
+ */
+typedef struct _slab_block
+{
+    struct _slab_block *next;       // 空闲链表中的下一个块
+} slab_block_t;
+
+typedef struct _slab_chunk
+{
+    struct _slab_chunk *next;       // 已经申请的下一块 slab，销毁时遍历释放
+} slab_chunk_t;
+
+typedef struct
+{
+    size_t block_size;              // 块大小
+    int blocks_per_chunk;           // 每块 slab 切出的块数
+    pthread_mutex_t lock;           // 保护空闲链表和 slab 链表
+    slab_block_t *free_blocks;      // 空闲块链表
+    slab_chunk_t *chunks;           // 已经申请的 slab
+    atomic_size_t chunk_num;        // 已经申请的 slab 数
+    atomic_size_t used_num;         // 正在使用的块数
+} slab_class_t;
+
+typedef struct
+{
+    int class_num;                  // 大小等级数
+    slab_class_t classes[SLAB_MAX_CLASS_NUM];
+} slab_t;
+
+int slab_init(slab_t *slab, const size_t *class_sizes, int class_num);
+void slab_destroy(slab_t *slab);
+void *slab_alloc(slab_t *slab, size_t size, size_t *capacity);
+void slab_free(slab_t *slab, void *block, size_t capacity);
+size_t slab_resident_bytes(slab_t *slab);
+
+#endif
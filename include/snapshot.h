@@ -0,0 +1,65 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+/*
+ * 增量快照（`-t tick_rate -d`）。
+ *
+ * 每个 tick 把一个房间中所有玩家当前的状态记为一个带序号的快照，最近 SNAPSHOT_HISTORY_NUM 个保存在房间自己的环形历史中。
+ * 客户端收到快照之后用 SNAPSHOT_ACK 回复序号，服务器以每个客户端最后确认的快照为基线编码 GAME_SNAPSHOT_DELTA：
+ * 基线中已有并且没有变化的玩家只占几个字节，变化的玩家只发送变化的字段，基线中没有的玩家发送完整的状态；
+ * 没有确认过、或者确认的快照已经不在历史中的客户端以完整状态（基线序号为 0）编码。
+ * 编码只和基线有关，确认了同一个基线的客户端共享同一个帧。
+ *
+ * GAME_SNAPSHOT_DELTA 消息体（小端）：
+ *   uint32 seq, uint32 base_seq, 然后是按顺序排列的记录，每条记录以 1 字节的标签开头：
+ *   - SNAPSHOT_RECORD_SAME  {uint16 base_index, uint16 count}：从基线第 base_index 条起连续 count 条没有变化；
+ *   - SNAPSHOT_RECORD_DELTA {uint16 base_index, uint16 mask, 变化的字...}：Transform 按 4 字节分为
+ *     SNAPSHOT_WORD_NUM 个字，mask 的第 i 位表示第 i 个字变化了，后面依次是变化的字的新值；
+ *   - SNAPSHOT_RECORD_FULL  {UUID, Transform}：完整的状态，紧凑 id 模式的客户端收到的是 {uint16 slot id, Transform}。
+ * 客户端按记录的顺序重建出本快照的完整列表，下一次的 base_index 引用的就是这个列表中的位置。
+ */
+
+#define SNAPSHOT_WORD_NUM (TRANSFORM_LEN / 4)
+
+typedef enum
+{
+    SNAPSHOT_RECORD_SAME = 0,
+    SNAPSHOT_RECORD_DELTA,
+    SNAPSHOT_RECORD_FULL
+} snapshot_record_tag_t;
+
+typedef struct
+{
+    int slot;                           // 玩家在注册表中的 slot，用于在基线中查找同一个玩家
+    char id[PLAYER_ID_LEN];             // 玩家 UUID，slot 被复用时用来区分新旧玩家
+    char transform[TRANSFORM_LEN];      // Godot var_to_bytes(Transform3D) 的原始字节
+} snapshot_record_t;
+
+typedef struct
+{
+    uint32_t seq;                       // 快照序号，从 1 开始，0 表示空
+    int record_num;
+    int capacity;                       // records 的容量，按需倍增，最多 SNAPSHOT_MAX_RECORDS
+    snapshot_record_t *records;
+} snapshot_t;
+
+typedef struct
+{
+    uint32_t seq;                       // 最新快照的序号
+    snapshot_t history[SNAPSHOT_HISTORY_NUM];
+} snapshot_history_t;
+
+int snapshot_history_init(snapshot_history_t *history);
+void snapshot_history_destroy(snapshot_history_t *history);
+
+snapshot_t *snapshot_begin(snapshot_history_t *history);
+int snapshot_add(snapshot_t *snapshot, int slot, const char *id, const char *transform);
+const snapshot_t *snapshot_find(const snapshot_history_t *history, uint32_t seq);
+
+int snapshot_encode(const snapshot_t *snapshot, const snapshot_t *base, bool compact, char *buffer);
+
+#endif
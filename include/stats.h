@@ -0,0 +1,190 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "config.h"
+
+#define STATS_MAGIC 0x54535153u /*"SQST"*/
+#define STATS_VERSION 5
+#define STATS_SHM_NAME_FORMAT "/squash_stats.%u" /*按端口区分的共享内存段名称*/
+
+// 直方图：每个 2 的幂区间再等分成 4 个桶，相对误差不超过 25%，最后一个桶包含所有更大的值
+#define STATS_HIST_SUB_BITS 2
+#define STATS_HIST_BUCKET_NUM 160 /*最后一个桶的下界约为 1900 秒*/
+#define STATS_TYPE_NUM 16         /*按 MessageType 计数，超出范围的类型记在 0 号*/
+
+// 一条消息经过的各个阶段的耗时
+typedef enum
+{
+    STATS_STAGE_RECV_READY = 0, // 放入 ready 队列 -> handler 取出
+    STATS_STAGE_READY_HANDLED,  // handler 取出 -> 处理完放入 work 队列
+    STATS_STAGE_HANDLED_WRITTEN,// 放入 work 队列 -> 发送 worker 写出（io_uring 后端为提交发送链）
+    STATS_STAGE_END_TO_END,     // 放入 ready 队列 -> 写出
+    STATS_STAGE_PING_RTT,       // PING 入队 -> handler 取出客户端回复的 PONG，即应用层的往返时间
+    STATS_STAGE_NUM,
+} stats_stage_t;
+
+typedef enum
+{
+    STATS_THREAD_OTHER = 0, // 没有登记身份的线程（压测程序中的线程等）
+    STATS_THREAD_REACTOR,
+    STATS_THREAD_HANDLER,
+    STATS_THREAD_WORKER,
+    STATS_THREAD_UDP,       // UDP 通道的接收线程
+} stats_thread_kind_t;
+
+/*
+ * 一个线程的统计数据，只由该线程写入。
+ *
+ * 计数器都是单写者的，写入时用 relaxed 的读 + 写代替原子加，不需要总线锁；读取方（squash_stat）随时用 relaxed 读取，
+ * 看到的是某个时刻附近的近似值。每个线程的数据按缓存行对齐，线程之间不会伪共享。
+ */
+typedef struct
+{
+    _Alignas(64) atomic_int kind;                  // stats_thread_kind_t
+    atomic_int id;                                 // reactor / worker 编号
+    _Atomic uint64_t hist[STATS_STAGE_NUM][STATS_HIST_BUCKET_NUM]; // 各阶段耗时（纳秒）的直方图
+    _Atomic uint64_t hist_sum[STATS_STAGE_NUM];   // 各阶段耗时之和
+    _Atomic uint64_t recv_msgs[STATS_TYPE_NUM];   // 解析出的消息数（reactor）
+    _Atomic uint64_t recv_type_bytes[STATS_TYPE_NUM]; // 解析出的消息字节数，含消息头
+    _Atomic uint64_t send_msgs[STATS_TYPE_NUM];   // 放入发送队列的帧数，群发时每个接收者算一次（worker）
+    _Atomic uint64_t send_type_bytes[STATS_TYPE_NUM];
+    _Atomic uint64_t read_bytes;                  // 从套接字读到的字节数
+    _Atomic uint64_t write_bytes;                 // 写到套接字的字节数
+    _Atomic uint64_t read_eagain;                 // read 返回 EAGAIN 的次数
+    _Atomic uint64_t write_eagain;                // 发送队列被 EAGAIN 阻塞的次数
+    _Atomic uint64_t accepts;                     // 建立的连接数
+    _Atomic uint64_t closes;                      // 拆除的连接数
+    _Atomic uint64_t evictions;                   // 因为握手或者空闲超时被断开的连接数（也计入 closes）
+    _Atomic uint64_t send_superseded;             // 发送队列中被新的状态帧替换掉的帧数（worker）
+    _Atomic uint64_t send_dropped;                // 发送队列超出字节数上限时丢弃的状态帧数
+    _Atomic uint64_t send_kicks;                  // 发送队列积压太久（或者放不下控制消息）被断开的连接数
+    _Atomic uint64_t udp_recv;                    // UDP 通道接受的数据报数（UDP 线程）
+    _Atomic uint64_t udp_recv_dropped;            // UDP 通道丢弃的数据报数：格式错误、令牌不匹配、比已经收到的更旧
+    _Atomic uint64_t udp_sent;                    // 通过 UDP 通道发出的数据报数（worker）
+    _Atomic uint64_t udp_send_dropped;            // 套接字发送缓冲区满等原因没有发出的数据报数
+    _Atomic uint64_t queue_depth;                 // 该线程消费的队列（handler：ready 队列，worker：work 队列）最近一次的深度
+    _Atomic uint64_t queue_depth_max;             // 队列深度的最大值
+} stats_thread_t;
+
+// 一个连接的发送队列深度，由该连接发送队列所属的 worker 在队列变化时写入；往返时间由 handler 写入
+typedef struct
+{
+    _Atomic uint32_t queue_frames;                // 队列中的帧数，0 表示队列为空
+    _Atomic uint32_t queue_bytes;                 // 队列中尚未写出的字节数
+    _Atomic uint64_t backlog_ns;                  // 队列最近一次从空变为非空的时刻
+    _Atomic uint32_t rtt_us;                      // 平滑后的往返时间（微秒），由 handler 在收到 PONG 时写入，0 表示没有样本
+    _Atomic uint32_t rtt_jitter_us;               // 往返时间的平均偏差（微秒）
+} stats_client_t;
+
+/*
+ * 统计共享内存段，服务器启动时以 STATS_SHM_NAME_FORMAT 创建并映射，squash_stat 以只读方式映射后读取。
+ * magic 在其余内容初始化之后最后写入。
+ */
+typedef struct
+{
+    _Atomic uint32_t magic;
+    uint32_t version;
+    uint64_t size;                                // 整个段的字节数
+    int32_t pid;                                  // 服务器进程
+    uint32_t port;
+    uint64_t start_ns;                            // 启动时刻（CLOCK_MONOTONIC）
+    atomic_int thread_num;                        // 已经登记的线程数
+    stats_thread_t threads[STATS_MAX_THREAD_NUM];
+    stats_client_t clients[MAX_CONNECTION_NUM];  // 按 slot 下标
+} stats_segment_t;
+
+extern stats_segment_t *g_stats;
+extern _Thread_local stats_thread_t *tls_stats;
+
+int init_stats(uint16_t port);
+void destroy_stats();
+stats_thread_t *stats_register(stats_thread_kind_t kind, int id);
+
+static inline uint64_t stats_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* 当前线程的统计数据，没有登记过的线程第一次使用时登记为 STATS_THREAD_OTHER */
+static inline stats_thread_t *stats_local()
+{
+    if (__builtin_expect(NULL == tls_stats, 0))
+        tls_stats = stats_register(STATS_THREAD_OTHER, -1);
+    return tls_stats;
+}
+
+/* 单写者计数器的累加 */
+static inline void stats_add(_Atomic uint64_t *counter, uint64_t n)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline void stats_set_depth(uint64_t depth)
+{
+    stats_thread_t *stats = stats_local();
+    atomic_store_explicit(&stats->queue_depth, depth, memory_order_relaxed);
+    if (depth > atomic_load_explicit(&stats->queue_depth_max, memory_order_relaxed))
+        atomic_store_explicit(&stats->queue_depth_max, depth, memory_order_relaxed);
+}
+
+/* 发布一个连接（slot）的发送队列深度，统计段还没有创建时忽略 */
+static inline void stats_set_client_queue(int slot, uint32_t frames, uint32_t bytes, uint64_t backlog_ns)
+{
+    if (NULL == g_stats)
+        return;
+    stats_client_t *client = &g_stats->clients[slot];
+    atomic_store_explicit(&client->queue_frames, frames, memory_order_relaxed);
+    atomic_store_explicit(&client->queue_bytes, bytes, memory_order_relaxed);
+    atomic_store_explicit(&client->backlog_ns, backlog_ns, memory_order_relaxed);
+}
+
+/* 发布一个连接（slot）的往返时间和抖动，统计段还没有创建时忽略 */
+static inline void stats_set_client_rtt(int slot, uint32_t rtt_us, uint32_t jitter_us)
+{
+    if (NULL == g_stats)
+        return;
+    stats_client_t *client = &g_stats->clients[slot];
+    atomic_store_explicit(&client->rtt_us, rtt_us, memory_order_relaxed);
+    atomic_store_explicit(&client->rtt_jitter_us, jitter_us, memory_order_relaxed);
+}
+
+static inline int stats_type_index(int type)
+{
+    return (0 <= type && type < STATS_TYPE_NUM) ? type : 0;
+}
+
+/* 耗时所在的桶：小于 4 的值各占一个桶，之后每个 2 的幂区间 4 个桶 */
+static inline int stats_bucket(uint64_t ns)
+{
+    if (ns < (1u << STATS_HIST_SUB_BITS))
+        return (int)ns;
+    int e = 63 - __builtin_clzll(ns);
+    int sub = (int)(ns >> (e - STATS_HIST_SUB_BITS)) & ((1 << STATS_HIST_SUB_BITS) - 1);
+    int bucket = ((e - STATS_HIST_SUB_BITS + 1) << STATS_HIST_SUB_BITS) + sub;
+    return bucket < STATS_HIST_BUCKET_NUM ? bucket : STATS_HIST_BUCKET_NUM - 1;
+}
+
+/* 桶的下界（纳秒），bucket + 1 的下界就是它的上界 */
+static inline uint64_t stats_bucket_lower(int bucket)
+{
+    if (bucket < (1 << STATS_HIST_SUB_BITS))
+        return (uint64_t)bucket;
+    int e = (bucket >> STATS_HIST_SUB_BITS) + STATS_HIST_SUB_BITS - 1;
+    uint64_t sub = bucket & ((1 << STATS_HIST_SUB_BITS) - 1);
+    return ((1ull << STATS_HIST_SUB_BITS) + sub) << (e - STATS_HIST_SUB_BITS);
+}
+
+static inline void stats_record(stats_stage_t stage, uint64_t ns)
+{
+    stats_thread_t *stats = stats_local();
+    stats_add(&stats->hist[stage][stats_bucket(ns)], 1);
+    stats_add(&stats->hist_sum[stage], ns);
+}
+
+#endif
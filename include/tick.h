@@ -0,0 +1,39 @@
+#ifndef __TICK_H__
+#define __TICK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*
+ * 服务器 tick：固定频率的时钟，由 timerfd 驱动。
+ *
+ * 开启之后（`-t tick_rate`），发送线程不再在收到 GAME_UPDATE 时立即转发，而是只保留每个玩家在两个 tick
+ * 之间最新的一条更新；每到一个 tick，把所有玩家最新的状态拼成一个 GAME_SNAPSHOT 帧广播给所有玩家，
+ * 每秒下发的消息数从“玩家数 x 玩家数 x 客户端发送频率”降为“玩家数 x tick 频率”。
+ *
+ * timerfd 以绝对时间设置成和 next_tick_ns 相同的时刻，注册在发送线程的 epoll / io_uring 中，
+ * 保证发送线程睡眠时能准时醒来；繁忙时发送线程每轮只比较一次单调时钟，不需要额外的系统调用。
+ * 只由发送线程访问（计数器除外）。
+ */
+typedef struct
+{
+    int timer_fd;                           // 非阻塞的 timerfd，tick 关闭时为 -1
+    int rate;                               // 每秒的 tick 数，0 表示关闭
+    uint64_t interval_ns;                   // 两个 tick 之间的间隔
+    uint64_t next_tick_ns;                  // 下一个 tick 的时刻（CLOCK_MONOTONIC）
+    atomic_uint_fast64_t tick_count;        // 已经执行的 tick 数
+    atomic_uint_fast64_t coalesced_count;   // 同一个 tick 内被更新的状态覆盖、没有发送的 GAME_UPDATE 数
+    atomic_uint_fast64_t snapshot_count;    // 广播的 GAME_SNAPSHOT 帧数
+} tick_t;
+
+int tick_init(tick_t *tick, int rate);
+void tick_destroy(tick_t *tick);
+bool tick_due(tick_t *tick);
+
+static inline bool tick_enabled(const tick_t *tick)
+{
+    return tick->rate > 0;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#define TIMER_WHEEL_SLOT_NUM (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOT_NUM - 1)
+
+/*
+ * 分层时间轮。
+ *
+ * 时间以 TIMER_WHEEL_TICK_MS 为一格，共 TIMER_WHEEL_LEVEL_NUM 层，每层 TIMER_WHEEL_SLOT_NUM 个槽：
+ * 第 0 层的一个槽是一格，第 l 层的一个槽是第 l - 1 层转一圈的时间。定时器按到期时刻与当前时刻的距离放进
+ * 能容纳它的最低一层；第 0 层每转一圈，把上一层当前槽中的定时器取出重新放置（cascade），它们会落到更低的层上。
+ * 添加和取消都是 O(1) 的链表操作，每个定时器在到期之前最多被重新放置 TIMER_WHEEL_LEVEL_NUM - 1 次。
+ *
+ * 定时器节点内嵌在使用者的结构体中（见 player_info 中的 `timer`），时间轮不分配任何内存。
+ * 只由一个线程访问（每个接收 reactor 一个，见 reactor_t）。
+ */
+typedef struct timer_node
+{
+    struct timer_node *prev;    // 所在槽的双向循环链表，没有挂在时间轮上时为 NULL
+    struct timer_node *next;
+    uint64_t expire;            // 到期的格数
+} timer_node_t;
+
+// 定时器到期时的回调，节点已经从时间轮上摘下，回调中可以重新添加
+typedef void (*timer_fn)(timer_node_t *node, void *arg);
+
+typedef struct
+{
+    timer_node_t slots[TIMER_WHEEL_LEVEL_NUM][TIMER_WHEEL_SLOT_NUM]; // 每个槽的链表头
+    uint64_t now;               // 下一个要处理的格
+    uint64_t now_ms;            // 最近一次推进时的时刻（毫秒，CLOCK_MONOTONIC），供使用者作为廉价的当前时间
+    uint64_t base_ms;           // 第 0 格对应的时刻
+    int count;                  // 挂在时间轮上的定时器数
+} timer_wheel_t;
+
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now_ms);
+void timer_wheel_add(timer_wheel_t *wheel, timer_node_t *node, uint64_t expire_ms);
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_node_t *node);
+int timer_wheel_advance(timer_wheel_t *wheel, uint64_t now_ms, timer_fn fn, void *arg);
+
+static inline void timer_node_init(timer_node_t *node)
+{
+    node->prev = node->next = NULL;
+    node->expire = 0;
+}
+
+static inline bool timer_node_armed(const timer_node_t *node)
+{
+    return NULL != node->next;
+}
+
+#endif
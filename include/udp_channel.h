@@ -0,0 +1,60 @@
+#ifndef __UDP_CHANNEL_H__
+#define __UDP_CHANNEL_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "binary_protocol.h"
+#include "frame.h"
+
+struct info_table;
+
+/*
+ * 可选的 UDP 通道（`-u`），只承载不可靠的 GAME_UPDATE。
+ *
+ * 服务器在 TCP 监听的端口上再绑定一个 UDP 套接字，RESPONSE_UUID 中 slot id 之后带上一个随机令牌，
+ * 客户端在每个数据报开头的 UdpHeader 中用令牌 + slot id 表明自己是哪一个 TCP 连接：
+ * - 客户端先通过 UDP 发送 UDP_BIND，服务器原样回复，客户端收到回复（UDP 双向可达）之后改用 UDP 上报 GAME_UPDATE；
+ * - 服务器收到一个连接的第一条 UDP GAME_UPDATE 之后记下它的地址，之后转发给它的 GAME_UPDATE 都走 UDP。
+ * 没有绑定的连接，以及加入、退出、玩家列表、快照等其他所有消息仍然走 TCP。
+ *
+ * 两个方向的数据报都带有逐个递增的序号，接收方只接受比已经收到的更新的数据报，乱序到达的旧状态直接丢弃；
+ * 丢失的状态由下一条覆盖，不重传，一个丢包不会像 TCP 那样让之后的所有状态都排在重传后面。
+ *
+ * 接收由独立的 UDP 线程负责（和 I/O 后端无关），用 recvmmsg 批量接收，校验之后把 GAME_UPDATE 补全成
+ * UUID + Transform3D，和 TCP 上收到的一样放入 ready 队列；发送由各个 worker 负责，见 udp_batch_t。
+ * 只支持 IPv4。
+ */
+typedef struct
+{
+    int socket;                 // UDP 套接字，-1 表示没有开启
+    pthread_t pid;              // 运行 udp_channel_main 的线程
+} udp_channel_t;
+
+/*
+ * 一个 worker 本轮要通过 UDP 发出的数据报，flush 时用一次 sendmmsg 全部发出。
+ * 每个数据报由接收者自己的 UdpHeader 和群发共享的帧两段组成，帧的引用在发出之后释放。
+ * 只由所属 worker 的发送线程访问；sendmmsg 需要 _GNU_SOURCE，结构体定义在 udp_channel.c 中。
+ */
+typedef struct udp_batch udp_batch_t;
+
+extern udp_channel_t g_udp;
+
+int init_udp_channel(uint16_t port);
+int start_udp_channel();
+void join_udp_channel();
+void destroy_udp_channel();
+void *udp_channel_main(void *arg);
+
+udp_batch_t *udp_batch_create();
+void udp_batch_destroy(udp_batch_t *batch);
+bool udp_batch_add(udp_batch_t *batch, struct info_table *player, frame_t *frame);
+void udp_batch_flush(udp_batch_t *batch);
+
+static inline bool udp_enabled()
+{
+    return 0 <= g_udp.socket;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __URING_H__
+#define __URING_H__
+
+#ifdef HAVE_IO_URING
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/*
+ * 直接基于 io_uring_setup / io_uring_enter / io_uring_register 系统调用的最小封装（不依赖 liburing）。
+ *
+ * 提交队列（SQ）和完成队列（CQ）都映射到用户态：准备 SQE、读取 CQE 都不需要系统调用，
+ * 只有把一批 SQE 交给内核、或者需要阻塞等待完成事件时才调用一次 io_uring_enter。
+ * 一个 uring_t 只能由一个线程使用。
+ */
+typedef struct
+{
+    int ring_fd;                   // io_uring 实例的文件描述符
+    unsigned features;             // 内核支持的特性（IORING_FEAT_*）
+
+    unsigned *sq_head;             // 内核已经消费到的 SQ 位置
+    unsigned *sq_tail;             // 用户态已经发布的 SQ 位置
+    unsigned *sq_array;            // SQ 下标数组，初始化时固定为 i -> i
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sqe_tail;             // 本地已经准备好、还没有发布给内核的 SQE 位置
+    unsigned sqe_submitted;        // 已经交给 io_uring_enter 的 SQE 位置
+    struct io_uring_sqe *sqes;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ptr;                  // mmap 出来的 SQ 环（FEAT_SINGLE_MMAP 时 CQ 也在其中）
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+} uring_t;
+
+/*
+ * 注册给内核的 provided buffer ring：multishot recv 每次完成时由内核从中挑一块缓冲区，
+ * 用户态处理完数据之后把缓冲区还回去。
+ */
+typedef struct
+{
+    struct io_uring_buf_ring *ring; // 与内核共享的缓冲区描述符环
+    char *base;                     // 所有缓冲区连续分配
+    unsigned entries;               // 缓冲区数量，必须是 2 的幂
+    unsigned buf_size;              // 每块缓冲区的大小
+    uint16_t bgid;                  // 缓冲区组编号，SQE 中通过 buf_group 引用
+    uint16_t tail;                  // 本地的环尾，uring_buf_ring_commit 时发布给内核
+} uring_buf_ring_t;
+
+int uring_init(uring_t *ring, unsigned entries);
+void uring_destroy(uring_t *ring);
+
+struct io_uring_sqe *uring_get_sqe(uring_t *ring);
+unsigned uring_sq_space(const uring_t *ring);
+int uring_submit(uring_t *ring, unsigned wait_num, int timeout_ms);
+
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring);
+void uring_cqe_seen(uring_t *ring);
+
+int uring_buf_ring_init(uring_t *ring, uring_buf_ring_t *buf_ring, uint16_t bgid, unsigned entries, unsigned buf_size);
+void uring_buf_ring_destroy(uring_t *ring, uring_buf_ring_t *buf_ring);
+void uring_buf_ring_recycle(uring_buf_ring_t *buf_ring, uint16_t bid);
+void uring_buf_ring_commit(uring_buf_ring_t *buf_ring);
+
+static inline char *uring_buf_ring_get(const uring_buf_ring_t *buf_ring, uint16_t bid)
+{
+    return buf_ring->base + (size_t)bid * buf_ring->buf_size;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __URING_BACKEND_H__
+#define __URING_BACKEND_H__
+
+#ifdef HAVE_IO_URING
+
+#include <sys/uio.h>
+#include "reactor.h"
+#include "worker.h"
+#include "player_info_array.h"
+
+/*
+ * io_uring I/O 后端（`-b uring`），替换 epoll 后端中“就绪通知 + read / writev”的部分，
+ * handler、ready / work 队列、发送队列以及消息解析完全复用：
+ * - 接收：每个 reactor 一个 io_uring 实例，监听套接字上挂一个 multishot accept，
+ *   每个连接挂一个从 provided buffer ring 中取缓冲区的 multishot recv，数据交给 `CQuery_recv_buffer` 解析；
+ * - 发送：每个发送 worker 一个 io_uring 实例，每个连接发送队列中的帧提交为一条 IOSQE_IO_LINK 链接起来的 send，
+ *   所有连接的发送链在下一轮循环开始时由一次 io_uring_enter 提交，完成事件通过回调交还给对应 worker 的发送线程。
+ */
+
+// 一条发送请求完成时的回调，result 为 send 的返回值（发送的字节数或 -errno）
+typedef void (*send_complete_fn)(worker_t *worker, player_info *player, int result);
+
+int uring_reactor_init(reactor_t *reactor);
+void uring_reactor_destroy(reactor_t *reactor);
+void *uring_recv_main(void *arg);
+
+int uring_sender_init(worker_t *worker, int wakeup_fd);
+void uring_sender_destroy(worker_t *worker);
+void uring_sender_add_wakeup_fd(worker_t *worker, int fd);
+int uring_sender_send_chain(worker_t *worker, player_info *player, const struct iovec *iov, int iov_num);
+int uring_sender_cancel(worker_t *worker, player_info *player);
+int uring_sender_poll(worker_t *worker, int timeout_ms, send_complete_fn on_complete);
+
+#endif
+
+#endif
@@ -15,10 +15,20 @@
 #include <netinet/tcp.h>
 #include <fcntl.h>
 #include <time.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/random.h>
 
 #include "config.h"
+#include "log.h"
 
-void generate_uuid(char *uuid);
+// 热路径上发起的系统调用次数（收发、epoll、io_uring、eventfd 等），io_bench 用它计算每条消息的系统调用数
+extern atomic_uint_fast64_t g_syscall_count;
+#define COUNT_SYSCALL(n) atomic_fetch_add_explicit(&g_syscall_count, (n), memory_order_relaxed)
+
+int generate_uuid(char *uuid);
+int generate_token(uint32_t *token);
 int setnonblocking(int sockfd);
 int config_socket(int sockfd);
 void print_addr_info(struct sockaddr_in *addr);
@@ -0,0 +1,49 @@
+#ifndef __WAKEUP_H__
+#define __WAKEUP_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// 消费者线程在队列为空时的等待策略
+typedef enum
+{
+    WAIT_POLICY_SPIN = 0, // 一直空转轮询（原先的行为），延迟最低，但空闲时也会占满一个核
+    WAIT_POLICY_PARK,     // 队列为空就立即睡在 eventfd 上，由生产者唤醒
+    WAIT_POLICY_ADAPTIVE  // 先空转 spin_num 轮，仍然没有任务再睡眠
+} wait_policy_t;
+
+// 判断消费者是否有任务可做的回调，用于睡眠前的二次检查
+typedef bool (*has_work_fn)(void *);
+
+/*
+ * 生产者/消费者之间的唤醒器。
+ *
+ * 消费者准备睡眠时先把 sleeping 置为 1，再检查一次队列，确认为空才真正阻塞在 eventfd 上；
+ * 生产者入队之后检查 sleeping，只有消费者确实在（或准备）睡眠时才写 eventfd，
+ * 所以在繁忙时生产者几乎没有额外的系统调用开销，也不会丢失唤醒。
+ */
+typedef struct
+{
+    int event_fd;                      // 非阻塞的 eventfd，可以直接注册到 epoll 中
+    atomic_int sleeping;               // 消费者是否处于（或即将进入）睡眠状态
+    wait_policy_t policy;              // 等待策略
+    int spin_num;                      // 自适应策略下进入睡眠前的空转轮数
+    atomic_uint_fast64_t notify_count; // 生产者实际写 eventfd 的次数
+    atomic_uint_fast64_t park_count;   // 消费者真正进入睡眠的次数
+} wakeup_t;
+
+int wakeup_init(wakeup_t *wakeup, wait_policy_t policy, int spin_num);
+void wakeup_destroy(wakeup_t *wakeup);
+
+void wakeup_notify(wakeup_t *wakeup);
+
+bool wakeup_should_park(wakeup_t *wakeup, int *idle_rounds);
+void wakeup_begin_park(wakeup_t *wakeup);
+void wakeup_end_park(wakeup_t *wakeup);
+
+void wakeup_idle(wakeup_t *wakeup, int *idle_rounds, has_work_fn has_work, void *arg, int timeout_ms);
+
+const char *wait_policy_name(wait_policy_t policy);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef __WORKER_H__
+#define __WORKER_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include "server_conf.h"
+#include "config.h"
+#include "ring_queue.h"
+#include "wakeup.h"
+#include "tick.h"
+#include "interest.h"
+#include "snapshot.h"
+#include "query.h"
+#include "udp_channel.h"
+
+struct info_table;
+
+/*
+ * 发送 worker：独立的 work 队列 + 发送 epoll（或 io_uring）+ tick + 兴趣网格 + 发送线程。
+ *
+ * 每个房间固定由一个 worker 负责（房间号对 worker 数取模），房间内的群发、tick 合并、快照编码都只在这个 worker 上进行，
+ * 不同 worker 之间除了 handler 写入的 work 队列之外没有任何共享的可写状态。
+ * 每个玩家的发送队列同一时刻只属于一个 worker（`player_info.worker`）：连接建立时属于大厅 worker（0 号），
+ * 认证之后迁移到所在房间的 worker，见 `send_req_main`。
+ * 除了计数器之外，结构体中的内容只由自己的发送线程访问。
+ */
+typedef struct
+{
+    int id;                                  // worker 编号
+    pthread_t pid;                           // 运行 send_req_main 的线程
+    spsc_ring work_ring;                     // 处理完成等待发送的 CQuery 队列（handler -> 该 worker）
+    wakeup_t work_wakeup;                    // work 队列的唤醒器，发送线程在上面睡眠
+    int send_epoll_fd;                       // 发送 epoll，等待可写事件、work 队列的唤醒和 tick
+    tick_t tick;                             // 该 worker 的 tick，驱动它负责的所有房间
+    interest_grid_t interest;                // 兴趣网格，不同房间的玩家互不可见
+    snapshot_record_t *world;                // 增量快照模式下每个 slot 最新的状态，id 不匹配时无效
+
+    struct info_table *dirty_players[MAX_CONNECTION_NUM];     // 本轮有新帧入队、等待 flush 的玩家
+    int dirty_player_num;
+    int wait_writable_num;                   // 等待可写事件（io_uring 后端：有发送链在途）的玩家数
+    uint64_t now_ns;                         // 本轮循环开始处理任务的时刻，发送队列的背压策略用它计算积压时间
+    udp_batch_t *udp;                        // 本轮要通过 UDP 通道发出的 GAME_UPDATE，和发送队列一起 flush，没有开启 `-u` 时为 NULL
+    uint64_t next_ping_ns;                   // 下一次向本 worker 负责的房间中的玩家发送 PING 的时刻
+    CQuery *migrating_queries[MAX_CONNECTION_NUM];            // 等待发送队列清空之后迁移到房间 worker 的玩家的认证消息
+    int migrating_num;
+    int tick_rooms[MAX_ROOM_NUM];            // 本 tick 内有 GAME_UPDATE 的房间
+    int tick_room_num;
+
+    // 发送线程使用的临时数组，放在这里避免占用线程栈
+    struct info_table *players[MAX_CONNECTION_NUM];         // 房间成员的快照
+    int near_slots[MAX_CONNECTION_NUM];                     // 兴趣网格的查询结果
+    char records[MAX_CONNECTION_NUM][GAME_UPDATE_LEN];      // 一个房间本 tick 的快照记录
+    int picked[MAX_CONNECTION_NUM];                         // 一个快照帧要编码的记录下标（兴趣范围内的记录）
+    int record_slots[MAX_CONNECTION_NUM];                   // 每条记录对应的 slot
+    int record_of_slot[MAX_CONNECTION_NUM];                 // slot -> 本 tick 的记录下标 + 1，0 表示没有记录
+    char frame_buffer[UINT16_MAX];                          // 编码快照帧的缓冲区
+    struct epoll_event events[MAX_EPOLL_EVENT];
+} worker_t;
+
+extern worker_t g_workers[MAX_WORKER_NUM];
+extern int g_worker_num;
+extern pconf_t *g_pconf;
+
+int init_workers();
+int start_workers();
+void join_workers();
+void destroy_workers();
+
+#endif
@@ -5,7 +5,8 @@
  * @brief 将消息打包到缓冲区中，包括消息头和可选的数据部分。
  * 
  * 此函数接受消息类型、可选的数据及其长度，以及一个缓冲区。它构造一个消息头，并将其与数据（如果存在）连接在一起，
- * 放入一个临时缓冲区中，然后将结果复制到目标缓冲区。通过 `dataLength` 参数更新打包后的消息的总大小（消息头 + 数据）。
+ * 直接写入目标缓冲区：先把数据向后移动消息头的长度，再在开头写入消息头，所以数据可以原地位于目标缓冲区的开头，
+ * 消息长度也不再受临时缓冲区的限制。通过 `dataLength` 参数更新打包后的消息的总大小（消息头 + 数据）。
  * 
  * @param type 消息的类型（`MessageType` 枚举或常量值），用于消息头中。
  * @param data 指向要包含在消息中的数据的指针。如果 `data` 为 NULL，则不会打包任何额外数据。
@@ -23,15 +24,12 @@ void pack_message(MessageType type, void *data, uint16_t *dataLength, char *buff
     header.length = header_size + *dataLength;
     header.type = type;
 
-    char tmp[512];
-
-    memmove(tmp, &header, header_size);
+    // 先把数据向后挪出消息头的位置（data 和 buffer 可以是同一块内存），再写入消息头
     if (data != NULL && *dataLength > 0)
     {
-        memmove(tmp + header_size, data, *dataLength);
+        memmove(buffer + header_size, data, *dataLength);
     }
-
-    memmove(buffer, tmp, header_size + *dataLength);
+    memmove(buffer, &header, header_size);
     *dataLength = header_size + *dataLength;
 }
 
@@ -0,0 +1,44 @@
+#include "frame.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief 创建一个帧，把已经编码好的字节流拷贝进去，初始引用计数为 1（属于调用方）。
+ *
+ * @param data 编码好的消息（消息头 + 消息体）。
+ * @param len 消息长度。
+ * @return 成功返回新的帧，内存分配失败返回 NULL。
+ */
+frame_t *frame_create(const char *data, uint16_t len)
+{
+    frame_t *frame = (frame_t *)malloc(sizeof(frame_t) + len);
+    if (NULL == frame)
+        return NULL;
+
+    atomic_init(&frame->refcount, 1);
+    frame->len = len;
+    memcpy(frame->data, data, len);
+    return frame;
+}
+
+/**
+ * @brief 为新的持有者增加一个引用。
+ *
+ * @return 返回同一个帧，方便写成 `queue[i] = frame_ref(frame)`。
+ */
+frame_t *frame_ref(frame_t *frame)
+{
+    atomic_fetch_add_explicit(&frame->refcount, 1, memory_order_relaxed);
+    return frame;
+}
+
+/**
+ * @brief 释放一个引用，最后一个引用释放时回收帧的内存。
+ */
+void frame_release(frame_t *frame)
+{
+    if (NULL == frame)
+        return;
+    if (1 == atomic_fetch_sub_explicit(&frame->refcount, 1, memory_order_acq_rel))
+        free(frame);
+}
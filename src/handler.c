@@ -1,22 +1,37 @@
 #include "handler.h"
+#include "room.h"
+
+/* ready 队列是否有待处理的 CQuery，睡眠前的二次检查使用 */
+static bool ready_queue_has_work(void *)
+{
+    return 0 < mpsc_ring_size(&g_ready_ring);
+}
 
 /**
  * @brief 事件处理主函数，运行在独立线程中。
  *
- * 该函数在全局标志 `g_over` 未被设置的情况下，持续从全局队列中通过 `get_gready_query()` 获取并处理轮转数据。
+ * 该函数在全局标志 `g_over` 未被设置的情况下，持续从 ready 队列中通过 `get_gready_queries()` 批量获取并处理轮转数据。
  *
- * 函数首先获取一个查询请求，并根据其类型执行相应的操作。如果查询类型不是 `RESPONSE_UUID`，则通过
- * `get_player_info_by_sock()` 获取对应玩家的信息，并使用 `plus_message_count()` 增加该玩家的消息计数。
+ * 对于取出的每一个查询请求，函数根据其类型执行相应的操作。如果查询类型不是 `RESPONSE_UUID`，则通过
+ * `get_player_info_by_sock()` 获取对应玩家的信息，并使用 `plus_message_count()` 增加该玩家的消息计数；
+ * 找不到玩家时直接把查询归还到 freeList。入队之前已经持有计数的查询（`m_pinned`，UDP 数据报等）不再增加计数。
  *
  * 根据查询的类型，函数将查询分发到不同的处理函数：
  * 
  * - `RESPONSE_UUID`: 调用 `handle_response_uuid(query)` 处理 UUID 响应。
  * - `SOME_ONE_QUIT`: 当有玩家退出时，记录日志并调用 `handle_some_one_quit(query)` 处理退出事件。
  * - `GAME_UPDATE`: 调用 `handle_game_update(query)` 处理游戏更新。
- * - `PLAYER_INFO_CERT`: 调用 `handle_player_info_cert(query)` 处理玩家认证信息。
+ * - `PLAYER_INFO_CERT`: 调用 `handle_player_info_cert(query)` 处理玩家认证信息（进入房间）。
  * - `CLIENT_READY`: 调用 `handle_client_ready(query)` 处理客户端准备就绪事件。
+ * - `SNAPSHOT_ACK`: 调用 `handle_snapshot_ack(query)` 记录客户端确认的快照序号。
+ * - `PONG`: 调用 `handle_pong(query)` 更新玩家的往返时间和抖动。
  * - 默认: 如果类型不属于以上情况，则忽略该查询。
  *
+ * ready 队列为空时按照 `g_ready_wakeup` 的等待策略空转或睡眠，由 reactor 入队之后唤醒，
+ * 睡眠最多持续 WAIT_TIMEOUT_MS 毫秒，以便及时发现 `g_over`。
+ *
+ * 每取出一批记录一次 ready 队列的深度，以及这一批中每个 CQuery 在 ready 队列中等待的时间（见 stats.h）。
+ *
  * 该函数会一直运行，直到全局变量 `g_over` 被设置。
  * 
  * @param void* 线程兼容的未使用参数。
@@ -24,67 +39,102 @@
  */
 void *event_handler_main(void *)
 {
-    CQuery *query = NULL;
+    CQuery *queries[QUERY_BATCH_NUM];
+    int idle_rounds = 0;
+    stats_register(STATS_THREAD_HANDLER, 0);
     while (!g_over)
     {
-        // printf("\033[32m%s\033[0m\n", "event_handler_main: ");
-        if (NULL == (query = get_gready_query()))
+        // 一次从 ready 队列中批量取出若干个 CQuery，减少对队列头尾的访问次数
+        size_t query_num = get_gready_queries(queries, QUERY_BATCH_NUM);
+        if (0 == query_num)
+        {
+            stats_set_depth(0);
+            wakeup_idle(&g_ready_wakeup, &idle_rounds, ready_queue_has_work, NULL, WAIT_TIMEOUT_MS);
             continue;
-        printf("\033[32m%s\033[0m %s type: %d\n", "(server)", "event_handler_main: get_gready_query success.", query->m_header.type);
-        if (query->m_header.type != RESPONSE_UUID)
+        }
+        idle_rounds = 0;
+        stats_set_depth(query_num + mpsc_ring_size(&g_ready_ring));
+        uint64_t ready_ns = stats_now_ns();
+        for (size_t i = 0; i < query_num; i++)
         {
-            player_info *player = get_player_info_by_sock(query->m_socket_fd);
-            if (player == NULL)
+            CQuery *query = queries[i];
+            stats_record(STATS_STAGE_RECV_READY, ready_ns - query->m_recv_ns);
+            query->m_ready_ns = ready_ns;
+            LOG_DEBUG("event_handler_main: get_gready_query success, type: %d", query->m_header.type);
+            if (NULL != query->m_pinned)
             {
-                perror("get_player_info_by_sock");
-                continue;
+                // 入队的线程已经持有了计数（见 CQuery.m_pinned），由这里接管，之后和其他消息一样由处理它的线程释放；
+                // 持有计数期间 slot 不会被回收、fd 不会被复用，这里再核对一次 fd 仍然属于这个玩家
+                player_info *player = query->m_pinned;
+                query->m_pinned = NULL;
+                if (player != get_player_info_by_sock(query->m_socket_fd))
+                {
+                    LOG_WARN("event_handler_main: socket %d no longer belongs to %s", query->m_socket_fd, player->id);
+                    add_free_list(query);
+                    minus_message_count(player);
+                    continue;
+                }
+            }
+            else if (query->m_header.type != RESPONSE_UUID)
+            {
+                player_info *player = get_player_info_by_sock(query->m_socket_fd);
+                if (player == NULL)
+                {
+                    LOG_WARN("event_handler_main: no player for socket %d", query->m_socket_fd);
+                    add_free_list(query);
+                    continue;
+                }
+                plus_message_count(player);
             }
-            plus_message_count(player);
-        }
 
-        switch (query->m_header.type)
-        {
-        case RESPONSE_UUID:
-            handle_response_uuid(query);
-            break;
-        case SOME_ONE_QUIT:
-            printf("\033[32m%s\033[0m\n", "event_handler_main: SOME_ONE_QUIT");
-            handle_some_one_quit(query);
-            break;
-        case GAME_UPDATE:
-            handle_game_update(query);
-            break;
-        case PLAYER_INFO_CERT:
-            handle_player_info_cert(query);
-            break;
-        case CLIENT_READY:
-            handle_client_ready(query);
-            break;
-        default:
-            break;
+            switch (query->m_header.type)
+            {
+            case RESPONSE_UUID:
+                handle_response_uuid(query);
+                break;
+            case SOME_ONE_QUIT:
+                LOG_DEBUG("event_handler_main: SOME_ONE_QUIT");
+                handle_some_one_quit(query);
+                break;
+            case GAME_UPDATE:
+                handle_game_update(query);
+                break;
+            case PLAYER_INFO_CERT:
+                handle_player_info_cert(query);
+                break;
+            case CLIENT_READY:
+                handle_client_ready(query);
+                break;
+            case SNAPSHOT_ACK:
+                handle_snapshot_ack(query);
+                break;
+            case PONG:
+                handle_pong(query);
+                break;
+            default:
+                break;
+            }
         }
     }
 }
 
 /**
- * @brief 处理客户端连接时的响应，初始化玩家信息并打包消息。
+ * @brief 处理客户端连接时的响应，打包 UUID 消息。
  *
- * 当客户端第一次连接到服务器时，服务器会创建一个半初始化的 `player_info` 结构体，
+ * 客户端连接到服务器时，reactor 在 accept 之后就已经为其登记了一个半初始化的 `player_info` 结构体，
  * 以便后续操作使用。此时，TCP 连接已经建立，接下来处理自定义的二进制协议内容。
  *
  * @param query 包含客户端请求的请求对象，携带了消息缓冲区和 socket 文件描述符。
  *
  * 主要步骤：
- * 1. 调用 `add_player_info` 函数，使用 `query` 中的数据为连接创建 `player_info` 对象。
- * 2. 通过 `CQuery_pack_message` 函数，将消息头和消息缓冲区中的数据打包到 `query` 的缓冲区中。
+ * 1. 通过 `CQuery_pack_message` 函数，将消息头和消息缓冲区中的数据打包到 `query` 的缓冲区中。
  *    当前实现在缓冲区中为消息头预留空间，然后将头部放入缓冲区中，这部分的效率可能需要优化。
- * 3. 将处理完成的 `query` 放入工作队列中，以便稍后发送响应。
+ * 2. 将处理完成的 `query` 放入工作队列中，以便稍后发送响应。
  */
 void handle_response_uuid(CQuery *query)
 {
-    // 当客户端第一次连接到服务器之中时，服务器会先创建一个半初始化的 player_info
-    // 方便接下来的操作，注意，此时 TCP 连接已经建立，只不过在进行我们定义的二进制协议之中的内容
-    add_player_info(query->m_byte_Query, query->m_socket_fd);
+    // 半初始化的 player_info 已经在 accept 时登记到注册表中（见 CQuery_accept_tcp_connect），
+    // 注意，此时 TCP 连接已经建立，只不过在进行我们定义的二进制协议之中的内容
     // 调用在 binary_protocol 之中编写的 oack_message 将 query 之中携带的消息头
     // 和其缓冲区之中的数据一起打包到其缓冲区之中（实际上就是在缓冲区之中腾出 header 的空间
     // 然后将 header 放进去，实在有点没有效率，后面我再想想怎么优化这一部分）
@@ -94,21 +144,20 @@ void handle_response_uuid(CQuery *query)
 }
 
 /**
- * @brief 处理全局玩家信息的请求，扫描并删除无效玩家信息，返回当前有效玩家列表。
+ * @brief 处理全局玩家信息的请求，返回玩家所在房间的有效玩家列表。
  *
- * 该函数主要处理客户端查询全局玩家信息的请求。首先会扫描并删除无效的玩家信息，
- * 然后将剩余的玩家信息打包发送回客户端。
+ * 该函数主要处理客户端查询全局玩家信息的请求，将同一个房间中在线的玩家信息打包发送回客户端。
+ * 已经断开的玩家在最后一条在途消息处理完时就已经被回收（见 `minus_message_count`），这里不需要再扫描。
  *
  * @param query 包含客户端请求的请求对象，携带了消息缓冲区和 socket 文件描述符。
  *
  * 主要步骤：
- * 1. 调用 `scan_and_delete_unavailable_player_info`，清理所有无效的玩家信息。
- * 2. 设置查询头部的消息类型为 `GLOBAL_PLAYER_INFO`。
- * 3. 调用 `package_global_player_info`，根据 `query` 的 socket 文件描述符获取当前所有玩家信息，
+ * 1. 设置查询头部的消息类型为 `GLOBAL_PLAYER_INFO`。
+ * 2. 调用 `package_global_player_info`，根据 `query` 的 socket 文件描述符获取房间中其他玩家的信息，
  *    并将其打包到缓冲区中。
  *    - 如果没有玩家信息可返回，设置查询长度为 0，打包消息并将查询对象放入工作队列，结束函数。
- * 4. 否则，将玩家信息设置到查询的缓冲区中，并打包消息。
- * 5. 将处理完成的 `query` 对象放入工作队列中，准备发送响应。
+ * 3. 否则，将玩家信息设置到查询的缓冲区中，并打包消息。
+ * 4. 将处理完成的 `query` 对象放入工作队列中，准备发送响应。
  */
 void handle_global_player_info(CQuery *query)
 {
@@ -124,19 +173,21 @@ void handle_global_player_info(CQuery *query)
     //     current = current->next;
     // }
 
-    scan_and_delete_unavailable_player_info();
     query->m_header.type = GLOBAL_PLAYER_INFO;
-    char *buffer = package_global_player_info(query->m_socket_fd);
+    player_info *player = get_player_info_by_sock(query->m_socket_fd);
+    int len;
+    char *buffer = package_global_player_info(query->m_socket_fd, player->room, player->compact_id, &len);
     if (NULL == buffer) // 没有玩家信息
     {
-        printf("(debug) %s\n", "handle_global_player_info: no player info.");
+        LOG_DEBUG("handle_global_player_info: no player info.");
         query->m_query_len = 0;
         CQuery_pack_message(query); // ???当时我是怎么设计的？为什么这里还要发送一次？
         add_gwork_list(query);
         return;
     }
-    // -1 就减在 '\0'
-    CQuery_set_query_buffer(query, buffer, strlen(buffer) - 1);
+    // -1 去掉最后一个 '@'
+    if (0 != CQuery_set_query_buffer(query, buffer, len - 1))
+        query->m_query_len = 0;
     free(buffer);
 
     CQuery_pack_message(query);
@@ -146,7 +197,7 @@ void handle_global_player_info(CQuery *query)
 
 void handle_some_one_join(CQuery *query)
 {
-    printf("(debug)\033[32m%s\033[0m\n", "handle_some_one_join: ");
+    LOG_DEBUG("handle_some_one_join: socket %d", query->m_socket_fd);
     query->m_header.type = SOME_ONE_JOIN;
     // 把@去掉
     query->m_query_len--;
@@ -154,20 +205,92 @@ void handle_some_one_join(CQuery *query)
     add_gwork_list(query);
 }
 
+/**
+ * @brief 把 SOME_ONE_QUIT 转给发送线程广播，并释放拆除连接时为它持有的消息计数（见 `CQuery_notify_quit`）。
+ *
+ * 转发出去的 SOME_ONE_QUIT 自己还持有 event_handler_main 增加的计数，发送线程处理完它之前玩家不会被回收。
+ */
 void handle_some_one_quit(CQuery *query)
 {
+    player_info *player = get_player_info_by_sock(query->m_socket_fd);
     CQuery_pack_message(query);
     add_gwork_list(query);
+    minus_message_count(player);
 }
 
+/**
+ * @brief 处理 GAME_UPDATE，紧凑 id 模式的客户端只上报 Transform3D，这里补上它的 UUID。
+ *
+ * 服务器内部以及旧客户端看到的 GAME_UPDATE 一律是 UUID + Transform3D，发给紧凑 id 模式的客户端时
+ * 再由发送 worker 换成 slot id，见 `handle_group_send`。
+ *
+ * UUID 和套接字对应的玩家不一致的 GAME_UPDATE 被丢弃：UDP 线程按 slot 找到玩家并填好 UUID 之后，
+ * 这个连接可能已经断开、套接字被新的连接复用，不能把旧连接的状态当成新玩家的转发出去。
+ */
 void handle_game_update(CQuery *query)
 {
+    player_info *player = get_player_info_by_sock(query->m_socket_fd);
+    if (player->compact_id && TRANSFORM_LEN == query->m_query_len)
+    {
+        if (0 != CQuery_reserve(query, GAME_UPDATE_LEN + header_size))
+        {
+            minus_message_count(player);
+            add_free_list(query);
+            return;
+        }
+        memmove(query->m_byte_Query + PLAYER_ID_LEN, query->m_byte_Query, TRANSFORM_LEN);
+        memcpy(query->m_byte_Query, player->id, PLAYER_ID_LEN);
+        query->m_query_len = GAME_UPDATE_LEN;
+    }
+    if (GAME_UPDATE_LEN == query->m_query_len && 0 != memcmp(query->m_byte_Query, player->id, PLAYER_ID_LEN))
+    {
+        LOG_DEBUG("handle_game_update: drop GAME_UPDATE of another player on socket %d", query->m_socket_fd);
+        minus_message_count(player);
+        add_free_list(query);
+        return;
+    }
     CQuery_pack_message(query);
     add_gwork_list(query);
 }
 
+/**
+ * @brief 处理玩家认证信息，让玩家进入请求的房间并回复房间中的玩家列表。
+ *
+ * 消息体为可选的 4 字节房间号（小端），没有消息体时进入 0 号房间；房间号之后还可以带上 4 字节的协议标志，
+ * 目前只有 PROTOCOL_FLAG_COMPACT_ID。两者都只在第一次认证时生效。
+ *
+ * 玩家的发送队列此时还属于大厅 worker，如果房间由别的 worker 负责，就先把这条消息作为迁移请求交给大厅 worker，
+ * 等它清空发送队列、把玩家交给房间的 worker 之后，消息会回到 ready 队列，再次经过这里时才回复 GLOBAL_PLAYER_INFO，
+ * 这样房间的 worker 按 work 队列的顺序先把玩家加入房间、再转发之后的 SOME_ONE_JOIN，玩家不会漏掉任何人。
+ *
+ * @param query 包含客户端请求的请求对象，携带了消息缓冲区和 socket 文件描述符。
+ */
 void handle_player_info_cert(CQuery *query)
 {
+    player_info *player = get_player_info_by_sock(query->m_socket_fd);
+    if (-1 == player->room)
+    {
+        uint32_t room_id = 0;
+        uint32_t flags = 0;
+        if (sizeof(room_id) <= query->m_query_len)
+            memcpy(&room_id, query->m_byte_Query, sizeof(room_id));
+        if (sizeof(room_id) + sizeof(flags) <= query->m_query_len)
+            memcpy(&flags, query->m_byte_Query + sizeof(room_id), sizeof(flags));
+        player->compact_id = 0 != (flags & PROTOCOL_FLAG_COMPACT_ID);
+        if (room_id >= MAX_ROOM_NUM)
+        {
+            LOG_WARN("handle_player_info_cert: invalid room %u from %s, use room 0.", room_id, player->id);
+            room_id = 0;
+        }
+        player->room = room_id;
+    }
+
+    room_t *room = get_room(player->room);
+    if (room->worker != atomic_load_explicit(&player->worker, memory_order_acquire))
+    {
+        add_gwork_list(query);
+        return;
+    }
     handle_global_player_info(query);
 }
 
@@ -188,7 +311,7 @@ void handle_player_info_cert(CQuery *query)
  */
 void handle_client_ready(CQuery *query)
 {
-    printf("(debug)\033[32m%s\033[0m, query len: %d\n", "handle_client_ready", query->m_query_len);
+    LOG_DEBUG("handle_client_ready: query len: %d", query->m_query_len);
 
     // 从query中获取玩家的id和name
     // 将玩家的id和name加入到player_infos中
@@ -199,7 +322,8 @@ void handle_client_ready(CQuery *query)
 
     // 计算玩家 name 的长度
     int name_len = 0;
-    while (query->m_byte_Query[PLAYER_ID_LEN + name_len] != '@')
+    while (PLAYER_ID_LEN + name_len < query->m_query_len && name_len < MAX_PLAYER_NAME_LEN &&
+           query->m_byte_Query[PLAYER_ID_LEN + name_len] != '@')
         name_len++;
 
     memmove(name, query->m_byte_Query + PLAYER_ID_LEN, name_len);
@@ -210,4 +334,80 @@ void handle_client_ready(CQuery *query)
 
     // 处理玩家加入事件 
     handle_some_one_join(query);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 处理客户端的快照确认，记录客户端已经重建的快照序号，作为之后增量快照的基线。
+ *
+ * 确认不需要回复，`query` 直接归还空闲队列。只接受比之前更新的序号，乱序到达的旧确认被忽略。
+ *
+ * @param query 消息体为 4 字节的快照序号（小端）。
+ */
+void handle_snapshot_ack(CQuery *query)
+{
+    player_info *player = get_player_info_by_sock(query->m_socket_fd);
+    uint32_t seq;
+    if (sizeof(seq) == query->m_query_len)
+    {
+        memcpy(&seq, query->m_byte_Query, sizeof(seq));
+        uint32_t old = atomic_load_explicit(&player->snapshot_ack, memory_order_relaxed);
+        // 序号会回绕，用差值判断新旧
+        if (0 == old || (int32_t)(seq - old) > 0)
+            atomic_store_explicit(&player->snapshot_ack, seq, memory_order_relaxed);
+    }
+    // 对应 event_handler_main 中增加的计数
+    minus_message_count(player);
+    add_free_list(query);
+}
+
+/**
+ * @brief 处理客户端对 PING 的回复，更新玩家平滑后的往返时间和抖动。
+ *
+ * PONG 原样带回 PING 中服务器的发送时刻，和现在的时刻相减就是一个往返时间样本。样本包括 PING 在发送队列中排队、
+ * 客户端处理以及 PONG 在 ready 队列中等待的时间，是客户端实际感受到的应用层往返时间，而不只是网络的往返时间。
+ * 平滑的方式和 TCP 估计 RTO 的方式相同（RFC 6298）：
+ * - 第一个样本 R：rtt = R，jitter = R / 2；
+ * - 之后：jitter = 3/4 jitter + 1/4 |rtt - R|，rtt = 7/8 rtt + 1/8 R。
+ * 结果写到 `player_info` 中供发送线程使用，并发布到统计段中；样本本身记入 `STATS_STAGE_PING_RTT` 直方图。
+ * 只有 handler 写入这两个值，不需要原子加。
+ *
+ * @param query 消息体为 PING_LEN 字节的服务器发送时刻。
+ */
+void handle_pong(CQuery *query)
+{
+    player_info *player = get_player_info_by_sock(query->m_socket_fd);
+    uint64_t sent_ns;
+    uint64_t now_ns = stats_now_ns();
+    if (PING_LEN == query->m_query_len)
+    {
+        memcpy(&sent_ns, query->m_byte_Query, sizeof(sent_ns));
+        // 时间戳来自客户端，不在合理范围内的直接忽略
+        if (sent_ns <= now_ns && now_ns - sent_ns <= MAX_PING_RTT_MS * 1000000ull)
+        {
+            uint32_t sample = (uint32_t)((now_ns - sent_ns) / 1000);
+            sample = 0 == sample ? 1 : sample;
+            uint32_t rtt = atomic_load_explicit(&player->rtt_us, memory_order_relaxed);
+            uint32_t jitter = atomic_load_explicit(&player->rtt_jitter_us, memory_order_relaxed);
+            if (0 == rtt)
+            {
+                rtt = sample;
+                jitter = sample / 2;
+            }
+            else
+            {
+                uint32_t deviation = rtt > sample ? rtt - sample : sample - rtt;
+                jitter = (uint32_t)((3ull * jitter + deviation) / 4);
+                rtt = (uint32_t)((7ull * rtt + sample) / 8);
+                rtt = 0 == rtt ? 1 : rtt;
+            }
+            atomic_store_explicit(&player->rtt_us, rtt, memory_order_relaxed);
+            atomic_store_explicit(&player->rtt_jitter_us, jitter, memory_order_relaxed);
+            stats_set_client_rtt(player->slot, rtt, jitter);
+            stats_record(STATS_STAGE_PING_RTT, now_ns - sent_ns);
+            LOG_DEBUG("handle_pong: %s rtt sample %u us, smoothed %u us, jitter %u us.", player->id, sample, rtt, jitter);
+        }
+    }
+    // 对应 event_handler_main 中增加的计数
+    minus_message_count(player);
+    add_free_list(query);
+}
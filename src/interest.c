@@ -0,0 +1,174 @@
+#include "interest.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Transform3D 经过 var_to_bytes 之后为 4 字节类型 + 3x3 基 + 原点，原点的 x、y、z 在最后 12 个字节
+#define TRANSFORM_ORIGIN_OFFSET (TRANSFORM_LEN - 3 * sizeof(float))
+// 超出这个范围的坐标换算成格子坐标会溢出，视为无效
+#define INTEREST_MAX_COORD 1e9f
+
+/**
+ * @brief 初始化兴趣网格。
+ *
+ * @param radius 兴趣半径，小于等于 0 表示关闭兴趣管理（不分配内存）。
+ * @return 成功返回 0，内存分配失败返回 -1。
+ */
+int interest_grid_init(interest_grid_t *grid, float radius)
+{
+    grid->radius = radius > 0 ? radius : 0;
+    grid->radius2 = grid->radius * grid->radius;
+    grid->buckets = NULL;
+    grid->entries = NULL;
+    atomic_init(&grid->relayed_count, 0);
+    atomic_init(&grid->filtered_count, 0);
+    if (!interest_enabled(grid))
+        return 0;
+
+    grid->buckets = (int *)malloc(sizeof(int) * INTEREST_BUCKET_NUM);
+    grid->entries = (interest_entry_t *)malloc(sizeof(interest_entry_t) * MAX_CONNECTION_NUM);
+    if (NULL == grid->buckets || NULL == grid->entries)
+    {
+        interest_grid_destroy(grid);
+        return -1;
+    }
+    for (int i = 0; i < INTEREST_BUCKET_NUM; i++)
+        grid->buckets[i] = -1;
+    for (int i = 0; i < MAX_CONNECTION_NUM; i++)
+        grid->entries[i].bucket = -1;
+    return 0;
+}
+
+void interest_grid_destroy(interest_grid_t *grid)
+{
+    free(grid->buckets);
+    free(grid->entries);
+    grid->buckets = NULL;
+    grid->entries = NULL;
+}
+
+static int bucket_of(int room, int cell_x, int cell_z)
+{
+    uint32_t h = (uint32_t)cell_x * 73856093u ^ (uint32_t)cell_z * 19349663u ^ (uint32_t)room * 83492791u;
+    return h & (INTEREST_BUCKET_NUM - 1);
+}
+
+/**
+ * @brief 从 GAME_UPDATE 的 Transform3D 中取出水平面上的位置。
+ *
+ * @return 坐标有效返回 true，NaN、无穷大或者过大的坐标返回 false。
+ */
+bool interest_position_from_transform(const char *transform, float *x, float *z)
+{
+    float origin[3];
+    memcpy(origin, transform + TRANSFORM_ORIGIN_OFFSET, sizeof(origin));
+    if (!isfinite(origin[0]) || !isfinite(origin[2]) ||
+        fabsf(origin[0]) > INTEREST_MAX_COORD || fabsf(origin[2]) > INTEREST_MAX_COORD)
+        return false;
+    *x = origin[0];
+    *z = origin[2];
+    return true;
+}
+
+static void unlink_entry(interest_grid_t *grid, int slot)
+{
+    interest_entry_t *entry = &grid->entries[slot];
+    if (-1 != entry->prev)
+        grid->entries[entry->prev].next = entry->next;
+    else
+        grid->buckets[entry->bucket] = entry->next;
+    if (-1 != entry->next)
+        grid->entries[entry->next].prev = entry->prev;
+    entry->bucket = -1;
+}
+
+/**
+ * @brief 登记或者移动一个玩家，只有跨越格子时才需要调整链表。
+ */
+void interest_grid_update(interest_grid_t *grid, int slot, int room, const char *id, float x, float z)
+{
+    interest_entry_t *entry = &grid->entries[slot];
+    int cell_x = (int)floorf(x / grid->radius);
+    int cell_z = (int)floorf(z / grid->radius);
+    memcpy(entry->id, id, PLAYER_ID_LEN);
+    entry->x = x;
+    entry->z = z;
+    if (-1 != entry->bucket && room == entry->room && cell_x == entry->cell_x && cell_z == entry->cell_z)
+        return;
+
+    if (-1 != entry->bucket)
+        unlink_entry(grid, slot);
+    entry->room = room;
+    entry->cell_x = cell_x;
+    entry->cell_z = cell_z;
+    entry->bucket = bucket_of(room, cell_x, cell_z);
+    entry->prev = -1;
+    entry->next = grid->buckets[entry->bucket];
+    if (-1 != entry->next)
+        grid->entries[entry->next].prev = slot;
+    grid->buckets[entry->bucket] = slot;
+}
+
+/**
+ * @brief 把玩家从网格中移除，玩家退出时调用。
+ */
+void interest_grid_remove(interest_grid_t *grid, int slot)
+{
+    if (-1 != grid->entries[slot].bucket)
+        unlink_entry(grid, slot);
+}
+
+/**
+ * @brief 判断 slot 当前的玩家（以 UUID 区分）是否已经登记在网格中。
+ */
+bool interest_grid_contains(const interest_grid_t *grid, int slot, const char *id)
+{
+    const interest_entry_t *entry = &grid->entries[slot];
+    return -1 != entry->bucket && 0 == memcmp(entry->id, id, PLAYER_ID_LEN);
+}
+
+/**
+ * @brief 查询和 slot 在同一个房间、距离不超过兴趣半径的其他玩家。
+ *
+ * 结果中可能包含 slot 已经被复用的陈旧条目，调用方需要用 `interest_grid_contains` 核对 UUID。
+ *
+ * @param slots 输出的 slot 下标。
+ * @return 找到的玩家数，slot 不在网格中时返回 0。
+ */
+int interest_grid_query(const interest_grid_t *grid, int slot, int *slots, int max_num)
+{
+    const interest_entry_t *center = &grid->entries[slot];
+    if (-1 == center->bucket)
+        return 0;
+
+    int num = 0;
+    int visited[9];
+    int visited_num = 0;
+    for (int dx = -1; dx <= 1; dx++)
+    {
+        for (int dz = -1; dz <= 1; dz++)
+        {
+            // 不同的格子可能哈希到同一个桶，每个桶只扫描一次
+            int bucket = bucket_of(center->room, center->cell_x + dx, center->cell_z + dz);
+            bool seen = false;
+            for (int i = 0; i < visited_num && !seen; i++)
+                seen = visited[i] == bucket;
+            if (seen)
+                continue;
+            visited[visited_num++] = bucket;
+
+            for (int s = grid->buckets[bucket]; -1 != s; s = grid->entries[s].next)
+            {
+                const interest_entry_t *entry = &grid->entries[s];
+                float ex = entry->x - center->x;
+                float ez = entry->z - center->z;
+                if (s == slot || entry->room != center->room || ex * ex + ez * ez > grid->radius2)
+                    continue;
+                if (num == max_num)
+                    return num;
+                slots[num++] = s;
+            }
+        }
+    }
+    return num;
+}
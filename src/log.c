@@ -0,0 +1,409 @@
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+// 日志记录头，之后是 arg_num 个 8 字节的参数槽，再之后是字符串参数的内容（字符串参数的槽中存放长度）
+typedef struct
+{
+    const log_site_t *site;     // 格式 id，NULL 表示环尾的填充记录
+    uint64_t time_ns;           // CLOCK_REALTIME 时间戳
+    uint32_t size;              // 整条记录的字节数，8 字节对齐
+    uint32_t arg_num;           // 参数个数
+} log_record_t;
+
+#define LOG_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+static _Thread_local log_ring_t *tls_log_ring = NULL;
+static _Thread_local bool tls_log_unregistered = false;
+
+static const char *log_level_names[] = {"debug", "info", "warn", "error", "off"};
+static const char *log_level_tags[] = {"DEBUG", "\033[32mINFO\033[0m ", "\033[33mWARN\033[0m ", "\033[31mERROR\033[0m"};
+
+static void *log_main(void *arg);
+
+/**
+ * @brief 初始化日志并启动日志线程，之后级别不低于 level 的日志才会被记录。
+ *
+ * @param level 日志级别，LOG_LEVEL_OFF 时不启动日志线程。
+ * @param out 输出流，只由日志线程写入。
+ * @return 成功返回 0，日志线程创建失败返回 -1。
+ */
+int init_log(log_level_t level, FILE *out)
+{
+    pthread_mutex_init(&g_log.ring_lock, NULL);
+    atomic_init(&g_log.ring_num, 0);
+    atomic_init(&g_log.dropped, 0);
+    atomic_init(&g_log.over, false);
+    g_log.out = out;
+    g_log.started = false;
+    if (LOG_LEVEL_OFF == level)
+        return 0;
+    if (0 != pthread_create(&g_log.pid, NULL, log_main, NULL))
+        return -1;
+    g_log.started = true;
+    atomic_store_explicit(&g_log_level, level, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief 关闭日志：通知日志线程把所有缓冲区取空之后退出，再释放缓冲区。
+ *
+ * 调用时其他线程不能再写日志。
+ */
+void destroy_log()
+{
+    atomic_store_explicit(&g_log_level, LOG_LEVEL_OFF, memory_order_relaxed);
+    if (g_log.started)
+    {
+        atomic_store_explicit(&g_log.over, true, memory_order_release);
+        pthread_join(g_log.pid, NULL);
+        g_log.started = false;
+    }
+    int ring_num = atomic_load_explicit(&g_log.ring_num, memory_order_acquire);
+    for (int i = 0; i < ring_num; i++)
+    {
+        free(g_log.rings[i]->buffer);
+        free(g_log.rings[i]);
+        g_log.rings[i] = NULL;
+    }
+    atomic_store_explicit(&g_log.ring_num, 0, memory_order_release);
+    pthread_mutex_destroy(&g_log.ring_lock);
+}
+
+/**
+ * @brief 取得当前线程的日志缓冲区，第一次调用时分配并登记。
+ *
+ * @return 线程数超过 LOG_MAX_THREAD_NUM 或者内存分配失败时返回 NULL，之后该线程的日志都被丢弃。
+ */
+static log_ring_t *log_thread_ring()
+{
+    if (NULL != tls_log_ring || tls_log_unregistered)
+        return tls_log_ring;
+
+    log_ring_t *ring = (log_ring_t *)calloc(1, sizeof(log_ring_t));
+    char *buffer = (char *)malloc(LOG_RING_SIZE);
+    pthread_mutex_lock(&g_log.ring_lock);
+    int ring_num = atomic_load_explicit(&g_log.ring_num, memory_order_relaxed);
+    if (NULL == ring || NULL == buffer || LOG_MAX_THREAD_NUM == ring_num)
+    {
+        pthread_mutex_unlock(&g_log.ring_lock);
+        free(ring);
+        free(buffer);
+        tls_log_unregistered = true;
+        return NULL;
+    }
+    ring->buffer = buffer;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    g_log.rings[ring_num] = ring;
+    // 日志线程只读取 ring_num 之内的缓冲区，先写好缓冲区再发布
+    atomic_store_explicit(&g_log.ring_num, ring_num + 1, memory_order_release);
+    pthread_mutex_unlock(&g_log.ring_lock);
+    tls_log_ring = ring;
+    return ring;
+}
+
+/**
+ * @brief 把一条日志追加到当前线程的缓冲区中，由 LOG_AT 在级别开启时调用。
+ *
+ * 只拷贝参数的原始值和字符串参数的内容，格式化由日志线程完成。缓冲区放不下时丢弃这条日志。
+ */
+void log_write(const log_site_t *site, const log_arg_t *args, int arg_num)
+{
+    log_ring_t *ring = log_thread_ring();
+    if (NULL == ring)
+    {
+        atomic_fetch_add_explicit(&g_log.dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    size_t str_lens[LOG_MAX_ARG_NUM];
+    size_t size = sizeof(log_record_t) + arg_num * sizeof(uint64_t);
+    for (int i = 0; i < arg_num; i++)
+    {
+        if (LOG_ARG_STR != args[i].type)
+            continue;
+        str_lens[i] = NULL == args[i].s ? 0 : strnlen(args[i].s, LOG_MAX_STRING_LEN);
+        size += str_lens[i];
+    }
+    size = LOG_ALIGN(size);
+
+    // 记录必须连续存放，环尾放不下时跳到环首，跳过的部分放得下记录头时写一条填充记录
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t offset = tail & (LOG_RING_SIZE - 1);
+    size_t skip = LOG_RING_SIZE - offset < size ? LOG_RING_SIZE - offset : 0;
+    if (tail + skip + size - head > LOG_RING_SIZE)
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    if (0 != skip)
+    {
+        if (skip >= sizeof(log_record_t))
+        {
+            log_record_t *pad = (log_record_t *)(ring->buffer + offset);
+            pad->site = NULL;
+            pad->size = skip;
+        }
+        tail += skip;
+        offset = 0;
+    }
+
+    log_record_t *record = (log_record_t *)(ring->buffer + offset);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    record->site = site;
+    record->time_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    record->size = size;
+    record->arg_num = arg_num;
+    uint64_t *slots = (uint64_t *)(record + 1);
+    char *strings = (char *)(slots + arg_num);
+    for (int i = 0; i < arg_num; i++)
+    {
+        switch (args[i].type)
+        {
+        case LOG_ARG_STR:
+            slots[i] = NULL == args[i].s ? UINT64_MAX : str_lens[i];
+            if (NULL != args[i].s)
+                memcpy(strings, args[i].s, str_lens[i]);
+            strings += NULL == args[i].s ? 0 : str_lens[i];
+            break;
+        case LOG_ARG_DOUBLE:
+            memcpy(&slots[i], &args[i].d, sizeof(double));
+            break;
+        case LOG_ARG_PTR:
+            slots[i] = (uintptr_t)args[i].p;
+            break;
+        default:
+            slots[i] = args[i].i;
+            break;
+        }
+    }
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+}
+
+void log_check_format(const char *format, ...)
+{
+    (void)format;
+}
+
+/* 输出记录的时间戳和级别，同一秒内的日期部分只格式化一次 */
+static void log_print_prefix(FILE *out, const log_record_t *record)
+{
+    static time_t cached_sec = -1;
+    static char cached_time[32];
+    time_t sec = record->time_ns / 1000000000ull;
+    if (sec != cached_sec)
+    {
+        struct tm local;
+        localtime_r(&sec, &local);
+        strftime(cached_time, sizeof(cached_time), "%Y-%m-%d %H:%M:%S", &local);
+        cached_sec = sec;
+    }
+    fprintf(out, "[%s.%03u] %s ", cached_time, (unsigned)(record->time_ns / 1000000 % 1000),
+            log_level_tags[record->site->level]);
+}
+
+/**
+ * @brief 按照格式串格式化一条记录。
+ *
+ * 逐个找出格式串中的转换说明，连同标志、宽度、精度和长度修饰一起交给 fprintf，每次只格式化一个参数，
+ * 参数的类型由转换说明决定（写日志时已经由 `log_check_format` 在编译时检查过）。
+ */
+static void log_print_record(FILE *out, const log_record_t *record)
+{
+    const char *format = record->site->format;
+    const uint64_t *slots = (const uint64_t *)(record + 1);
+    const char *strings = (const char *)(slots + record->arg_num);
+    uint32_t arg = 0;
+
+    log_print_prefix(out, record);
+    while ('\0' != *format)
+    {
+        const char *percent = strchr(format, '%');
+        if (NULL == percent)
+        {
+            fputs(format, out);
+            break;
+        }
+        fwrite(format, 1, percent - format, out);
+        if ('%' == percent[1])
+        {
+            fputc('%', out);
+            format = percent + 2;
+            continue;
+        }
+
+        // 转换说明：%[标志][宽度][.精度][长度修饰]转换字符
+        const char *modifier = percent + 1 + strspn(percent + 1, "-+ #0123456789.");
+        const char *end = modifier;
+        while ('\0' != *end && NULL != strchr("hlzjt", *end))
+            end++;
+        char conv = *end;
+        bool wide = end != modifier && 'h' != *modifier;   // 64 位整数，统一换成 ll 输出
+        if ('\0' == conv || arg >= record->arg_num || end - percent + 4 > 32)
+            break;
+        char spec[32];
+        int spec_len = modifier - percent;
+        memcpy(spec, percent, spec_len);
+        if (wide && NULL != strchr("diuoxX", conv))
+            spec_len += sprintf(spec + spec_len, "ll%c", conv);
+        else
+        {
+            memcpy(spec + spec_len, modifier, end - modifier + 1);
+            spec_len += end - modifier + 1;
+            spec[spec_len] = '\0';
+        }
+        format = end + 1;
+
+        uint64_t slot = slots[arg++];
+        switch (conv)
+        {
+        case 'd':
+        case 'i':
+            if (wide)
+                fprintf(out, spec, (long long)slot);
+            else
+                fprintf(out, spec, (int)slot);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            if (wide)
+                fprintf(out, spec, (unsigned long long)slot);
+            else
+                fprintf(out, spec, (unsigned)slot);
+            break;
+        case 'c':
+            fprintf(out, spec, (int)slot);
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+        {
+            double value;
+            memcpy(&value, &slot, sizeof(double));
+            fprintf(out, spec, value);
+            break;
+        }
+        case 'p':
+            fprintf(out, spec, (void *)(uintptr_t)slot);
+            break;
+        case 's':
+        {
+            char value[LOG_MAX_STRING_LEN + 1];
+            if (UINT64_MAX == slot)
+                strcpy(value, "(null)");
+            else
+            {
+                memcpy(value, strings, slot);
+                value[slot] = '\0';
+                strings += slot;
+            }
+            fprintf(out, spec, value);
+            break;
+        }
+        default:
+            fputs(spec, out);
+            break;
+        }
+    }
+    // 日志统一以换行结束，原先 printf 中自带的换行不重复输出
+    size_t format_len = strlen(record->site->format);
+    if (0 == format_len || '\n' != record->site->format[format_len - 1])
+        fputc('\n', out);
+}
+
+/**
+ * @brief 把所有线程的缓冲区取空一遍。
+ *
+ * @return 本次输出的日志条数。
+ */
+static size_t log_drain(FILE *out)
+{
+    size_t record_num = 0;
+    int ring_num = atomic_load_explicit(&g_log.ring_num, memory_order_acquire);
+    for (int i = 0; i < ring_num; i++)
+    {
+        log_ring_t *ring = g_log.rings[i];
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        while (head < tail)
+        {
+            size_t offset = head & (LOG_RING_SIZE - 1);
+            if (LOG_RING_SIZE - offset < sizeof(log_record_t))
+            {
+                head += LOG_RING_SIZE - offset;
+                continue;
+            }
+            const log_record_t *record = (const log_record_t *)(ring->buffer + offset);
+            if (NULL != record->site)
+            {
+                log_print_record(out, record);
+                record_num++;
+            }
+            head += record->size;
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+
+        uint64_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        if (dropped != ring->reported)
+        {
+            fprintf(out, "\033[33m(log)log buffer of thread %d is full, %" PRIu64 " records dropped.\033[0m\n", i,
+                    dropped - ring->reported);
+            ring->reported = dropped;
+        }
+    }
+    return record_num;
+}
+
+/* 日志线程：不断取空各个线程的缓冲区，没有新日志时把输出流刷出去并睡眠 LOG_FLUSH_INTERVAL_MS */
+static void *log_main(void *arg)
+{
+    (void)arg;
+    FILE *out = g_log.out;
+    while (true)
+    {
+        // 先读退出标志再取空，保证退出之前写入的日志都会被输出
+        bool over = atomic_load_explicit(&g_log.over, memory_order_acquire);
+        size_t record_num = log_drain(out);
+        if (over)
+            break;
+        if (0 == record_num)
+        {
+            fflush(out);
+            struct timespec ts = {0, LOG_FLUSH_INTERVAL_MS * 1000000L};
+            nanosleep(&ts, NULL);
+        }
+    }
+    fflush(out);
+    return NULL;
+}
+
+/**
+ * @brief 按名称解析日志级别（debug、info、warn、error、off）。
+ *
+ * @return 成功返回级别，名称不合法时返回 -1。
+ */
+int log_level_parse(const char *name)
+{
+    for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_OFF; i++)
+        if (0 == strcmp(name, log_level_names[i]))
+            return i;
+    return -1;
+}
+
+const char *log_level_name(log_level_t level)
+{
+    return log_level_names[level];
+}
@@ -6,15 +6,14 @@
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    g_pconf = (pconf_t *)malloc(sizeof(pconf_t));
+    if (0 != parse_config_args(g_pconf, argc, argv))
     {
-        printf("Usage: %s <port>\n", argv[0]);
+        printf("Usage: %s <port> [-r reactor_num] [-W worker_num] [-m reuseport|exclusive] [-w spin|park|adaptive] [-s spin_num] [-b epoll|uring] [-t tick_rate] [-d] [-i radius] [-k idle_seconds] [-q queue_kb] [-L lag_ms] [-u] [-p ping_ms] [-l debug|info|warn|error|off]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
-    int port = atoi(argv[1]);
 
-    g_pconf = (pconf_t *)malloc(sizeof(pconf_t));
-    if (0 != load_config(g_pconf, port))
+    if (0 != load_config(g_pconf, g_pconf->port))
     {
         perror("can't start server!");
         return -1;
@@ -32,35 +31,42 @@ int main(int argc, char *argv[])
             printf("\033[31m%s\033[0m", "(server)malloc error.\n");
             break;
         case -2:
-            printf("\033[31m%s\033[0m", "(server)epoll_create error.\n");
+            printf("\033[31m%s\033[0m", "(server)epoll_create / io_uring_setup error.\n");
+            break;
+        case -3:
+            printf("\033[31m%s\033[0m", "(server)udp socket error.\n");
             break;
         }
         return -1;
     } /*初始化全局变量*/
 
-    // 新建3个子线程，分别是处理线程，发包线程，收包线程
+    // 新建子线程，分别是处理线程，每个 worker 一个的发包线程，每个 reactor 一个的收包线程，以及开启 -u 时的 UDP 收包线程
     pthread_t handler_pid;
-    pthread_t send_pid;
-    pthread_t recv_pid;
     if (0 != pthread_create(&handler_pid, NULL, event_handler_main, NULL))
     {
         clean_main();
         return -2;
     }
-    if (0 != pthread_create(&send_pid, NULL, send_req_main, NULL))
+    if (0 != start_workers())
+    {
+        clean_main();
+        return -2;
+    }
+    if (0 != start_reactors())
     {
         clean_main();
         return -2;
     }
-    if (0 != pthread_create(&recv_pid, NULL, recv_res_main, NULL))
+    if (0 != start_udp_channel())
     {
         clean_main();
         return -2;
     }
 
     pthread_join(handler_pid, NULL);
-    pthread_join(send_pid, NULL);
-    pthread_join(recv_pid, NULL);
+    join_workers();
+    join_reactors();
+    join_udp_channel();
 
     // if (0 != clean_main())
     // {
@@ -0,0 +1,177 @@
+#include "out_queue.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include "util.h"
+
+void out_queue_init(out_queue_t *queue)
+{
+    queue->frames = NULL;
+    queue->head = 0;
+    queue->num = 0;
+    queue->offset = 0;
+    queue->bytes = 0;
+    queue->inflight = 0;
+}
+
+/**
+ * @brief 把帧的一个引用追加到队列末尾，队列为空时先借用帧引用数组。
+ *
+ * @return 成功返回 0，队列已满或者借不到帧引用数组时返回 -1（该帧对这个连接被丢弃，不会持有引用）。
+ */
+int out_queue_push(out_queue_t *queue, frame_t *frame)
+{
+    if (OUT_QUEUE_FRAME_NUM == queue->num)
+        return -1;
+    if (NULL == queue->frames)
+    {
+        size_t capacity;
+        if (NULL == (queue->frames = (frame_t **)slab_alloc(&g_io_buffer_slab, OUT_QUEUE_FRAMES_SIZE, &capacity)))
+            return -1;
+        queue->head = 0;
+    }
+
+    uint32_t tail = (queue->head + queue->num) % OUT_QUEUE_FRAME_NUM;
+    queue->frames[tail] = frame_ref(frame);
+    queue->num++;
+    queue->bytes += frame->len;
+    return 0;
+}
+
+/**
+ * @brief 用 frame 替换队列中被它取代的最新一帧：消息类型（帧的前 4 字节）相同，
+ * 并且 [key_offset, key_offset + key_len) 范围内的字节也相同。
+ *
+ * 替换保留旧帧在队列中的位置，旧帧释放引用。已经写出一部分的队头帧以及 io_uring 后端已经提交给内核的帧不会被替换。
+ *
+ * @return 替换成功返回 0，没有可以替换的帧返回 -1（队列不变，不会持有 frame 的引用）。
+ */
+int out_queue_supersede(out_queue_t *queue, frame_t *frame, uint32_t key_offset, uint32_t key_len)
+{
+    uint32_t first = queue->inflight + (0 != queue->offset ? 1 : 0);
+    if (frame->len < key_offset + key_len)
+        return -1;
+    for (uint32_t i = queue->num; i > first; i--)
+    {
+        uint32_t index = (queue->head + i - 1) % OUT_QUEUE_FRAME_NUM;
+        frame_t *old = queue->frames[index];
+        if (old->len < key_offset + key_len || 0 != memcmp(old->data, frame->data, sizeof(int32_t)) ||
+            0 != memcmp(old->data + key_offset, frame->data + key_offset, key_len))
+            continue;
+        queue->bytes = queue->bytes - old->len + frame->len;
+        queue->frames[index] = frame_ref(frame);
+        frame_release(old);
+        return 0;
+    }
+    return -1;
+}
+
+/* 弹出并释放队头帧，队列清空时归还帧引用数组 */
+static void out_queue_pop(out_queue_t *queue)
+{
+    frame_release(queue->frames[queue->head]);
+    queue->frames[queue->head] = NULL;
+    queue->head = (queue->head + 1) % OUT_QUEUE_FRAME_NUM;
+    queue->num--;
+    queue->offset = 0;
+    if (0 == queue->num)
+    {
+        slab_free(&g_io_buffer_slab, queue->frames, OUT_QUEUE_FRAMES_SIZE);
+        queue->frames = NULL;
+        queue->head = 0;
+    }
+}
+
+/**
+ * @brief 按顺序取出队列中待发送的片段，最多 max_num 个帧，队头帧从 offset 处开始。
+ *
+ * 只是查看，不会出队；真正发送出去之后再调用 `out_queue_consume`。
+ *
+ * @return 填充的 iovec 数量。
+ */
+int out_queue_peek_iov(const out_queue_t *queue, struct iovec *iov, int max_num)
+{
+    int iov_num = 0;
+    for (uint32_t i = 0; i < queue->num && iov_num < max_num; i++)
+    {
+        frame_t *frame = queue->frames[(queue->head + i) % OUT_QUEUE_FRAME_NUM];
+        uint32_t skip = (0 == i) ? queue->offset : 0;
+        iov[iov_num].iov_base = frame->data + skip;
+        iov[iov_num].iov_len = frame->len - skip;
+        iov_num++;
+    }
+    return iov_num;
+}
+
+/**
+ * @brief 按顺序把已经发送出去的字节数分摊到各个帧上，完整发送的帧立即释放引用，
+ * 最后一个只发送了一部分的帧记录 offset。
+ */
+void out_queue_consume(out_queue_t *queue, size_t bytes)
+{
+    queue->bytes -= bytes;
+    while (bytes > 0 && queue->num > 0)
+    {
+        frame_t *frame = queue->frames[queue->head];
+        size_t remain = frame->len - queue->offset;
+        if (bytes < remain)
+        {
+            queue->offset += bytes;
+            return;
+        }
+        bytes -= remain;
+        out_queue_pop(queue);
+    }
+}
+
+/**
+ * @brief 用 writev 把队列中的帧尽可能多地写到套接字中。
+ *
+ * 每次系统调用最多覆盖 OUT_QUEUE_IOV_NUM 个帧，队头帧从 offset 处开始写；
+ * 部分写入时更新 offset，完整写出的帧立即释放引用。
+ * 实际调用的是带 MSG_NOSIGNAL 的 sendmsg（效果和 writev 相同）：对端已经重置、但读线程还没有把玩家标记为
+ * 不可用时，写入只返回 EPIPE，不会触发 SIGPIPE 终止整个进程。
+ *
+ * @param sockfd 非阻塞的套接字。
+ * @return OUT_QUEUE_DRAINED：队列已写空；OUT_QUEUE_BLOCKED：遇到 EAGAIN，队列中还有数据；
+ * OUT_QUEUE_ERROR：发生了其他写错误。
+ */
+int out_queue_flush(out_queue_t *queue, int sockfd)
+{
+    struct iovec iov[OUT_QUEUE_IOV_NUM];
+    while (queue->num > 0)
+    {
+        int iov_num = out_queue_peek_iov(queue, iov, OUT_QUEUE_IOV_NUM);
+        size_t want_write = 0;
+        for (int i = 0; i < iov_num; i++)
+            want_write += iov[i].iov_len;
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_num;
+        COUNT_SYSCALL(1);
+        ssize_t have_write = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+        if (have_write < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            return (EAGAIN == errno || EWOULDBLOCK == errno) ? OUT_QUEUE_BLOCKED : OUT_QUEUE_ERROR;
+        }
+
+        out_queue_consume(queue, have_write);
+        if ((size_t)have_write < want_write)
+            return OUT_QUEUE_BLOCKED; // 内核只接受了一部分，说明发送缓冲区已满
+    }
+    return OUT_QUEUE_DRAINED;
+}
+
+/**
+ * @brief 释放队列中的全部帧引用。
+ */
+void out_queue_clear(out_queue_t *queue)
+{
+    while (queue->num > 0)
+        out_queue_pop(queue);
+    queue->bytes = 0;
+}
@@ -1,4 +1,6 @@
 #include "player_info_array.h"
+#include "room.h"
+#include "stats.h"
 
 pthread_mutex_t player_info_array_mutex;
 
@@ -7,10 +9,148 @@ void init_player_info_array_lock()
     pthread_mutex_init(&player_info_array_mutex, NULL);
 }
 
-void player_info_array_init()
+/**
+ * @brief UUID 的 FNV-1a 哈希。
+ */
+static uint32_t hash_player_id(const char *id)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < PLAYER_ID_LEN && id[i] != '\0'; i++)
+    {
+        hash ^= (unsigned char)id[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief 在 UUID 哈希表中查找玩家，调用方需要持有 player_info_array_mutex。
+ *
+ * @return 找到时返回哈希表中的位置，否则返回 -1。
+ */
+static int find_id_pos(const char *id)
+{
+    uint32_t pos = hash_player_id(id) & player_infos.id_table_mask;
+    while (-1 != player_infos.id_table[pos])
+    {
+        if (0 == strncmp(player_infos.slots[player_infos.id_table[pos]].id, id, PLAYER_ID_LEN))
+            return pos;
+        pos = (pos + 1) & player_infos.id_table_mask;
+    }
+    return -1;
+}
+
+static void insert_id(int slot)
+{
+    uint32_t pos = hash_player_id(player_infos.slots[slot].id) & player_infos.id_table_mask;
+    while (-1 != player_infos.id_table[pos])
+        pos = (pos + 1) & player_infos.id_table_mask;
+    player_infos.id_table[pos] = slot;
+}
+
+/**
+ * @brief 从 UUID 哈希表中删除指定位置的元素。
+ *
+ * 线性探测不能简单地把位置置空，否则会截断其后同一探测链上的元素，
+ * 这里把后面“本该在空位之前”的元素依次前移（backward shift），不需要墓碑标记。
+ */
+static void remove_id_pos(uint32_t pos)
 {
+    uint32_t mask = player_infos.id_table_mask;
+    uint32_t hole = pos;
+    uint32_t next = (pos + 1) & mask;
+    while (-1 != player_infos.id_table[next])
+    {
+        uint32_t home = hash_player_id(player_infos.slots[player_infos.id_table[next]].id) & mask;
+        // home 不在 (hole, next] 区间内，说明该元素可以前移到 hole
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            player_infos.id_table[hole] = player_infos.id_table[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    player_infos.id_table[hole] = -1;
+}
+
+/**
+ * @brief 把玩家从注册表中摘除并归还 slot，调用方需要持有 player_info_array_mutex。
+ */
+static void remove_player_info(player_info *info)
+{
+    if (0 <= info->socketfd && info->socketfd < MAX_FD_NUM &&
+        atomic_load_explicit(&player_infos.by_fd[info->socketfd], memory_order_relaxed) == info)
+        atomic_store_explicit(&player_infos.by_fd[info->socketfd], NULL, memory_order_release);
+
+    int pos = find_id_pos(info->id);
+    if (-1 != pos)
+        remove_id_pos(pos);
+    room_leave(info);
+
+    // 活跃列表用最后一个元素填补空位
+    int last = player_infos.active[player_infos.length - 1];
+    player_infos.active[info->active_index] = last;
+    player_infos.slots[last].active_index = info->active_index;
+    player_infos.length--;
+
+    info->active_index = -1;
+    stats_set_client_rtt(info->slot, 0, 0);
+    player_infos.free_slots[player_infos.free_num++] = info->slot;
+}
+
+/**
+ * @brief 一次性分配注册表的全部内存。
+ *
+ * slots 使用 calloc 分配，没有被用到的 slot 不会真正占用物理内存；
+ * 空闲栈按照从小到大的顺序弹出，让在线玩家尽量集中在数组的前部。
+ *
+ * @return 成功返回 0，内存分配失败返回 -1。
+ */
+int player_info_array_init()
+{
+    uint32_t table_size = 1;
+    while (table_size < 2 * MAX_CONNECTION_NUM)
+        table_size <<= 1;
+
     player_infos.length = 0;
-    player_infos.head = NULL;
+    player_infos.slots = calloc(MAX_CONNECTION_NUM, sizeof(player_info));
+    player_infos.free_slots = malloc(sizeof(int) * MAX_CONNECTION_NUM);
+    player_infos.active = malloc(sizeof(int) * MAX_CONNECTION_NUM);
+    player_infos.by_fd = calloc(MAX_FD_NUM, sizeof(*player_infos.by_fd));
+    player_infos.id_table = malloc(sizeof(int) * table_size);
+    player_infos.id_table_mask = table_size - 1;
+    if (NULL == player_infos.slots || NULL == player_infos.free_slots || NULL == player_infos.active ||
+        NULL == player_infos.by_fd || NULL == player_infos.id_table)
+        return -1;
+
+    for (int i = 0; i < MAX_CONNECTION_NUM; i++)
+    {
+        player_infos.slots[i].slot = i;
+        player_infos.slots[i].active_index = -1;
+        player_infos.slots[i].socketfd = -1;
+        pthread_mutex_init(&player_infos.slots[i].msg_count_mutex, NULL);
+        out_queue_init(&player_infos.slots[i].out_queue);
+        player_infos.free_slots[i] = MAX_CONNECTION_NUM - 1 - i;
+    }
+    player_infos.free_num = MAX_CONNECTION_NUM;
+    for (uint32_t i = 0; i < table_size; i++)
+        player_infos.id_table[i] = -1;
+    return 0;
+}
+
+void player_info_array_destroy()
+{
+    if (NULL != player_infos.slots)
+    {
+        for (int i = 0; i < MAX_CONNECTION_NUM; i++)
+            pthread_mutex_destroy(&player_infos.slots[i].msg_count_mutex);
+    }
+    free(player_infos.slots);
+    free(player_infos.free_slots);
+    free(player_infos.active);
+    free((void *)player_infos.by_fd);
+    free(player_infos.id_table);
+    memset(&player_infos, 0, sizeof(player_infos));
 }
 
 int get_player_info_array_length()
@@ -22,180 +162,149 @@ int get_player_info_array_length()
     return length;
 }
 
+static int reclaim_unavailable_locked(void);
+
 /**
- * @brief 添加新的玩家信息到玩家信息链表中。
+ * @brief 为新连接分配一个 slot 并登记到注册表中。
  *
- * 该函数为新玩家创建一个 `player_info` 结构体，并将其添加到全局链表 `player_infos` 的头部。新玩家信息包括
- * 玩家ID、socket文件描述符、消息计数等。该函数使用互斥锁来确保对链表操作的线程安全。
+ * 连接在 accept 之后立刻登记，这样 reactor 收到第一个字节时就一定能通过 fd 找到对应的 player_info。
+ * 新玩家的 message_count 初始为 1，对应在途的 RESPONSE_UUID 消息。
  *
- * @param id 新玩家的唯一标识符，传入时为一个常量字符串。
+ * @param id 新玩家的唯一标识符（UUID）。
  * @param socketfd 与该玩家通信的 socket 文件描述符。
- * @return int 操作结果：
- * - 0：成功添加玩家信息。
- * - -1：内存分配失败。
+ * slot 用完时先回收一遍已经拆除、但还没有被回收的玩家，仍然没有空闲 slot 才放弃。
  *
- * @note 在执行过程中，函数会为 `player_info` 结构体及其相关字段（如 `id` 和 `msg_count_mutex`）分配内存。
- * 如果分配内存失败，函数会进行相应的清理并返回错误码。使用互斥锁 `player_info_array_mutex` 确保线程安全。
+ * @return 成功时返回新玩家的 `player_info` 指针；slot 用完或 fd 超出索引范围时返回 `NULL`。
  */
-int add_player_info(const char *id, int socketfd)
+player_info *add_player_info(const char *id, int socketfd)
 {
-    // printf("add_player_info: %s\n", id);
+    if (0 > socketfd || socketfd >= MAX_FD_NUM)
+        return NULL;
+
     pthread_mutex_lock(&player_info_array_mutex);
-    player_info *new_player_info = malloc(sizeof(player_info));
-    if (new_player_info == NULL)
+    if (0 == player_infos.free_num && 0 == reclaim_unavailable_locked())
     {
         pthread_mutex_unlock(&player_info_array_mutex);
-        return -1;
+        return NULL;
     }
+    player_info *info = &player_infos.slots[player_infos.free_slots[--player_infos.free_num]];
 
-    // 为新的player_info分配内存
-    new_player_info->id = malloc(PLAYER_ID_LEN + 1);
-    if (new_player_info->id == NULL)
-    {
-        free(new_player_info);
-        pthread_mutex_unlock(&player_info_array_mutex);
-        return -1;
-    }
-    strcpy(new_player_info->id, id);
+    // 令牌由调用方在登记之后生成，在那之前上一个使用这个 slot 的连接的数据报都会被 UDP 线程丢弃
+    atomic_store_explicit(&info->udp_token, 0, memory_order_relaxed);
+    atomic_store_explicit(&info->udp_addr, 0, memory_order_relaxed);
+    atomic_store_explicit(&info->udp_recv_ms, 0, memory_order_relaxed);
+    info->udp_recv_seq = 0;
+    info->udp_send_seq = 0;
 
     // 初始化玩家信息
-    new_player_info->socketfd = socketfd;
-    new_player_info->message_count = 1;
-    new_player_info->havent_send = 0;
-    new_player_info->available = true;
-    new_player_info->ready = false;
-    new_player_info->msg_count_mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
-    pthread_mutex_init(new_player_info->msg_count_mutex, NULL);
-
-    // 将新玩家添加到链表头部 
-    new_player_info->next = player_infos.head;
-    player_infos.head = new_player_info;
-    player_infos.length++;
+    strncpy(info->id, id, PLAYER_ID_LEN);
+    info->id[PLAYER_ID_LEN] = '\0';
+    info->name[0] = '\0';
+    info->socketfd = socketfd;
+    info->query = NULL;
+    info->is_header_handled = false;
+    info->rcv_buffer = NULL;
+    info->rcv_head = 0;
+    info->rcv_tail = 0;
+    info->body_received = 0;
+    atomic_store_explicit(&info->conn_state, CONN_OPEN, memory_order_relaxed);
+    info->available = true;
+    info->ready = false;
+    info->message_count = 1;
+    atomic_store_explicit(&info->snapshot_ack, 0, memory_order_relaxed);
+    atomic_store_explicit(&info->rtt_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&info->rtt_jitter_us, 0, memory_order_relaxed);
+    info->room = -1;
+    info->compact_id = false;
+    info->send_kicked = false;
+    atomic_store_explicit(&info->worker, 0, memory_order_relaxed);
+    // 发送和 tick 的状态：上一个使用这个 slot 的连接的 worker 在计数归零之前已经不再引用它们，这里恢复成初始值，
+    // 否则残留的标志会让新连接的帧不进入 flush / tick 列表，或者被重复登记
+    out_queue_init(&info->out_queue);
+    info->wait_writable = false;
+    info->in_flush_list = false;
+    info->send_backlog_ns = 0;
+    info->pending_update = NULL;
+    info->in_tick_list = false;
+    info->tick_next = -1;
 
-    pthread_mutex_unlock(&player_info_array_mutex);
+    insert_id(info->slot);
+    info->active_index = player_infos.length;
+    player_infos.active[player_infos.length++] = info->slot;
+    // 最后再发布到 fd 索引中，无锁读到该指针的线程一定能看到上面初始化好的内容
+    atomic_store_explicit(&player_infos.by_fd[socketfd], info, memory_order_release);
 
-    // printf("done\n");
-    return 0;
+    pthread_mutex_unlock(&player_info_array_mutex);
+    return info;
 }
 
 /**
  * @brief 设置指定玩家的名称，并标记玩家为已准备好状态。
  *
- * 该函数通过遍历玩家信息链表，查找具有指定 `id` 的玩家，并为其设置名称。设置成功后，将玩家的 `ready` 状态
+ * 通过 UUID 哈希表查找具有指定 `id` 的玩家，并为其设置名称。设置成功后，将玩家的 `ready` 状态
  * 标记为 `true`。该函数使用互斥锁来保证线程安全。
  *
  * @param id 玩家唯一标识符字符串。假定在外部已经分配内存，需要在函数内释放。
  * @param name 要设置的玩家名称。假定在外部已经分配内存，需要在函数内释放。
  * @return int 操作结果：
  * - 0：成功设置名称。
- * - -1：内存分配失败。
  * - -2：未找到匹配的玩家。
  *
- * @note 该函数在处理完毕后会释放 `id` 和 `name` 的内存，并解锁互斥锁。
+ * @note 该函数在处理完毕后会释放 `id` 和 `name` 的内存，并解锁互斥锁。名称超过 MAX_PLAYER_NAME_LEN 的部分会被截断。
  */
 int set_player_name(char *id, char *name)
 {
+    int result = -2;
     pthread_mutex_lock(&player_info_array_mutex);
-    player_info *current = player_infos.head;
-    while (current != NULL)
+    int pos = find_id_pos(id);
+    if (-1 != pos)
     {
-        if (strcmp(current->id, id) == 0)
-        {
-            current->name = malloc(strlen(name) + 1);
-            if (current->name == NULL)
-            {
-                pthread_mutex_unlock(&player_info_array_mutex);
-                return -1;
-            }
-            strcpy(current->name, name);
-            current->ready = true;
-            free(id);
-            free(name);
-            pthread_mutex_unlock(&player_info_array_mutex);
-            return 0;
-        }
-        current = current->next;
+        player_info *info = &player_infos.slots[player_infos.id_table[pos]];
+        strncpy(info->name, name, MAX_PLAYER_NAME_LEN);
+        info->name[MAX_PLAYER_NAME_LEN] = '\0';
+        info->ready = true;
+        result = 0;
     }
+    pthread_mutex_unlock(&player_info_array_mutex);
     free(id);
     free(name);
-    pthread_mutex_unlock(&player_info_array_mutex);
-    return -2;
+    return result;
 }
 
 int delete_player_info(const char *id)
 {
     pthread_mutex_lock(&player_info_array_mutex);
-    player_info *current = player_infos.head;
-    player_info *previous = NULL;
-    while (current != NULL)
+    int pos = find_id_pos(id);
+    if (-1 == pos)
     {
-        if (strcmp(current->id, id) == 0)
-        {
-            if (previous == NULL)
-            {
-                player_infos.head = current->next;
-            }
-            else
-            {
-                previous->next = current->next;
-            }
-            free(current->id);
-            free(current->name);
-            free(current);
-            player_infos.length--;
-            return 0;
-        }
-        previous = current;
-        current = current->next;
+        pthread_mutex_unlock(&player_info_array_mutex);
+        return 1;
     }
+    remove_player_info(&player_infos.slots[player_infos.id_table[pos]]);
     pthread_mutex_unlock(&player_info_array_mutex);
-    return 1;
+    return 0;
 }
 
 int delete_player_info_by_socketfd(int socketfd)
 {
     pthread_mutex_lock(&player_info_array_mutex);
-    player_info *current = player_infos.head;
-    player_info *previous = NULL;
-    while (current != NULL)
+    player_info *info = get_player_info_by_sock(socketfd);
+    if (NULL == info)
     {
-        if (current->socketfd == socketfd)
-        {
-            if (previous == NULL)
-            {
-                player_infos.head = current->next;
-            }
-            else
-            {
-                previous->next = current->next;
-            }
-            free(current->id);
-            free(current->name);
-            free(current);
-            player_infos.length--;
-            return 0;
-        }
-        previous = current;
-        current = current->next;
+        pthread_mutex_unlock(&player_info_array_mutex);
+        return 1;
     }
+    remove_player_info(info);
     pthread_mutex_unlock(&player_info_array_mutex);
-    return 1;
+    return 0;
 }
 
 int clear_player_info_array()
 {
-    player_info *current = player_infos.head;
-    player_info *next;
-    while (current != NULL)
-    {
-        next = current->next;
-        free(current->id);
-        free(current->name);
-        free(current);
-        current = next;
-    }
-    player_infos.length = 0;
-    player_infos.head = NULL;
+    pthread_mutex_lock(&player_info_array_mutex);
+    while (player_infos.length > 0)
+        remove_player_info(&player_infos.slots[player_infos.active[player_infos.length - 1]]);
+    pthread_mutex_unlock(&player_info_array_mutex);
     return 0;
 }
 
@@ -204,93 +313,84 @@ int clear_player_info_array()
 /**
  * @brief 根据 socket 文件描述符查找并返回对应的玩家信息。
  *
- * 该函数通过遍历全局玩家信息链表，根据传入的 `socketfd` 查找匹配的玩家信息，并返回该玩家的 `player_info` 结构体指针。
- * 如果找到匹配的玩家，返回该玩家的指针；如果未找到，返回 `NULL`。函数在操作过程中使用互斥锁确保线程安全。
+ * 直接以 `socketfd` 为下标读取 fd 索引，不需要加锁，时间复杂度 O(1)。
+ * reactor 的接收路径、处理线程和发送线程在每条消息上都会调用它。
  *
  * @param socketfd 要查找的玩家的 socket 文件描述符。
  * @return player_info* 指向匹配玩家的 `player_info` 结构体的指针；如果未找到匹配的玩家，返回 `NULL`。
  *
- * @note 该函数会锁定 `player_info_array_mutex` 互斥锁，确保链表访问的线程安全。在查找结束后，无论是否找到玩家，都会解锁。
+ * @note 返回的指针指向稠密数组中的 slot，slot 的内存永远不会被释放，但可能在玩家被删除后分配给新的连接。
  */
 player_info *get_player_info_by_sock(int socketfd)
 {
+    if (0 > socketfd || socketfd >= MAX_FD_NUM)
+        return NULL;
+    return atomic_load_explicit(&player_infos.by_fd[socketfd], memory_order_acquire);
+}
+
+/**
+ * @brief 根据玩家 UUID 查找玩家信息，时间复杂度 O(1)。
+ *
+ * @return 找到时返回对应的 `player_info` 指针，否则返回 `NULL`。
+ */
+player_info *get_player_info_by_id(const char *id)
+{
+    player_info *info = NULL;
     pthread_mutex_lock(&player_info_array_mutex);
-    player_info *current = player_infos.head;
-    while (current != NULL)
-    {
-        if (current->socketfd == socketfd)
-        {
-            pthread_mutex_unlock(&player_info_array_mutex);
-            return current;
-        }
-        current = current->next;
-    }
+    int pos = find_id_pos(id);
+    if (-1 != pos)
+        info = &player_infos.slots[player_infos.id_table[pos]];
     pthread_mutex_unlock(&player_info_array_mutex);
-    return NULL;
+    return info;
 }
 
 /**
- * @brief 获取当前所有玩家的 socket 文件描述符数组。
+ * @brief 获取当前所有在线玩家的快照，用于群发。
  *
- * 该函数遍历全局玩家信息链表，并返回一个包含所有玩家 `socketfd` 的动态数组。数组的第一个元素 `sockfds[0]` 
- * 存储了数组中元素的数量，其后的元素为玩家的 socket 文件描述符。若玩家列表为空或内存分配失败，则返回 `NULL`。
- * 函数使用互斥锁确保链表访问的线程安全。
+ * 在锁内把活跃列表中的玩家指针顺序拷贝到调用方提供的数组中，群发时只需要按顺序遍历这个数组，
+ * 不需要为每个接收者再去查表，也不需要分配内存。
  *
- * @return int* 指向包含玩家 `socketfd` 的动态数组指针，数组的 0 号位置存储了数组的长度。
- * 返回 `NULL` 表示玩家列表为空或内存分配失败。
- *
- * @note 返回的数组由 `malloc` 分配内存，调用方需要在使用完毕后调用 `free` 释放内存。该函数使用 `player_info_array_mutex` 
- * 互斥锁来确保线程安全，在完成链表操作后会解锁。
+ * @param players 调用方提供的数组，用于存放玩家指针。
+ * @param max_num 数组容量。
+ * @return 实际写入的玩家数。
  */
-int *get_player_info_sockfds()
+int get_player_info_snapshot(player_info **players, int max_num)
 {
     pthread_mutex_lock(&player_info_array_mutex);
-    if (player_infos.length == 0)
-    {
-        pthread_mutex_unlock(&player_info_array_mutex);
-        return NULL;
-    }
-    int *sockfds = malloc(sizeof(int) * player_infos.length + 1);
-    if (sockfds == NULL)
-    {
-        pthread_mutex_unlock(&player_info_array_mutex);
-        return NULL;
-    }
-    player_info *current = player_infos.head;
-    int i = 1;
-    while (current != NULL)
-    {
-        sockfds[i] = current->socketfd;
-        current = current->next;
-        i++;
-    }
-    // 数组的0号元素之中存储了数组之中元素的数量
-    sockfds[0] = player_infos.length;
+    int num = (int)player_infos.length < max_num ? (int)player_infos.length : max_num;
+    for (int i = 0; i < num; i++)
+        players[i] = &player_infos.slots[player_infos.active[i]];
     pthread_mutex_unlock(&player_info_array_mutex);
-    return sockfds;
+    return num;
 }
 
 /**
- * @brief 打包全局玩家信息为一个字符串，排除特定的 socket 文件描述符。
+ * @brief 打包一个房间的玩家信息为一个字符串，排除特定的 socket 文件描述符。
+ *
+ * 该函数遍历在线玩家列表，排除 `except_socketfd` 对应的玩家、其他房间的玩家以及还没有发送 CLIENT_READY（没有名字）的玩家，
+ * 将其他玩家的 `id` 和 `name` 连接成一个字符串，每个玩家的信息之间用 `@` 分隔。
+ * 返回的字符串以 `\0` 结尾，并由 `malloc` 动态分配内存。
+ * 如果玩家数量为 1 或 0、房间中没有符合条件的其他玩家，或者内存分配失败，则返回 `NULL`。函数使用互斥锁确保线程安全。
  *
- * 该函数遍历全局玩家信息链表，排除 `except_socketfd` 对应的玩家，将其他玩家的 `id` 和 `name` 连接成一个字符串，
- * 每个玩家的信息之间用 `@` 分隔。返回的字符串以 `\0` 结尾，并由 `malloc` 动态分配内存。
- * 如果玩家数量为 1 或 0，或者内存分配失败，则返回 `NULL`。函数使用互斥锁确保线程安全。
+ * 紧凑 id 模式下每个玩家的信息前面多出 2 字节的 slot id，客户端用它建立 slot id -> UUID 的映射；
+ * slot id 可能包含 `\0` 和 `@`，所以长度通过 `len` 返回，客户端按位置解析。
  *
  * @param except_socketfd 需要排除的 socket 文件描述符，该玩家信息不会包含在返回的字符串中。
+ * @param room 房间号，只打包这个房间中的玩家。
+ * @param compact 是否在每个玩家的信息前面加上 slot id。
+ * @param len 输出参数，打包的字节数（不含结尾的 `\0`）。
  * @return char* 包含全局玩家信息的字符串，以 `\0` 结尾。若发生错误返回 `NULL`。
  *
  * @note 返回的字符串由 `malloc` 分配内存，调用方在使用完毕后需要调用 `free` 释放内存。
- * 函数使用 `player_info_array_mutex` 互斥锁来确保链表访问的线程安全，在完成链表操作后会解锁。
+ * 字符串加上消息头最多 MAX_QUERY_LEN 字节，放不下的玩家会被略去。
  */
-char *package_global_player_info(int except_socketfd)
+char *package_global_player_info(int except_socketfd, int room, bool compact, int *len)
 {
     pthread_mutex_lock(&player_info_array_mutex);
-    player_info *info = player_infos.head;
     int have_set_len = 0;
     char *delimiter = "@";
-    char *global_player_info = malloc(QUERY_BUFFER_LEN);
-    // int max_buffer_size = UNIT_BUFFER_SIZE * 2;
+    int max_len = MAX_QUERY_LEN - (int)sizeof(MessageHeader);
+    char *global_player_info = malloc(max_len);
 
     // 检查内存分配是否成功，以及玩家数量是否大于 1（否则无需打包信息）
     if (global_player_info == NULL ||
@@ -301,142 +401,160 @@ char *package_global_player_info(int except_socketfd)
         return NULL;
     }
     // 遍历所有玩家信息，将符合条件的玩家信息拼接成字符串
-    while (info)
+    for (size_t i = 0; i < player_infos.length; i++)
     {
+        player_info *info = &player_infos.slots[player_infos.active[i]];
         // 排除 `except_socketfd` 的玩家，并且确保玩家状态为 `available`
-        if (info->socketfd != except_socketfd && info->available)
+        if (info->socketfd == except_socketfd || info->room != room || !info->available || !info->ready)
+            continue;
+
+        int id_len = strlen(info->id);
+        int name_len = strlen(info->name);
+        int slot_len = compact ? SLOT_ID_LEN : 0;
+        if (have_set_len + slot_len + id_len + name_len + (int)strlen(delimiter) >= max_len)
+            break;
+        if (compact)
         {
-            // if (have_set_len + strlen(info->id) + strlen(info->name) + strlen(delimiter) > max_buffer_size)
-            // {
-            //     max_buffer_size += UNIT_BUFFER_SIZE;
-            //     global_player_info = realloc(global_player_info, max_buffer_size);
-            //     if (global_player_info == NULL)
-            //     {
-            //         pthread_mutex_unlock(&player_info_array_mutex);
-            //         // TODO 这里服务器应该是崩溃了，需不需要传递这个消息给客户端？
-            //         return NULL;
-            //     }
-            // }
-
-            // printf("(debug)strlen id: %d\n", strlen(info->id));
-            // printf("(debug)strlen name: %d\n", strlen(info->name));
-            // printf("(debug)strlen delimiter: %d\n", strlen(delimiter));
-            memmove(global_player_info + have_set_len, info->id, strlen(info->id));
-            have_set_len += strlen(info->id);
-            memmove(global_player_info + have_set_len, info->name, strlen(info->name));
-            have_set_len += strlen(info->name);
-            memmove(global_player_info + have_set_len, delimiter, strlen(delimiter));
-            have_set_len += strlen(delimiter);
+            uint16_t slot_id = info->slot;
+            memcpy(global_player_info + have_set_len, &slot_id, SLOT_ID_LEN);
+            have_set_len += SLOT_ID_LEN;
         }
-        info = info->next;
+        memmove(global_player_info + have_set_len, info->id, id_len);
+        have_set_len += id_len;
+        memmove(global_player_info + have_set_len, info->name, name_len);
+        have_set_len += name_len;
+        memmove(global_player_info + have_set_len, delimiter, strlen(delimiter));
+        have_set_len += strlen(delimiter);
     } /*将所有的玩家信息拼接成一个字符串，用@分隔*/
-    global_player_info[have_set_len] = '\0';
     pthread_mutex_unlock(&player_info_array_mutex);
+    if (0 == have_set_len) // 房间中没有其他玩家
+    {
+        free(global_player_info);
+        return NULL;
+    }
+    global_player_info[have_set_len] = '\0';
+    *len = have_set_len;
 
-    printf("(debug)global_player_info: %s\n", global_player_info);
+    LOG_DEBUG("global_player_info: %s", global_player_info);
     return global_player_info;
 }
 
 /**
- * @brief 扫描并删除不可用的玩家信息
+ * @brief 回收一个已经拆除、没有在途消息的玩家，调用方需要持有 player_info_array_mutex。
  *
- * 该函数遍历 `player_infos` 链表，查找所有不可用且消息计数为 0 的玩家信息，
- * 并将其从链表中删除，释放相关资源。删除玩家信息的条件为：
- * - `available` 标志为假（表示玩家不可用）。
+ * 回收的条件为：
+ * - 仍然登记在注册表中（`active_index` 不为 -1，没有被回收过）。
+ * - `available` 标志为假（表示连接已经拆除）。
  * - `message_count` 为 0（表示没有未处理的消息）。
  *
- * 删除的玩家信息包括以下资源：
- * - 玩家 ID 和名字的内存。
- * - 玩家在接收和发送 epoll 中注册的 socket 文件描述符。
+ * 回收的资源包括：
+ * - 玩家在 fd 索引、UUID 哈希表和活跃列表中的登记，slot 归还到空闲栈。
+ * - 玩家 socket 在 epoll 中的注册（关闭 socket 时内核会自动将其从所属 reactor 的 epoll 和发送 epoll 中移除）。
  * - 玩家 socket 连接。
- * - 互斥锁（用于管理消息计数的同步机制）。
- *
- * 该函数会对 `player_infos` 链表加锁，以防止其他线程同时对链表进行修改。
- * 删除操作完成后会更新链表的长度，并释放内存。
- *
- * @return int
- * 函数总是返回 0，表示操作成功。
  *
- * @note 
- * - 该函数的执行依赖于以下全局变量：
- *   - `player_infos`: 玩家信息链表。
- *   - `g_recv_epoll_fd`: 接收 epoll 文件描述符。
- *   - `g_send_epoll_fd`: 发送 epoll 文件描述符。
- * - 该函数会调用 `epoll_ctl`、`close` 等函数来操作 epoll 和 socket 资源。
+ * @return 回收了该玩家时返回 true。
  */
-int scan_and_delete_unavailable_player_info()
+static bool reclaim_player_info(player_info *info)
 {
-    pthread_mutex_lock(&player_info_array_mutex);   // 加锁，防止并发修改 player_info 列表
-    player_info *current = player_infos.head;   // 初始化遍历指针 `current`，指向 player_info 链表的头部
-    player_info *previous = NULL;   // `previous` 用于记录 `current` 的前一个节点
-    player_info *tmp = NULL;    // 临时指针 `tmp` 用于删除节点后释放内存
-    bool delete_flag = false;   // 删除标志位，用于指示当前节点是否需要删除
+    if (-1 == info->active_index || info->available || get_message_count(info) != 0)
+        return false;
 
-    while (current != NULL)
-    {
-        // 判断当前 player 是否不可用，并且消息队列为空
-        if (!current->available && current->message_count == 0)
-        {
-            printf("(debug)prepare to delete unavailable player info\n");
-            if (previous == NULL)
-                player_infos.head = current->next;
-            else
-                previous->next = current->next;
-            
-            // 释放当前 player 的 ID 和名字内存
-            free(current->id);
-            free(current->name);
-            // 从接收 epoll 中删除该玩家的 socket 描述符
-            epoll_ctl(g_recv_epoll_fd, EPOLL_CTL_DEL, current->socketfd, NULL);
-            // 如果该玩家还有未发送的消息，从发送 epoll 中删除其 socket 描述符
-            if (current->havent_send > 0)
-                epoll_ctl(g_send_epoll_fd, EPOLL_CTL_DEL, current->socketfd, NULL);
-            // 关闭该玩家的 socket 连接
-            close(current->socketfd);
-            // 销毁该玩家的消息计数互斥锁，并释放互斥锁内存
-            pthread_mutex_destroy(current->msg_count_mutex);
-            free(current->msg_count_mutex);
-
-            // 设置删除标志位
-            delete_flag = true;
-            player_infos.length--;
-        }
+    LOG_DEBUG("prepare to delete unavailable player info %s", info->id);
+    int socketfd = info->socketfd;
+    remove_player_info(info);
+    // 先从 fd 索引中摘除再关闭 socket，避免 fd 被新连接复用时覆盖新的登记
+    COUNT_SYSCALL(1);
+    close(socketfd);
+    info->socketfd = -1;
+    return true;
+}
 
-        previous = current;
-        tmp = current;
-        current = current->next;
+/**
+ * @brief 回收在线玩家列表中所有可以回收的玩家，调用方需要持有 player_info_array_mutex。
+ *
+ * 活跃列表删除时会用最后一个元素填补空位，所以这里从后往前遍历。
+ *
+ * @return 回收的玩家数。
+ */
+static int reclaim_unavailable_locked(void)
+{
+    int reclaimed = 0;
+    for (int i = (int)player_infos.length - 1; i >= 0; i--)
+        if (reclaim_player_info(&player_infos.slots[player_infos.active[i]]))
+            reclaimed++;
+    return reclaimed;
+}
 
-        // 如果删除标志位为真，释放当前节点的内存
-        if (delete_flag)
-        {
-            delete_flag = false;
-            free(tmp);
-        }
-    }
+/**
+ * @brief 扫描并删除不可用的玩家信息
+ *
+ * 玩家通常在最后一条在途消息处理完时就已经被回收（见 `minus_message_count`），
+ * 这里遍历在线玩家列表，回收所有剩下的不可用且消息计数为 0 的玩家，作为兜底。
+ *
+ * @return 回收的玩家数。
+ */
+int scan_and_delete_unavailable_player_info()
+{
+    pthread_mutex_lock(&player_info_array_mutex);   // 加锁，防止并发修改玩家注册表
+    int reclaimed = reclaim_unavailable_locked();
     pthread_mutex_unlock(&player_info_array_mutex);
-    return 0;
+    return reclaimed;
 }
 
 void plus_message_count(player_info *info)
 {
-    printf("(debug) \033[33m%s\033[0m message count ++\n", info->id);
-    pthread_mutex_lock(info->msg_count_mutex);
+    LOG_DEBUG("%s message count ++", info->id);
+    pthread_mutex_lock(&info->msg_count_mutex);
     info->message_count++;
-    pthread_mutex_unlock(info->msg_count_mutex);
+    pthread_mutex_unlock(&info->msg_count_mutex);
+}
+
+/**
+ * @brief 只在玩家仍然在线时增加消息计数，用于不经过接收 reactor 的 ready 队列生产者（UDP 线程、迁移玩家的 worker）。
+ *
+ * reactor 放入 ready 队列的消息总是排在同一个连接的 SOME_ONE_QUIT 之前，handler 处理它们时玩家一定还没有被回收；
+ * 其他线程入队的消息没有这个顺序保证，需要在入队之前就持有计数。`available` 在拆除时先于释放拆除计数被置为假，
+ * 所以在计数锁内看到玩家仍然在线，就说明计数还没有归零、slot 不会在计数释放之前被回收。
+ *
+ * slot 可能在调用方找到它之后换了主人，调用方在持有计数之后还要再核对一次身份（例如 UDP 令牌）。
+ *
+ * @return 玩家已经拆除时返回 false，不增加计数。
+ */
+bool try_plus_message_count(player_info *info)
+{
+    pthread_mutex_lock(&info->msg_count_mutex);
+    bool pinned = info->available;
+    if (pinned)
+        info->message_count++;
+    pthread_mutex_unlock(&info->msg_count_mutex);
+    return pinned;
 }
 
+/**
+ * @brief 减少玩家的消息计数。
+ *
+ * 连接已经拆除（`available` 为假）时，把计数减到 0 的线程就是最后一个处理该玩家消息的线程，
+ * 由它立即回收玩家的 slot、fd 和 UUID 登记，之后其他线程不会再通过这个玩家访问它们。
+ * 回收要加注册表锁，这里先放开消息计数的锁，保持注册表锁 -> 消息计数锁的加锁顺序。
+ */
 void minus_message_count(player_info *info)
 {
-    printf("(debug) \033[33m%s\033[0m message count --\n", info->id);
-    pthread_mutex_lock(info->msg_count_mutex);
-    info->message_count--;
-    pthread_mutex_unlock(info->msg_count_mutex);
+    LOG_DEBUG("%s message count --", info->id);
+    pthread_mutex_lock(&info->msg_count_mutex);
+    bool reclaim = 0 == --info->message_count && !info->available;
+    pthread_mutex_unlock(&info->msg_count_mutex);
+    if (reclaim)
+    {
+        pthread_mutex_lock(&player_info_array_mutex);
+        reclaim_player_info(info);
+        pthread_mutex_unlock(&player_info_array_mutex);
+    }
 }
 
 int get_message_count(player_info *info)
 {
-    pthread_mutex_lock(info->msg_count_mutex);
+    pthread_mutex_lock(&info->msg_count_mutex);
     int count = info->message_count;
-    pthread_mutex_unlock(info->msg_count_mutex);
+    pthread_mutex_unlock(&info->msg_count_mutex);
     return count;
-}
\ No newline at end of file
+}
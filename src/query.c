@@ -1,5 +1,8 @@
 #include "query.h"
 #include "query_list.h"
+#include "reactor.h"
+#include "udp_channel.h"
+#include <sys/uio.h>
 
 CQuery *CQuery_create()
 {
@@ -17,8 +20,13 @@ void CQuery_init(CQuery *query)
     query->m_header.length = 0;
     query->m_socket_fd = -1;
 
-    memset(query->m_byte_Query, 0, QUERY_BUFFER_LEN);
+    query->m_byte_Query = NULL;
+    query->m_query_cap = 0;
     query->m_query_len = -1;
+    query->m_recv_ns = 0;
+    query->m_ready_ns = 0;
+    query->m_handled_ns = 0;
+    query->m_pinned = NULL;
     query->p_pre_query = NULL;
     query->p_next_query = NULL;
 }
@@ -28,6 +36,7 @@ void CQuery_destroy(CQuery *query)
     if (query)
     {
         CQuery_close_socket(query);
+        CQuery_release_buffer(query);
         free(query);
     }
 }
@@ -40,12 +49,13 @@ void CQuery_destroy(CQuery *query)
  * 该文件描述符将用于与客户端通信。如果 `accept` 调用失败，则返回 -1。
  *
  * param listen_socket 监听套接字的文件描述符，必须已经调用 `bind` 和 `listen` 进行绑定和监听。
+ * param epoll_fd 负责该连接读事件的 reactor 的 epoll 实例，新连接会注册到这里。
  * 
  * return 
  *   - 成功时，返回新连接的套接字文件描述符，用于后续的读写操作。
  *   - 失败时，返回 -1，表示 `accept` 调用出错。
  */
-int CQuery_accept_tcp_connect(int listen_socket)
+int CQuery_accept_tcp_connect(int listen_socket, int epoll_fd)
 {
     // 定义一个 CQuery 指针，用于存储当前请求连接
     CQuery *query = NULL;
@@ -57,11 +67,12 @@ int CQuery_accept_tcp_connect(int listen_socket)
     // 定义地址结构体，用于存储客户端的地址信息
     struct sockaddr_in addr;
     socklen_t addrlen = sizeof(addr);
-    struct epoll_event ev;
+    int socketfd;
 
-    // 尝试接受来自客户端的新连接，保存到query->m_socket_fd中
+    // 尝试接受来自客户端的新连接
     // 如果失败，检查错误类型：资源临时不可用（EAGAIN或EWOULDBLOCK）或其他错误
-    if (0 > (query->m_socket_fd = accept(listen_socket, (struct sockaddr *)&addr, &addrlen)))
+    COUNT_SYSCALL(1);
+    if (0 > (socketfd = accept(listen_socket, (struct sockaddr *)&addr, &addrlen)))
     {
         // 如果是EAGAIN或EWOULDBLOCK错误，表明资源暂时不可用，将query返回到空闲列表并返回错误码
         if (EAGAIN == errno || EWOULDBLOCK == errno)
@@ -71,53 +82,127 @@ int CQuery_accept_tcp_connect(int listen_socket)
         }
         else
         {
-            // 如果是其他错误，关闭连接，返回到空闲列表，并返回套接字接受错误
-            CQuery_close_socket(query);
+            // 如果是其他错误，返回到空闲列表，并返回套接字接受错误
             add_free_list(query);
             return SOCKET_ACCEPT_ERROR;
         }
     }
 
+    // 配置套接字、生成 UUID 并登记玩家，失败时 query 已经被归还
+    player_info *info = NULL;
+    int result = CQuery_init_connection(query, socketfd, &addr, &info);
+    if (NO_ERROR != result)
+        return result;
+
+    // 设置用于接收数据的epoll事件，监听文件描述符的可读事件、边缘触发、对端关闭、错误、挂起等事件
+    struct epoll_event new_evt;
+    new_evt.events = EPOLLIN | EPOLLET | EPOLLRDHUP | EPOLLERR | EPOLLHUP | EPOLLPRI;
+    new_evt.data.ptr = info;    // 事件中直接携带玩家的 slot，reactor 不需要再按 fd 查表
+    // 将新接收到的连接注册到 accept 它的 reactor 的 epoll 实例中，进行事件监听
+    COUNT_SYSCALL(1);
+    if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, CQuery_get_socket(query), &new_evt))
+    { /*注册在recv_epoll的监听队列上*/
+        // 如果注册失败，注销玩家、关闭连接并返回到空闲列表，返回epoll错误
+        reactor_conn_closed(info);
+        delete_player_info_by_socketfd(query->m_socket_fd);
+        unreserve_free_query();
+        CQuery_close_socket(query);
+        add_free_list(query);
+
+        return EPOLL_ERROR;
+    }
+    
+    // 将query添加到处理队列中，等待后续操作
+    add_gready_list(query);
+    return NO_ERROR;    // 一切正常，返回无错误
+}
+
+/**
+ * @brief 为一个刚刚 accept 的连接做与 I/O 后端无关的初始化。
+ *
+ * 配置套接字选项，生成 UUID 并写入 `query`（类型为 RESPONSE_UUID），然后在玩家注册表中登记。
+ * 开启了 UDP 通道时同时生成这个连接的 UDP 令牌，跟在 slot id 之后下发。
+ * 同时为连接拆除时的 SOME_ONE_QUIT 预留一个 CQuery（见 `CQuery_notify_quit`），预留不到时拒绝连接；
+ * 成功之后调用方如果放弃这个连接，需要用 `unreserve_free_query` 归还预留。
+ * 调用方在成功之后注册该连接的读事件（epoll 或 io_uring multishot recv），再把 `query` 放入 ready 队列。
+ *
+ * @param query 用于下发 UUID 的 CQuery。
+ * @param socketfd 新连接的套接字。
+ * @param addr 客户端地址，为 NULL 时（io_uring multishot accept 不返回地址）通过 getpeername 获取。
+ * @param info 输出参数，登记好的玩家信息。
+ * @return 成功返回 NO_ERROR；失败时套接字已经关闭、`query` 已经归还，返回相应的错误码。
+ */
+int CQuery_init_connection(CQuery *query, int socketfd, struct sockaddr_in *addr, player_info **info)
+{
+    query->m_socket_fd = socketfd;
+
+    // 为拆除时的 SOME_ONE_QUIT 预留一个 CQuery，空闲列表只剩预留部分时拒绝新连接
+    if (!reserve_free_query())
+    {
+        CQuery_close_socket(query);
+        add_free_list(query);
+        return RESOURCE_UNAVAILABLE;
+    }
+
     // 配置接受到的socket文件描述符，如果失败，关闭连接并返回错误码
     if (0 > config_socket(query->m_socket_fd))
     {
+        unreserve_free_query();
         CQuery_close_socket(query);
         add_free_list(query);
         return SOCKET_CONFIGUE_ERROR;
     }
 
-    // 生成一个UUID，并将其保存到请求的缓冲区中
-    char uuid[PLAYER_ID_LEN + 1];
-    generate_uuid(uuid);
-    CQuery_set_query_buffer(query, uuid, PLAYER_ID_LEN + 1);
+    // 生成一个UUID，并将其保存到请求的缓冲区中；'\0' 之后是登记之后才知道的 slot id，旧客户端读到 '\0' 为止；
+    // 开启了 UDP 通道时再跟上 4 字节的令牌（小端）
+    char uuid[PLAYER_ID_LEN + 1 + SLOT_ID_LEN + UDP_TOKEN_LEN] = {0};
+    int uuid_len = PLAYER_ID_LEN + 1 + SLOT_ID_LEN;
+    uint32_t udp_token = 0;
+    if (udp_enabled())
+        uuid_len += UDP_TOKEN_LEN;
+    if (0 != generate_uuid(uuid) || (udp_enabled() && 0 != generate_token(&udp_token)) ||
+        0 != CQuery_set_query_buffer(query, uuid, uuid_len))
+    {
+        unreserve_free_query();
+        CQuery_close_socket(query);
+        add_free_list(query);
+        return RESOURCE_UNAVAILABLE;
+    }
     query->m_header.type = RESPONSE_UUID;   // 设置响应头类型为UUID
 
-    // 输出服务器日志，表示接受到一个新连接并打印客户端地址信息
-    printf("\033[32m%s\033[0m %s", "(server)", "accept new connection from: ");
-    print_addr_info(&addr);
-    printCurrentTime();
-
-    // 输出服务器日志，表示尝试向客户端发送UUID并等待响应
-    printf("\033[34m(server)\033[0m trying send uuid: \033[0;33m%s\033[0m to client, waiting for response...", uuid);
-    printCurrentTime();
-
-    // 设置用于接收数据的epoll事件，监听文件描述符的可读事件、边缘触发、错误、挂起等事件
-    struct epoll_event new_evt;
-    new_evt.events = EPOLLIN | EPOLLET | EPOLLERR | EPOLLHUP | EPOLLPRI;
-    new_evt.data.fd = query->m_socket_fd;
-    // 将新接收到的连接注册到全局的recv_epoll队列中，进行事件监听
-    if (0 > epoll_ctl(g_recv_epoll_fd, EPOLL_CTL_ADD, CQuery_get_socket(query), &new_evt))
-    { /*注册在recv_epoll的监听队列上*/
-        // 如果注册失败，关闭连接并返回到空闲列表，返回epoll错误
+    // 在注册读事件之前登记玩家，保证收到第一个字节时 reactor 一定能找到对应的 player_info
+    if (NULL == (*info = add_player_info(uuid, query->m_socket_fd)))
+    {
+        unreserve_free_query();
         CQuery_close_socket(query);
         add_free_list(query);
+        return RESOURCE_UNAVAILABLE;
+    }
+    uint16_t slot_id = (*info)->slot;
+    memcpy(query->m_byte_Query + PLAYER_ID_LEN + 1, &slot_id, SLOT_ID_LEN);
+    if (udp_enabled())
+    {
+        memcpy(query->m_byte_Query + PLAYER_ID_LEN + 1 + SLOT_ID_LEN, &udp_token, UDP_TOKEN_LEN);
+        atomic_store_explicit(&(*info)->udp_token, udp_token, memory_order_release);
+    }
 
-        return EPOLL_ERROR;
+    struct sockaddr_in peer;
+    if (NULL == addr)
+    {
+        socklen_t addrlen = sizeof(peer);
+        memset(&peer, 0, sizeof(peer));
+        COUNT_SYSCALL(1);
+        getpeername(socketfd, (struct sockaddr *)&peer, &addrlen);
+        addr = &peer;
     }
-    
-    // 将query添加到处理队列中，等待后续操作
-    add_gready_list(query);
-    return NO_ERROR;    // 一切正常，返回无错误
+
+    // 输出服务器日志，表示接受到一个新连接，之后向客户端发送 UUID 并等待响应
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr->sin_addr, ip, INET_ADDRSTRLEN);
+    LOG_INFO("accept new connection from %s:%d, trying send uuid %s to client.", ip, ntohs(addr->sin_port), uuid);
+    stats_add(&stats_local()->accepts, 1);
+    reactor_conn_open(*info);
+    return NO_ERROR;
 }
 
 /**
@@ -172,137 +257,390 @@ int CQuery_send_query(CQuery *query)
     return have_send;
 }
 
+/* 接收环形缓冲区的下标：读写游标单调递增，对容量取模（容量为 2 的幂）得到下标 */
+static inline uint32_t rcv_index(uint32_t cursor)
+{
+    return cursor & (RECV_BUFFER_SIZE - 1);
+}
+
+/**
+ * @brief 取得接收环形缓冲区的空闲部分，写游标后面到环尾、环头到读游标前面最多两段。
+ *
+ * 还没有借用缓冲区时先从 g_io_buffer_slab 中借一个。
+ *
+ * @return 空闲的段数，缓冲区满或者借不到缓冲区时返回 0。
+ */
+static int rcv_free_segments(player_info *info, struct iovec iov[2])
+{
+    if (NULL == info->rcv_buffer)
+    {
+        size_t capacity;
+        if (NULL == (info->rcv_buffer = (char *)slab_alloc(&g_io_buffer_slab, RECV_BUFFER_SIZE, &capacity)))
+            return 0;
+        info->rcv_head = info->rcv_tail = 0;
+    }
+    uint32_t free_len = RECV_BUFFER_SIZE - (info->rcv_tail - info->rcv_head);
+    if (0 == free_len)
+        return 0;
+    uint32_t tail = rcv_index(info->rcv_tail);
+    uint32_t first = RECV_BUFFER_SIZE - tail;
+    iov[0].iov_base = info->rcv_buffer + tail;
+    if (free_len <= first)
+    {
+        iov[0].iov_len = free_len;
+        return 1;
+    }
+    iov[0].iov_len = first;
+    iov[1].iov_base = info->rcv_buffer;
+    iov[1].iov_len = free_len - first;
+    return 2;
+}
+
+/* 从读游标处拷贝 len 字节（可能跨越环尾）到 dst，不推进读游标 */
+static void rcv_peek(const player_info *info, void *dst, uint32_t len)
+{
+    uint32_t head = rcv_index(info->rcv_head);
+    uint32_t first = RECV_BUFFER_SIZE - head;
+    if (len <= first)
+    {
+        memcpy(dst, info->rcv_buffer + head, len);
+        return;
+    }
+    memcpy(dst, info->rcv_buffer + head, first);
+    memcpy((char *)dst + first, info->rcv_buffer, len - first);
+}
+
+/**
+ * @brief 缓冲区中的数据全部解析完（或者 force 为 true，直接丢弃）时把缓冲区还给 g_io_buffer_slab。
+ *
+ * 只剩不完整的消息头时继续持有；消息体在解析出消息头之后直接拷贝进 CQuery，不需要缓冲区。
+ */
+static void rcv_release(player_info *info, bool force)
+{
+    if (NULL == info->rcv_buffer || (!force && info->rcv_head != info->rcv_tail))
+        return;
+    slab_free(&g_io_buffer_slab, info->rcv_buffer, RECV_BUFFER_SIZE);
+    info->rcv_buffer = NULL;
+    info->rcv_head = info->rcv_tail = 0;
+}
+
+/* 从读游标处拷贝 len 字节到 dst 并推进读游标 */
+static void rcv_consume(player_info *info, void *dst, uint32_t len)
+{
+    rcv_peek(info, dst, len);
+    info->rcv_head += len;
+}
+
+/* 记下连接最近一次收到数据的时刻，使用时间轮的缓存时间，不读时钟 */
+static inline void conn_touch(player_info *info)
+{
+    if (NULL != tls_reactor)
+        info->last_recv_ms = tls_reactor->timers.now_ms;
+}
+
+/* 拆除一个连接：先从 reactor 的 epoll 中摘除，保证之后不会再收到携带这个 slot 的事件，再通知其他玩家 */
+static void close_connection(player_info *info, int epoll_fd)
+{
+    COUNT_SYSCALL(1);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, info->socketfd, NULL);
+    CQuery_notify_quit(info);
+}
+
 /**
  * 函数名称: CQuery_recv_message
- * 功能: 接收来自客户端的消息并处理 TCP 连接状态和消息缓冲
+ * 功能: 接收来自客户端的消息并推进连接的状态机（epoll 后端）
  * 参数:
- *   - socketfd: 代表客户端的套接字文件描述符，用于接收和处理消息
+ *   - info: 该连接对应的玩家信息（从 epoll 事件的 data.ptr 中取得），用于接收和处理消息
+ *   - epoll_fd: 该连接所属 reactor 的 epoll 实例
+ *   - events: epoll 返回的事件
  * 返回值:
- *   - 成功时返回 NO_ERROR（定义的常量），表示消息成功处理
- *   - 失败时返回相应的错误代码，如 `-1` 表示套接字关闭或其他读取错误
+ *   - 成功时返回本次解析出并放入 ready 队列的完整消息数（>= 0）
+ *   - 连接已经关闭或者在本次调用中被关闭时返回 `-1`，其他失败返回相应的错误代码
+ *
+ * 断开检测完全由事件和读取结果驱动，不需要额外的系统调用：
+ * EPOLLRDHUP / EPOLLHUP 或者 read 返回 0 表示对端关闭了写端，连接进入 CONN_DRAINING，
+ * 把内核中剩下的数据读完、解析出其中完整的消息之后拆除；EPOLLERR 或者 read 出错（如 ECONNRESET）时
+ * 同样先解析已经收到的数据再拆除。完整的消息先于 SOME_ONE_QUIT 进入 ready 队列。
  */
-int CQuery_recv_message(int socketfd)
+int CQuery_recv_message(player_info *info, int epoll_fd, uint32_t events)
 {
-    // 定义一个结构体 `tcp_info`，用于获取 TCP 连接的状态信息
-    struct tcp_info tcpinfo;
-    socklen_t len = sizeof(tcpinfo);
+    int socketfd = info->socketfd;
+    int state = atomic_load_explicit(&info->conn_state, memory_order_relaxed);
+    if (CONN_CLOSED == state)
+        return -1;
+    if (events & (EPOLLRDHUP | EPOLLHUP))
+        state = CONN_DRAINING;
 
-    // 使用 `getsockopt` 获取套接字的 TCP 连接状态
-    if (getsockopt(socketfd, IPPROTO_TCP, TCP_INFO, &tcpinfo, &len) == -1)
+    int msg_count = 0;  // 本次解析出的完整消息数
+    int read_byte;      // 读取的字节数
+    int result = 0;
+
+    // 使用 `readv` 从套接字读取数据，直接写入玩家接收环形缓冲区的空闲部分（跨越环尾时分成两段）
+    do
     {
-        // 如果获取失败，打印错误信息并返回 -1
-        perror("getsockopt failed");
-        return -1;
+        struct iovec iov[2];
+        int iov_num = rcv_free_segments(info, iov);
+        if (0 == iov_num)
+        {
+            // 缓冲区满了：先解析腾出空间，仍然腾不出来（CQuery 耗尽）时剩下的数据留在内核中
+            if (0 > (result = CQuery_parse_message(info)))
+                break;
+            msg_count += result;
+            if (0 == (iov_num = rcv_free_segments(info, iov)))
+            {
+                result = RESOURCE_UNAVAILABLE;
+                break;
+            }
+        }
+        COUNT_SYSCALL(1);
+        if (0 < (read_byte = readv(socketfd, iov, iov_num)))
+        {
+            // 推进写游标
+            info->rcv_tail += read_byte;
+            stats_add(&stats_local()->read_bytes, read_byte);
+            conn_touch(info);
+        }
+        else if (0 == read_byte)
+        {
+            // 对端关闭了写端，数据已经读完
+            state = CONN_DRAINING;
+        }
+        else if (EINTR == errno)
+        {
+            read_byte = 1;
+        }
+        else if (EAGAIN == errno || EWOULDBLOCK == errno)
+        {
+            stats_add(&stats_local()->read_eagain, 1);
+        }
+        else
+        {
+            // ECONNRESET 等错误：连接已经不可用
+            LOG_WARN("read from %s failed: %s", info->id, strerror(errno));
+            state = CONN_CLOSED;
+        }
+    } while (0 < read_byte);
+
+    if (CONN_DRAINING == state)
+        atomic_store_explicit(&info->conn_state, CONN_DRAINING, memory_order_relaxed);
+    if (0 <= result)
+    {
+        result = CQuery_parse_message(info);
+        if (0 <= result)
+            msg_count += result;
     }
 
-    // 检查 TCP 状态是否为 `TCP_CLOSE` 或 `TCP_CLOSE_WAIT`
-    // 表示客户端已经断开连接或即将断开连接
-    if (tcpinfo.tcpi_state == TCP_CLOSE || tcpinfo.tcpi_state == TCP_CLOSE_WAIT)
+    // 对端已经关闭或者出错（包括解析时发现消息超长）：已经收到的完整消息都已入队，拆除连接
+    if (CONN_OPEN != state || (events & EPOLLERR) || MESSAGE_TOO_LONG == result)
     {
-        // 从 epoll 中删除该套接字的监听
-        epoll_ctl(g_recv_epoll_fd, EPOLL_CTL_DEL, socketfd, NULL);
-        epoll_ctl(g_send_epoll_fd, EPOLL_CTL_DEL, socketfd, NULL);
+        close_connection(info, epoll_fd);
+        return -1;
+    }
+    rcv_release(info, false);
+    return 0 > result ? result : msg_count;
+}
 
-        // 根据套接字文件描述符获取对应的玩家信息
-        player_info *info = get_player_info_by_sock(socketfd);
-        if (info)
+/**
+ * @brief 把 io_uring multishot recv 收到的一段数据追加到玩家的接收缓冲区中并解析（io_uring 后端）。
+ *
+ * provided buffer 在处理完之后就要还给内核，所以这里总是把数据拷贝进 `rcv_buffer`；
+ * 每次最多拷贝缓冲区剩余的空间，拷贝之后立即解析，腾出空间再继续。
+ *
+ * @param info 该连接对应的玩家信息。
+ * @param data 内核填好的接收缓冲区。
+ * @param len 数据长度。
+ * @return 成功时返回解析出并放入 ready 队列的完整消息数；CQuery 耗尽、缓冲区无法腾出空间时
+ * 丢弃剩余数据并返回 RESOURCE_UNAVAILABLE；消息超长时断开连接并返回 MESSAGE_TOO_LONG。
+ */
+int CQuery_recv_buffer(player_info *info, const char *data, int len)
+{
+    int msg_count = 0;
+    stats_add(&stats_local()->read_bytes, len);
+    conn_touch(info);
+    while (len > 0)
+    {
+        struct iovec iov[2];
+        int iov_num = rcv_free_segments(info, iov);
+        if (0 == iov_num)
+        {
+            LOG_WARN("receive buffer of %s is full, drop %d bytes.", info->id, len);
+            return RESOURCE_UNAVAILABLE;
+        }
+        for (int i = 0; i < iov_num && len > 0; i++)
         {
-            // 打印客户端退出信息
-            printf("\033[31m");
-            printf("(server)client quit: ");
-            printf("\033[0m");
-            printCurrentTime();
-            printf("\033[31m");
-            printf("(server)client id: %s, name: %s, socketfd: %d\n", info->id, info->name, info->socketfd);
-            printf("\033[0m");
-
-            // 将玩家标记为不可用
-            info->available = false;
-
-            CQuery *query;
-            // 通知其他玩家有人退出
-            while (NULL == (query = get_free_query()))
-                ;   // 获取空闲的数据请求对象
-            query->m_socket_fd = socketfd;
-            query->m_header.type = SOME_ONE_QUIT;   // 设置消息类型为退出消息
-            CQuery_set_query_buffer(query, info->id, PLAYER_ID_LEN); // 设置消息缓冲区内容为玩家 UUID
-            add_gready_list(query); // 将消息加入等待处理队列
+            int copy_len = len < (int)iov[i].iov_len ? len : (int)iov[i].iov_len;
+            memcpy(iov[i].iov_base, data, copy_len);
+            info->rcv_tail += copy_len;
+            data += copy_len;
+            len -= copy_len;
         }
 
-        // close(socketfd);
-        return -1;
+        int result = CQuery_parse_message(info);
+        if (0 > result)
+            return result;
+        msg_count += result;
     }
+    rcv_release(info, false);
+    return msg_count;
+}
 
-    int read_byte;  // 读取的字节数
-    player_info *info = get_player_info_by_sock(socketfd);  // 获取玩家信息
-
-    // 使用 `read` 函数从套接字读取数据，注意：这里是读到对应玩家的缓冲区之中
-    while (0 < (read_byte = read(socketfd, info->rcv_buffer + info->havent_handle, UNIT_BUFFER_SIZE)))
+/**
+ * @brief 从玩家的接收缓冲区中解析出所有完整的消息，批量放入 ready 队列。
+ *
+ * 两种 I/O 后端共用：数据进入 `rcv_buffer` 之后就由这里按照“消息头 -> 消息体”的状态机切分。
+ * 消息头直接在环形缓冲区中读取；解析出消息头之后就从 slab 中申请好消息体的存储，之后每收到一段消息体，
+ * 立即从环形缓冲区拷贝到 CQuery 中并推进读游标。每个字节只被拷贝一次，缓冲区中的数据也不需要向前挪动，
+ * 而且环形缓冲区只需要放得下一个消息头，消息体的长度不受它的容量限制。
+ *
+ * @return 成功时返回解析出的完整消息数；CQuery 耗尽时返回 RESOURCE_UNAVAILABLE（已经解析出的消息照常入队，
+ * 缓冲区中剩下的数据留到下一次）；消息超过 MAX_QUERY_LEN 时断开连接并返回 MESSAGE_TOO_LONG。
+ */
+int CQuery_parse_message(player_info *info)
+{
+    int msg_count = 0;  // 本次解析出的完整消息数
+    int batch_count = 0;    // 暂存在 ready_batch 之中、还没有放入 ready 队列的消息数
+    CQuery *ready_batch[QUERY_BATCH_NUM];   // 一次读事件可能解析出多条消息，攒起来批量入队
+    int result = 0;
+    stats_thread_t *stats = stats_local();
+
+    // 玩家已经退出，缓冲区中剩下的数据直接丢弃
+    if (!info->available)
     {
-        // 更新未处理的数据长度
-        info->havent_handle += read_byte;
-        // printf("read_byte: %d, havent_hanlde: %d\n", read_byte, havent_handle);
+        info->rcv_head = info->rcv_tail;
+        return 0;
     }
 
-    // 检查 `errno` 是否为 `EAGAIN` 或 `EWOULDBLOCK`
-    // 这表示读取的数据不足或阻塞
-    if (EAGAIN == errno || EWOULDBLOCK == errno)
+    while (true)
     {
-        int have_handle;    // 处理的数据长度
-        bool is_body_handled = false;
-        // 循环处理接收到的消息
-        // info->prepare_to_handle 表示需要处理的数据长度。
-        // info->havent_handle 表示当前接收缓冲区中尚未处理的字节数。
-        // 该 while 循环的目的是确保在缓冲区中有足够的数据可以处理时（prepare_to_handle 小于或等于 havent_handle），继续处理。
-        while (info->prepare_to_handle <= info->havent_handle)
+        uint32_t buffered = info->rcv_tail - info->rcv_head; // 缓冲区中还没有解析的字节数
+        // info->is_header_handled == true 说明消息的头部已经被正确解析，现在需要拷贝消息体。
+        if (info->is_header_handled)
         {
-            // info->is_header_handled == true 说明消息的头部已经被正确解析，现在需要处理消息体。
-            if (info->is_header_handled)
+            CQuery *query = info->query;
+            uint32_t remain = query->m_header.length - info->body_received;
+            uint32_t copy_len = buffered < remain ? buffered : remain;
+            rcv_consume(info, query->m_byte_Query + info->body_received, copy_len);
+            info->body_received += copy_len;
+            if (info->body_received < query->m_header.length)
+                break;  // 消息体还没有收全，等待下一次读事件
+
+            // 消息体收全之后设置 query->m_query_len，并将其暂存到 ready_batch 中，攒够一批之后放入 ready 队列。
+            query->m_query_len = query->m_header.length;
+            if (CLIENT_READY == query->m_header.type && !info->handshake_done)
+                reactor_conn_ready(info);
+            int type = stats_type_index(query->m_header.type);
+            stats_add(&stats->recv_msgs[type], 1);
+            stats_add(&stats->recv_type_bytes[type], query->m_query_len + header_size);
+            ready_batch[batch_count++] = query;
+            if (QUERY_BATCH_NUM == batch_count)
             {
-                // memmove 函数将接收缓冲区中的数据（消息体）移动到 query 对象的 m_byte_Query 字段中。
-                memmove(info->query->m_byte_Query, info->rcv_buffer, info->query->m_header.length);
-                // 然后，将消息体的长度设置为 query->m_query_len，并将其添加到 gready_list 列表中，供后续处理。
-                info->query->m_query_len = info->query->m_header.length;
-                add_gready_list(info->query);
-
-                // 处理完消息体后，将 is_header_handled 标志设置为 false，
-                // 并更新 have_handle 和 prepare_to_handle，准备处理下一个消息头。
-                info->is_header_handled = false;
-                have_handle = info->query->m_header.length;
-                info->prepare_to_handle = header_size;
+                add_gready_list_batch(ready_batch, batch_count);
+                batch_count = 0;
             }
-            else
+            msg_count++;
+
+            // 准备处理下一个消息头
+            info->query = NULL;
+            info->is_header_handled = false;
+            info->body_received = 0;
+        }
+        else
+        {
+            if (buffered < (uint32_t)header_size)
+                break;  // 消息头还没有收全
+
+            // 先在缓冲区中读出消息头但不推进读游标，检查长度之后再申请 CQuery 和消息体的存储，
+            // 任何一步失败时数据都原样留在缓冲区中
+            MessageHeader header;
+            rcv_peek(info, &header, header_size);
+            if ((size_t)header.length + header_size > MAX_QUERY_LEN)
             {
-                // 如果 is_header_handled == false，表示当前还没有处理消息头，因此首先需要获取一个新的 CQuery 对象。
-                if (NULL == (info->query = get_free_query()))
-                    return RESOURCE_UNAVAILABLE;
-                // 之后，将当前套接字描述符赋值给 query->m_socket_fd，
-                // 并使用 memmove 将接收缓冲区中的数据（消息头部）拷贝到 query->m_header。
-                info->query->m_socket_fd = socketfd;
-                memmove(&info->query->m_header, info->rcv_buffer, header_size);
-                // printf("message type: %d, message length: %d\n", header->type, header->length);
- 
-                // 处理完消息头部后，设置 is_header_handled = true，
-                // 并更新 have_handle 和 prepare_to_handle，以准备处理消息体。
-                info->is_header_handled = true;
-                have_handle = header_size;
-                info->prepare_to_handle = info->query->m_header.length;
+                LOG_WARN("message from %s is too long (%u bytes), close connection.", info->id, header.length);
+                COUNT_SYSCALL(1);
+                shutdown(info->socketfd, SHUT_RDWR);
+                CQuery_notify_quit(info);
+                result = MESSAGE_TOO_LONG;
+                break;
             }
-
-            // 通过 memmove，将未处理的字节向缓冲区的前端移动，确保缓冲区紧凑，方便后续继续接收数据。
-            memmove(info->rcv_buffer, info->rcv_buffer + have_handle, info->havent_handle - have_handle);
-            info->havent_handle -= have_handle;
-            // printf("have_handle: %d, havent_handle: %d\n\n", have_handle, havent_handle);
+            CQuery *query = get_free_query();
+            if (NULL == query)
+            {
+                result = RESOURCE_UNAVAILABLE;
+                break;
+            }
+            // 按消息体的长度从 slab 中申请存储，并预留出 handler 原地打包时加上的消息头
+            if (0 != CQuery_reserve(query, header.length + header_size))
+            {
+                add_free_list(query);
+                result = RESOURCE_UNAVAILABLE;
+                break;
+            }
+            query->m_socket_fd = info->socketfd;
+            query->m_header = header;
+            info->rcv_head += header_size;
+            info->query = query;
+            info->is_header_handled = true;
+            info->body_received = 0;
         }
     }
-    else if (-1 == read_byte)
+    // 把剩下的消息一次性放入 ready 队列
+    add_gready_list_batch(ready_batch, batch_count);
+    return 0 > result ? result : msg_count;
+}
+
+/**
+ * @brief 拆除一个连接：把连接推进到 CONN_CLOSED、玩家标记为不可用，并向其他玩家广播 SOME_ONE_QUIT。
+ *
+ * 对端关闭、读取出错、消息超长等所有断开路径都汇集到这里，只有第一次把状态推进到 CONN_CLOSED 的调用生效。
+ *
+ * 拆除在标记玩家不可用之前先为 SOME_ONE_QUIT 持有一个消息计数，handler 转发 SOME_ONE_QUIT 之后才释放
+ * （见 `handle_some_one_quit`）。这样 ready 队列中排在 SOME_ONE_QUIT 前面的消息全部处理完之前计数不会归零，
+ * 之后把计数减到 0 的线程立即回收玩家的 slot、fd 和 UUID 登记（见 `minus_message_count`）。
+ *
+ * SOME_ONE_QUIT 使用连接在 accept 时预留的 CQuery（见 `CQuery_init_connection`），不会因为空闲列表
+ * 暂时耗尽而在 reactor 线程上等待。
+ *
+ * @return 本次调用拆除了连接时返回 true，连接之前已经拆除时返回 false。
+ */
+bool CQuery_notify_quit(player_info *info)
+{
+    if (CONN_CLOSED == atomic_exchange_explicit(&info->conn_state, CONN_CLOSED, memory_order_acq_rel))
+        return false;
+
+    LOG_INFO("client quit, id: %s, name: %s, socketfd: %d, rtt: %u us, jitter: %u us", info->id, info->name,
+             info->socketfd, atomic_load_explicit(&info->rtt_us, memory_order_relaxed),
+             atomic_load_explicit(&info->rtt_jitter_us, memory_order_relaxed));
+    stats_add(&stats_local()->closes, 1);
+    reactor_conn_closed(info);
+
+    // 为 SOME_ONE_QUIT 持有一个计数，必须在标记为不可用之前，否则在途的消息处理完时就会回收
+    plus_message_count(info);
+    // 将玩家标记为不可用
+    info->available = false;
+    // 之后收到的数据都会被丢弃：归还接收缓冲区和正在接收的消息
+    rcv_release(info, true);
+    if (NULL != info->query)
     {
-        // TODO 读取出错逻辑
-        printf("read error: %d\n\n", errno);
-        return SOCKET_ACCEPT_ERROR;
+        add_free_list(info->query);
+        info->query = NULL;
     }
+    info->is_header_handled = false;
+    info->body_received = 0;
 
-    return NO_ERROR;
+    // 通知其他玩家有人退出：取走 accept 时预留的 CQuery
+    CQuery *query = get_reserved_query();
+    if (NULL == query)
+    {
+        // 预留只在 accept 时成对建立，正常情况下不会走到这里；退回为 SOME_ONE_QUIT 持有的计数，让 slot 照常回收
+        LOG_ERROR("no reserved query for quitting client %s, socketfd: %d", info->id, info->socketfd);
+        minus_message_count(info);
+        return true;
+    }
+    query->m_socket_fd = info->socketfd;
+    query->m_header.type = SOME_ONE_QUIT;   // 设置消息类型为退出消息
+    CQuery_set_query_buffer(query, info->id, PLAYER_ID_LEN); // 设置消息缓冲区内容为玩家 UUID
+    add_gready_list(query); // 将消息加入等待处理队列
+    return true;
 }
 
 int CQuery_close_socket(CQuery *query)
@@ -348,9 +686,17 @@ int CQuery_check_socket_err(const CQuery *query)
         return error;
 }
 
-void CQuery_pack_message(CQuery *query)
+/**
+ * @brief 在 `m_byte_Query` 中原地加上消息头，打包之后 `m_query_len` 为消息头 + 消息体的长度。
+ *
+ * @return 成功返回 0；打包之后超过 MAX_QUERY_LEN 或者无法扩容时返回 RESOURCE_UNAVAILABLE，消息保持不变。
+ */
+int CQuery_pack_message(CQuery *query)
 {
+    if (0 != CQuery_reserve(query, (size_t)query->m_query_len + header_size))
+        return RESOURCE_UNAVAILABLE;
     pack_message(query->m_header.type, query->m_byte_Query, &query->m_query_len, query->m_byte_Query);
+    return 0;
 }
 
 bool CQuery_is_sock_ok(const CQuery *query)
@@ -372,8 +718,52 @@ int CQuery_get_socket(CQuery *query)
     return query->m_socket_fd;
 }
 
+/**
+ * @brief 保证 `m_byte_Query` 至少能放下 len 字节，不够时从 g_payload_slab 中换一个更大的块并拷贝原有内容。
+ *
+ * @param len 需要的容量，不能超过 MAX_QUERY_LEN。
+ * @return 成功返回 0，超过 MAX_QUERY_LEN 或者内存分配失败时返回 RESOURCE_UNAVAILABLE，原有的块保持不变。
+ */
+int CQuery_reserve(CQuery *query, size_t len)
+{
+    if (len <= query->m_query_cap)
+        return 0;
+    if (len > MAX_QUERY_LEN)
+        return RESOURCE_UNAVAILABLE;
+
+    size_t capacity;
+    char *buffer = (char *)slab_alloc(&g_payload_slab, len, &capacity);
+    if (NULL == buffer)
+        return RESOURCE_UNAVAILABLE;
+    if (NULL != query->m_byte_Query)
+    {
+        memcpy(buffer, query->m_byte_Query, query->m_query_cap);
+        slab_free(&g_payload_slab, query->m_byte_Query, query->m_query_cap);
+    }
+    query->m_byte_Query = buffer;
+    query->m_query_cap = capacity;
+    return 0;
+}
+
+/**
+ * @brief 把 `m_byte_Query` 还给 g_payload_slab，CQuery 回到空闲队列时调用。
+ */
+void CQuery_release_buffer(CQuery *query)
+{
+    slab_free(&g_payload_slab, query->m_byte_Query, query->m_query_cap);
+    query->m_byte_Query = NULL;
+    query->m_query_cap = 0;
+}
+
+/**
+ * @brief 把 buf_len 字节的消息体拷贝进 `m_byte_Query`，同时预留出之后打包时加上的消息头。
+ *
+ * @return 成功返回 0，空间不足时返回 RESOURCE_UNAVAILABLE。
+ */
 int CQuery_set_query_buffer(CQuery *query, const char *pBuf, int buf_len)
 {
+    if (0 != CQuery_reserve(query, (size_t)buf_len + header_size))
+        return RESOURCE_UNAVAILABLE;
     memmove(query->m_byte_Query, pBuf, buf_len);
     query->m_query_len = buf_len;
 
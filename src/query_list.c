@@ -1,48 +1,93 @@
 #include "query_list.h"
+#include "room.h"
+#include <sched.h>
 
 pthread_mutex_t g_free_list_mutex;
-pthread_mutex_t g_ready_list_mutex;
-pthread_mutex_t g_work_list_mutex;
 
 int init_query_list_lock()
 {
     pthread_mutex_init(&g_free_list_mutex, NULL);
-    pthread_mutex_init(&g_ready_list_mutex, NULL);
-    pthread_mutex_init(&g_work_list_mutex, NULL);
     return 0;
 }
 
 int destroy_query_list_lock()
 {
     pthread_mutex_destroy(&g_free_list_mutex);
-    pthread_mutex_destroy(&g_ready_list_mutex);
-    pthread_mutex_destroy(&g_work_list_mutex);
     return 0;
 }
 
+/*
+ * 空闲列表中的 CQuery 数量，以及其中为已登记的连接预留、只能用于 SOME_ONE_QUIT 的数量。
+ * 每个连接在 accept 时预留一个，拆除时用 `get_reserved_query` 取走，
+ * 所以拆除连接时一定能拿到通知其他玩家的 CQuery，不需要在 reactor 线程上等待其他线程归还。
+ */
+static size_t g_free_num = 0;
+static size_t g_reserved_num = 0;
+
+static CQuery *pop_free_query_locked()
+{
+    CQuery *pQuery = g_pfree_list;
+    g_pfree_list = CQuery_get_next_query(g_pfree_list);
+    if (NULL != g_pfree_list)
+        CQuery_set_pre_query(g_pfree_list, NULL);
+    g_free_num--;
+
+    CQuery_set_pre_query(pQuery, NULL);
+    CQuery_set_next_query(pQuery, NULL);
+    return pQuery;
+}
+
 CQuery *get_free_query()
 {
     CQuery *pQuery = NULL;
     pthread_mutex_lock(&g_free_list_mutex);
-    if (NULL == g_pfree_list)
+    // 预留给连接拆除的部分不能被普通消息占用
+    if (NULL == g_pfree_list || g_free_num <= g_reserved_num)
     {
         pthread_mutex_unlock(&g_free_list_mutex);
         return NULL;
     }
-    pQuery = g_pfree_list;
+    pQuery = pop_free_query_locked();
+    pthread_mutex_unlock(&g_free_list_mutex);
+    return pQuery;
+}
 
-    g_pfree_list = CQuery_get_next_query(g_pfree_list);
-    if (NULL != g_pfree_list)
-        CQuery_set_pre_query(g_pfree_list, NULL);
+bool reserve_free_query()
+{
+    bool reserved = false;
+    pthread_mutex_lock(&g_free_list_mutex);
+    if (g_free_num > g_reserved_num)
+    {
+        g_reserved_num++;
+        reserved = true;
+    }
     pthread_mutex_unlock(&g_free_list_mutex);
+    return reserved;
+}
 
-    CQuery_set_pre_query(pQuery, NULL);
-    CQuery_set_next_query(pQuery, NULL);
+void unreserve_free_query()
+{
+    pthread_mutex_lock(&g_free_list_mutex);
+    g_reserved_num--;
+    pthread_mutex_unlock(&g_free_list_mutex);
+}
+
+CQuery *get_reserved_query()
+{
+    CQuery *pQuery = NULL;
+    pthread_mutex_lock(&g_free_list_mutex);
+    if (NULL != g_pfree_list && 0 < g_reserved_num)
+    {
+        g_reserved_num--;
+        pQuery = pop_free_query_locked();
+    }
+    pthread_mutex_unlock(&g_free_list_mutex);
     return pQuery;
 }
 
 int add_free_list(CQuery *pQuery)
 {
+    CQuery_release_buffer(pQuery);
     pthread_mutex_lock(&g_free_list_mutex);
     CQuery_init(pQuery);
     if (NULL == g_pfree_list)
@@ -58,126 +103,155 @@ int add_free_list(CQuery *pQuery)
         CQuery_set_pre_query(g_pfree_list, pQuery);
         g_pfree_list = pQuery;
     }
+    g_free_num++;
     pthread_mutex_unlock(&g_free_list_mutex);
     return 0;
 }
 
 //========================================
 
-CQuery *get_gready_query()
+/**
+ * @brief 初始化 ready 队列。
+ *
+ * ready 队列是有界的无锁环形队列，由所有接收 reactor 并发写入、handler 线程读出，使用 MPSC 队列；
+ * 每个发送 worker 的 work 队列只由 handler 线程写入、该 worker 读出，使用 SPSC 队列，见 `init_workers`。
+ *
+ * 队列中的元素全部来自 CQuery 池，所以容量不小于 CQuery 总数时队列永远不会满。
+ *
+ * @param capacity 队列容量，通常为 g_query_num。
+ * @return 成功返回 0，内存分配失败返回 -1。
+ */
+int init_query_list_ring(size_t capacity)
 {
-    CQuery *pQuery = NULL;
-    pthread_mutex_lock(&g_ready_list_mutex);
-    if (NULL == g_pready_list)
-    {
-        pthread_mutex_unlock(&g_ready_list_mutex);
-        return NULL;
-    }
-    pQuery = g_pready_list;
+    if (0 != mpsc_ring_init(&g_ready_ring, capacity))
+        return -1;
+    return 0;
+}
 
-    g_pready_list = CQuery_get_next_query(g_pready_list);
-    if (NULL != g_pready_list)
-        CQuery_set_pre_query(g_pready_list, NULL);
+void destroy_query_list_ring()
+{
+    mpsc_ring_destroy(&g_ready_ring);
+}
 
-    pthread_mutex_unlock(&g_ready_list_mutex);
+/**
+ * @brief 初始化 ready 队列的唤醒器（每个 worker 的 work 队列唤醒器在 `init_workers` 中初始化）。
+ *
+ * 队列为空时 handler/sender 线程不再一直空转，而是按照 policy 睡眠在唤醒器的 eventfd 上，
+ * 生产者入队之后通过 `wakeup_notify` 唤醒它们。
+ *
+ * @return 成功返回 0，eventfd 创建失败返回 -1。
+ */
+int init_query_list_wakeup(wait_policy_t policy, int spin_num)
+{
+    if (0 != wakeup_init(&g_ready_wakeup, policy, spin_num))
+        return -1;
+    return 0;
+}
 
-    CQuery_set_pre_query(pQuery, NULL);
-    CQuery_set_next_query(pQuery, NULL);
+void destroy_query_list_wakeup()
+{
+    wakeup_destroy(&g_ready_wakeup);
+}
 
-    return pQuery;
+CQuery *get_gready_query()
+{
+    return (CQuery *)mpsc_ring_pop(&g_ready_ring);
+}
+
+size_t get_gready_queries(CQuery **queries, size_t max_num)
+{
+    return mpsc_ring_pop_batch(&g_ready_ring, (void **)queries, max_num);
 }
 
 int add_gready_list(CQuery *pQuery)
 {
-    pthread_mutex_lock(&g_ready_list_mutex);
-    if (NULL == g_pready_list)
-    {
-        CQuery_set_pre_query(pQuery, NULL);
-        CQuery_set_next_query(pQuery, NULL);
+    return add_gready_list_batch(&pQuery, 1);
+}
 
-        g_pready_list = pQuery;
-        g_pready_list_tail = pQuery;
+/**
+ * @brief 批量把 CQuery 放入 ready 队列，可以被多个 reactor 同时调用。
+ *
+ * 理论上队列不会满（见 init_query_list_ring），万一满了就让出 CPU 等待 handler 消费。
+ * 入队完成后如果 handler 正在睡眠则将其唤醒，一批只唤醒一次。
+ * 第一次入队的 CQuery 记下入队时刻，作为之后各阶段耗时的起点；迁移之后回到 ready 队列的保留原来的时刻。
+ */
+int add_gready_list_batch(CQuery **queries, size_t num)
+{
+    if (0 < num)
+    {
+        uint64_t now = stats_now_ns();
+        for (size_t i = 0; i < num; i++)
+            if (0 == queries[i]->m_recv_ns)
+                queries[i]->m_recv_ns = now;
     }
-    else
+    size_t have_add = 0;
+    while (have_add < num)
     {
-        CQuery_set_pre_query(pQuery, g_pready_list_tail);
-        CQuery_set_next_query(pQuery, NULL);
-        CQuery_set_next_query(g_pready_list_tail, pQuery);
-
-        g_pready_list_tail = pQuery;
+        have_add += mpsc_ring_push_batch(&g_ready_ring, (void **)queries + have_add, num - have_add);
+        if (have_add < num)
+            sched_yield();
     }
-    pthread_mutex_unlock(&g_ready_list_mutex);
+    wakeup_notify(&g_ready_wakeup);
     return 0;
 }
 
-CQuery *get_gwork_query()
+CQuery *get_gwork_query(worker_t *worker)
 {
-    CQuery *pQuery = NULL;
-    pthread_mutex_lock(&g_work_list_mutex);
-    if (NULL == g_pwork_list)
-    {
-        pthread_mutex_unlock(&g_work_list_mutex);
-        return NULL;
-    }
-    pQuery = g_pwork_list;
+    return (CQuery *)spsc_ring_pop(&worker->work_ring);
+}
 
-    g_pwork_list = CQuery_get_next_query(g_pwork_list);
-    if (NULL != g_pwork_list)
-        CQuery_set_pre_query(g_pwork_list, NULL);
-    pthread_mutex_unlock(&g_work_list_mutex);
+size_t get_gwork_queries(worker_t *worker, CQuery **queries, size_t max_num)
+{
+    return spsc_ring_pop_batch(&worker->work_ring, (void **)queries, max_num);
+}
 
-    CQuery_set_pre_query(pQuery, NULL);
-    CQuery_set_next_query(pQuery, NULL);
-    return pQuery;
+/**
+ * @brief 选择处理一个 CQuery 的发送 worker。
+ *
+ * 房间内的广播（GAME_UPDATE、SOME_ONE_JOIN、SOME_ONE_QUIT）交给负责该房间的 worker，
+ * 其他消息（单发的回复、迁移请求）交给玩家发送队列当前所属的 worker。
+ */
+static worker_t *route_query(CQuery *pQuery)
+{
+    player_info *player = get_player_info_by_sock(pQuery->m_socket_fd);
+    if (NULL == player)
+        return &g_workers[0];
+    int type = pQuery->m_header.type;
+    room_t *room = get_room(player->room);
+    if (NULL != room && (GAME_UPDATE == type || SOME_ONE_JOIN == type || SOME_ONE_QUIT == type))
+        return &g_workers[room->worker];
+    return &g_workers[atomic_load_explicit(&player->worker, memory_order_acquire)];
 }
 
 int add_gwork_list(CQuery *pQuery)
 {
-    pthread_mutex_lock(&g_work_list_mutex);
-    if (NULL == g_pwork_list)
-    {
-        CQuery_set_pre_query(pQuery, NULL);
-        CQuery_set_next_query(pQuery, NULL);
-
-        g_pwork_list = pQuery;
-        g_pwork_list_tail = pQuery;
-    }
-    else
-    {
-        CQuery_set_pre_query(pQuery, g_pwork_list_tail);
-        CQuery_set_next_query(pQuery, NULL);
-        CQuery_set_next_query(g_pwork_list_tail, pQuery);
-
-        g_pwork_list_tail = pQuery;
-    }
-    pthread_mutex_unlock(&g_work_list_mutex);
-    return 0;
+    return add_gwork_list_batch(route_query(pQuery), &pQuery, 1);
 }
 
-int del_gwork_list(CQuery *pQuery)
+/**
+ * @brief 批量把 CQuery 放入指定 worker 的 work 队列，只能由 handler 线程调用。
+ *
+ * 入队之前记下处理完成的时刻，并把 handler 处理的耗时记入统计。
+ */
+int add_gwork_list_batch(worker_t *worker, CQuery **queries, size_t num)
 {
-    pthread_mutex_lock(&g_work_list_mutex);
-    if (NULL != CQuery_get_pre_query(pQuery))
+    if (0 < num)
     {
-        // pQuery->get_pre_query()->set_next_query(pQuery->get_next_query());
-        CQuery *pre_query = CQuery_get_pre_query(pQuery);
-        CQuery *next_query = CQuery_get_next_query(pQuery);
-        CQuery_set_next_query(pre_query, next_query);
+        uint64_t now = stats_now_ns();
+        for (size_t i = 0; i < num; i++)
+        {
+            queries[i]->m_handled_ns = now;
+            if (0 != queries[i]->m_ready_ns)
+                stats_record(STATS_STAGE_READY_HANDLED, now - queries[i]->m_ready_ns);
+        }
     }
-    else
+    size_t have_add = 0;
+    while (have_add < num)
     {
-        // g_pwork_list = pQuery->get_next_query();
-        g_pwork_list = CQuery_get_next_query(pQuery);
+        have_add += spsc_ring_push_batch(&worker->work_ring, (void **)queries + have_add, num - have_add);
+        if (have_add < num)
+            sched_yield();
     }
-    if (NULL != CQuery_get_next_query(pQuery))
-    {
-        // pQuery->get_next_query()->set_pre_query(pQuery->get_pre_query());
-        CQuery *next_query = CQuery_get_next_query(pQuery);
-        CQuery *pre_query = CQuery_get_pre_query(pQuery);
-        CQuery_set_pre_query(next_query, pre_query);
-    }
-    pthread_mutex_unlock(&g_work_list_mutex);
-    CQuery_set_pre_query(pQuery, NULL);
-    CQuery_set_next_query(pQuery, NULL);
+    wakeup_notify(&worker->work_wakeup);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,210 @@
+#include "reactor.h"
+#include "recv_res.h"
+#include "uring_backend.h"
+#include "player_info_array.h"
+#include <unistd.h>
+
+_Thread_local reactor_t *tls_reactor = NULL;
+
+/**
+ * @brief 按照 g_pconf 中的配置创建所有接收 reactor。
+ *
+ * 每个 reactor 拥有自己的 epoll 实例，并把自己的监听套接字注册进去：
+ * - LISTEN_REUSEPORT：每个 reactor 的监听套接字互不相同，内核按四元组哈希把新连接分给不同的套接字；
+ * - LISTEN_EXCLUSIVE：所有 reactor 共享同一个监听套接字，带上 EPOLLEXCLUSIVE 之后，
+ *   一个新连接只会唤醒其中一个 reactor，避免惊群。
+ *
+ * io_uring 后端不使用 epoll，每个 reactor 改为创建自己的 io_uring 实例，监听套接字上的 multishot accept
+ * 在接收线程启动之后挂上（见 `uring_recv_main`）。
+ *
+ * @return 成功返回 0，epoll / io_uring 创建或注册失败返回 -1。
+ */
+int init_reactors()
+{
+    g_reactor_num = g_pconf->reactor_num;
+    for (int i = 0; i < g_reactor_num; i++)
+    {
+        reactor_t *reactor = &g_reactors[i];
+        reactor->id = i;
+        reactor->listen_socket = g_pconf->listen_sockets[i];
+        atomic_init(&reactor->accept_count, 0);
+        atomic_init(&reactor->recv_msg_count, 0);
+        timer_wheel_init(&reactor->timers, stats_now_ns() / 1000000);
+        reactor->epoll_fd = -1;
+
+#ifdef HAVE_IO_URING
+        if (IO_BACKEND_URING == g_pconf->io_backend)
+        {
+            if (0 > uring_reactor_init(reactor))
+                return -1;
+            continue;
+        }
+#endif
+        if (0 > (reactor->epoll_fd = epoll_create(MAX_EPOLL_EVENT)))
+            return -1;
+
+        struct epoll_event ep_evt;
+        ep_evt.events = EPOLLIN | EPOLLET;
+        if (LISTEN_EXCLUSIVE == g_pconf->listen_mode)
+            ep_evt.events |= EPOLLEXCLUSIVE;
+        ep_evt.data.ptr = reactor;  // 连接的事件携带 player_info 指针，监听套接字的事件携带 reactor 指针
+        if (0 > epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->listen_socket, &ep_evt))
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 为每个 reactor 启动一个接收线程，epoll 后端运行 `recv_res_main`，io_uring 后端运行 `uring_recv_main`。
+ *
+ * @return 成功返回 0，线程创建失败返回 -1。
+ */
+int start_reactors()
+{
+    void *(*reactor_main)(void *) = recv_res_main;
+#ifdef HAVE_IO_URING
+    if (IO_BACKEND_URING == g_pconf->io_backend)
+        reactor_main = uring_recv_main;
+#endif
+    for (int i = 0; i < g_reactor_num; i++)
+    {
+        if (0 != pthread_create(&g_reactors[i].pid, NULL, reactor_main, &g_reactors[i]))
+            return -1;
+    }
+    return 0;
+}
+
+void join_reactors()
+{
+    for (int i = 0; i < g_reactor_num; i++)
+        pthread_join(g_reactors[i].pid, NULL);
+}
+
+void destroy_reactors()
+{
+    for (int i = 0; i < g_reactor_num; i++)
+    {
+#ifdef HAVE_IO_URING
+        if (IO_BACKEND_URING == g_pconf->io_backend)
+            uring_reactor_destroy(&g_reactors[i]);
+#endif
+        if (0 <= g_reactors[i].epoll_fd)
+            close(g_reactors[i].epoll_fd);
+    }
+}
+
+/*
+ * 连接的定时器。
+ *
+ * 每个 reactor 用自己的时间轮管理自己 accept 进来的连接，定时器的添加、触发和取消都在接收线程上完成，不需要加锁：
+ * - accept 之后挂上握手定时器，HANDSHAKE_TIMEOUT_MS 之内没有收到 CLIENT_READY 就断开（只发来半个握手的连接、
+ *   握手中途掉线的半开连接）；
+ * - 收到 CLIENT_READY 时改为空闲定时器（心跳截止时间，`-k`，默认 DEFAULT_IDLE_TIMEOUT 秒），`-k 0` 时取消。
+ *   连接每次收到数据（任何消息，包括 PONG）只记下时间轮的缓存时间，UDP 线程记下最近一次收到数据报的时刻，都不动定时器；
+ *   定时器到期时如果期间收到过数据就按最后一次收到数据的时刻重新添加，否则断开，走和对端关闭相同的拆除流程。
+ *   所以每个连接每个超时周期只有 O(1) 次时间轮操作，与收到的消息数无关；
+ * - 连接拆除时（`CQuery_notify_quit`）取消定时器。
+ */
+
+/* 断开一个超时的连接：shutdown 让对端立刻感知，再走和对端关闭相同的拆除流程 */
+static void evict_connection(reactor_t *reactor, player_info *info, const char *reason)
+{
+    LOG_INFO("(reactor %d) evict %s (socketfd %d, rtt %u us): %s.", reactor->id, info->id, info->socketfd,
+             atomic_load_explicit(&info->rtt_us, memory_order_relaxed), reason);
+    stats_add(&stats_local()->evictions, 1);
+    COUNT_SYSCALL(1);
+    shutdown(info->socketfd, SHUT_RDWR);
+    if (0 <= reactor->epoll_fd)
+    {
+        COUNT_SYSCALL(1);
+        epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, info->socketfd, NULL);
+    }
+    CQuery_notify_quit(info);
+}
+
+static void on_conn_timer(timer_node_t *node, void *arg)
+{
+    reactor_t *reactor = (reactor_t *)arg;
+    player_info *info = (player_info *)((char *)node - offsetof(player_info, timer));
+    if (!info->handshake_done)
+    {
+        evict_connection(reactor, info, "handshake timeout");
+        return;
+    }
+    if (0 == g_pconf->idle_timeout)
+        return;
+    // 绑定了 UDP 通道的客户端可能只通过 UDP 上报状态，最近一次从 UDP 收到数据也算活跃
+    uint64_t last_recv_ms = info->last_recv_ms;
+    uint64_t udp_recv_ms = atomic_load_explicit(&info->udp_recv_ms, memory_order_relaxed);
+    if (udp_recv_ms > last_recv_ms)
+        last_recv_ms = udp_recv_ms;
+    uint64_t deadline = last_recv_ms + (uint64_t)g_pconf->idle_timeout * 1000;
+    if (deadline <= reactor->timers.now_ms)
+        evict_connection(reactor, info, "idle timeout");
+    else
+        timer_wheel_add(&reactor->timers, node, deadline);
+}
+
+/**
+ * @brief 新连接登记之后调用（在 accept 它的接收线程上），挂上握手定时器。
+ */
+void reactor_conn_open(struct info_table *info)
+{
+    reactor_t *reactor = tls_reactor;
+    info->handshake_done = false;
+    if (NULL == reactor)
+        return;
+    info->last_recv_ms = reactor->timers.now_ms;
+    timer_wheel_add(&reactor->timers, &info->timer, reactor->timers.now_ms + HANDSHAKE_TIMEOUT_MS);
+}
+
+/**
+ * @brief 收到 CLIENT_READY 时调用（在接收该连接的线程上），握手定时器换成空闲定时器，不检查空闲时直接取消。
+ */
+void reactor_conn_ready(struct info_table *info)
+{
+    reactor_t *reactor = tls_reactor;
+    info->handshake_done = true;
+    if (NULL == reactor)
+        return;
+    if (0 == g_pconf->idle_timeout)
+        timer_wheel_cancel(&reactor->timers, &info->timer);
+    else
+        timer_wheel_add(&reactor->timers, &info->timer, info->last_recv_ms + (uint64_t)g_pconf->idle_timeout * 1000);
+}
+
+/**
+ * @brief 连接拆除时调用（在接收该连接的线程上），取消它的定时器，之后 slot 可以安全地交给新连接。
+ */
+void reactor_conn_closed(struct info_table *info)
+{
+    if (NULL != tls_reactor)
+        timer_wheel_cancel(&tls_reactor->timers, &info->timer);
+}
+
+/**
+ * @brief 接收线程每轮循环调用一次：推进时间轮，断开超时的连接。
+ *
+ * @return 下一次等待事件的超时时间（毫秒）：有定时器时为一格，保证定时器按时触发；否则为 TIME_OUT。
+ */
+int reactor_expire_timers(reactor_t *reactor)
+{
+    timer_wheel_advance(&reactor->timers, stats_now_ns() / 1000000, on_conn_timer, reactor);
+    return 0 < reactor->timers.count ? TIMER_WHEEL_TICK_MS : TIME_OUT;
+}
+
+uint64_t get_reactors_accept_count()
+{
+    uint64_t count = 0;
+    for (int i = 0; i < g_reactor_num; i++)
+        count += atomic_load_explicit(&g_reactors[i].accept_count, memory_order_relaxed);
+    return count;
+}
+
+uint64_t get_reactors_recv_msg_count()
+{
+    uint64_t count = 0;
+    for (int i = 0; i < g_reactor_num; i++)
+        count += atomic_load_explicit(&g_reactors[i].recv_msg_count, memory_order_relaxed);
+    return count;
+}
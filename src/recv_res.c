@@ -1,55 +1,60 @@
 #include "recv_res.h"
 #include "util.h"
 
-void *recv_res_main(void *)
+/**
+ * @brief 接收 reactor 的主循环，每个 reactor 一个线程。
+ *
+ * 每个 reactor 只等待自己的 epoll 实例，负责自己的监听套接字上的新连接以及
+ * 由自己 accept 进来的连接上的读事件，不同的 reactor 之间互不干扰。
+ *
+ * @param arg 指向该线程负责的 `reactor_t`。
+ */
+void *recv_res_main(void *arg)
 {
+    reactor_t *reactor = (reactor_t *)arg;
     // 这里定义了一个 epoll_event 数组 ep_evt，用来存储 epoll_wait 返回的事件信息。
     struct epoll_event ep_evt[MAX_EPOLL_EVENT];
+    stats_register(STATS_THREAD_REACTOR, reactor->id);
+    tls_reactor = reactor;
+    int timeout = TIME_OUT;
 
     // 函数的核心逻辑是一个循环，不断调用 epoll_wait，直到全局变量 g_over 被置为真才退出循环
     while (!g_over)
     {
-        // epoll_wait 函数监听文件描述符 g_recv_epoll_fd，
-        // 最多返回 MAX_EPOLL_EVENT 个就绪事件，超时时间为 TIME_OUT 毫秒。
-        int ready_num = epoll_wait(g_recv_epoll_fd, ep_evt, MAX_EPOLL_EVENT, TIME_OUT);
+        // epoll_wait 函数监听该 reactor 的 epoll 实例，
+        // 最多返回 MAX_EPOLL_EVENT 个就绪事件；有连接的定时器时最多等待时间轮的一格，否则为 TIME_OUT 毫秒。
+        COUNT_SYSCALL(1);
+        int ready_num = epoll_wait(reactor->epoll_fd, ep_evt, MAX_EPOLL_EVENT, timeout);
+        // 先推进时间轮，断开握手或者空闲超时的连接，之后处理事件时时间轮的缓存时间就是当前时刻
+        timeout = reactor_expire_timers(reactor);
         // ready_num 是就绪事件的数量，如果返回值大于 0，表示有可处理的事件；
         // 如果返回 0，则表示超时；如果返回 -1，则发生了错误。
-        printf("recv event num: %d.\n", ready_num);
+        LOG_DEBUG("(reactor %d) recv event num: %d.", reactor->id, ready_num);
 
-        // if (ready_num > 0)
-        // {
-        //     printf("%s", "recv_res_main: epoll_wait success.");
-        //     printf("--recv event num: %d.--", ready_num);
-        //     printCurrentTime();
-        // }
-
-        // for 循环会遍历所有返回的就绪事件，并判断是否是读事件（EPOLLIN）。读事件表示文件描述符有数据可读。
+        // for 循环会遍历所有返回的就绪事件：监听套接字上的读事件表示有新连接，
+        // 连接上的 EPOLLIN / EPOLLRDHUP / EPOLLHUP / EPOLLERR 都交给 `CQuery_recv_message`。
         for (int i = 0; i < ready_num; i++)
         { /*循环处理每个就绪的事件*/
-            if (ep_evt[i].events & EPOLLIN)
-            { /*读事件*/
-                if (ep_evt[i].data.fd == g_pconf->listen_socket)
-                { /*有新的连接请求*/
-                    int result;
-                    while (0 == (result = CQuery_accept_tcp_connect(g_pconf->listen_socket)))
-                        ;
-                    printAcceptError(result);
-                } /*有新的连接请求*/
-                else
-                { /*有新的数据可读*/
-                    // printf("\033[32m%s\033[0m", "recv_res_main: recv new message.\n");
-                    CQuery_recv_message(ep_evt[i].data.fd);
-                } /*有新的数据可读*/
-            }
+            if (ep_evt[i].data.ptr == reactor)
+            { /*有新的连接请求*/
+                if (!(ep_evt[i].events & EPOLLIN))
+                {
+                    LOG_ERROR("(reactor %d) unexpected events %u on listen socket.", reactor->id, ep_evt[i].events);
+                    continue;
+                }
+                int result;
+                while (0 == (result = CQuery_accept_tcp_connect(reactor->listen_socket, reactor->epoll_fd)))
+                    atomic_fetch_add_explicit(&reactor->accept_count, 1, memory_order_relaxed);
+                printAcceptError(result);
+            } /*有新的连接请求*/
             else
-            {
-                printf("\033[31m%s\033[0m", "epoll_wait error.");
-                printCurrentTime();
-                printf("\033[31m%s\033[0m", "debug: error occured in recv_res_main.\n\n");
-                perror("perror: epoll_wait error.");
-            }
+            { /*有新的数据可读，或者对端关闭、连接出错，交给连接的状态机处理*/
+                int result = CQuery_recv_message((player_info *)ep_evt[i].data.ptr, reactor->epoll_fd, ep_evt[i].events);
+                if (result > 0)
+                    atomic_fetch_add_explicit(&reactor->recv_msg_count, result, memory_order_relaxed);
+            } /*有新的数据可读*/
         }
     }
 
     return NULL;
-}
\ No newline at end of file
+}
@@ -0,0 +1,234 @@
+#include "ring_queue.h"
+#include <stdlib.h>
+
+// 把容量向上取整到 2 的幂，这样取模可以用位与代替
+static size_t round_up_pow2(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    return size;
+}
+
+/**
+ * @brief 初始化一个 MPSC 环形队列。
+ *
+ * 采用 Dmitry Vyukov 的有界队列算法：每个槽位带一个序号 seq，
+ * - seq == pos        表示该槽位在第 pos 个位置上是空的，生产者可以写入；
+ * - seq == pos + 1    表示该槽位已经写入数据，消费者可以读取；
+ * - 消费者读取之后把 seq 置为 pos + 容量，留给下一轮的生产者。
+ *
+ * @param ring 需要初始化的队列。
+ * @param capacity 期望的容量，会被向上取整到 2 的幂。
+ * @return 成功返回 0，内存分配失败返回 -1。
+ */
+int mpsc_ring_init(mpsc_ring *ring, size_t capacity)
+{
+    size_t size = round_up_pow2(capacity);
+    ring->cells = (ring_cell *)malloc(sizeof(ring_cell) * size);
+    if (NULL == ring->cells)
+        return -1;
+
+    ring->mask = size - 1;
+    for (size_t i = 0; i < size; i++)
+    {
+        atomic_init(&ring->cells[i].seq, i);
+        ring->cells[i].data = NULL;
+    }
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    return 0;
+}
+
+void mpsc_ring_destroy(mpsc_ring *ring)
+{
+    free(ring->cells);
+    ring->cells = NULL;
+}
+
+/**
+ * @brief 向 MPSC 队列中放入一个元素，可以被多个线程同时调用。
+ *
+ * @return 成功返回 0，队列已满返回 -1。
+ */
+int mpsc_ring_push(mpsc_ring *ring, void *item)
+{
+    return (1 == mpsc_ring_push_batch(ring, &item, 1)) ? 0 : -1;
+}
+
+/**
+ * @brief 向 MPSC 队列中批量放入元素，可以被多个线程同时调用。
+ *
+ * 只用一次 CAS 就把连续的 num 个槽位一起占下来，然后逐个写入并发布。
+ * 由于消费者总是按顺序释放槽位，只要第 pos + k 个槽位是空的，它前面的槽位也一定是空的。
+ *
+ * @param items 待入队的元素数组。
+ * @param num 元素个数。
+ * @return 实际入队的元素个数（队列剩余空间不足时可能小于 num，队列已满时为 0）。
+ */
+size_t mpsc_ring_push_batch(mpsc_ring *ring, void **items, size_t num)
+{
+    size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t count;
+    for (;;)
+    {
+        // 统计从 pos 开始有多少个连续的空槽位
+        count = 0;
+        while (count < num)
+        {
+            ring_cell *cell = &ring->cells[(pos + count) & ring->mask];
+            if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + count)
+                break;
+            count++;
+        }
+
+        if (0 == count)
+        {
+            ring_cell *cell = &ring->cells[pos & ring->mask];
+            size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+            if ((long)(seq - pos) < 0)
+                return 0; // 槽位还没有被消费者释放，队列已满
+            // 其他生产者已经占用了这个位置，重新读取 tail
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+            continue;
+        }
+
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + count,
+                                                  memory_order_relaxed, memory_order_relaxed))
+            break;
+        // CAS 失败时 pos 已经被更新为最新的 tail，重新统计
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ring_cell *cell = &ring->cells[(pos + i) & ring->mask];
+        cell->data = items[i];
+        atomic_store_explicit(&cell->seq, pos + i + 1, memory_order_release);
+    }
+    return count;
+}
+
+/**
+ * @brief 从 MPSC 队列中取出一个元素，只能由唯一的消费者线程调用。
+ *
+ * @return 队首元素，队列为空时返回 NULL。
+ */
+void *mpsc_ring_pop(mpsc_ring *ring)
+{
+    void *item = NULL;
+    return (1 == mpsc_ring_pop_batch(ring, &item, 1)) ? item : NULL;
+}
+
+/**
+ * @brief 从 MPSC 队列中批量取出元素，只能由唯一的消费者线程调用。
+ *
+ * 遇到还没有发布完成的槽位就停止，保证取出的元素始终保持入队顺序。
+ *
+ * @param items 用于存放取出元素的数组。
+ * @param max_num 最多取出的元素个数。
+ * @return 实际取出的元素个数。
+ */
+size_t mpsc_ring_pop_batch(mpsc_ring *ring, void **items, size_t max_num)
+{
+    size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t count = 0;
+    while (count < max_num)
+    {
+        ring_cell *cell = &ring->cells[(pos + count) & ring->mask];
+        if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + count + 1)
+            break;
+        items[count] = cell->data;
+        // 把槽位留给下一轮（pos + 容量）的生产者
+        atomic_store_explicit(&cell->seq, pos + count + ring->mask + 1, memory_order_release);
+        count++;
+    }
+    if (count > 0)
+        atomic_store_explicit(&ring->head, pos + count, memory_order_relaxed);
+    return count;
+}
+
+// 队列中元素个数的近似值，只用于统计
+size_t mpsc_ring_size(mpsc_ring *ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    return (tail > head) ? tail - head : 0;
+}
+
+//========================================
+
+int spsc_ring_init(spsc_ring *ring, size_t capacity)
+{
+    size_t size = round_up_pow2(capacity);
+    ring->cells = (void **)calloc(size, sizeof(void *));
+    if (NULL == ring->cells)
+        return -1;
+
+    ring->mask = size - 1;
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    return 0;
+}
+
+void spsc_ring_destroy(spsc_ring *ring)
+{
+    free(ring->cells);
+    ring->cells = NULL;
+}
+
+int spsc_ring_push(spsc_ring *ring, void *item)
+{
+    return (1 == spsc_ring_push_batch(ring, &item, 1)) ? 0 : -1;
+}
+
+/**
+ * @brief 向 SPSC 队列中批量放入元素，只能由唯一的生产者线程调用。
+ *
+ * 先写入所有槽位，最后用一次 release 写 tail 把它们一起发布给消费者。
+ *
+ * @return 实际入队的元素个数。
+ */
+size_t spsc_ring_push_batch(spsc_ring *ring, void **items, size_t num)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t free_num = ring->mask + 1 - (tail - head);
+    size_t count = (num < free_num) ? num : free_num;
+
+    for (size_t i = 0; i < count; i++)
+        ring->cells[(tail + i) & ring->mask] = items[i];
+    if (count > 0)
+        atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    return count;
+}
+
+void *spsc_ring_pop(spsc_ring *ring)
+{
+    void *item = NULL;
+    return (1 == spsc_ring_pop_batch(ring, &item, 1)) ? item : NULL;
+}
+
+/**
+ * @brief 从 SPSC 队列中批量取出元素，只能由唯一的消费者线程调用。
+ *
+ * @return 实际取出的元素个数。
+ */
+size_t spsc_ring_pop_batch(spsc_ring *ring, void **items, size_t max_num)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t count = (tail - head < max_num) ? tail - head : max_num;
+
+    for (size_t i = 0; i < count; i++)
+        items[i] = ring->cells[(head + i) & ring->mask];
+    if (count > 0)
+        atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    return count;
+}
+
+size_t spsc_ring_size(spsc_ring *ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    return tail - head;
+}
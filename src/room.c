@@ -0,0 +1,114 @@
+#include "room.h"
+
+/**
+ * @brief 初始化所有房间，房间 i 由 i % worker_num 号 worker 负责。
+ *
+ * @return 总是返回 0。
+ */
+int init_rooms(int worker_num)
+{
+    for (int i = 0; i < MAX_ROOM_NUM; i++)
+    {
+        room_t *room = &g_rooms[i];
+        room->id = i;
+        room->worker = i % worker_num;
+        pthread_mutex_init(&room->lock, NULL);
+        room->member_head = -1;
+        room->member_num = 0;
+        room->tick_head = -1;
+        room->in_tick_list = false;
+        room->snapshots = NULL;
+    }
+    return 0;
+}
+
+void destroy_rooms()
+{
+    for (int i = 0; i < MAX_ROOM_NUM; i++)
+    {
+        pthread_mutex_destroy(&g_rooms[i].lock);
+        if (NULL != g_rooms[i].snapshots)
+        {
+            snapshot_history_destroy(g_rooms[i].snapshots);
+            free(g_rooms[i].snapshots);
+            g_rooms[i].snapshots = NULL;
+        }
+    }
+}
+
+/**
+ * @brief 根据房间号取得房间。
+ *
+ * @return 房间号合法时返回房间，否则返回 NULL。
+ */
+room_t *get_room(int room_id)
+{
+    if (0 > room_id || room_id >= MAX_ROOM_NUM)
+        return NULL;
+    return &g_rooms[room_id];
+}
+
+/**
+ * @brief 把玩家加入房间的成员链表，已经在房间中时什么都不做。由负责该房间的 worker 调用。
+ */
+void room_join(room_t *room, player_info *player)
+{
+    pthread_mutex_lock(&room->lock);
+    if (!player->in_room)
+    {
+        player->room_prev = -1;
+        player->room_next = room->member_head;
+        if (-1 != room->member_head)
+            player_infos.slots[room->member_head].room_prev = player->slot;
+        room->member_head = player->slot;
+        room->member_num++;
+        player->in_room = true;
+    }
+    pthread_mutex_unlock(&room->lock);
+}
+
+/**
+ * @brief 把玩家从所在房间的成员链表中摘除，玩家从注册表中删除时调用，调用方需要持有注册表锁。
+ */
+void room_leave(player_info *player)
+{
+    room_t *room = get_room(player->room);
+    if (NULL == room)
+        return;
+    pthread_mutex_lock(&room->lock);
+    if (player->in_room)
+    {
+        if (-1 != player->room_prev)
+            player_infos.slots[player->room_prev].room_next = player->room_next;
+        else
+            room->member_head = player->room_next;
+        if (-1 != player->room_next)
+            player_infos.slots[player->room_next].room_prev = player->room_prev;
+        room->member_num--;
+        player->in_room = false;
+    }
+    pthread_mutex_unlock(&room->lock);
+}
+
+/**
+ * @brief 获取房间当前所有成员的快照，用于房间内的群发，和 `get_player_info_snapshot` 一样不需要分配内存。
+ *
+ * @return 实际写入的玩家数。
+ */
+int room_snapshot(room_t *room, player_info **players, int max_num)
+{
+    int num = 0;
+    pthread_mutex_lock(&room->lock);
+    for (int s = room->member_head; -1 != s && num < max_num; s = player_infos.slots[s].room_next)
+        players[num++] = &player_infos.slots[s];
+    pthread_mutex_unlock(&room->lock);
+    return num;
+}
+
+int room_member_num(room_t *room)
+{
+    pthread_mutex_lock(&room->lock);
+    int num = room->member_num;
+    pthread_mutex_unlock(&room->lock);
+    return num;
+}
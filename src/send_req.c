@@ -1,290 +1,1112 @@
 #include "send_req.h"
 
+static void queue_frame(worker_t *worker, player_info *player, frame_t *frame);
+static void flush_player(worker_t *worker, player_info *player);
+static void flush_dirty_players(worker_t *worker);
+static void release_out_queue(worker_t *worker, player_info *player);
+static void kick_slow_player(worker_t *worker, player_info *player, const char *reason);
+static void publish_queue_depth(player_info *player);
+static void poll_send_events(worker_t *worker, int timeout);
+static void coalesce_update(worker_t *worker, room_t *room, player_info *player, CQuery *query);
+static void emit_snapshots(worker_t *worker);
+static void emit_delta_snapshots(worker_t *worker);
+static void update_interest(worker_t *worker, player_info *player, const char *transform);
+static void check_migrations(worker_t *worker);
+static void send_pings(worker_t *worker);
+#ifdef HAVE_IO_URING
+static void submit_player_sends(worker_t *worker, player_info *player);
+static void handle_send_complete(worker_t *worker, player_info *player, int result);
+#endif
+
 /**
- * @brief 游戏服务器中用于处理发送请求的主函数。
+ * @brief 发送 worker 的主函数，每个 worker 一个线程。
+ * 
+ * 该函数持续处理从服务器向客户端发送的出站数据。每个连接都有一个保存帧引用的发送队列（`out_queue_t`），
+ * 发送分为两个阶段：
+ * - 入队：从 work 队列批量取出若干个数据包，把每个数据包编码后的帧追加到所有接收者的发送队列中，
+ *   此时不做任何系统调用；
+ * - flush：这一批数据包处理完之后，对每个有新帧的连接调用一次 `writev`，把它队列中的所有帧一起写出去，
+ *   这样一个客户端在一批（一个 tick）内收到的所有更新只需要一次系统调用。
+ * 
+ * 如果 `writev` 遇到 `EAGAIN`，队列中剩下的帧（以及队头帧已经写出的偏移量）会保留在发送队列中，
+ * 并在发送 epoll 上注册该连接的可写事件，等可写之后再继续 flush。
+ * 发送队列是有界的，消费得太慢的连接按背压策略替换、丢弃状态帧，积压太久时被断开，见 `queue_frame`，
+ * 所以一个慢客户端不会拖慢同一个房间中的其他玩家。
+ * 
+ * io_uring 后端（`-b uring`）下 flush 不调用 writev，而是把每个连接的帧准备成一条链接在一起的 send，
+ * 所有连接的发送链在下一轮循环开始时由一次 io_uring_enter 提交；发送链在途期间该连接不会再次 flush，
+ * 新入队的帧等这条链完成之后再发送。
+ * 
+ * 群发只发给同一个房间的玩家，房间由固定的 worker 负责，见 `room_t`。玩家连接之后先属于大厅 worker（0 号），
+ * 收到 PLAYER_INFO_CERT 之后如果房间属于别的 worker，就等它的发送队列清空之后迁移过去，见 `check_migrations`。
  * 
- * 该函数持续处理从服务器向客户端发送的出站数据，使用 `epoll_wait` 机制监控处于非阻塞状态的客户端的套接字事件
- * （尤其是之前在写操作中遇到 EAGAIN 错误的客户端）。
+ * 开启了 UDP 通道（`-u`）时，发给已经绑定 UDP 的玩家的 GAME_UPDATE 不进入发送队列，而是攒成数据报，
+ * 和发送队列一起在 flush 时用一次 sendmmsg 发出，见 udp_channel.h。
  * 
- * 函数的主要职责包括：
- * - 处理客户端的部分发送数据并重试写操作。
- * - 管理每个客户端的 `player_info` 数据，更新它们的发送缓冲区，并在数据完全发送后将它们从 epoll 监控中移除。
- * - 处理游戏更新消息、玩家加入/退出通知及其他与游戏相关的事件，并将其分发给相关客户端。
+ * 每隔 `-p` 毫秒向本 worker 负责的房间中的所有玩家发送一次 PING，客户端回复的 PONG 由 handler 用来估计往返时间，
+ * 见 `send_pings`。
  * 
- * 该函数采用循环结构，持续运行直到全局标志 `g_over` 被设置为真，表示服务器应关闭。它还监控是否有玩家处于写阻塞状态
- * （通过 `g_is_write_eagain` 标志），并使用 `epoll` 机制以非阻塞方式处理客户端请求。
+ * 兴趣管理（`-i radius`）开启时 GAME_UPDATE 只发给兴趣半径以内的玩家，见 `handle_interest_send`。
+ * 
+ * tick 模式（`-t tick_rate`）下 GAME_UPDATE 不立即群发，只保留每个玩家最新的一条，
+ * 每到一个 tick 由 `emit_snapshots` 按房间合并成 GAME_SNAPSHOT 广播（`-d` 时由 `emit_delta_snapshots` 下发增量快照）。
+ * 
+ * 该函数采用循环结构，持续运行直到全局标志 `g_over` 被设置为真，表示服务器应关闭。
+ * work 队列为空时，按照 worker 唤醒器的等待策略阻塞在发送 epoll 上，同时等待可写事件、tick 和 handler 的唤醒。
  * 
- * 在套接字通信期间处理错误，对于 `EAGAIN` 和 `EWOULDBLOCK` 情况会重试，而其他错误则使用 `perror` 进行记录。
  * 在遇到致命的套接字错误时，应实现将玩家踢出游戏的逻辑。
  * 
- * @param 无（该函数接收一个 `void` 指针作为参数，但在当前实现中未使用该参数）
+ * 一批中立即转发的数据包在 flush 之后记录从 handler 放入 work 队列到写出、以及端到端的耗时（见 stats.h）；
+ * tick 模式下合并进快照的 GAME_UPDATE 的延迟主要由 tick 间隔决定，不计入统计。
+ * 
+ * @param arg 该线程负责的 `worker_t`。
  * 
  * @return `void*` （该函数返回一个 `void` 指针，但当前实现中从未使用该返回值）
  */
-void *send_req_main(void *)
+void *send_req_main(void *arg)
 {
-    not_right = 0;  // 初始化未完成发送的数据计数
+    worker_t *worker = (worker_t *)arg;
     int tmp_count = 1;  // 用于调试，记录发送请求计数
     CQuery *pQuery = NULL;  // 当前处理的任务请求指针
-    struct epoll_event ep_evt[MAX_EPOLL_EVENT]; // 存储 epoll 事件的数组 
+    CQuery *queries[QUERY_BATCH_NUM];   // 一次从 work 队列中批量取出的任务请求
+    uint64_t sent_recv_ns[QUERY_BATCH_NUM];     // 这一批中立即转发的数据包放入 ready 队列的时刻
+    uint64_t sent_handled_ns[QUERY_BATCH_NUM];  // 以及放入 work 队列的时刻
+    int sent_num;
+
+    int idle_rounds = 0;    // 连续没有取到任务的轮数，用于自适应等待策略
+    stats_register(STATS_THREAD_WORKER, worker->id);
 
     while (!g_over)
     {
-        // printf("\033[32m%s\033[0m, not_right: %d\n", "send_req_main: ", not_right);
-        // 如果有没有完成的发送请求 
-        if (g_is_write_eagain)
-        {   
-            // 等待 epoll事件，超时设置为0表示非阻塞 
-            int ready_num = epoll_wait(g_send_epoll_fd, ep_evt, MAX_EPOLL_EVENT, 0); /*等待事件*/
+        // work 队列为空并且等待策略要求睡眠时，宣告睡眠后再检查一次队列，
+        // 确认仍然为空才阻塞在发送 epoll 上（work 队列的 eventfd 也注册在其中）；
+        // 还有玩家在等待迁移时不睡眠，以便及时交出
+        int timeout = 0;
+        bool parked = false;
+        if (0 == spsc_ring_size(&worker->work_ring) && 0 == worker->migrating_num &&
+            wakeup_should_park(&worker->work_wakeup, &idle_rounds))
+        {
+            wakeup_begin_park(&worker->work_wakeup);
+            parked = true;
+            if (0 == spsc_ring_size(&worker->work_ring))
+            {
+                timeout = WAIT_TIMEOUT_MS;
+                atomic_fetch_add_explicit(&worker->work_wakeup.park_count, 1, memory_order_relaxed);
+            }
+        }
 
-            // 处理每一个就绪的套接字
-            for (int i = 0; i < ready_num; i++)
+        // 处理可写事件（io_uring 后端：提交发送链并处理完成事件），需要睡眠时阻塞在其中等待唤醒
+        poll_send_events(worker, timeout);
+        if (parked)
+            wakeup_end_park(&worker->work_wakeup);
+        worker->now_ns = stats_now_ns();
+
+        // 从 work 队列之中批量取出待发送的数据包
+        size_t query_num = get_gwork_queries(worker, queries, QUERY_BATCH_NUM);
+        stats_set_depth(0 == query_num ? 0 : query_num + spsc_ring_size(&worker->work_ring));
+        if (0 != query_num)
+            idle_rounds = 0;
+        sent_num = 0;
+        for (size_t i = 0; i < query_num; i++)
+        {
+            pQuery = queries[i];
+
+            // 获取该数据包对应的玩家信息 
+            player_info *player = get_player_info_by_sock(pQuery->m_socket_fd);
+            if (player == NULL)
             {
-                int sockfd = ep_evt[i].data.fd; // 获取就绪的套接字
-                player_info *player = get_player_info_by_sock(sockfd);  // 获取对应的 player_info
-                if (player == NULL)
-                {
-                    perror("get_player_info_by_sock");
-                    continue;
-                }
-                if (!player->available) // 假如玩家已经是“等待被删除”状态，则直接跳过 
-                    continue;
-                // ========= ==发送数据==
-                int have_write = write(sockfd, player->snd_buffer, player->havent_send);
-                if (have_write > 0)
-                {
-                    player->havent_send -= have_write;  //更新没有发送数据的大小 
-                    if (player->havent_send > 0)
-                    {
-                        // 将还没有发送完的数据移动到对应player_info的send_buffer中
-                        memmove(player->snd_buffer, player->snd_buffer + have_write, player->havent_send);
-                    }
-                    else
-                    {
-                        // 将该socket从epoll中移除
-                        epoll_ctl(g_send_epoll_fd, EPOLL_CTL_DEL, sockfd, NULL);
-                        not_right--;    // 减少未完成发送的计数 
-                    }
-                }
-                else
+                LOG_WARN("send_req_main: no player for socket %d", pQuery->m_socket_fd);
+                add_free_list(pQuery);
+                continue;
+            }
+            room_t *room = get_room(player->room);
+            int type = pQuery->m_header.type;
+            if (!player->available) // 假如玩家现在已经退出游戏，则释放该数据包以及该玩家还没发出去的帧
+            {
+                // 连接拆除之前收到的 GAME_UPDATE（tick 模式下已经不会再合并）以及拆除时入队的 SOME_ONE_QUIT
+                // 仍然要发给房间中的其他玩家，玩家在从注册表中删除之前一直在房间的成员链表中
+                if (NULL != room && (type == SOME_ONE_QUIT || (type == GAME_UPDATE && !tick_enabled(&worker->tick))))
                 {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK)
-                        continue;
+                    if (type == GAME_UPDATE && interest_enabled(&worker->interest))
+                        handle_interest_send(worker, room, player, pQuery);
                     else
-                    {
-                        // TODO：这里应该将玩家踢出游戏，但是现在还没有实现
-                        perror("write");
-                        continue;
-                    }
+                        handle_group_send(worker, room, player, pQuery);
+                    sent_recv_ns[sent_num] = pQuery->m_recv_ns;
+                    sent_handled_ns[sent_num++] = pQuery->m_handled_ns;
                 }
+                // 必须在减少消息计数之前释放，计数归零之后 slot 随时可能被回收；
+                // 发送队列只能由它所属的 worker 释放，tick 模式下暂存的 GAME_UPDATE 在下一个 tick 释放
+                if (interest_enabled(&worker->interest))
+                    interest_grid_remove(&worker->interest, player->slot);
+                if (worker->id == atomic_load_explicit(&player->worker, memory_order_relaxed))
+                    release_out_queue(worker, player);
+                minus_message_count(player);
+                add_free_list(pQuery);
+                continue;
+            }
+            // 迁移请求：连同它的消息计数一起留到发送队列清空之后再处理
+            if (type == PLAYER_INFO_CERT)
+            {
+                worker->migrating_queries[worker->migrating_num++] = pQuery;
+                continue;
+            }
+            bool broadcast = type == GAME_UPDATE || type == SOME_ONE_JOIN || type == SOME_ONE_QUIT;
+            if (broadcast && NULL == room)  // 还没有进入房间的玩家没有可以转发的对象
+            {
+                minus_message_count(player);
+                add_free_list(pQuery);
+                continue;
+            }
+            // tick 模式下只保留最新的状态，数据包连同它的消息计数一起留到 tick 时再处理
+            if (type == GAME_UPDATE && tick_enabled(&worker->tick))
+            {
+                coalesce_update(worker, room, player, pQuery);
+                continue;
             }
+            // 玩家已经迁移到本 worker，回复 GLOBAL_PLAYER_INFO 之前加入房间，之后房间中的广播都会发给它；
+            // 必须在减少消息计数之前加入，保证玩家从注册表中删除时一定会离开房间
+            if (type == GLOBAL_PLAYER_INFO && NULL != room && room->worker == worker->id)
+                room_join(room, player);
+
+            // 更新玩家消息计数 
+            minus_message_count(player);
+
+            // 根据数据包类型来决定是要群发还是单发，开启兴趣管理时 GAME_UPDATE 只发给附近的玩家
+            if (type == GAME_UPDATE && interest_enabled(&worker->interest))
+                handle_interest_send(worker, room, player, pQuery);
+            else if (broadcast)
+                handle_group_send(worker, room, player, pQuery);
+            else
+            {
+                // 否则就单发 
+                LOG_DEBUG("send_req_main: %d:%d", type, tmp_count++);
+                handle_send(worker, pQuery->m_socket_fd, pQuery);
+            }
+            sent_recv_ns[sent_num] = pQuery->m_recv_ns;
+            sent_handled_ns[sent_num++] = pQuery->m_handled_ns;
+
+            // 数据包已经编码成帧放入发送队列，可以归还了
+            add_free_list(pQuery);
+        }
+
+        // 到达 tick 时把每个房间中玩家最新的状态合并成快照入队
+        if (tick_due(&worker->tick))
+        {
+            if (g_pconf->delta_snapshot)
+                emit_delta_snapshots(worker);
+            else
+                emit_snapshots(worker);
+        }
+        if (0 < g_pconf->ping_interval_ms && worker->now_ns >= worker->next_ping_ns)
+            send_pings(worker);
 
-            // 如果没有未完成的发送任务，将 `g_is_write_eagain` 置为 false
-            if (not_right == 0)
-                g_is_write_eagain = false;
+        // 这一批数据包全部入队之后，每个连接只用一次 writev 写出；
+        // 发送链完成之后还有帧没发完的连接会被重新登记，即使没有新任务也要 flush
+        flush_dirty_players(worker);
+        if (NULL != worker->udp)
+            udp_batch_flush(worker->udp);
+        if (0 < sent_num)
+        {
+            uint64_t written_ns = stats_now_ns();
+            for (int i = 0; i < sent_num; i++)
+            {
+                stats_record(STATS_STAGE_HANDLED_WRITTEN, written_ns - sent_handled_ns[i]);
+                stats_record(STATS_STAGE_END_TO_END, written_ns - sent_recv_ns[i]);
+            }
         }
-        // 从待发送链表之中取一个待发送的数据包 
-        if (NULL == (pQuery = get_gwork_query()))
+        check_migrations(worker);
+
+        // 自旋等待时让出 CPU，避免在单核机器上和 handler 抢时间片
+        if (0 == query_num && !parked)
+            sched_yield();
+    }
+    return NULL;
+}
+
+/**
+ * @brief 向本 worker 负责的房间中的所有玩家发送 PING。
+ *
+ * 一轮中所有玩家共享同一个帧，消息体是本轮循环开始的时刻（单调时钟），客户端原样回复之后由 handler 计算往返时间，
+ * 见 `handle_pong`。PING 和状态帧一样按背压策略替换、丢弃：积压的连接只保留最新的一个 PING，见 `queue_frame`。
+ * 大厅中的玩家（还没有进入房间）不发送。
+ */
+static void send_pings(worker_t *worker)
+{
+    worker->next_ping_ns = worker->now_ns + g_pconf->ping_interval_ms * 1000000ull;
+    char buffer[sizeof(MessageHeader) + PING_LEN];
+    MessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = PING;
+    header.length = sizeof(buffer); // 服务器发出的消息长度包含消息头
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), &worker->now_ns, PING_LEN);
+
+    frame_t *frame = NULL;
+    for (int r = 0; r < MAX_ROOM_NUM; r++)
+    {
+        room_t *room = &g_rooms[r];
+        if (room->worker != worker->id || 0 == room_member_num(room))
             continue;
+        if (NULL == frame && NULL == (frame = frame_create(buffer, sizeof(buffer))))
+        {
+            LOG_ERROR("frame_create failed.");
+            return;
+        }
+        int player_num = room_snapshot(room, worker->players, MAX_CONNECTION_NUM);
+        for (int i = 0; i < player_num; i++)
+            handle_send_frame(worker, worker->players[i], frame);
+    }
+    if (NULL != frame)
+        frame_release(frame);
+}
 
-        // 获取该数据包对应的玩家信息 
-        player_info *player = get_player_info_by_sock(pQuery->m_socket_fd);
-        if (player == NULL)
+/**
+ * @brief 把发送队列已经清空的待迁移玩家交给它所在房间的 worker。
+ *
+ * 迁移请求是 handler 转来的 PLAYER_INFO_CERT。玩家的发送队列中没有帧、没有在途的发送链、也不在等待可写事件时，
+ * 本 worker 不会再访问它的发送队列，这时把 `player->worker` 改为房间的 worker，再把 PLAYER_INFO_CERT 交还 handler，
+ * 由 handler 重新处理：GLOBAL_PLAYER_INFO 会被送到新的 worker，新的 worker 在回复之前把玩家加入房间。
+ * 迁移期间暂存的消息计数保证 slot 不会被回收，交还 handler 时这个计数通过 `m_pinned` 一起移交，
+ * 直到 handler 重新处理完 PLAYER_INFO_CERT 都不会释放。
+ */
+static void check_migrations(worker_t *worker)
+{
+    int kept = 0;
+    for (int i = 0; i < worker->migrating_num; i++)
+    {
+        CQuery *query = worker->migrating_queries[i];
+        player_info *player = get_player_info_by_sock(query->m_socket_fd);
+        room_t *room = get_room(player->room);
+        if (!player->available || NULL == room)
         {
-            perror("get_player_info_by_sock");
+            release_out_queue(worker, player);
+            minus_message_count(player);
+            add_free_list(query);
             continue;
         }
-        // 更新玩家消息计数 
-        minus_message_count(player);
-        if (!player->available) // 假如玩家现在已经退出游戏，则释放该数据包 
+        if (!out_queue_empty(&player->out_queue) || 0 != player->out_queue.inflight ||
+            player->wait_writable || player->in_flush_list)
         {
-            add_free_list(pQuery);
+            worker->migrating_queries[kept++] = query;
             continue;
         }
+        LOG_DEBUG("migrate %s to worker %d (room %d).", player->id, room->worker, room->id);
+        atomic_store_explicit(&player->worker, room->worker, memory_order_release);
+        // event_handler_main 中增加的计数随 query 一起交给 handler，不在这里释放：
+        // 重新入队之后、handler 取出之前，同一个连接的 SOME_ONE_QUIT 可能先被处理
+        query->m_pinned = player;
+        add_gready_list(query);
+    }
+    worker->migrating_num = kept;
+}
+
+/**
+ * @brief tick 模式下暂存一个玩家的 GAME_UPDATE，同一个 tick 内后到的更新覆盖先到的。
+ *
+ * 暂存的数据包继续持有 handler 为它增加的消息计数，保证 tick 之前 slot 不会被回收；
+ * 被覆盖的数据包立即归还并减少计数。玩家登记在房间的待合并链表中，房间登记在 worker 的待合并列表中。
+ */
+static void coalesce_update(worker_t *worker, room_t *room, player_info *player, CQuery *query)
+{
+    if (GAME_UPDATE_LEN != query->m_query_len - header_size)
+    {
+        LOG_WARN("coalesce_update: bad GAME_UPDATE length %d from %s", query->m_query_len - header_size, player->id);
+        minus_message_count(player);
+        add_free_list(query);
+        return;
+    }
+    if (NULL != player->pending_update)
+    {
+        add_free_list(player->pending_update);
+        minus_message_count(player);
+        atomic_fetch_add_explicit(&worker->tick.coalesced_count, 1, memory_order_relaxed);
+    }
+    player->pending_update = query;
+    if (!player->in_tick_list)
+    {
+        player->in_tick_list = true;
+        player->tick_next = room->tick_head;
+        room->tick_head = player->slot;
+        if (!room->in_tick_list)
+        {
+            room->in_tick_list = true;
+            worker->tick_rooms[worker->tick_room_num++] = room->id;
+        }
+    }
+}
 
-        // 根据数据包类型来决定是要群发还是单发 
-        if (pQuery->m_header.type == GAME_UPDATE ||
-            pQuery->m_header.type == SOME_ONE_JOIN ||
-            pQuery->m_header.type == SOME_ONE_QUIT)
+/**
+ * @brief 把本 tick 的若干条快照记录（下标为 indices）编码成一个 GAME_SNAPSHOT 帧，放入 targets 中每个玩家的发送队列。
+ *
+ * @param compact 为 true 时记录中的 UUID 换成 slot id，targets 必须都是紧凑 id 模式的玩家。
+ */
+static void send_snapshot(worker_t *worker, const int *indices, int record_num, bool compact, player_info **targets,
+                          int target_num)
+{
+    char *buffer = worker->frame_buffer;
+    char *p = buffer + header_size;
+    for (int i = 0; i < record_num; i++)
+    {
+        const char *record = worker->records[indices[i]];
+        if (compact)
         {
-            // 如果有多个玩家，就进行群发 
-            if (get_player_info_array_length() > 1)
-                handle_group_send(pQuery);
-            else
+            uint16_t slot_id = worker->record_slots[indices[i]];
+            memcpy(p, &slot_id, SLOT_ID_LEN);
+            memcpy(p + SLOT_ID_LEN, record + PLAYER_ID_LEN, TRANSFORM_LEN);
+            p += COMPACT_UPDATE_LEN;
+        }
+        else
+        {
+            memcpy(p, record, GAME_UPDATE_LEN);
+            p += GAME_UPDATE_LEN;
+        }
+    }
+    MessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = GAME_SNAPSHOT;
+    header.length = p - buffer;
+    memcpy(buffer, &header, header_size);
+
+    frame_t *frame = frame_create(buffer, header.length);
+    if (NULL == frame)
+    {
+        LOG_ERROR("frame_create failed.");
+        return;
+    }
+    for (int i = 0; i < target_num; i++)
+        handle_send_frame(worker, targets[i], frame);
+    frame_release(frame);
+    atomic_fetch_add_explicit(&worker->tick.snapshot_count, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief 取出一个房间本 tick 内所有玩家暂存的 GAME_UPDATE，对每个仍然在线的玩家回调一次 fold。
+ *
+ * 暂存的数据包在这里归还，并减少暂存时保留的消息计数。
+ */
+static void take_room_updates(worker_t *worker, room_t *room,
+                              void (*fold)(worker_t *worker, player_info *player, const char *update, int *record_num),
+                              int *record_num)
+{
+    int s = room->tick_head;
+    room->tick_head = -1;
+    room->in_tick_list = false;
+    while (-1 != s)
+    {
+        player_info *player = &player_infos.slots[s];
+        s = player->tick_next;
+        player->in_tick_list = false;
+        CQuery *query = player->pending_update;
+        player->pending_update = NULL;
+        if (player->available)
+            fold(worker, player, query->m_byte_Query + header_size, record_num);
+        add_free_list(query);
+        // 对应暂存时保留的计数，归零之后 slot 随时可能被回收
+        minus_message_count(player);
+    }
+}
+
+static void fold_record(worker_t *worker, player_info *player, const char *update, int *record_num)
+{
+    memcpy(worker->records[*record_num], update, GAME_UPDATE_LEN);
+    update_interest(worker, player, update + PLAYER_ID_LEN);
+    worker->record_slots[*record_num] = player->slot;
+    worker->record_of_slot[player->slot] = ++*record_num;
+}
+
+/**
+ * @brief 把一个房间本 tick 内所有玩家最新的状态合并成 GAME_SNAPSHOT 下发给房间中的所有玩家。
+ *
+ * 快照的消息体由若干条定长记录（UUID + Transform3D，和 GAME_UPDATE 的消息体相同；紧凑 id 模式下为 slot id + Transform3D）
+ * 拼接而成，一个帧放不下时拆成多个帧。
+ * - 没有开启兴趣管理时，两种格式的帧各自只编码一次，以共享帧的方式放入对应玩家的发送队列，
+ *   快照中也包含接收者自己的状态，由客户端跳过；
+ * - 开启兴趣管理时，每个玩家只收到兴趣范围内其他玩家的记录，每个玩家各自编码一个帧。
+ */
+static void emit_room_snapshot(worker_t *worker, room_t *room)
+{
+    const int max_records = (UINT16_MAX - header_size) / GAME_UPDATE_LEN;
+
+    int record_num = 0;
+    take_room_updates(worker, room, fold_record, &record_num);
+    if (0 == record_num)
+        return;
+
+    player_info **players = worker->players;
+    int player_num = room_snapshot(room, players, MAX_CONNECTION_NUM);
+    if (!interest_enabled(&worker->interest))
+    {
+        // 旧格式的玩家换到前面，紧凑 id 模式的玩家放在后面
+        int legacy_num = 0;
+        for (int i = 0; i < player_num; i++)
+        {
+            if (players[i]->compact_id)
+                continue;
+            player_info *tmp = players[legacy_num];
+            players[legacy_num++] = players[i];
+            players[i] = tmp;
+        }
+        for (int i = 0; i < record_num; i++)
+            worker->picked[i] = i;
+        for (int i = 0; i < record_num; i += max_records)
+        {
+            int num = record_num - i < max_records ? record_num - i : max_records;
+            if (0 < legacy_num)
+                send_snapshot(worker, &worker->picked[i], num, false, players, legacy_num);
+            if (legacy_num < player_num)
+                send_snapshot(worker, &worker->picked[i], num, true, players + legacy_num, player_num - legacy_num);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < player_num; i++)
+        {
+            if (!interest_grid_contains(&worker->interest, players[i]->slot, players[i]->id))
+                continue;
+            int near_num = interest_grid_query(&worker->interest, players[i]->slot, worker->near_slots, MAX_CONNECTION_NUM);
+            int picked_num = 0;
+            for (int j = 0; j < near_num; j++)
             {
-                printf("(debug) %s\n", "send_req_main: no player info.");
+                int index = worker->record_of_slot[worker->near_slots[j]];
+                if (0 != index)
+                    worker->picked[picked_num++] = index - 1;
             }
+            for (int j = 0; j < picked_num; j += max_records)
+                send_snapshot(worker, &worker->picked[j], picked_num - j < max_records ? picked_num - j : max_records,
+                              players[i]->compact_id, &players[i], 1);
+            atomic_fetch_add_explicit(&worker->interest.relayed_count, picked_num, memory_order_relaxed);
+            atomic_fetch_add_explicit(&worker->interest.filtered_count,
+                                      record_num - picked_num - (0 != worker->record_of_slot[players[i]->slot]),
+                                      memory_order_relaxed);
         }
-        else
+    }
+    for (int i = 0; i < record_num; i++)
+        worker->record_of_slot[worker->record_slots[i]] = 0;
+}
+
+/**
+ * @brief tick 模式下的 tick：对本 tick 内有 GAME_UPDATE 的每个房间各下发一次快照。
+ */
+static void emit_snapshots(worker_t *worker)
+{
+    for (int i = 0; i < worker->tick_room_num; i++)
+        emit_room_snapshot(worker, &g_rooms[worker->tick_rooms[i]]);
+    worker->tick_room_num = 0;
+}
+
+static void fold_world(worker_t *worker, player_info *player, const char *update, int *)
+{
+    memcpy(worker->world[player->slot].id, player->id, PLAYER_ID_LEN);
+    memcpy(worker->world[player->slot].transform, update + PLAYER_ID_LEN, TRANSFORM_LEN);
+}
+
+/**
+ * @brief 增量快照模式下一个房间的 tick：记录新的快照，并以每个玩家确认的快照为基线下发。
+ *
+ * 快照包含房间中所有上报过状态的在线玩家（不只是本 tick 有更新的），没有变化的玩家在增量中几乎不占空间。
+ * 编码只取决于基线和玩家的 id 模式，确认了同一个快照、id 模式相同的玩家共享同一个帧，
+ * 每个 tick 每种 id 模式最多编码 SNAPSHOT_HISTORY_NUM + 1 次。
+ * 房间的快照历史在第一次有玩家时分配。
+ */
+static void emit_room_delta_snapshot(worker_t *worker, room_t *room)
+{
+    struct
+    {
+        uint32_t base_seq;
+        bool compact;
+        frame_t *frame;
+    } encoded[2 * (SNAPSHOT_HISTORY_NUM + 1)];
+
+    player_info **players = worker->players;
+    int player_num = room_snapshot(room, players, MAX_CONNECTION_NUM);
+    if (0 == player_num)
+        return;
+    if (NULL == room->snapshots)
+    {
+        if (NULL == (room->snapshots = (snapshot_history_t *)malloc(sizeof(snapshot_history_t))))
+        {
+            LOG_ERROR("can't allocate snapshot history of room %d.", room->id);
+            return;
+        }
+        snapshot_history_init(room->snapshots);
+    }
+
+    snapshot_t *snapshot = snapshot_begin(room->snapshots);
+    for (int i = 0; i < player_num; i++)
+    {
+        snapshot_record_t *state = &worker->world[players[i]->slot];
+        if (0 != memcmp(state->id, players[i]->id, PLAYER_ID_LEN))
+            continue;
+        if (0 > snapshot_add(snapshot, players[i]->slot, state->id, state->transform))
+        {
+            LOG_WARN("emit_room_delta_snapshot: snapshot of room %d is full, %d players left out.", room->id, player_num - i);
+            break;
+        }
+    }
+    if (0 == snapshot->record_num)
+        return;
+
+    int encoded_num = 0;
+    for (int i = 0; i < player_num; i++)
+    {
+        const snapshot_t *base =
+            snapshot_find(room->snapshots, atomic_load_explicit(&players[i]->snapshot_ack, memory_order_relaxed));
+        if (base == snapshot)   // 序号回绕之后的陈旧确认
+            base = NULL;
+        uint32_t base_seq = NULL == base ? 0 : base->seq;
+        bool compact = players[i]->compact_id;
+
+        int j = 0;
+        while (j < encoded_num && (encoded[j].base_seq != base_seq || encoded[j].compact != compact))
+            j++;
+        if (j == encoded_num)
         {
-            // 否则就单发 
-            printf("send_req_main: %d:%d\n", pQuery->m_header.type, tmp_count++);
-            handle_send(pQuery->m_socket_fd, pQuery);
+            frame_t *frame =
+                frame_create(worker->frame_buffer, snapshot_encode(snapshot, base, compact, worker->frame_buffer));
+            if (NULL == frame)
+            {
+                LOG_ERROR("frame_create failed.");
+                continue;
+            }
+            encoded[encoded_num].base_seq = base_seq;
+            encoded[encoded_num].compact = compact;
+            encoded[encoded_num++].frame = frame;
+            atomic_fetch_add_explicit(&worker->tick.snapshot_count, 1, memory_order_relaxed);
         }
+        handle_send_frame(worker, players[i], encoded[j].frame);
+    }
+    // 释放编码时持有的引用，还在各个发送队列中的引用会在写出之后释放
+    for (int j = 0; j < encoded_num; j++)
+        frame_release(encoded[j].frame);
+}
+
+/**
+ * @brief 增量快照模式下的 tick：更新世界状态，再对本 worker 负责的每个有玩家的房间下发增量快照。
+ */
+static void emit_delta_snapshots(worker_t *worker)
+{
+    for (int i = 0; i < worker->tick_room_num; i++)
+        take_room_updates(worker, &g_rooms[worker->tick_rooms[i]], fold_world, NULL);
+    worker->tick_room_num = 0;
+
+    for (int r = worker->id; r < MAX_ROOM_NUM; r += g_worker_num)
+        emit_room_delta_snapshot(worker, &g_rooms[r]);
+}
+
+/**
+ * @brief 把 `query` 中打包好的群发消息编码成紧凑 id 模式的帧：消息体中发起者的 UUID 换成它的 slot id。
+ *
+ * - GAME_UPDATE：slot id + Transform3D；
+ * - SOME_ONE_JOIN：slot id + UUID + 名称，加入消息保留完整的 UUID，客户端用它建立 slot id -> UUID 的映射；
+ * - SOME_ONE_QUIT：slot id。
+ */
+static frame_t *create_compact_frame(worker_t *worker, player_info *sender, CQuery *query)
+{
+    char *buffer = worker->frame_buffer;
+    const char *body = query->m_byte_Query + header_size;
+    int body_len = query->m_query_len - header_size;
+    uint16_t slot_id = sender->slot;
+    memcpy(buffer + header_size, &slot_id, SLOT_ID_LEN);
+
+    MessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = query->m_header.type;
+    header.length = header_size + SLOT_ID_LEN;
+    if (GAME_UPDATE == header.type && GAME_UPDATE_LEN == body_len)
+    {
+        memcpy(buffer + header.length, body + PLAYER_ID_LEN, TRANSFORM_LEN);
+        header.length += TRANSFORM_LEN;
+    }
+    else if (SOME_ONE_JOIN == header.type && header.length + body_len <= UINT16_MAX)
+    {
+        memcpy(buffer + header.length, body, body_len);
+        header.length += body_len;
+    }
+    memcpy(buffer, &header, header_size);
+    return frame_create(buffer, header.length);
+}
 
-        // 释放对应的数据包（已经发送完了）
-        add_free_list(pQuery);
+/**
+ * @brief 取得发给 target 的群发帧，两种 id 模式的帧各自在第一次用到时编码，之后共享。
+ *
+ * @param frames 旧格式和紧凑 id 模式的帧，调用方在群发结束之后释放。
+ */
+static frame_t *group_frame(worker_t *worker, player_info *sender, CQuery *query, frame_t *frames[2], player_info *target)
+{
+    int compact = target->compact_id;
+    if (NULL == frames[compact])
+    {
+        frames[compact] = compact ? create_compact_frame(worker, sender, query)
+                                  : frame_create(query->m_byte_Query, query->m_query_len);
+        if (NULL == frames[compact])
+            LOG_ERROR("frame_create failed.");
     }
+    return frames[compact];
 }
 
 /**
  * @brief 处理群发消息的函数。
  * 
- * 该函数用于将来自某个客户端的消息发送给所有其他客户端（即群发）。消息由 `query` 参数中包含的套接字
- * 和相关数据提供，并被发送给所有连接的客户端，除去消息的发起者。
+ * 该函数用于将来自某个客户端的消息发送给同一个房间中的所有其他客户端（即群发）。消息由 `query` 参数中包含的套接字
+ * 和相关数据提供，并被发送给房间中所有连接的客户端，除去消息的发起者。
  * 
  * 函数的主要流程包括：
- * - 获取当前所有客户端的套接字列表，通过 `get_player_info_sockfds()` 函数获得。
- * - 检查套接字列表是否为空，或只有一个客户端连接的情况，如果满足条件则直接返回。
- * - 遍历套接字列表，将消息发送给每个除发起请求的客户端外的其他客户端。
- * - 对于每个客户端，调用 `handle_send()` 函数完成消息发送。
- * 
- * 在调试过程中，函数会打印各个阶段的调试信息，包括当前处理的套接字和其对应的状态。
+ * - 把 `query` 中打包好的消息编码成一个只读、带引用计数的帧，整个群发只拷贝这一次；
+ *   房间中有紧凑 id 模式的玩家时再编码一个用 slot id 代替 UUID 的帧，见 `create_compact_frame`。
+ * - 通过 `room_snapshot()` 把房间成员的指针拷贝到 worker 私有的数组中，不需要分配内存。
+ * - 顺序遍历该数组，把对应格式的帧的一个引用追加到每个除发起请求的客户端外的其他客户端的发送队列中。
  * 
+ * @param worker 负责该房间的 worker。
+ * @param room 消息发起者所在的房间。
+ * @param player 消息的发起者。
  * @param query 指向包含要群发的消息信息的 `CQuery` 结构体的指针。该结构体中包含消息的发起者
  *              的套接字信息及消息内容。
  * 
  * @return 无返回值。
  */
-void handle_group_send(CQuery *query)
+void handle_group_send(worker_t *worker, room_t *room, player_info *player, CQuery *query)
 {
     int sockfd = query->m_socket_fd;
-    printf("(debug) %s%d\n", "handle_group_send(): ", sockfd);
+    LOG_DEBUG("handle_group_send(): %d", sockfd);
 
-    int *sockfds = get_player_info_sockfds();
-    if (NULL == sockfds)
-        return;
-    printf("(debug) %s%d\n", "handle_group_send^^: ", sockfds[0]);
-    if (1 == sockfds[0])
+    player_info **players = worker->players;
+    int player_num = room_snapshot(room, players, MAX_CONNECTION_NUM);
+    if (player_num <= 1)
     {
-        free(sockfds);
+        LOG_DEBUG("handle_group_send: no other player in room %d.", room->id);
         return;
     }
 
-    for (int i = 1; i <= sockfds[0]; i++)
+    frame_t *frames[2] = {NULL, NULL};
+    for (int i = 0; i < player_num; i++)
     {
-        printf("(debug) %s%d\n", "handle_group_send: ", sockfds[i]);
-        if (sockfds[i] == sockfd)
+        if (players[i]->socketfd == sockfd)
             continue;
-        printf("(debug) %s%d\n", "handle_group_send>>: ", sockfds[i]);
-        handle_send(sockfds[i], query);
+        LOG_DEBUG("handle_group_send>>: %d", players[i]->socketfd);
+        frame_t *frame = group_frame(worker, player, query, frames, players[i]);
+        if (NULL != frame)
+            handle_send_frame(worker, players[i], frame);
     }
+    // 释放创建时持有的引用，还在各个发送队列中的引用会在写出之后释放
+    for (int i = 0; i < 2; i++)
+        if (NULL != frames[i])
+            frame_release(frames[i]);
 }
 
 /**
- * @brief 处理向指定客户端发送数据的函数。
+ * @brief 按兴趣范围转发一条 GAME_UPDATE。
  * 
- * 该函数将消息从服务器发送到指定客户端的套接字（`target_sock`）。消息数据由 `query` 参数提供，
- * 其中包含消息内容及其长度。根据发送的结果，函数可能会将未发送完的数据缓存在对应的 `player_info`
- * 结构体中，并利用 epoll 注册为可写事件以便稍后继续发送。
+ * 先用消息中的位置更新发起者在兴趣网格中的位置，再从网格中查出同一个房间中半径以内的玩家，
+ * 只有它们的发送队列中会放入这个帧（每种 id 模式同样只编码一次）。房间中半径以外的玩家数计入 `filtered_count`。
  * 
- * 函数的主要功能包括：
- * - 获取目标客户端的 `player_info` 结构体，并检查其可用性。
- * - 根据消息的类型（如玩家加入、退出、游戏更新等）输出调试信息。
- * - 如果目标客户端在上次发送操作中仍有未发送完的数据，则将新数据追加到该客户端的发送缓冲区中。
- * - 尝试立即向目标客户端发送数据。如果数据未完全发送（例如遇到 `EAGAIN` 错误），则将剩余数据
- *   缓存到 `player_info` 的发送缓冲区中，并在 epoll 中注册该套接字的写事件以便稍后继续发送。
- * - 处理发送过程中可能出现的错误（如 `EAGAIN` 或 `send` 失败）。
+ * @param worker 负责该房间的 worker。
+ * @param room 消息发起者所在的房间。
+ * @param player 消息的发起者。
+ * @param query 已经打包好的 GAME_UPDATE。
+ * 
+ * @return 无返回值。
+ */
+void handle_interest_send(worker_t *worker, room_t *room, player_info *player, CQuery *query)
+{
+    if (GAME_UPDATE_LEN != query->m_query_len - header_size)
+    {
+        LOG_WARN("handle_interest_send: bad GAME_UPDATE length %d from %s", query->m_query_len - header_size, player->id);
+        return;
+    }
+    update_interest(worker, player, query->m_byte_Query + header_size + PLAYER_ID_LEN);
+
+    frame_t *frames[2] = {NULL, NULL};
+    int relayed = 0;
+    int near_num = interest_grid_query(&worker->interest, player->slot, worker->near_slots, MAX_CONNECTION_NUM);
+    for (int i = 0; i < near_num; i++)
+    {
+        player_info *target = &player_infos.slots[worker->near_slots[i]];
+        // 跳过 slot 已经被复用、新玩家还没有上报过位置的陈旧条目
+        if (!target->available || !interest_grid_contains(&worker->interest, worker->near_slots[i], target->id))
+            continue;
+        frame_t *frame = group_frame(worker, player, query, frames, target);
+        if (NULL == frame)
+            continue;
+        handle_send_frame(worker, target, frame);
+        relayed++;
+    }
+    for (int i = 0; i < 2; i++)
+        if (NULL != frames[i])
+            frame_release(frames[i]);
+
+    int others = room_member_num(room) - 1;
+    atomic_fetch_add_explicit(&worker->interest.relayed_count, relayed, memory_order_relaxed);
+    if (others > relayed)
+        atomic_fetch_add_explicit(&worker->interest.filtered_count, others - relayed, memory_order_relaxed);
+}
+
+/**
+ * @brief 用 GAME_UPDATE 中的 Transform3D 更新玩家在兴趣网格中的位置，坐标无效时保留原来的位置。
+ */
+static void update_interest(worker_t *worker, player_info *player, const char *transform)
+{
+    float x, z;
+    if (interest_enabled(&worker->interest) && interest_position_from_transform(transform, &x, &z))
+        interest_grid_update(&worker->interest, player->slot, player->room, player->id, x, z);
+}
+
+/**
+ * @brief 向指定客户端单发 `query` 中打包好的消息。
  * 
+ * @param worker 目标客户端发送队列所属的 worker。
  * @param target_sock 目标客户端的套接字，表示消息要发送到的客户端。
  * @param query 指向包含待发送数据的 `CQuery` 结构体的指针，其中包含数据及其长度等信息。
  * 
  * @return 无返回值。
  */
-void handle_send(int target_sock, CQuery *query)
+void handle_send(worker_t *worker, int target_sock, CQuery *query)
 {
-    printf("\033[32m%s\033[0m\n", "handle_send");
-    // 获取要发送的数据和数据长度 
-    char *data = query->m_byte_Query;
-    int data_size = query->m_query_len;
-    int remain_size = data_size;    // 因为有可能会在中途对方的缓冲区已经收满
-                                    // 所以要初始化剩余未发送的数据大小 
-
     // 获取目标客户端的 player_info 结构体
     player_info *player = get_player_info_by_sock(target_sock);
     if (player == NULL)
     {
-        perror("get_player_info_by_sock");
+        LOG_WARN("handle_send: no player for socket %d", target_sock);
         return;
     }
 
-    // 如果玩家不可用（等待资源被清理完之后进行销毁），直接返回
+    frame_t *frame = frame_create(query->m_byte_Query, query->m_query_len);
+    if (NULL == frame)
+    {
+        LOG_ERROR("frame_create failed.");
+        return;
+    }
+    handle_send_frame(worker, player, frame);
+    frame_release(frame);
+}
+
+/**
+ * @brief 把一个帧放入指定玩家的发送队列，单发与群发共用。
+ * 
+ * 这里只是追加一个帧引用并把玩家登记到本轮待 flush 的列表中，真正的写操作在
+ * `flush_dirty_players` 中进行。玩家不可用（等待资源被清理完之后进行销毁）时直接忽略。
+ * 绑定了 UDP 通道的玩家，GAME_UPDATE 改为加入本轮的 UDP 数据报，不经过发送队列和它的背压策略。
+ * 
+ * @param worker 目标玩家发送队列所属的 worker。
+ * @param player 目标玩家。
+ * @param frame 待发送的帧，调用方仍然持有自己的引用。
+ * 
+ * @return 无返回值。
+ */
+void handle_send_frame(worker_t *worker, player_info *player, frame_t *frame)
+{
     if (!player->available)
         return;
+    if (NULL != worker->udp && !player->send_kicked && udp_batch_add(worker->udp, player, frame))
+        return;
+    queue_frame(worker, player, frame);
+}
 
-    // if (query->m_header.type == GLOBAL_PLAYER_INFO)
-    // {
-    //     printf("(debug) GLOBAL_PLAYER_INFO\n");
-    // }
-    // else if (query->m_header.type == RESPONSE_UUID)
-    // {
-    //     printf("(debug) RESPONSE_UUID\n");
-    // }
-    if (query->m_header.type == SOME_ONE_JOIN)
+/**
+ * @brief 按背压策略把帧放入玩家的发送队列，并把玩家登记到本轮待 flush 的列表中。
+ *
+ * - 队列从空变为非空时记下时刻，队列持续非空超过 `-L` 毫秒（客户端消费得比服务器产生得慢）时断开连接；
+ *   远端的玩家确认数据本来就要更久，积压时间的上限再加上它的 `player_rtt_slack_ns`，不会因为距离远而被误判为慢客户端；
+ * - 连接已经阻塞（等待可写事件，或者 io_uring 后端有发送链在途）时，新的状态帧先替换队列中还没有开始发送、
+ *   被它取代的旧帧：同一个玩家的 GAME_UPDATE，上一个增量快照（每个增量快照都是相对于客户端确认过的快照的完整状态），
+ *   或者上一个 PING（它的时间戳已经过时）；
+ * - 队列中尚未写出的字节数超过 `-q` 时丢弃新的状态帧（GAME_UPDATE、GAME_SNAPSHOT、GAME_SNAPSHOT_DELTA、PING），
+ *   之后的状态会覆盖它；
+ * - 控制消息（其余类型）从不丢弃，队列满到放不下时断开连接，而不是让客户端收到缺了 JOIN / QUIT 的消息流。
+ */
+static void queue_frame(worker_t *worker, player_info *player, frame_t *frame)
+{
+    if (player->send_kicked)
+        return;
+    out_queue_t *queue = &player->out_queue;
+    if (out_queue_empty(queue))
+        player->send_backlog_ns = worker->now_ns;
+    else if (0 < g_pconf->send_lag_ms &&
+             worker->now_ns - player->send_backlog_ns > g_pconf->send_lag_ms * 1000000ull + player_rtt_slack_ns(player))
     {
-        printf("(debug) SOME_ONE_JOIN\n");
+        kick_slow_player(worker, player, "send queue lagging");
+        return;
     }
-    else if (query->m_header.type == SOME_ONE_QUIT)
+
+    MessageHeader header;
+    memcpy(&header, frame->data, header_size);
+    stats_thread_t *stats = stats_local();
+    bool state = GAME_UPDATE == header.type || GAME_SNAPSHOT == header.type || GAME_SNAPSHOT_DELTA == header.type ||
+                 PING == header.type;
+    if (state && player->wait_writable)
     {
-        printf("(debug) SOME_ONE_QUIT\n");
+        uint32_t key_len = 0;
+        if (GAME_UPDATE == header.type)
+            key_len = player->compact_id ? SLOT_ID_LEN : PLAYER_ID_LEN;
+        if (GAME_SNAPSHOT != header.type && 0 == out_queue_supersede(queue, frame, header_size, key_len))
+        {
+            stats_add(&stats->send_superseded, 1);
+            publish_queue_depth(player);
+            return;
+        }
     }
-    else if (query->m_header.type == GAME_UPDATE)
+    if (state && !out_queue_empty(queue) && queue->bytes + frame->len > g_pconf->send_queue_kb * 1024ull)
     {
-        printf("(debug) GAME_UPDATE\n");
+        stats_add(&stats->send_dropped, 1);
+        return;
     }
-    else if (query->m_header.type == PLAYER_INFO_CERT)
+    if (0 > out_queue_push(queue, frame))
     {
-        printf("(debug) PLAYER_INFO_CERT\n");
+        if (state)
+            stats_add(&stats->send_dropped, 1);
+        else
+            kick_slow_player(worker, player, "send queue full");
+        return;
     }
-    else if (query->m_header.type == CLIENT_READY)
+    int type = stats_type_index(header.type);
+    stats_add(&stats->send_msgs[type], 1);
+    stats_add(&stats->send_type_bytes[type], frame->len);
+    publish_queue_depth(player);
+    // 正在等待可写事件的连接由 epoll 驱动 flush，不需要登记
+    if (!player->in_flush_list && !player->wait_writable)
     {
-        printf("(debug) CLIENT_READY\n");
+        player->in_flush_list = true;
+        worker->dirty_players[worker->dirty_player_num++] = player;
     }
+}
+
+/**
+ * @brief 断开一个消费得太慢的连接。
+ *
+ * 连接属于接收它的 reactor，发送线程不能直接拆除，这里只 `shutdown` 套接字并释放发送队列：
+ * reactor 随后读到 0，走和正常退出相同的 `CQuery_notify_quit`。在那之前发给它的帧都直接丢弃。
+ */
+static void kick_slow_player(worker_t *worker, player_info *player, const char *reason)
+{
+    LOG_WARN("disconnect slow client %s: %s, %u frames (%u bytes) queued for %u ms, rtt %u us, jitter %u us.", player->id,
+             reason, player->out_queue.num, (unsigned)player->out_queue.bytes,
+             (unsigned)((worker->now_ns - player->send_backlog_ns) / 1000000),
+             atomic_load_explicit(&player->rtt_us, memory_order_relaxed),
+             atomic_load_explicit(&player->rtt_jitter_us, memory_order_relaxed));
+    player->send_kicked = true;
+    stats_add(&stats_local()->send_kicks, 1);
+    COUNT_SYSCALL(1);
+    shutdown(player->socketfd, SHUT_RDWR);
+    release_out_queue(worker, player);
+}
 
-    // 如果玩家当前有未完成的发送数据 
-    if (player->havent_send > 0)
+/* 把玩家发送队列的深度写到统计段中，`squash_stat -q` 按它列出积压最多的连接 */
+static void publish_queue_depth(player_info *player)
+{
+    stats_set_client_queue(player->slot, player->out_queue.num, (uint32_t)player->out_queue.bytes,
+                           player->send_backlog_ns);
+}
+
+/**
+ * @brief 等待并处理发送侧的 I/O 事件。
+ *
+ * - epoll 后端：只有存在被 EAGAIN 阻塞的发送队列，或者需要睡眠等待新的任务时才调用 epoll_wait，
+ *   对每个可写的连接继续 flush；
+ * - io_uring 后端：提交上一轮准备好的所有发送链，并处理已经完成的 send。
+ *
+ * @param timeout 大于 0 时最多阻塞 timeout 毫秒，work 队列的唤醒也会让它返回。
+ */
+static void poll_send_events(worker_t *worker, int timeout)
+{
+#ifdef HAVE_IO_URING
+    if (IO_BACKEND_URING == g_pconf->io_backend)
     {
-        //  将新的数据追加到发送缓存的未发送部分后面 
-        memcpy(player->snd_buffer + player->havent_send, data, data_size);
-        player->havent_send += data_size;   // 更新缓存之中的未发送数据大小
+        uring_sender_poll(worker, timeout, handle_send_complete);
         return;
     }
+#endif
+    struct epoll_event *ep_evt = worker->events; // 存储 epoll 事件的数组
+
+    // 如果有被 EAGAIN 阻塞的发送队列，或者需要睡眠等待新的任务
+    if (0 == worker->wait_writable_num && 0 == timeout)
+        return;
+
+    // 没有任务时阻塞等待，否则超时设置为0表示非阻塞
+    COUNT_SYSCALL(1);
+    int ready_num = epoll_wait(worker->send_epoll_fd, ep_evt, MAX_EPOLL_EVENT, timeout); /*等待事件*/
 
-    // 尝试直接发送数据
-    ssize_t have_sent = write(target_sock, data, data_size);
+    // 处理每一个可写的连接
+    for (int i = 0; i < ready_num; i++)
+    {
+        if (ep_evt[i].data.ptr == &worker->work_wakeup)   // work 队列的唤醒事件，计数在 wakeup_end_park 中读空
+            continue;
+        if (ep_evt[i].data.ptr == &worker->tick)          // tick 的 timerfd，在 tick_due 中读空
+            continue;
+        player_info *player = (player_info *)ep_evt[i].data.ptr;  // 事件中直接携带了对应的 player_info
+        if (!player->available) // 假如玩家已经是“等待被删除”状态，则丢弃其发送队列
+        {
+            release_out_queue(worker, player);
+            continue;
+        }
+        // 继续写出发送队列中剩下的帧
+        flush_player(worker, player);
+    }
+}
 
-    // 发送成功
-    if (have_sent > 0)
+/**
+ * @brief 写出一个玩家发送队列中的帧，并根据结果维护它在发送 epoll 中的可写事件注册。
+ * 
+ * - 队列写空：如果之前在等待可写事件，就把套接字从发送 epoll 中移除；
+ * - 遇到 EAGAIN：第一次阻塞时把套接字以 EPOLLOUT | EPOLLET 注册到发送 epoll 中；
+ * - 其他错误：暂时只记录日志。
+ *
+ * io_uring 后端下改为准备一条发送链，见 `submit_player_sends`。
+ */
+static void flush_player(worker_t *worker, player_info *player)
+{
+#ifdef HAVE_IO_URING
+    if (IO_BACKEND_URING == g_pconf->io_backend)
     {
-        remain_size = data_size - have_sent;    // 计算还没有发送的数据大小
-        // printf("Sent %zd bytes\n", bytes_sent);
+        submit_player_sends(worker, player);
+        return;
     }
-    else if (have_sent == 0 || (have_sent < 0 && errno == EAGAIN))
+#endif
+    size_t queued_bytes = player->out_queue.bytes;
+    int result = out_queue_flush(&player->out_queue, player->socketfd);
+    stats_add(&stats_local()->write_bytes, queued_bytes - player->out_queue.bytes);
+    publish_queue_depth(player);
+    if (OUT_QUEUE_DRAINED == result)
     {
-        // 检查是否所有数据都发送成功
-        if (remain_size > 0)
+        if (player->wait_writable)
+        {
+            // 将该socket从epoll中移除
+            COUNT_SYSCALL(1);
+            epoll_ctl(worker->send_epoll_fd, EPOLL_CTL_DEL, player->socketfd, NULL);
+            player->wait_writable = false;
+            worker->wait_writable_num--;
+        }
+    }
+    else if (OUT_QUEUE_BLOCKED == result)
+    {
+        stats_add(&stats_local()->write_eagain, 1);
+        if (!player->wait_writable)
         { /*仍然有数据没有被发送出去，登记到epoll上*/
             struct epoll_event ev;
             ev.events = EPOLLOUT | EPOLLET; // 不使用EPOLLONESHOOT
-            ev.data.fd = target_sock;
-            epoll_ctl(g_send_epoll_fd, EPOLL_CTL_MOD, target_sock, &ev);
+            ev.data.ptr = player;   // 可写事件直接携带玩家的 slot
+            // 套接字此前没有注册在发送 epoll 中，必须用 ADD，MOD 会以 ENOENT 失败导致永远等不到可写事件
+            COUNT_SYSCALL(1);
+            if (0 > epoll_ctl(worker->send_epoll_fd, EPOLL_CTL_ADD, player->socketfd, &ev) && EEXIST == errno)
+                epoll_ctl(worker->send_epoll_fd, EPOLL_CTL_MOD, player->socketfd, &ev);
+            player->wait_writable = true;
+            worker->wait_writable_num++;
+        }
+    }
+    else
+    {
+        // TODO：这里应该将玩家踢出游戏，但是现在还没有实现
+        LOG_WARN("writev to %s failed: %s", player->id, strerror(errno));
+    }
+}
 
-            // 将还没有发送完的数据移动到对应player_info的send_buffer中
-            memcpy(player->snd_buffer, data + have_sent, remain_size);
-            player->havent_send = remain_size;
+/**
+ * @brief 对本轮有新帧入队的每个玩家各做一次 flush。
+ */
+static void flush_dirty_players(worker_t *worker)
+{
+    for (int i = 0; i < worker->dirty_player_num; i++)
+    {
+        player_info *player = worker->dirty_players[i];
+        player->in_flush_list = false;
+        if (player->available && !player->wait_writable)
+            flush_player(worker, player);
+    }
+    worker->dirty_player_num = 0;
+}
 
-            g_is_write_eagain = true;
-            not_right++;
-        }
-        else
-        { /*所有数据都已经发送出去*/
-            // All data sent, no need to register for EPOLLOUT
-            printf("All data sent\n");
+/**
+ * @brief 释放玩家发送队列中的全部帧，玩家退出时由发送线程调用。
+ *
+ * 玩家同时从本轮待 flush 的列表中摘除：之后的消息计数归零时 slot 就会被回收，
+ * 留在列表中的指针会让 `flush_dirty_players` 访问换了主人的 slot。
+ * io_uring 后端下如果还有发送链在途，这些帧仍然被内核引用，只能先取消发送链，
+ * 等完成事件回来之后再在 `handle_send_complete` 中释放。
+ */
+static void release_out_queue(worker_t *worker, player_info *player)
+{
+    if (player->in_flush_list)
+    {
+        for (int i = 0; i < worker->dirty_player_num; i++)
+        {
+            if (worker->dirty_players[i] != player)
+                continue;
+            worker->dirty_players[i] = worker->dirty_players[--worker->dirty_player_num];
+            break;
         }
+        player->in_flush_list = false;
     }
-    else
+#ifdef HAVE_IO_URING
+    if (player->out_queue.inflight > 0)
+    {
+        uring_sender_cancel(worker, player);
+        return;
+    }
+#endif
+    out_queue_clear(&player->out_queue);
+    publish_queue_depth(player);
+    if (player->wait_writable)
+    {
+        COUNT_SYSCALL(1);
+        epoll_ctl(worker->send_epoll_fd, EPOLL_CTL_DEL, player->socketfd, NULL);
+        player->wait_writable = false;
+        worker->wait_writable_num--;
+    }
+}
+
+#ifdef HAVE_IO_URING
+/**
+ * @brief 把一个玩家发送队列中最多 OUT_QUEUE_IOV_NUM 个帧准备成一条 io_uring 发送链。
+ *
+ * 发送链在途期间增加玩家的消息计数，保证 slot 在所有完成事件回来之前不会被回收、套接字不会被关闭。
+ */
+static void submit_player_sends(worker_t *worker, player_info *player)
+{
+    struct iovec iov[OUT_QUEUE_IOV_NUM];
+    int iov_num = out_queue_peek_iov(&player->out_queue, iov, OUT_QUEUE_IOV_NUM);
+    if (0 == iov_num)
+        return;
+    if (0 > uring_sender_send_chain(worker, player, iov, iov_num))
     {
-        // Handle error
-        perror("send");
+        // 帧留在队列中，下次有新帧入队时再尝试
+        LOG_WARN("can't submit send chain of %s.", player->id);
+        return;
     }
-}
\ No newline at end of file
+    player->out_queue.inflight = iov_num;
+    player->wait_writable = true;
+    worker->wait_writable_num++;
+    plus_message_count(player);
+}
+
+/**
+ * @brief io_uring 后端中一个 send 完成时的回调。
+ *
+ * 按发送出去的字节数出队；整条链完成之后，如果玩家已经退出（或者积压太久被断开）就释放剩下的帧，
+ * 否则在发送链期间又有新帧入队时把玩家重新登记到待 flush 的列表中。
+ * 链中出错（包括被取消）时不主动重试，和 epoll 后端一样等下一次有新帧入队时再 flush。
+ */
+static void handle_send_complete(worker_t *worker, player_info *player, int result)
+{
+    out_queue_t *queue = &player->out_queue;
+    if (result > 0)
+    {
+        out_queue_consume(queue, result);
+        stats_add(&stats_local()->write_bytes, result);
+    }
+    else if (-ECANCELED != result)
+        LOG_WARN("send to %s failed: %s", player->id, strerror(-result));
+    if (0 != --queue->inflight)
+        return;
+
+    player->wait_writable = false;
+    worker->wait_writable_num--;
+    if (!player->available || player->send_kicked)
+        out_queue_clear(queue);
+    else if (result > 0 && !out_queue_empty(queue) && !player->in_flush_list)
+    {
+        player->in_flush_list = true;
+        worker->dirty_players[worker->dirty_player_num++] = player;
+    }
+    publish_queue_depth(player);
+    // 对应 submit_player_sends 中增加的计数，必须放在最后，归零之后 slot 随时可能被回收
+    minus_message_count(player);
+}
+#endif
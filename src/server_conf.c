@@ -1,12 +1,220 @@
 #include "server_conf.h"
 #include "util.h"
 #include <stdio.h>
+#include <unistd.h>
+#include <getopt.h>
 
-int load_config(pconf_t *pconf, uint16_t port)
+/**
+ * @brief 使用默认值初始化服务器配置。
+ *
+ * @param pconf 需要初始化的配置结构体。
+ */
+void init_config(pconf_t *pconf)
 {
-    pconf->port = port;
+    pconf->listen_socket = -1;
+    pconf->port = 0;
+    pconf->reactor_num = DEFAULT_REACTOR_NUM;
+    pconf->worker_num = DEFAULT_WORKER_NUM;
+    pconf->listen_mode = LISTEN_REUSEPORT;
+    for (int i = 0; i < MAX_REACTOR_NUM; i++)
+        pconf->listen_sockets[i] = -1;
+    pconf->wait_policy = WAIT_POLICY_PARK;
+    pconf->spin_num = DEFAULT_SPIN_NUM;
+    pconf->io_backend = IO_BACKEND_EPOLL;
+    pconf->tick_rate = DEFAULT_TICK_RATE;
+    pconf->delta_snapshot = false;
+    pconf->interest_radius = 0;
+    pconf->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+    pconf->send_queue_kb = DEFAULT_SEND_QUEUE_KB;
+    pconf->send_lag_ms = DEFAULT_SEND_LAG_MS;
+    pconf->udp_enabled = false;
+    pconf->ping_interval_ms = DEFAULT_PING_INTERVAL_MS;
+    pconf->log_level = LOG_LEVEL_INFO;
+}
+
+const char *io_backend_name(io_backend_t io_backend)
+{
+    return IO_BACKEND_URING == io_backend ? "uring" : "epoll";
+}
+
+/**
+ * @brief 解析命令行参数，填充服务器配置。
+ *
+ * 用法：`squash_server <port> [-r reactor_num] [-W worker_num] [-m reuseport|exclusive] [-w spin|park|adaptive] [-s spin_num] [-b epoll|uring] [-t tick_rate] [-d] [-i radius] [-k idle_seconds] [-q queue_kb] [-L lag_ms] [-u] [-p ping_ms] [-l debug|info|warn|error|off]`
+ *
+ * - `-r`：接收 reactor 的数量，取值范围为 [1, MAX_REACTOR_NUM]。
+ * - `-W`：发送 worker 的数量，取值范围为 [1, MAX_WORKER_NUM]。房间 i 由第 i % worker_num 个 worker 负责，
+ *   不同 worker 上的房间之间没有任何共享的可写状态。
+ * - `-m`：多个 reactor 之间的监听方式，`reuseport` 为每个 reactor 一个 SO_REUSEPORT 监听套接字，
+ *   `exclusive` 为所有 reactor 共享同一个监听套接字并使用 EPOLLEXCLUSIVE 注册。
+ * - `-w`：handler/sender 线程在队列为空时的等待策略，默认为 `park`（睡眠等待唤醒），
+ *   `spin` 为一直空转，`adaptive` 为先空转 `-s` 轮再睡眠。
+ * - `-s`：自适应等待策略下进入睡眠前的空转轮数。
+ * - `-b`：收发使用的 I/O 后端，默认为 `epoll`；`uring` 需要编译时开启 io_uring 支持（HAVE_IO_URING）。
+ * - `-t`：服务器 tick 频率（Hz），取值范围为 [0, MAX_TICK_RATE]。默认为 0，收到 GAME_UPDATE 立即转发；
+ *   大于 0 时每个 tick 只把每个玩家最新的状态合并成一个 GAME_SNAPSHOT 广播出去。
+ * - `-d`：tick 模式下改为下发增量快照（GAME_SNAPSHOT_DELTA），必须同时指定 `-t`。
+ * - `-i`：兴趣半径（游戏世界中的距离），GAME_UPDATE 只转发给水平距离在半径以内的玩家。默认为 0，转发给所有人；
+ *   增量快照对所有玩家使用同一份世界快照，不能和 `-d` 同时使用。
+ * - `-k`：空闲超时（秒），取值范围为 [0, MAX_IDLE_TIMEOUT]。完成握手的连接超过这么久没有发来任何数据
+ *   （TCP 上的任何消息，包括回复 PING 的 PONG，以及 UDP 通道上的数据报）就被断开，默认为 DEFAULT_IDLE_TIMEOUT；
+ *   0 表示不检查，只依赖 TCP keepalive。默认的 PING 间隔下房间中正常的客户端每秒至少回复一次 PONG，
+ *   关闭 PING（`-p 0`）并且客户端可能长时间不发送数据时需要同时调大或关闭空闲超时。
+ *   没有在 HANDSHAKE_TIMEOUT_MS 之内完成握手的连接总是会被断开。
+ * - `-q`：每个连接发送队列中尚未写出的字节数上限（KB），取值范围为 [1, MAX_SEND_QUEUE_KB]，默认为 DEFAULT_SEND_QUEUE_KB。
+ *   超出之后新的状态帧（GAME_UPDATE / 快照）被丢弃，控制消息不受限制，见 `queue_frame`。
+ * - `-L`：发送队列持续非空超过这么多毫秒的连接被断开，取值范围为 [0, MAX_SEND_LAG_MS]，默认为 DEFAULT_SEND_LAG_MS，
+ *   0 表示不检查。
+ * - `-u`：在同一个端口上开启 UDP 通道，客户端绑定之后 GAME_UPDATE 改走 UDP（不可靠、按序号丢弃旧状态），
+ *   其他消息仍然走 TCP，见 udp_channel.h。默认关闭。
+ * - `-p`：向房间中的玩家发送 PING 的间隔（毫秒），取值范围为 [0, MAX_PING_INTERVAL_MS]，默认为 DEFAULT_PING_INTERVAL_MS，
+ *   0 表示不发送。客户端回复的 PONG 用来估计每个玩家的往返时间和抖动，见 `handle_pong`。
+ * - `-l`：日志级别，默认为 `info`；`debug` 会记录每条消息的收发过程，`off` 关闭日志（不启动日志线程）。
+ *
+ * @return 成功返回 0，参数非法返回 -1。
+ */
+int parse_config_args(pconf_t *pconf, int argc, char *argv[])
+{
+    init_config(pconf);
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "r:W:m:w:s:b:t:di:k:q:L:up:l:")))
+    {
+        switch (opt)
+        {
+        case 'r':
+            pconf->reactor_num = atoi(optarg);
+            if (pconf->reactor_num < 1 || pconf->reactor_num > MAX_REACTOR_NUM)
+                return -1;
+            break;
+        case 'W':
+            pconf->worker_num = atoi(optarg);
+            if (pconf->worker_num < 1 || pconf->worker_num > MAX_WORKER_NUM)
+                return -1;
+            break;
+        case 'm':
+            if (0 == strcmp(optarg, "reuseport"))
+                pconf->listen_mode = LISTEN_REUSEPORT;
+            else if (0 == strcmp(optarg, "exclusive"))
+                pconf->listen_mode = LISTEN_EXCLUSIVE;
+            else
+                return -1;
+            break;
+        case 'w':
+            if (0 == strcmp(optarg, "spin"))
+                pconf->wait_policy = WAIT_POLICY_SPIN;
+            else if (0 == strcmp(optarg, "park"))
+                pconf->wait_policy = WAIT_POLICY_PARK;
+            else if (0 == strcmp(optarg, "adaptive"))
+                pconf->wait_policy = WAIT_POLICY_ADAPTIVE;
+            else
+                return -1;
+            break;
+        case 's':
+            pconf->spin_num = atoi(optarg);
+            if (pconf->spin_num < 1)
+                return -1;
+            break;
+        case 'b':
+            if (0 == strcmp(optarg, "epoll"))
+                pconf->io_backend = IO_BACKEND_EPOLL;
+            else if (0 == strcmp(optarg, "uring"))
+            {
+#ifdef HAVE_IO_URING
+                pconf->io_backend = IO_BACKEND_URING;
+#else
+                printf("\033[31m(server)io_uring backend is not compiled in.\033[0m\n");
+                return -1;
+#endif
+            }
+            else
+                return -1;
+            break;
+        case 't':
+            pconf->tick_rate = atoi(optarg);
+            if (pconf->tick_rate < 0 || pconf->tick_rate > MAX_TICK_RATE)
+                return -1;
+            break;
+        case 'd':
+            pconf->delta_snapshot = true;
+            break;
+        case 'i':
+            pconf->interest_radius = atof(optarg);
+            if (!(pconf->interest_radius >= 0))
+                return -1;
+            break;
+        case 'k':
+            pconf->idle_timeout = atoi(optarg);
+            if (pconf->idle_timeout < 0 || pconf->idle_timeout > MAX_IDLE_TIMEOUT)
+                return -1;
+            break;
+        case 'q':
+            pconf->send_queue_kb = atoi(optarg);
+            if (pconf->send_queue_kb < 1 || pconf->send_queue_kb > MAX_SEND_QUEUE_KB)
+                return -1;
+            break;
+        case 'L':
+            pconf->send_lag_ms = atoi(optarg);
+            if (pconf->send_lag_ms < 0 || pconf->send_lag_ms > MAX_SEND_LAG_MS)
+                return -1;
+            break;
+        case 'u':
+            pconf->udp_enabled = true;
+            break;
+        case 'p':
+            pconf->ping_interval_ms = atoi(optarg);
+            if (pconf->ping_interval_ms < 0 || pconf->ping_interval_ms > MAX_PING_INTERVAL_MS)
+                return -1;
+            break;
+        case 'l':
+        {
+            int level = log_level_parse(optarg);
+            if (0 > level)
+                return -1;
+            pconf->log_level = (log_level_t)level;
+            break;
+        }
+        default:
+            return -1;
+        }
+    }
+
+    // 增量快照以 tick 为单位编码，并且所有玩家共享同一份世界快照
+    if (pconf->delta_snapshot && (0 == pconf->tick_rate || pconf->interest_radius > 0))
+        return -1;
+
+    // 剩下的第一个非选项参数为端口号
+    if (optind >= argc)
+        return -1;
+    pconf->port = atoi(argv[optind]);
+    return 0;
+}
 
+/**
+ * @brief 创建一个绑定到指定端口的监听套接字。
+ *
+ * SO_REUSEADDR / SO_REUSEPORT 必须在 bind 之前设置才会生效，所以这里不能依赖 `config_socket`
+ * （它是在 listen 之后调用的）。
+ *
+ * @param port 监听端口。
+ * @param reuseport 是否开启 SO_REUSEPORT，让多个套接字可以绑定到同一个端口上。
+ * @return 成功返回监听套接字，失败返回 -1。
+ */
+static int create_listen_socket(uint16_t port, bool reuseport)
+{
     int listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (0 > listen_socket)
+        return -1;
+
+    int one = 1;
+    setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, (char *)&one, sizeof(int));
+    if (reuseport && 0 > setsockopt(listen_socket, SOL_SOCKET, SO_REUSEPORT, (char *)&one, sizeof(int)))
+    {
+        perror("setsockopt SO_REUSEPORT");
+        close(listen_socket);
+        return -1;
+    }
+
     struct sockaddr_in addbuf;
     addbuf.sin_family = AF_INET;
     // 使用htons函数将端口号转换为网络字节序·
@@ -18,17 +226,42 @@ int load_config(pconf_t *pconf, uint16_t port)
     if (-1 == bind(listen_socket, (struct sockaddr *)&addbuf, sizeof(addbuf)))
     {
         perror("server can't bind!");
+        close(listen_socket);
         return -1;
     }
 
-    listen(listen_socket, 1);
+    // backlog 过小会在连接风暴时直接丢弃 SYN，客户端要等到重传超时才能连上
+    listen(listen_socket, LISTEN_BACKLOG);
     config_socket(listen_socket);
-    pconf->listen_socket = listen_socket;
+    return listen_socket;
+}
+
+int load_config(pconf_t *pconf, uint16_t port)
+{
+    pconf->port = port;
+
+    // SO_REUSEPORT 模式下每个 reactor 各自持有一个监听套接字，
+    // EPOLLEXCLUSIVE 模式下所有 reactor 共享第一个监听套接字
+    bool reuseport = (LISTEN_REUSEPORT == pconf->listen_mode);
+    int socket_num = reuseport ? pconf->reactor_num : 1;
+    for (int i = 0; i < socket_num; i++)
+    {
+        if (0 > (pconf->listen_sockets[i] = create_listen_socket(port, reuseport)))
+            return -1;
+    }
+    for (int i = socket_num; i < pconf->reactor_num; i++)
+        pconf->listen_sockets[i] = pconf->listen_sockets[0];
+    pconf->listen_socket = pconf->listen_sockets[0];
 
     // 使用绿色打印
     printf("\033[32m");
-    printf("server config success!, listening to socket %d\n", pconf->listen_socket);
+    printf("server config success!, listening to socket %d, reactor num: %d, worker num: %d, mode: %s, wait policy: %s, io backend: %s, tick rate: %d%s, interest radius: %g, idle timeout: %ds, send queue: %dKB, send lag: %dms, udp: %s, ping: %dms, log level: %s\n",
+           pconf->listen_socket, pconf->reactor_num, pconf->worker_num, reuseport ? "reuseport" : "exclusive",
+           wait_policy_name(pconf->wait_policy), io_backend_name(pconf->io_backend), pconf->tick_rate,
+           pconf->delta_snapshot ? " (delta)" : "", pconf->interest_radius, pconf->idle_timeout,
+           pconf->send_queue_kb, pconf->send_lag_ms, pconf->udp_enabled ? "on" : "off",
+           pconf->ping_interval_ms, log_level_name(pconf->log_level));
     printf("\033[0m");
 
     return 0;
-}
\ No newline at end of file
+}
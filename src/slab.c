@@ -0,0 +1,142 @@
+#include "slab.h"
+#include <stdlib.h>
+
+// slab 头部占用的字节数，保证切出的块按 16 字节对齐
+#define SLAB_CHUNK_HEADER_SIZE 16
+
+/**
+ * @brief 初始化分配器的各个大小等级，此时不申请任何 slab。
+ *
+ * @param class_sizes 各个等级的块大小，从小到大排列，都必须是 16 的倍数。
+ * @param class_num 等级数，不超过 SLAB_MAX_CLASS_NUM。
+ * @return 成功返回 0，等级数不合法时返回 -1。
+ */
+int slab_init(slab_t *slab, const size_t *class_sizes, int class_num)
+{
+    if (0 >= class_num || class_num > SLAB_MAX_CLASS_NUM)
+        return -1;
+    slab->class_num = class_num;
+    for (int i = 0; i < class_num; i++)
+    {
+        slab_class_t *cls = &slab->classes[i];
+        cls->block_size = class_sizes[i];
+        cls->blocks_per_chunk = SLAB_CHUNK_SIZE / cls->block_size;
+        if (0 == cls->blocks_per_chunk)
+            cls->blocks_per_chunk = 1;
+        pthread_mutex_init(&cls->lock, NULL);
+        cls->free_blocks = NULL;
+        cls->chunks = NULL;
+        atomic_init(&cls->chunk_num, 0);
+        atomic_init(&cls->used_num, 0);
+    }
+    return 0;
+}
+
+void slab_destroy(slab_t *slab)
+{
+    for (int i = 0; i < slab->class_num; i++)
+    {
+        slab_class_t *cls = &slab->classes[i];
+        slab_chunk_t *chunk = cls->chunks;
+        while (NULL != chunk)
+        {
+            slab_chunk_t *next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+        cls->chunks = NULL;
+        cls->free_blocks = NULL;
+        pthread_mutex_destroy(&cls->lock);
+    }
+}
+
+/**
+ * @brief 申请一块新的 slab，切成等长的块挂到空闲链表上，调用方需要持有该等级的锁。
+ *
+ * @return 成功返回 0，内存分配失败返回 -1。
+ */
+static int slab_grow(slab_class_t *cls)
+{
+    slab_chunk_t *chunk = (slab_chunk_t *)malloc(SLAB_CHUNK_HEADER_SIZE + cls->block_size * cls->blocks_per_chunk);
+    if (NULL == chunk)
+        return -1;
+    chunk->next = cls->chunks;
+    cls->chunks = chunk;
+
+    char *blocks = (char *)chunk + SLAB_CHUNK_HEADER_SIZE;
+    for (int i = cls->blocks_per_chunk - 1; i >= 0; i--)
+    {
+        slab_block_t *block = (slab_block_t *)(blocks + i * cls->block_size);
+        block->next = cls->free_blocks;
+        cls->free_blocks = block;
+    }
+    atomic_fetch_add_explicit(&cls->chunk_num, 1, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief 从能放下 size 字节的最小等级中取出一个块。
+ *
+ * @param size 需要的字节数。
+ * @param capacity 输出参数，块的实际大小，归还时原样传给 `slab_free`。
+ * @return 成功返回块的地址；size 超过最大等级或者内存分配失败时返回 NULL。
+ */
+void *slab_alloc(slab_t *slab, size_t size, size_t *capacity)
+{
+    int i = 0;
+    while (i < slab->class_num && slab->classes[i].block_size < size)
+        i++;
+    if (slab->class_num == i)
+        return NULL;
+
+    slab_class_t *cls = &slab->classes[i];
+    pthread_mutex_lock(&cls->lock);
+    if (NULL == cls->free_blocks && 0 != slab_grow(cls))
+    {
+        pthread_mutex_unlock(&cls->lock);
+        return NULL;
+    }
+    slab_block_t *block = cls->free_blocks;
+    cls->free_blocks = block->next;
+    pthread_mutex_unlock(&cls->lock);
+
+    atomic_fetch_add_explicit(&cls->used_num, 1, memory_order_relaxed);
+    *capacity = cls->block_size;
+    return block;
+}
+
+/**
+ * @brief 把块归还到它所属等级的空闲链表中。
+ *
+ * @param capacity `slab_alloc` 返回的块大小。
+ */
+void slab_free(slab_t *slab, void *block, size_t capacity)
+{
+    if (NULL == block)
+        return;
+
+    int i = 0;
+    while (i < slab->class_num - 1 && slab->classes[i].block_size != capacity)
+        i++;
+
+    slab_class_t *cls = &slab->classes[i];
+    pthread_mutex_lock(&cls->lock);
+    ((slab_block_t *)block)->next = cls->free_blocks;
+    cls->free_blocks = (slab_block_t *)block;
+    pthread_mutex_unlock(&cls->lock);
+    atomic_fetch_sub_explicit(&cls->used_num, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief 统计分配器向系统申请的内存总量（不含 slab 头部）。
+ */
+size_t slab_resident_bytes(slab_t *slab)
+{
+    size_t bytes = 0;
+    for (int i = 0; i < slab->class_num; i++)
+    {
+        slab_class_t *cls = &slab->classes[i];
+        bytes += atomic_load_explicit(&cls->chunk_num, memory_order_relaxed) * cls->block_size * cls->blocks_per_chunk;
+    }
+    return bytes;
+}
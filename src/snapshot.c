@@ -0,0 +1,201 @@
+#include "snapshot.h"
+#include "binary_protocol.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 编码时使用的 slot -> 基线下标 + 1 的临时索引，0 表示不在基线中；每个发送线程一份，编码结束时恢复为全 0
+static _Thread_local int base_index[MAX_CONNECTION_NUM];
+
+/**
+ * @brief 初始化快照历史。
+ *
+ * 每个快照的记录数组在第一次追加时才分配，之后按需倍增，一个房间的历史只占用和房间人数相当的内存。
+ *
+ * @return 总是返回 0。
+ */
+int snapshot_history_init(snapshot_history_t *history)
+{
+    history->seq = 0;
+    for (int i = 0; i < SNAPSHOT_HISTORY_NUM; i++)
+    {
+        history->history[i].seq = 0;
+        history->history[i].record_num = 0;
+        history->history[i].capacity = 0;
+        history->history[i].records = NULL;
+    }
+    return 0;
+}
+
+void snapshot_history_destroy(snapshot_history_t *history)
+{
+    for (int i = 0; i < SNAPSHOT_HISTORY_NUM; i++)
+    {
+        free(history->history[i].records);
+        history->history[i].records = NULL;
+        history->history[i].capacity = 0;
+    }
+}
+
+/**
+ * @brief 开始一个新的快照，覆盖历史中最旧的一个。
+ *
+ * @return 新快照，序号为上一个快照加一（跳过 0）。
+ */
+snapshot_t *snapshot_begin(snapshot_history_t *history)
+{
+    if (0 == ++history->seq)
+        history->seq = 1;
+    snapshot_t *snapshot = &history->history[history->seq % SNAPSHOT_HISTORY_NUM];
+    snapshot->seq = history->seq;
+    snapshot->record_num = 0;
+    return snapshot;
+}
+
+/**
+ * @brief 向快照中追加一个玩家的状态。
+ *
+ * @return 成功返回 0，快照已满（超过一个帧能够容纳的记录数）或者内存分配失败返回 -1。
+ */
+int snapshot_add(snapshot_t *snapshot, int slot, const char *id, const char *transform)
+{
+    if (SNAPSHOT_MAX_RECORDS == snapshot->record_num)
+        return -1;
+    if (snapshot->record_num == snapshot->capacity)
+    {
+        int capacity = 0 == snapshot->capacity ? 8 : 2 * snapshot->capacity;
+        if (capacity > SNAPSHOT_MAX_RECORDS)
+            capacity = SNAPSHOT_MAX_RECORDS;
+        snapshot_record_t *records = (snapshot_record_t *)realloc(snapshot->records, sizeof(snapshot_record_t) * capacity);
+        if (NULL == records)
+            return -1;
+        snapshot->records = records;
+        snapshot->capacity = capacity;
+    }
+    snapshot_record_t *record = &snapshot->records[snapshot->record_num++];
+    record->slot = slot;
+    memcpy(record->id, id, PLAYER_ID_LEN);
+    memcpy(record->transform, transform, TRANSFORM_LEN);
+    return 0;
+}
+
+/**
+ * @brief 在历史中查找指定序号的快照。
+ *
+ * @return 找到返回快照，序号为 0 或者已经被覆盖返回 NULL。
+ */
+const snapshot_t *snapshot_find(const snapshot_history_t *history, uint32_t seq)
+{
+    if (0 == seq)
+        return NULL;
+    const snapshot_t *snapshot = &history->history[seq % SNAPSHOT_HISTORY_NUM];
+    return snapshot->seq == seq ? snapshot : NULL;
+}
+
+static char *put_u16(char *p, uint16_t value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+static char *put_u32(char *p, uint32_t value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+/**
+ * @brief 以 base 为基线把快照编码成一条完整的 GAME_SNAPSHOT_DELTA 消息（消息头 + 消息体）。
+ *
+ * 记录数不超过 SNAPSHOT_MAX_RECORDS 时编码结果一定不超过 UINT16_MAX 字节。
+ *
+ * @param base 基线快照，NULL 表示没有基线，所有玩家都以完整状态编码。
+ * @param compact 完整状态中是否用 slot id 代替 UUID。
+ * @param buffer 输出缓冲区，至少 UINT16_MAX 字节。
+ * @return 编码后消息的长度。
+ */
+int snapshot_encode(const snapshot_t *snapshot, const snapshot_t *base, bool compact, char *buffer)
+{
+    char *p = buffer + header_size;
+    p = put_u32(p, snapshot->seq);
+    p = put_u32(p, NULL == base ? 0 : base->seq);
+
+    int base_num = NULL == base ? 0 : base->record_num;
+    for (int i = 0; i < base_num; i++)
+        base_index[base->records[i].slot] = i + 1;
+
+    char *run = NULL;       // 当前 SAME 记录的位置，连续没有变化的玩家合并成一条
+    int run_next = -1;      // 能够延续当前 SAME 记录的下一个基线下标
+    uint16_t run_count = 0;
+    for (int i = 0; i < snapshot->record_num; i++)
+    {
+        const snapshot_record_t *record = &snapshot->records[i];
+        int b = base_index[record->slot] - 1;
+        const snapshot_record_t *old = NULL;
+        if (0 <= b && 0 == memcmp(base->records[b].id, record->id, PLAYER_ID_LEN))
+            old = &base->records[b];
+
+        if (NULL == old)
+        {
+            run = NULL;
+            *p++ = SNAPSHOT_RECORD_FULL;
+            if (compact)
+            {
+                p = put_u16(p, record->slot);
+                memcpy(p, record->transform, TRANSFORM_LEN);
+                p += TRANSFORM_LEN;
+            }
+            else
+            {
+                memcpy(p, record->id, PLAYER_ID_LEN);
+                memcpy(p + PLAYER_ID_LEN, record->transform, TRANSFORM_LEN);
+                p += GAME_UPDATE_LEN;
+            }
+            continue;
+        }
+
+        uint16_t mask = 0;
+        for (int w = 0; w < SNAPSHOT_WORD_NUM; w++)
+            if (0 != memcmp(old->transform + w * 4, record->transform + w * 4, 4))
+                mask |= 1u << w;
+
+        if (0 == mask)
+        {
+            if (NULL != run && b == run_next)
+                run_count++;
+            else
+            {
+                run = p;
+                run_count = 1;
+                *p++ = SNAPSHOT_RECORD_SAME;
+                p = put_u16(p, b);
+                p += sizeof(uint16_t);
+            }
+            put_u16(run + 1 + sizeof(uint16_t), run_count);
+            run_next = b + 1;
+            continue;
+        }
+
+        run = NULL;
+        *p++ = SNAPSHOT_RECORD_DELTA;
+        p = put_u16(p, b);
+        p = put_u16(p, mask);
+        for (int w = 0; w < SNAPSHOT_WORD_NUM; w++)
+        {
+            if (mask & (1u << w))
+            {
+                memcpy(p, record->transform + w * 4, 4);
+                p += 4;
+            }
+        }
+    }
+
+    for (int i = 0; i < base_num; i++)
+        base_index[base->records[i].slot] = 0;
+
+    MessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = GAME_SNAPSHOT_DELTA;
+    header.length = p - buffer;
+    memcpy(buffer, &header, header_size);
+    return header.length;
+}
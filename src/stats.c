@@ -0,0 +1,104 @@
+#include "stats.h"
+#include "log.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+_Thread_local stats_thread_t *tls_stats = NULL;
+
+// 共享内存段创建之前、或者线程数超过 STATS_MAX_THREAD_NUM 时使用的数据，不会被任何人读取
+static stats_thread_t stats_overflow;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static char stats_shm_name[32];
+static bool stats_shared = false;
+
+/**
+ * @brief 创建并映射统计共享内存段，之后各个线程的统计数据都写在段中，由 squash_stat 读取。
+ *
+ * 段的名称由端口决定（STATS_SHM_NAME_FORMAT），同一个端口上残留的旧段会被覆盖。
+ * 无法创建共享内存时退回到进程私有的匿名映射，服务器照常运行，只是外部看不到统计数据。
+ *
+ * @return 成功返回 0，连匿名映射也失败时返回 -1。
+ */
+int init_stats(uint16_t port)
+{
+    size_t size = sizeof(stats_segment_t);
+    snprintf(stats_shm_name, sizeof(stats_shm_name), STATS_SHM_NAME_FORMAT, port);
+    void *addr = MAP_FAILED;
+    int fd = shm_open(stats_shm_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (0 <= fd)
+    {
+        if (0 == ftruncate(fd, size))
+            addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == addr)
+            shm_unlink(stats_shm_name);
+    }
+    stats_shared = MAP_FAILED != addr;
+    if (!stats_shared)
+    {
+        LOG_WARN("can't create stats segment %s: %s, stats are only kept in process.", stats_shm_name, strerror(errno));
+        if (MAP_FAILED == (addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)))
+            return -1;
+    }
+
+    // 新映射的页面都是 0，只需要填写段头，magic 最后写入
+    stats_segment_t *stats = (stats_segment_t *)addr;
+    stats->version = STATS_VERSION;
+    stats->size = size;
+    stats->pid = getpid();
+    stats->port = port;
+    stats->start_ns = stats_now_ns();
+    atomic_init(&stats->thread_num, 0);
+    atomic_store_explicit(&stats->magic, STATS_MAGIC, memory_order_release);
+    g_stats = stats;
+    return 0;
+}
+
+/**
+ * @brief 解除映射并删除共享内存段，调用时其他线程不能再写统计数据。
+ */
+void destroy_stats()
+{
+    if (NULL == g_stats)
+        return;
+    munmap(g_stats, sizeof(stats_segment_t));
+    if (stats_shared)
+        shm_unlink(stats_shm_name);
+    g_stats = NULL;
+    stats_shared = false;
+}
+
+/**
+ * @brief 在统计段中为当前线程登记一份数据，线程启动时调用一次。
+ *
+ * @param kind 线程的身份，squash_stat 按身份分别显示队列深度等数据。
+ * @param id reactor / worker 编号，其他线程为 -1。
+ * @return 登记好的数据，之后通过 `stats_local` 取得；统计段还没有创建或者已满时返回一份不会被读取的数据。
+ */
+stats_thread_t *stats_register(stats_thread_kind_t kind, int id)
+{
+    stats_thread_t *stats = &stats_overflow;
+    pthread_mutex_lock(&stats_lock);
+    if (NULL != g_stats)
+    {
+        int thread_num = atomic_load_explicit(&g_stats->thread_num, memory_order_relaxed);
+        if (thread_num < STATS_MAX_THREAD_NUM)
+        {
+            stats = &g_stats->threads[thread_num];
+            atomic_store_explicit(&stats->kind, kind, memory_order_relaxed);
+            atomic_store_explicit(&stats->id, id, memory_order_relaxed);
+            // 读取方只访问 thread_num 之内的数据，先写好身份再发布
+            atomic_store_explicit(&g_stats->thread_num, thread_num + 1, memory_order_release);
+        }
+        else
+            LOG_WARN("stats segment is full, stats of this thread are dropped.");
+    }
+    pthread_mutex_unlock(&stats_lock);
+    tls_stats = stats;
+    return stats;
+}
@@ -0,0 +1,81 @@
+#include "tick.h"
+#include "util.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+static uint64_t tick_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief 初始化 tick，rate 大于 0 时创建一个以 1/rate 秒为周期的 timerfd。
+ *
+ * @param rate 每秒的 tick 数，0 表示关闭 tick（收到 GAME_UPDATE 立即转发）。
+ * @return 成功返回 0，timerfd 创建或设置失败返回 -1。
+ */
+int tick_init(tick_t *tick, int rate)
+{
+    tick->timer_fd = -1;
+    tick->rate = rate;
+    tick->interval_ns = 0;
+    tick->next_tick_ns = 0;
+    atomic_init(&tick->tick_count, 0);
+    atomic_init(&tick->coalesced_count, 0);
+    atomic_init(&tick->snapshot_count, 0);
+    if (0 == rate)
+        return 0;
+
+    if (0 > (tick->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)))
+        return -1;
+
+    tick->interval_ns = 1000000000ull / rate;
+    tick->next_tick_ns = tick_now_ns() + tick->interval_ns;
+
+    struct itimerspec spec;
+    spec.it_value.tv_sec = tick->next_tick_ns / 1000000000ull;
+    spec.it_value.tv_nsec = tick->next_tick_ns % 1000000000ull;
+    spec.it_interval.tv_sec = tick->interval_ns / 1000000000ull;
+    spec.it_interval.tv_nsec = tick->interval_ns % 1000000000ull;
+    if (0 > timerfd_settime(tick->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL))
+    {
+        tick_destroy(tick);
+        return -1;
+    }
+    return 0;
+}
+
+void tick_destroy(tick_t *tick)
+{
+    if (0 <= tick->timer_fd)
+        close(tick->timer_fd);
+    tick->timer_fd = -1;
+}
+
+/**
+ * @brief 判断是否到达了下一个 tick，到达时读空 timerfd 并推进到下一个 tick 的时刻。
+ *
+ * 发送线程落后超过一个周期时不补发错过的 tick，直接对齐到当前时刻之后的下一个 tick。
+ */
+bool tick_due(tick_t *tick)
+{
+    if (!tick_enabled(tick))
+        return false;
+
+    uint64_t now = tick_now_ns();
+    if (now < tick->next_tick_ns)
+        return false;
+    while (tick->next_tick_ns <= now)
+        tick->next_tick_ns += tick->interval_ns;
+
+    // timerfd 在 epoll 中是水平触发的，必须读空，否则发送线程睡眠时会被立即唤醒
+    uint64_t expirations;
+    COUNT_SYSCALL(1);
+    while (0 > read(tick->timer_fd, &expirations, sizeof(expirations)) && EINTR == errno)
+        ;
+    atomic_fetch_add_explicit(&tick->tick_count, 1, memory_order_relaxed);
+    return true;
+}
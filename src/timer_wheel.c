@@ -0,0 +1,152 @@
+#include "timer_wheel.h"
+
+static void list_init(timer_node_t *head)
+{
+    head->prev = head->next = head;
+}
+
+static void list_append(timer_node_t *head, timer_node_t *node)
+{
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static void list_unlink(timer_node_t *node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = NULL;
+}
+
+/* 把 src 中的所有节点移到 dst（空链表头）上，src 变为空 */
+static void list_move(timer_node_t *src, timer_node_t *dst)
+{
+    if (src->next == src)
+    {
+        list_init(dst);
+        return;
+    }
+    dst->next = src->next;
+    dst->prev = src->prev;
+    dst->next->prev = dst;
+    dst->prev->next = dst;
+    list_init(src);
+}
+
+/* 按到期时刻与当前格的距离选择层和槽，已经过期的放进第 0 层的当前槽，在本格处理 */
+static void wheel_place(timer_wheel_t *wheel, timer_node_t *node)
+{
+    uint64_t max_delta = (1ull << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVEL_NUM)) - 1;
+    if (node->expire < wheel->now)
+        node->expire = wheel->now;
+    if (node->expire - wheel->now > max_delta)
+        node->expire = wheel->now + max_delta;
+
+    uint64_t delta = node->expire - wheel->now;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVEL_NUM - 1 && delta >= (1ull << (TIMER_WHEEL_SLOT_BITS * (level + 1))))
+        level++;
+    int slot = (int)(node->expire >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+    list_append(&wheel->slots[level][slot], node);
+}
+
+/* 把第 level 层当前槽中的定时器重新放置到更低的层，返回该槽的下标 */
+static int wheel_cascade(timer_wheel_t *wheel, int level)
+{
+    int slot = (int)(wheel->now >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+    timer_node_t pending;
+    list_move(&wheel->slots[level][slot], &pending);
+    while (pending.next != &pending)
+    {
+        timer_node_t *node = pending.next;
+        list_unlink(node);
+        wheel_place(wheel, node);
+    }
+    return slot;
+}
+
+/**
+ * @brief 初始化时间轮，当前时刻作为第 0 格。
+ */
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now_ms)
+{
+    for (int level = 0; level < TIMER_WHEEL_LEVEL_NUM; level++)
+        for (int slot = 0; slot < TIMER_WHEEL_SLOT_NUM; slot++)
+            list_init(&wheel->slots[level][slot]);
+    wheel->now = 0;
+    wheel->now_ms = now_ms;
+    wheel->base_ms = now_ms;
+    wheel->count = 0;
+}
+
+/**
+ * @brief 添加一个在 expire_ms 到期的定时器，节点已经挂在时间轮上时先取消原来的到期时刻。
+ *
+ * 到期时刻向上取整到格，定时器最多晚 TIMER_WHEEL_TICK_MS 加上一轮 reactor 循环的时间触发，不会提前触发。
+ * 超出时间轮范围（TIMER_WHEEL_SLOT_NUM ^ TIMER_WHEEL_LEVEL_NUM 格）的到期时刻被截断到最远的一格。
+ */
+void timer_wheel_add(timer_wheel_t *wheel, timer_node_t *node, uint64_t expire_ms)
+{
+    timer_wheel_cancel(wheel, node);
+    uint64_t offset = expire_ms > wheel->base_ms ? expire_ms - wheel->base_ms : 0;
+    node->expire = (offset + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    wheel_place(wheel, node);
+    wheel->count++;
+}
+
+/**
+ * @brief 取消一个定时器，节点没有挂在时间轮上时什么也不做。
+ */
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_node_t *node)
+{
+    if (!timer_node_armed(node))
+        return;
+    list_unlink(node);
+    wheel->count--;
+}
+
+/**
+ * @brief 把时间轮推进到 now_ms，依次对到期的定时器调用 fn。
+ *
+ * 每一格只处理第 0 层的一个槽，第 0 层转完一圈时才需要 cascade；时间轮上没有定时器时直接跳到当前格。
+ *
+ * @return 本次触发的定时器数。
+ */
+int timer_wheel_advance(timer_wheel_t *wheel, uint64_t now_ms, timer_fn fn, void *arg)
+{
+    int fired = 0;
+    wheel->now_ms = now_ms;
+    uint64_t target = now_ms > wheel->base_ms ? (now_ms - wheel->base_ms) / TIMER_WHEEL_TICK_MS : 0;
+    while (wheel->now <= target)
+    {
+        if (0 == wheel->count)
+        {
+            wheel->now = target + 1;
+            break;
+        }
+
+        // 第 0 层转完一圈：依次把上一层的当前槽取下来重新放置，上一层也转完一圈时继续向上
+        for (int level = 1; level < TIMER_WHEEL_LEVEL_NUM; level++)
+        {
+            if (0 != (wheel->now & ((1ull << (TIMER_WHEEL_SLOT_BITS * level)) - 1)))
+                break;
+            wheel_cascade(wheel, level);
+        }
+
+        // 先把到期的链表整体取下，回调中重新添加的定时器不会在本格再次触发
+        timer_node_t expired;
+        list_move(&wheel->slots[0][wheel->now & TIMER_WHEEL_SLOT_MASK], &expired);
+        wheel->now++;
+        while (expired.next != &expired)
+        {
+            timer_node_t *node = expired.next;
+            list_unlink(node);
+            wheel->count--;
+            fired++;
+            fn(node, arg);
+        }
+    }
+    return fired;
+}
@@ -0,0 +1,373 @@
+#define _GNU_SOURCE /*recvmmsg / sendmmsg*/
+#include "udp_channel.h"
+#include "player_info_array.h"
+#include "query_list.h"
+#include "stats.h"
+#include "util.h"
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+extern bool g_over;
+
+struct udp_batch
+{
+    struct mmsghdr msgs[UDP_BATCH_NUM];
+    struct iovec iov[UDP_BATCH_NUM][2];
+    UdpHeader headers[UDP_BATCH_NUM];
+    struct sockaddr_in addrs[UDP_BATCH_NUM];
+    frame_t *frames[UDP_BATCH_NUM];
+    int num;
+};
+
+// 接收线程使用的缓冲区，只由 UDP 线程访问
+static struct mmsghdr recv_msgs[UDP_BATCH_NUM];
+static struct iovec recv_iov[UDP_BATCH_NUM];
+static struct sockaddr_in recv_addrs[UDP_BATCH_NUM];
+static char recv_buffers[UDP_BATCH_NUM][UDP_DATAGRAM_SIZE];
+
+/* 玩家的 UDP 地址打包成一个 64 位整数，发送线程可以原子地读取：IPv4 地址 << 16 | 端口（都是网络字节序） */
+static inline uint64_t pack_udp_addr(const struct sockaddr_in *addr)
+{
+    return ((uint64_t)addr->sin_addr.s_addr << 16) | addr->sin_port;
+}
+
+static inline void unpack_udp_addr(uint64_t packed, struct sockaddr_in *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = (uint32_t)(packed >> 16);
+    addr->sin_port = (uint16_t)packed;
+}
+
+/**
+ * @brief 创建并绑定 UDP 通道的套接字，和 TCP 监听套接字使用同一个端口。
+ *
+ * 接收线程阻塞在 recvmmsg 上，接收超时设置为 WAIT_TIMEOUT_MS，以便及时发现 `g_over`；
+ * 发送线程用 MSG_DONTWAIT 发送，缓冲区满时直接丢弃数据报。
+ *
+ * @return 成功返回 0，套接字创建或绑定失败返回 -1。
+ */
+int init_udp_channel(uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (0 > sock)
+        return -1;
+
+    int buffer_size = UDP_SOCKET_BUFFER;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = WAIT_TIMEOUT_MS * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (0 > bind(sock, (struct sockaddr *)&addr, sizeof(addr)))
+    {
+        perror("server can't bind udp socket!");
+        close(sock);
+        return -1;
+    }
+
+    for (int i = 0; i < UDP_BATCH_NUM; i++)
+    {
+        recv_iov[i].iov_base = recv_buffers[i];
+        recv_iov[i].iov_len = UDP_DATAGRAM_SIZE;
+        memset(&recv_msgs[i], 0, sizeof(recv_msgs[i]));
+        recv_msgs[i].msg_hdr.msg_iov = &recv_iov[i];
+        recv_msgs[i].msg_hdr.msg_iovlen = 1;
+        recv_msgs[i].msg_hdr.msg_name = &recv_addrs[i];
+    }
+    g_udp.socket = sock;
+    return 0;
+}
+
+/**
+ * @brief 开启了 UDP 通道时启动运行 `udp_channel_main` 的接收线程。
+ *
+ * @return 成功（或者没有开启）返回 0，线程创建失败返回 -1。
+ */
+int start_udp_channel()
+{
+    if (!udp_enabled())
+        return 0;
+    return 0 == pthread_create(&g_udp.pid, NULL, udp_channel_main, NULL) ? 0 : -1;
+}
+
+void join_udp_channel()
+{
+    if (udp_enabled())
+        pthread_join(g_udp.pid, NULL);
+}
+
+void destroy_udp_channel()
+{
+    if (!udp_enabled())
+        return;
+    close(g_udp.socket);
+    g_udp.socket = -1;
+}
+
+/**
+ * @brief 校验数据报的 UdpHeader，返回它所属的玩家。
+ *
+ * slot 越界、令牌不匹配（包括 slot 已经换了主人）、连接已经拆除，或者序号不比这个连接已经收到的更新时返回 NULL。
+ * 连接的第一个数据报总是接受，之后序号用差值判断新旧，允许回绕。
+ */
+static player_info *check_datagram(const UdpHeader *udp)
+{
+    if (udp->slot >= MAX_CONNECTION_NUM)
+        return NULL;
+    player_info *player = &player_infos.slots[udp->slot];
+    uint32_t token = atomic_load_explicit(&player->udp_token, memory_order_acquire);
+    if (0 == token || token != udp->token || !player->available)
+        return NULL;
+    if (0 != player->udp_recv_seq && 0 >= (int32_t)(udp->seq - player->udp_recv_seq))
+        return NULL;
+    player->udp_recv_seq = udp->seq;
+    return player;
+}
+
+/* 回复 UDP_BIND：UdpHeader（序号为 0，不占用发送序号）+ 只有消息头的 UDP_BIND */
+static void reply_bind(const UdpHeader *request, const struct sockaddr_in *addr)
+{
+    char reply[UDP_HEADER_SIZE + sizeof(MessageHeader)];
+    UdpHeader udp = *request;
+    udp.seq = 0;
+    MessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = UDP_BIND;
+    header.length = header_size;
+    memcpy(reply, &udp, UDP_HEADER_SIZE);
+    memcpy(reply + UDP_HEADER_SIZE, &header, header_size);
+    COUNT_SYSCALL(1);
+    sendto(g_udp.socket, reply, UDP_HEADER_SIZE + header_size, MSG_DONTWAIT, (const struct sockaddr *)addr,
+           sizeof(*addr));
+}
+
+/**
+ * @brief 处理一个数据报：UDP_BIND 直接回复，GAME_UPDATE 补全成 UUID + Transform3D 之后放入 ready_batch。
+ *
+ * 客户端发来的 GAME_UPDATE 可以只有 Transform3D，也可以带着 UUID，这里一律换成 slot 当前主人的 UUID，
+ * 再交给 handler 按套接字核对一次（见 `handle_game_update`），所以数据报无法冒充别的玩家。
+ * 放入 ready 队列的 GAME_UPDATE 持有玩家的一个消息计数（`m_pinned`），handler 处理它时玩家不会被回收，fd 也不会被复用。
+ *
+ * @return 数据报被接受时返回 true。
+ */
+static bool handle_datagram(const char *data, int len, const struct sockaddr_in *addr, uint64_t now_ms,
+                            CQuery **ready_batch, int *ready_num)
+{
+    if (len < UDP_HEADER_SIZE + header_size)
+        return false;
+    UdpHeader udp;
+    MessageHeader header;
+    memcpy(&udp, data, UDP_HEADER_SIZE);
+    memcpy(&header, data + UDP_HEADER_SIZE, header_size);
+    const char *body = data + UDP_HEADER_SIZE + header_size;
+    int body_len = len - UDP_HEADER_SIZE - header_size;
+    if (header.length != body_len)
+        return false;
+    player_info *player = check_datagram(&udp);
+    if (NULL == player)
+        return false;
+    atomic_store_explicit(&player->udp_recv_ms, now_ms, memory_order_relaxed);
+
+    stats_thread_t *stats = stats_local();
+    if (UDP_BIND == header.type)
+    {
+        reply_bind(&udp, addr);
+        stats_add(&stats->recv_msgs[UDP_BIND], 1);
+        stats_add(&stats->recv_type_bytes[UDP_BIND], len - UDP_HEADER_SIZE);
+        return true;
+    }
+    if (GAME_UPDATE != header.type || (TRANSFORM_LEN != body_len && GAME_UPDATE_LEN != body_len))
+        return false;
+
+    // 数据报和 reactor 不是同一个 ready 队列生产者，同一个连接的 SOME_ONE_QUIT 可能先被处理，
+    // 所以入队之前先持有一个消息计数，由 handler 接管；持有之后再核对一次令牌，slot 可能刚刚换了主人
+    if (!try_plus_message_count(player))
+        return false;
+    if (udp.token != atomic_load_explicit(&player->udp_token, memory_order_acquire))
+    {
+        minus_message_count(player);
+        return false;
+    }
+    CQuery *query = get_free_query();
+    if (NULL == query || 0 != CQuery_reserve(query, GAME_UPDATE_LEN + header_size))
+    {
+        if (NULL != query)
+            add_free_list(query);
+        minus_message_count(player);
+        return false;
+    }
+    memcpy(query->m_byte_Query, player->id, PLAYER_ID_LEN);
+    memcpy(query->m_byte_Query + PLAYER_ID_LEN, body + body_len - TRANSFORM_LEN, TRANSFORM_LEN);
+    query->m_query_len = GAME_UPDATE_LEN;
+    query->m_header.type = GAME_UPDATE;
+    query->m_header.length = GAME_UPDATE_LEN;
+    query->m_socket_fd = player->socketfd;
+    query->m_pinned = player;
+    ready_batch[(*ready_num)++] = query;
+
+    // 第一条 GAME_UPDATE 说明客户端已经收到了 UDP_BIND 的回复，之后发给它的 GAME_UPDATE 改走 UDP；
+    // 客户端的地址变化（NAT 重新映射）时跟着更新
+    uint64_t packed = pack_udp_addr(addr);
+    if (packed != atomic_load_explicit(&player->udp_addr, memory_order_relaxed))
+    {
+        LOG_INFO("udp channel of %s bound to %s:%d.", player->id, inet_ntoa(addr->sin_addr), ntohs(addr->sin_port));
+        atomic_store_explicit(&player->udp_addr, packed, memory_order_relaxed);
+    }
+
+    stats_add(&stats->recv_msgs[GAME_UPDATE], 1);
+    stats_add(&stats->recv_type_bytes[GAME_UPDATE], len - UDP_HEADER_SIZE);
+    return true;
+}
+
+/**
+ * @brief UDP 通道的接收线程。
+ *
+ * 每次 recvmmsg 阻塞到第一个数据报到达（MSG_WAITFORONE），再把已经到达的最多 UDP_BATCH_NUM 个一起取出，
+ * 一批中所有的 GAME_UPDATE 一次放入 ready 队列。接收超时（WAIT_TIMEOUT_MS）之后检查 `g_over`。
+ */
+void *udp_channel_main(void *)
+{
+    stats_thread_t *stats = stats_register(STATS_THREAD_UDP, 0);
+    CQuery *ready_batch[UDP_BATCH_NUM];
+    while (!g_over)
+    {
+        for (int i = 0; i < UDP_BATCH_NUM; i++)
+            recv_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        COUNT_SYSCALL(1);
+        int num = recvmmsg(g_udp.socket, recv_msgs, UDP_BATCH_NUM, MSG_WAITFORONE, NULL);
+        if (0 > num)
+        {
+            if (EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno)
+                LOG_WARN("recvmmsg on udp channel failed: %s", strerror(errno));
+            continue;
+        }
+
+        uint64_t now_ms = stats_now_ns() / 1000000;
+        int ready_num = 0;
+        for (int i = 0; i < num; i++)
+        {
+            struct msghdr *hdr = &recv_msgs[i].msg_hdr;
+            if (0 == (hdr->msg_flags & MSG_TRUNC) && sizeof(struct sockaddr_in) == hdr->msg_namelen &&
+                handle_datagram(recv_buffers[i], recv_msgs[i].msg_len, &recv_addrs[i], now_ms, ready_batch,
+                                &ready_num))
+                stats_add(&stats->udp_recv, 1);
+            else
+                stats_add(&stats->udp_recv_dropped, 1);
+        }
+        add_gready_list_batch(ready_batch, ready_num);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 为一个 worker 创建数据报批次。
+ *
+ * @return 成功返回新的批次，内存分配失败返回 NULL。
+ */
+udp_batch_t *udp_batch_create()
+{
+    return (udp_batch_t *)calloc(1, sizeof(udp_batch_t));
+}
+
+void udp_batch_destroy(udp_batch_t *batch)
+{
+    if (NULL == batch)
+        return;
+    for (int i = 0; i < batch->num; i++)
+        frame_release(batch->frames[i]);
+    free(batch);
+}
+
+/**
+ * @brief 绑定了 UDP 通道的玩家，把发给它的 GAME_UPDATE 帧加入本轮的数据报中，不经过它的发送队列。
+ *
+ * 数据报的序号由发送队列所属的 worker 逐个分配（跳过 0）。批次满了时先发出。
+ *
+ * @return 帧已经加入批次时返回 true；玩家没有绑定 UDP 通道或者帧不是 GAME_UPDATE 时返回 false，由调用方走 TCP。
+ */
+bool udp_batch_add(udp_batch_t *batch, struct info_table *player, frame_t *frame)
+{
+    uint64_t packed = atomic_load_explicit(&player->udp_addr, memory_order_relaxed);
+    if (0 == packed)
+        return false;
+    MessageHeader header;
+    memcpy(&header, frame->data, header_size);
+    if (GAME_UPDATE != header.type)
+        return false;
+
+    if (UDP_BATCH_NUM == batch->num)
+        udp_batch_flush(batch);
+    int i = batch->num++;
+    if (0 == ++player->udp_send_seq)
+        ++player->udp_send_seq;
+    UdpHeader *udp = &batch->headers[i];
+    udp->token = atomic_load_explicit(&player->udp_token, memory_order_relaxed);
+    udp->slot = player->slot;
+    udp->reserved = 0;
+    udp->seq = player->udp_send_seq;
+    unpack_udp_addr(packed, &batch->addrs[i]);
+    batch->iov[i][0].iov_base = udp;
+    batch->iov[i][0].iov_len = UDP_HEADER_SIZE;
+    batch->iov[i][1].iov_base = frame->data;
+    batch->iov[i][1].iov_len = frame->len;
+    batch->frames[i] = frame_ref(frame);
+
+    struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->msg_name = &batch->addrs[i];
+    hdr->msg_namelen = sizeof(batch->addrs[i]);
+    hdr->msg_iov = batch->iov[i];
+    hdr->msg_iovlen = 2;
+
+    stats_thread_t *stats = stats_local();
+    stats_add(&stats->send_msgs[GAME_UPDATE], 1);
+    stats_add(&stats->send_type_bytes[GAME_UPDATE], frame->len);
+    return true;
+}
+
+/**
+ * @brief 用 sendmmsg 发出本轮所有的数据报，并释放它们引用的帧。
+ *
+ * 套接字发送缓冲区满（EAGAIN）时剩下的数据报直接丢弃，下一条状态会覆盖它们；
+ * 其他错误只影响出错的那一个数据报，跳过它继续发送。
+ */
+void udp_batch_flush(udp_batch_t *batch)
+{
+    if (0 == batch->num)
+        return;
+    int sent = 0, dropped = 0;
+    while (sent + dropped < batch->num)
+    {
+        COUNT_SYSCALL(1);
+        int n = sendmmsg(g_udp.socket, batch->msgs + sent + dropped, batch->num - sent - dropped, MSG_DONTWAIT);
+        if (0 < n)
+        {
+            sent += n;
+            continue;
+        }
+        if (EINTR == errno)
+            continue;
+        if (EAGAIN == errno || EWOULDBLOCK == errno)
+        {
+            dropped = batch->num - sent;
+            break;
+        }
+        LOG_WARN("sendmmsg on udp channel failed: %s", strerror(errno));
+        dropped++;
+    }
+
+    for (int i = 0; i < batch->num; i++)
+        frame_release(batch->frames[i]);
+    batch->num = 0;
+    stats_thread_t *stats = stats_local();
+    stats_add(&stats->udp_sent, sent);
+    stats_add(&stats->udp_send_dropped, dropped);
+}
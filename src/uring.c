@@ -0,0 +1,293 @@
+#include "uring.h"
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "util.h"
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t arg_size)
+{
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int sys_io_uring_register(int ring_fd, unsigned opcode, void *arg, unsigned arg_num)
+{
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, arg_num);
+}
+
+/**
+ * @brief 创建一个 io_uring 实例并把 SQ / CQ / SQE 数组映射到用户态。
+ *
+ * CQ 的大小设置为 SQ 的 4 倍：multishot accept / recv 一个 SQE 会产生多个 CQE，
+ * 这样在一轮处理完之前 CQ 不容易溢出。
+ *
+ * @param entries SQ 的大小。
+ * @return 成功返回 0，失败返回 -1（errno 为失败原因，内核不支持所需特性时为 ENOSYS）。
+ */
+int uring_init(uring_t *ring, unsigned entries)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    if (0 > (ring->ring_fd = sys_io_uring_setup(entries, &params)))
+        return -1;
+    ring->features = params.features;
+    // 等待时需要带超时（EXT_ARG），以便及时发现 g_over
+    if (!(ring->features & IORING_FEAT_EXT_ARG))
+    {
+        close(ring->ring_fd);
+        errno = ENOSYS;
+        return -1;
+    }
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (ring->features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cq_size > ring->sq_size)
+            ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ring->sq_ptr)
+        goto fail;
+    if (ring->features & IORING_FEAT_SINGLE_MMAP)
+        ring->cq_ptr = ring->sq_ptr;
+    else
+    {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == ring->cq_ptr)
+            goto fail;
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (MAP_FAILED == ring->sqes)
+        goto fail;
+
+    char *sq = (char *)ring->sq_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = *(unsigned *)(sq + params.sq_off.ring_entries);
+    ring->sqe_tail = *ring->sq_tail;
+    ring->sqe_submitted = ring->sqe_tail;
+    // SQE 总是按顺序使用，下标数组固定为恒等映射，之后不再修改
+    for (unsigned i = 0; i < ring->sq_entries; i++)
+        ring->sq_array[i] = i;
+
+    char *cq = (char *)ring->cq_ptr;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+
+fail:
+    uring_destroy(ring);
+    return -1;
+}
+
+void uring_destroy(uring_t *ring)
+{
+    if (NULL != ring->sqes && MAP_FAILED != (void *)ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+    if (NULL != ring->cq_ptr && MAP_FAILED != ring->cq_ptr && ring->cq_ptr != ring->sq_ptr)
+        munmap(ring->cq_ptr, ring->cq_size);
+    if (NULL != ring->sq_ptr && MAP_FAILED != ring->sq_ptr)
+        munmap(ring->sq_ptr, ring->sq_size);
+    if (0 <= ring->ring_fd)
+        close(ring->ring_fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+}
+
+/**
+ * @brief SQ 中还能准备多少个 SQE。
+ *
+ * 一条链接在一起（IOSQE_IO_LINK）的请求链必须在同一次 io_uring_enter 中提交，
+ * 调用方在准备一条链之前用它确认空间足够，不够就先 `uring_submit`。
+ */
+unsigned uring_sq_space(const uring_t *ring)
+{
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    return ring->sq_entries - (ring->sqe_tail - head);
+}
+
+/**
+ * @brief 取一个清零之后的空闲 SQE。
+ *
+ * @return SQ 已满时返回 NULL，调用方需要先 `uring_submit`。
+ */
+struct io_uring_sqe *uring_get_sqe(uring_t *ring)
+{
+    if (0 == uring_sq_space(ring))
+        return NULL;
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+/**
+ * @brief 发布所有已经准备好的 SQE，并（可选地）等待完成事件。
+ *
+ * 没有待提交的 SQE 并且不需要等待时不会进入内核。
+ *
+ * @param wait_num 至少等待多少个 CQE，0 表示只提交不等待。
+ * @param timeout_ms 等待的超时时间（毫秒），只在 wait_num > 0 时有意义。
+ * @return 成功返回提交的 SQE 数，失败返回 -errno（等待超时为 -ETIME）。
+ */
+int uring_submit(uring_t *ring, unsigned wait_num, int timeout_ms)
+{
+    unsigned to_submit = ring->sqe_tail - ring->sqe_submitted;
+    if (0 == to_submit && 0 == wait_num)
+        return 0;
+
+    // SQE 的内容必须在内核看到新的 tail 之前写完
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    if (wait_num > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    int result;
+    do
+    {
+        COUNT_SYSCALL(1);
+        result = sys_io_uring_enter(ring->ring_fd, to_submit, wait_num, flags,
+                                    wait_num > 0 ? &arg : NULL, wait_num > 0 ? sizeof(arg) : 0);
+    } while (0 > result && EINTR == errno);
+
+    if (0 > result)
+    {
+        // 超时之前提交的 SQE 也已经被内核消费
+        if (ETIME == errno)
+            ring->sqe_submitted = ring->sqe_tail;
+        return -errno;
+    }
+    ring->sqe_submitted += result;
+    return result;
+}
+
+/**
+ * @brief 查看 CQ 队头的完成事件，不进入内核。
+ *
+ * @return 没有完成事件时返回 NULL。处理完之后必须调用 `uring_cqe_seen`。
+ */
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring)
+{
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+void uring_cqe_seen(uring_t *ring)
+{
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 分配 entries 块大小为 buf_size 的接收缓冲区，并作为 provided buffer ring 注册到内核。
+ *
+ * @param bgid 缓冲区组编号，同一个 io_uring 实例内唯一。
+ * @param entries 缓冲区数量，必须是 2 的幂并且不超过 32768。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int uring_buf_ring_init(uring_t *ring, uring_buf_ring_t *buf_ring, uint16_t bgid, unsigned entries, unsigned buf_size)
+{
+    memset(buf_ring, 0, sizeof(*buf_ring));
+    if (0 == entries || 0 != (entries & (entries - 1)))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t ring_size = entries * sizeof(struct io_uring_buf);
+    void *ring_mem = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (MAP_FAILED == ring_mem)
+        return -1;
+    buf_ring->ring = (struct io_uring_buf_ring *)ring_mem;
+    buf_ring->entries = entries;
+    buf_ring->buf_size = buf_size;
+    buf_ring->bgid = bgid;
+    if (NULL == (buf_ring->base = (char *)malloc((size_t)entries * buf_size)))
+    {
+        munmap(ring_mem, ring_size);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring_mem;
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+    if (0 > sys_io_uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1))
+    {
+        free(buf_ring->base);
+        munmap(ring_mem, ring_size);
+        memset(buf_ring, 0, sizeof(*buf_ring));
+        return -1;
+    }
+
+    for (unsigned i = 0; i < entries; i++)
+        uring_buf_ring_recycle(buf_ring, (uint16_t)i);
+    uring_buf_ring_commit(buf_ring);
+    return 0;
+}
+
+void uring_buf_ring_destroy(uring_t *ring, uring_buf_ring_t *buf_ring)
+{
+    if (NULL == buf_ring->ring)
+        return;
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = buf_ring->bgid;
+    sys_io_uring_register(ring->ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    munmap(buf_ring->ring, buf_ring->entries * sizeof(struct io_uring_buf));
+    free(buf_ring->base);
+    memset(buf_ring, 0, sizeof(*buf_ring));
+}
+
+/**
+ * @brief 把编号为 bid 的缓冲区放回环中，调用 `uring_buf_ring_commit` 之后内核才能看到。
+ */
+void uring_buf_ring_recycle(uring_buf_ring_t *buf_ring, uint16_t bid)
+{
+    struct io_uring_buf *buf = &buf_ring->ring->bufs[buf_ring->tail & (buf_ring->entries - 1)];
+    buf->addr = (uint64_t)(uintptr_t)uring_buf_ring_get(buf_ring, bid);
+    buf->len = buf_ring->buf_size;
+    buf->bid = bid;
+    buf_ring->tail++;
+}
+
+void uring_buf_ring_commit(uring_buf_ring_t *buf_ring)
+{
+    __atomic_store_n(&buf_ring->ring->tail, buf_ring->tail, __ATOMIC_RELEASE);
+}
+
+#endif
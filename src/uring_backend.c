@@ -0,0 +1,352 @@
+#include "uring_backend.h"
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <poll.h>
+#include "uring.h"
+#include "query_list.h"
+
+// user_data 的低 3 位区分请求的种类，其余位是 reactor / player_info 指针（至少 8 字节对齐），
+// 唤醒用的 multishot poll 在其余位中存放被监视的 fd
+#define URING_TAG_ACCEPT 1
+#define URING_TAG_RECV 2
+#define URING_TAG_SEND 3
+#define URING_TAG_WAKEUP 4
+#define URING_TAG_CANCEL 5
+#define URING_TAG_MASK 7ull
+
+// 每个接收 reactor 的 io_uring 实例和 provided buffer ring
+typedef struct
+{
+    uring_t ring;
+    uring_buf_ring_t buf_ring;
+} uring_reactor_t;
+
+static uring_reactor_t uring_reactors[MAX_REACTOR_NUM];
+static uring_t sender_rings[MAX_WORKER_NUM];  // 每个发送 worker 一个，以 worker 编号为下标
+
+extern bool g_over;
+
+static inline uint64_t uring_pack(void *ptr, uint64_t tag)
+{
+    return (uint64_t)(uintptr_t)ptr | tag;
+}
+
+static inline void *uring_unpack_ptr(uint64_t user_data)
+{
+    return (void *)(uintptr_t)(user_data & ~URING_TAG_MASK);
+}
+
+/* 取一个空闲的 SQE，SQ 已满时先把已经准备好的提交掉 */
+static struct io_uring_sqe *get_sqe(uring_t *ring)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    if (NULL == sqe && 0 <= uring_submit(ring, 0, 0))
+        sqe = uring_get_sqe(ring);
+    return sqe;
+}
+
+/* 在监听套接字上挂一个 multishot accept，之后每个新连接产生一个 CQE */
+static void arm_accept(uring_reactor_t *uring_reactor, reactor_t *reactor)
+{
+    struct io_uring_sqe *sqe = get_sqe(&uring_reactor->ring);
+    if (NULL == sqe)
+    {
+        LOG_ERROR("(reactor %d) can't arm multishot accept.", reactor->id);
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = reactor->listen_socket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = uring_pack(reactor, URING_TAG_ACCEPT);
+}
+
+/* 为一个连接挂一个 multishot recv，数据写入内核从 buffer ring 中挑选的缓冲区 */
+static void arm_recv(uring_reactor_t *uring_reactor, player_info *info)
+{
+    struct io_uring_sqe *sqe = get_sqe(&uring_reactor->ring);
+    if (NULL == sqe)
+    {
+        LOG_ERROR("can't arm multishot recv for %s.", info->id);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = info->socketfd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = uring_reactor->buf_ring.bgid;
+    sqe->user_data = uring_pack(info, URING_TAG_RECV);
+}
+
+/**
+ * @brief 为接收 reactor 创建 io_uring 实例和 provided buffer ring（io_uring 后端下代替 epoll 实例）。
+ *
+ * @return 成功返回 0，失败返回 -1。
+ */
+int uring_reactor_init(reactor_t *reactor)
+{
+    uring_reactor_t *uring_reactor = &uring_reactors[reactor->id];
+    if (0 > uring_init(&uring_reactor->ring, URING_ENTRIES))
+    {
+        perror("io_uring_setup");
+        return -1;
+    }
+    if (0 > uring_buf_ring_init(&uring_reactor->ring, &uring_reactor->buf_ring, 0,
+                                URING_RECV_BUFFER_NUM, URING_RECV_BUFFER_SIZE))
+    {
+        perror("io_uring_register(IORING_REGISTER_PBUF_RING)");
+        uring_destroy(&uring_reactor->ring);
+        return -1;
+    }
+    return 0;
+}
+
+void uring_reactor_destroy(reactor_t *reactor)
+{
+    uring_reactor_t *uring_reactor = &uring_reactors[reactor->id];
+    uring_buf_ring_destroy(&uring_reactor->ring, &uring_reactor->buf_ring);
+    uring_destroy(&uring_reactor->ring);
+}
+
+/* 处理 multishot accept 产生的一个新连接 */
+static void handle_accept(uring_reactor_t *uring_reactor, reactor_t *reactor, int socketfd)
+{
+    CQuery *query = get_free_query();
+    if (NULL == query)
+    {
+        LOG_WARN("(reactor %d) no free query, reject connection.", reactor->id);
+        close(socketfd);
+        return;
+    }
+
+    player_info *info = NULL;
+    int result = CQuery_init_connection(query, socketfd, NULL, &info);
+    if (NO_ERROR != result)
+    {
+        printAcceptError(result);
+        return;
+    }
+    arm_recv(uring_reactor, info);
+    add_gready_list(query);
+    atomic_fetch_add_explicit(&reactor->accept_count, 1, memory_order_relaxed);
+}
+
+/* 处理 multishot recv 的一个完成事件 */
+static void handle_recv(uring_reactor_t *uring_reactor, reactor_t *reactor, player_info *info, struct io_uring_cqe *cqe)
+{
+    if (cqe->res > 0)
+    {
+        uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        int result = CQuery_recv_buffer(info, uring_buf_ring_get(&uring_reactor->buf_ring, bid), cqe->res);
+        // 数据已经拷贝进玩家的接收缓冲区，立即把缓冲区还给内核
+        uring_buf_ring_recycle(&uring_reactor->buf_ring, bid);
+        if (result > 0)
+            atomic_fetch_add_explicit(&reactor->recv_msg_count, result, memory_order_relaxed);
+    }
+    else if (-ENOBUFS != cqe->res)
+    {
+        // 对端关闭（res == 0）或者连接出错，multishot recv 随之结束
+        CQuery_notify_quit(info);
+        return;
+    }
+
+    // 缓冲区暂时耗尽（-ENOBUFS）等原因导致 multishot recv 结束时重新挂上
+    if (!(cqe->flags & IORING_CQE_F_MORE) && info->available)
+        arm_recv(uring_reactor, info);
+}
+
+/**
+ * @brief io_uring 后端下接收 reactor 的主循环，每个 reactor 一个线程。
+ *
+ * 每轮循环只调用一次 io_uring_enter：提交上一轮新挂上的 accept / recv 并等待完成事件，
+ * 然后在用户态直接遍历 CQ，处理完之后一次性把用过的接收缓冲区还给内核。
+ *
+ * @param arg 指向该线程负责的 `reactor_t`。
+ */
+void *uring_recv_main(void *arg)
+{
+    reactor_t *reactor = (reactor_t *)arg;
+    uring_reactor_t *uring_reactor = &uring_reactors[reactor->id];
+    uring_t *ring = &uring_reactor->ring;
+    stats_register(STATS_THREAD_REACTOR, reactor->id);
+    tls_reactor = reactor;
+    int timeout = TIME_OUT;
+
+    arm_accept(uring_reactor, reactor);
+    while (!g_over)
+    {
+        int result = uring_submit(ring, 1, timeout);
+        if (0 > result && -ETIME != result)
+            LOG_ERROR("(reactor %d) io_uring_enter error: %d", reactor->id, -result);
+        // 断开握手或者空闲超时的连接，shutdown 之后 multishot recv 以 0 结束，再次拆除时直接返回
+        timeout = reactor_expire_timers(reactor);
+
+        int cqe_num = 0;
+        struct io_uring_cqe *cqe;
+        while (NULL != (cqe = uring_peek_cqe(ring)))
+        {
+            void *ptr = uring_unpack_ptr(cqe->user_data);
+            switch (cqe->user_data & URING_TAG_MASK)
+            {
+            case URING_TAG_ACCEPT:
+                if (cqe->res >= 0)
+                    handle_accept(uring_reactor, reactor, cqe->res);
+                else
+                    LOG_ERROR("(reactor %d) accept error: %d", reactor->id, -cqe->res);
+                if (!(cqe->flags & IORING_CQE_F_MORE))
+                    arm_accept(uring_reactor, reactor);
+                break;
+            case URING_TAG_RECV:
+                handle_recv(uring_reactor, reactor, (player_info *)ptr, cqe);
+                break;
+            default:
+                break;
+            }
+            uring_cqe_seen(ring);
+            cqe_num++;
+        }
+        uring_buf_ring_commit(&uring_reactor->buf_ring);
+        LOG_DEBUG("(reactor %d) completion num: %d.", reactor->id, cqe_num);
+    }
+    return NULL;
+}
+
+/* 在 fd 上挂一个 multishot poll，fd 可读（handler 唤醒、tick 到达）时产生一个 CQE，让睡眠中的发送线程醒来 */
+static void arm_wakeup(uring_t *ring, int fd)
+{
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (NULL == sqe)
+        return;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = ((uint64_t)fd << 3) | URING_TAG_WAKEUP;
+}
+
+/**
+ * @brief 创建发送 worker 使用的 io_uring 实例。
+ *
+ * @param wakeup_fd work 队列唤醒器的 eventfd，发送线程睡眠在 io_uring 上时由它唤醒。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int uring_sender_init(worker_t *worker, int wakeup_fd)
+{
+    if (0 > uring_init(&sender_rings[worker->id], URING_ENTRIES))
+    {
+        perror("io_uring_setup");
+        return -1;
+    }
+    arm_wakeup(&sender_rings[worker->id], wakeup_fd);
+    return 0;
+}
+
+/**
+ * @brief 让发送线程睡眠时也等待 fd 可读（例如 tick 的 timerfd），fd 的内容由调用方自己读取。
+ */
+void uring_sender_add_wakeup_fd(worker_t *worker, int fd)
+{
+    arm_wakeup(&sender_rings[worker->id], fd);
+}
+
+void uring_sender_destroy(worker_t *worker)
+{
+    uring_destroy(&sender_rings[worker->id]);
+}
+
+/**
+ * @brief 把一个连接待发送的片段准备成一条链接在一起的 send 请求链，在下一次 `uring_sender_poll` 时提交。
+ *
+ * 链中的 send 按顺序执行，都带 MSG_WAITALL：只有前一个片段全部发送出去才会开始下一个，
+ * 某个 send 失败时后面的请求以 -ECANCELED 完成。每个请求完成时都会回调一次。
+ *
+ * @return 成功返回 0，SQ 放不下整条链时返回 -1。
+ */
+int uring_sender_send_chain(worker_t *worker, player_info *player, const struct iovec *iov, int iov_num)
+{
+    uring_t *sender_ring = &sender_rings[worker->id];
+    // 一条链必须在同一次 io_uring_enter 中提交，空间不够就先把已经准备好的提交掉
+    if (uring_sq_space(sender_ring) < (unsigned)iov_num)
+        uring_submit(sender_ring, 0, 0);
+    if (uring_sq_space(sender_ring) < (unsigned)iov_num)
+        return -1;
+
+    for (int i = 0; i < iov_num; i++)
+    {
+        struct io_uring_sqe *sqe = uring_get_sqe(sender_ring);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = player->socketfd;
+        sqe->addr = (uint64_t)(uintptr_t)iov[i].iov_base;
+        sqe->len = iov[i].iov_len;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        // 除最后一个之外都带 MSG_MORE，内核把整条链合并成尽量少的 TCP 段，效果和一次 writev 相同
+        if (i + 1 < iov_num)
+        {
+            sqe->msg_flags |= MSG_MORE;
+            sqe->flags = IOSQE_IO_LINK;
+        }
+        sqe->user_data = uring_pack(player, URING_TAG_SEND);
+    }
+    return 0;
+}
+
+/**
+ * @brief 取消一个连接所有还没有完成的 send（玩家退出时使用），被取消的请求照常产生完成事件。
+ */
+int uring_sender_cancel(worker_t *worker, player_info *player)
+{
+    struct io_uring_sqe *sqe = get_sqe(&sender_rings[worker->id]);
+    if (NULL == sqe)
+        return -1;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = uring_pack(player, URING_TAG_SEND);
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = uring_pack(NULL, URING_TAG_CANCEL);
+    return 0;
+}
+
+/**
+ * @brief 提交所有已经准备好的请求，并处理已经产生的完成事件。
+ *
+ * @param timeout_ms 大于 0 时至少等待一个完成事件（send 完成或者 handler 的唤醒），最多等待 timeout_ms 毫秒；
+ * 为 0 时只提交，不阻塞。
+ * @param on_complete send 完成时的回调。
+ * @return 处理的 send 完成事件数。
+ */
+int uring_sender_poll(worker_t *worker, int timeout_ms, send_complete_fn on_complete)
+{
+    uring_t *sender_ring = &sender_rings[worker->id];
+    int result = uring_submit(sender_ring, timeout_ms > 0 ? 1 : 0, timeout_ms);
+    if (0 > result && -ETIME != result)
+        LOG_ERROR("sender io_uring_enter error: %d", -result);
+
+    int send_num = 0;
+    struct io_uring_cqe *cqe;
+    while (NULL != (cqe = uring_peek_cqe(sender_ring)))
+    {
+        uint64_t user_data = cqe->user_data;
+        int res = cqe->res;
+        bool more = cqe->flags & IORING_CQE_F_MORE;
+        // 先归还 CQE，回调中可能会准备新的 SQE
+        uring_cqe_seen(sender_ring);
+
+        switch (user_data & URING_TAG_MASK)
+        {
+        case URING_TAG_SEND:
+            on_complete(worker, (player_info *)uring_unpack_ptr(user_data), res);
+            send_num++;
+            break;
+        case URING_TAG_WAKEUP:
+            // eventfd / timerfd 的计数由各自的使用者读空，这里只需要保证 poll 一直挂着
+            if (!more)
+                arm_wakeup(sender_ring, (int)(user_data >> 3));
+            break;
+        default:
+            break;
+        }
+    }
+    return send_num;
+}
+
+#endif
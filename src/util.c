@@ -1,22 +1,73 @@
 #include "util.h"
 
-void generate_uuid(char *uuid)
+// 每个 reactor 线程一份随机数池，一次 getrandom 取出 UUID_POOL_NUM 个 UUID 的随机字节
+static _Thread_local uint8_t uuid_pool[UUID_POOL_NUM][16];
+static _Thread_local int uuid_pool_left = 0;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/* 用 getrandom 把随机数池填满，被信号打断或者只读到一部分时继续读 */
+static int refill_uuid_pool()
 {
-    FILE *file = fopen("/proc/sys/kernel/random/uuid", "r");
-    if (file == NULL)
+    size_t have_read = 0;
+    while (have_read < sizeof(uuid_pool))
     {
-        perror("Error opening /proc/sys/kernel/random/uuid");
-        exit(EXIT_FAILURE);
+        COUNT_SYSCALL(1);
+        ssize_t n = getrandom((uint8_t *)uuid_pool + have_read, sizeof(uuid_pool) - have_read, 0);
+        if (0 > n)
+        {
+            if (EINTR == errno)
+                continue;
+            return -1;
+        }
+        have_read += n;
     }
+    uuid_pool_left = UUID_POOL_NUM;
+    return 0;
+}
 
-    if (fscanf(file, "%s", uuid) != 1)
+/**
+ * @brief 生成一个随机（v4）UUID，格式与 /proc/sys/kernel/random/uuid 相同：36 个字符的小写 8-4-4-4-12 形式。
+ *
+ * 随机字节从线程自己的随机数池中取，池空时才调用一次 getrandom，平均每个 UUID 的系统调用数为 1 / UUID_POOL_NUM。
+ *
+ * @param uuid 输出缓冲区，至少 PLAYER_ID_LEN + 1 字节，结果以 '\0' 结尾。
+ * @return 成功返回 0，getrandom 失败时返回 -1。
+ */
+int generate_uuid(char *uuid)
+{
+    if (0 == uuid_pool_left && 0 != refill_uuid_pool())
+        return -1;
+    uint8_t *bytes = uuid_pool[--uuid_pool_left];
+    bytes[6] = (bytes[6] & 0x0f) | 0x40; // 版本号 4
+    bytes[8] = (bytes[8] & 0x3f) | 0x80; // RFC 4122 变体
+
+    char *out = uuid;
+    for (int i = 0; i < 16; i++)
     {
-        perror("Error reading UUID");
-        fclose(file);
-        exit(EXIT_FAILURE);
+        if (4 == i || 6 == i || 8 == i || 10 == i)
+            *out++ = '-';
+        *out++ = hex_digits[bytes[i] >> 4];
+        *out++ = hex_digits[bytes[i] & 0x0f];
     }
+    *out = '\0';
+    return 0;
+}
 
-    fclose(file);
+/**
+ * @brief 生成一个非 0 的随机令牌（UDP 通道使用），和 UUID 共用线程的随机数池，但使用独立的一份随机字节。
+ *
+ * @return 成功返回 0，getrandom 失败时返回 -1。
+ */
+int generate_token(uint32_t *token)
+{
+    do
+    {
+        if (0 == uuid_pool_left && 0 != refill_uuid_pool())
+            return -1;
+        memcpy(token, uuid_pool[--uuid_pool_left], sizeof(*token));
+    } while (0 == *token);
+    return 0;
 }
 
 int setnonblocking(int sockfd)
@@ -27,13 +78,13 @@ int setnonblocking(int sockfd)
     opts = fcntl(sockfd, F_GETFL, 0);
     if (opts < 0)
     {
-        perror("fcntl(sock,GETFL)");
+        LOG_ERROR("fcntl(sock,GETFL) failed: %s", strerror(errno));
         return -1;
     }
     opts = opts | O_NONBLOCK;
     if (fcntl(sockfd, F_SETFL, opts) < 0)
     {
-        perror("fcntl(sock,SETFL,opts)");
+        LOG_ERROR("fcntl(sock,SETFL,opts) failed: %s", strerror(errno));
         return -1;
     }
 }
@@ -60,6 +111,7 @@ void print_addr_info(struct sockaddr_in *addr)
 int config_socket(int sockfd)
 {
     int one = 1;
+    COUNT_SYSCALL(9);   // 7 次 setsockopt + 2 次 fcntl
 
     // 设置 SO_REUSEADDR 选项，允许 socket 绑定到已使用的地址。
     // 这有助于在重启服务时，尽快重新绑定到相同的地址，而不会等待旧的连接完全关闭。
@@ -162,32 +214,12 @@ void printAcceptError(int result)
     if (result < 0 && result != RESOURCE_TEMPOREARILY_UNAVAILABLE)
     {
         if (result == RESOURCE_UNAVAILABLE)
-        {
-            printf("\033[31m%s\033[0m", "get_free_query error.");
-            printCurrentTime();
-            printf("\033[31m%s\033[0m", "debug: error occured in recv_res_main.\n");
-            perror("perror: get_free_query error.");
-        }
+            LOG_ERROR("get_free_query error: %s", strerror(errno));
         else if (result == SOCKET_ACCEPT_ERROR)
-        {
-            printf("\033[31m%s\033[0m", "CQuery_accept_tcp_connect error.");
-            printCurrentTime();
-            printf("\033[31m%s\033[0m", "debug: error occured in recv_res_main.\n");
-            perror("perror: CQuery_accept_tcp_connect error.");
-        }
+            LOG_ERROR("CQuery_accept_tcp_connect error: %s", strerror(errno));
         else if (result == SOCKET_CONFIGUE_ERROR)
-        {
-            printf("\033[31m%s\033[0m", "config_socket error.");
-            printCurrentTime();
-            printf("\033[31m%s\033[0m", "debug: error occured in recv_res_main.\n");
-            perror("perror: config_socket error.");
-        }
+            LOG_ERROR("config_socket error: %s", strerror(errno));
         else if (result == EPOLL_ERROR)
-        {
-            printf("\033[31m%s\033[0m", "epoll_ctl error.");
-            printCurrentTime();
-            printf("\033[31m%s\033[0m", "debug: error occured in recv_res_main.\n\n");
-            perror("perror: epoll_ctl error.");
-        }
+            LOG_ERROR("epoll_ctl error: %s", strerror(errno));
     }
 }
\ No newline at end of file
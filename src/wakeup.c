@@ -0,0 +1,153 @@
+#include "wakeup.h"
+#include "util.h"
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+
+/**
+ * @brief 初始化唤醒器。
+ *
+ * @param policy 等待策略。
+ * @param spin_num 自适应策略下进入睡眠之前的空转轮数。
+ * @return 成功返回 0，eventfd 创建失败返回 -1。
+ */
+int wakeup_init(wakeup_t *wakeup, wait_policy_t policy, int spin_num)
+{
+    if (0 > (wakeup->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)))
+        return -1;
+
+    atomic_init(&wakeup->sleeping, 0);
+    wakeup->policy = policy;
+    wakeup->spin_num = spin_num;
+    atomic_init(&wakeup->notify_count, 0);
+    atomic_init(&wakeup->park_count, 0);
+    return 0;
+}
+
+void wakeup_destroy(wakeup_t *wakeup)
+{
+    if (0 <= wakeup->event_fd)
+        close(wakeup->event_fd);
+    wakeup->event_fd = -1;
+}
+
+/**
+ * @brief 生产者在入队之后调用，必要时唤醒睡眠中的消费者。
+ *
+ * 入队操作与这里对 sleeping 的读取之间需要一个全屏障，和消费者那一侧
+ * “写 sleeping -> 全屏障 -> 检查队列”配对，保证两边至少有一方能看到对方的写入。
+ */
+void wakeup_notify(wakeup_t *wakeup)
+{
+    if (WAIT_POLICY_SPIN == wakeup->policy)
+        return;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (0 == atomic_load_explicit(&wakeup->sleeping, memory_order_relaxed))
+        return;
+    // 多个生产者同时发现消费者在睡眠时，只需要其中一个去写 eventfd
+    if (0 == atomic_exchange_explicit(&wakeup->sleeping, 0, memory_order_relaxed))
+        return;
+
+    uint64_t one = 1;
+    COUNT_SYSCALL(1);
+    while (0 > write(wakeup->event_fd, &one, sizeof(one)) && EINTR == errno)
+        ;
+    atomic_fetch_add_explicit(&wakeup->notify_count, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief 消费者在一轮没有取到任务之后调用，判断是否应该进入睡眠。
+ *
+ * @param idle_rounds 连续空闲的轮数，由调用方保存，取到任务时应清零。
+ * @return 需要睡眠时返回 true，否则返回 false（调用方继续轮询）。
+ */
+bool wakeup_should_park(wakeup_t *wakeup, int *idle_rounds)
+{
+    switch (wakeup->policy)
+    {
+    case WAIT_POLICY_PARK:
+        return true;
+    case WAIT_POLICY_ADAPTIVE:
+        if (++(*idle_rounds) < wakeup->spin_num)
+            return false;
+        *idle_rounds = 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 宣告消费者即将睡眠。调用之后必须再检查一次队列，
+ * 如果队列不为空就直接调用 `wakeup_end_park`，否则阻塞在 event_fd 上。
+ */
+void wakeup_begin_park(wakeup_t *wakeup)
+{
+    atomic_store_explicit(&wakeup->sleeping, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/**
+ * @brief 消费者醒来（或放弃睡眠）之后调用，清除睡眠标志并读空 eventfd 的计数。
+ */
+void wakeup_end_park(wakeup_t *wakeup)
+{
+    atomic_store_explicit(&wakeup->sleeping, 0, memory_order_relaxed);
+
+    uint64_t count;
+    do
+        COUNT_SYSCALL(1);
+    while (0 < read(wakeup->event_fd, &count, sizeof(count)));
+}
+
+/**
+ * @brief 消费者队列为空时的通用等待逻辑。
+ *
+ * - SPIN：只让出 CPU，立即返回；
+ * - PARK / ADAPTIVE：在需要睡眠时，按照“宣告睡眠 -> 二次检查 -> poll(eventfd)”的顺序阻塞，
+ *   最多等待 timeout_ms 毫秒，这样消费者仍然能定期检查 g_over 等退出条件。
+ *
+ * @param idle_rounds 连续空闲的轮数，由调用方保存。
+ * @param has_work 判断队列是否有任务的回调。
+ * @param arg 传给 has_work 的参数。
+ * @param timeout_ms 最长睡眠时间（毫秒）。
+ */
+void wakeup_idle(wakeup_t *wakeup, int *idle_rounds, has_work_fn has_work, void *arg, int timeout_ms)
+{
+    if (!wakeup_should_park(wakeup, idle_rounds))
+    {
+        // 单核机器上空转会和生产者抢时间片，自旋时也让出一下 CPU
+        sched_yield();
+        return;
+    }
+
+    wakeup_begin_park(wakeup);
+    if (!has_work(arg))
+    {
+        atomic_fetch_add_explicit(&wakeup->park_count, 1, memory_order_relaxed);
+        struct pollfd pfd;
+        pfd.fd = wakeup->event_fd;
+        pfd.events = POLLIN;
+        COUNT_SYSCALL(1);
+        poll(&pfd, 1, timeout_ms);
+    }
+    wakeup_end_park(wakeup);
+}
+
+const char *wait_policy_name(wait_policy_t policy)
+{
+    switch (policy)
+    {
+    case WAIT_POLICY_SPIN:
+        return "spin";
+    case WAIT_POLICY_PARK:
+        return "park";
+    case WAIT_POLICY_ADAPTIVE:
+        return "adaptive";
+    default:
+        return "unknown";
+    }
+}
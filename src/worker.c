@@ -0,0 +1,111 @@
+#include "worker.h"
+#include "send_req.h"
+#include "uring_backend.h"
+#include <unistd.h>
+
+/**
+ * @brief 按照 g_pconf 中的配置创建所有发送 worker。
+ *
+ * 每个 worker 拥有自己的 work 队列、唤醒器、发送 epoll 和 tick，work 队列的 eventfd 与 tick 的 timerfd
+ * 都注册在发送 epoll 中，发送线程睡眠时能被 handler 的唤醒和 tick 及时叫醒。
+ * 开启了 UDP 通道时每个 worker 另外分配自己的数据报批次，所以必须在 `init_udp_channel` 之后调用。
+ * io_uring 后端下每个 worker 另外创建自己的发送 io_uring 实例，eventfd / timerfd 以 multishot poll 的方式挂在其中。
+ *
+ * @return 成功返回 0，内存分配失败返回 -1，epoll / io_uring / timerfd 创建失败返回 -2。
+ */
+int init_workers()
+{
+    g_worker_num = g_pconf->worker_num;
+    for (int i = 0; i < g_worker_num; i++)
+    {
+        worker_t *worker = &g_workers[i];
+        worker->id = i;
+        worker->dirty_player_num = 0;
+        worker->wait_writable_num = 0;
+        worker->migrating_num = 0;
+        worker->tick_room_num = 0;
+        worker->next_ping_ns = 0;
+        worker->udp = NULL;
+        worker->world = NULL;
+
+        if (0 != spsc_ring_init(&worker->work_ring, g_query_num))
+            return -1;
+        if (0 != wakeup_init(&worker->work_wakeup, g_pconf->wait_policy, g_pconf->spin_num))
+            return -2;
+        if (0 > (worker->send_epoll_fd = epoll_create(MAX_EPOLL_EVENT)))
+            return -2;
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &worker->work_wakeup;
+        if (0 > epoll_ctl(worker->send_epoll_fd, EPOLL_CTL_ADD, worker->work_wakeup.event_fd, &ev))
+            return -2;
+#ifdef HAVE_IO_URING
+        if (IO_BACKEND_URING == g_pconf->io_backend && 0 != uring_sender_init(worker, worker->work_wakeup.event_fd))
+            return -2;
+#endif
+
+        if (0 != tick_init(&worker->tick, g_pconf->tick_rate))
+            return -2;
+        if (tick_enabled(&worker->tick))
+        {
+            ev.events = EPOLLIN;
+            ev.data.ptr = &worker->tick;
+            if (0 > epoll_ctl(worker->send_epoll_fd, EPOLL_CTL_ADD, worker->tick.timer_fd, &ev))
+                return -2;
+#ifdef HAVE_IO_URING
+            if (IO_BACKEND_URING == g_pconf->io_backend)
+                uring_sender_add_wakeup_fd(worker, worker->tick.timer_fd);
+#endif
+        }
+        if (0 != interest_grid_init(&worker->interest, g_pconf->interest_radius))
+            return -1;
+        if (udp_enabled() && NULL == (worker->udp = udp_batch_create()))
+            return -1;
+        if (g_pconf->delta_snapshot &&
+            NULL == (worker->world = (snapshot_record_t *)calloc(MAX_CONNECTION_NUM, sizeof(snapshot_record_t))))
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 为每个 worker 启动一个运行 `send_req_main` 的发送线程。
+ *
+ * @return 成功返回 0，线程创建失败返回 -1。
+ */
+int start_workers()
+{
+    for (int i = 0; i < g_worker_num; i++)
+    {
+        if (0 != pthread_create(&g_workers[i].pid, NULL, send_req_main, &g_workers[i]))
+            return -1;
+    }
+    return 0;
+}
+
+void join_workers()
+{
+    for (int i = 0; i < g_worker_num; i++)
+        pthread_join(g_workers[i].pid, NULL);
+}
+
+void destroy_workers()
+{
+    for (int i = 0; i < g_worker_num; i++)
+    {
+        worker_t *worker = &g_workers[i];
+#ifdef HAVE_IO_URING
+        if (IO_BACKEND_URING == g_pconf->io_backend)
+            uring_sender_destroy(worker);
+#endif
+        close(worker->send_epoll_fd);
+        spsc_ring_destroy(&worker->work_ring);
+        wakeup_destroy(&worker->work_wakeup);
+        tick_destroy(&worker->tick);
+        interest_grid_destroy(&worker->interest);
+        free(worker->world);
+        worker->world = NULL;
+        udp_batch_destroy(worker->udp);
+        worker->udp = NULL;
+    }
+}
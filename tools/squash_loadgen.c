@@ -0,0 +1,997 @@
+/**
+ * squash_loadgen：模拟大量游戏客户端，对服务器施加负载并测量连接耗时、转发延迟和吞吐量。
+ *
+ * 每个模拟玩家是一个非阻塞的 TCP 连接，按照 `binary_protocol.h` 中的帧格式完成与 Godot 客户端相同的握手：
+ * 收到 RESPONSE_UUID 之后发送 PLAYER_INFO_CERT（房间号 = 玩家编号 % 房间数，-C 时带上紧凑 id 标志），
+ * 收到 GLOBAL_PLAYER_INFO 之后发送 CLIENT_READY。全部玩家就绪之后，每个玩家以 -r Hz 的频率发送 GAME_UPDATE，
+ * 同一个线程中的玩家在一个发送周期内均匀错开。
+ *
+ * GAME_UPDATE 中的 Transform3D 是合法的 var_to_bytes 格式：basis 的前 12 个字节换成发送时刻（CLOCK_MONOTONIC）和玩家编号，
+ * origin 是玩家在 -x 大小的世界中随机游走的位置，兴趣管理照常生效。收到 GAME_UPDATE、GAME_SNAPSHOT 以及
+ * GAME_SNAPSHOT_DELTA 中的完整记录时，用当前时刻减去记录中的发送时刻得到转发延迟。发送方和接收方都在本进程中，
+ * 服务器在其他机器上时延迟同样有效。压测程序不回复 SNAPSHOT_ACK，增量快照模式下服务器总是下发完整记录。
+ * 服务器的 PING 立即原样回复 PONG，服务器据此统计每个玩家的往返时间（`squash_stat`）。
+ *
+ * -U 时使用服务器的 UDP 通道（服务器需要以 `-u` 启动）：收到带令牌的 RESPONSE_UUID 之后为每个玩家创建一个 UDP 套接字，
+ * 反复发送 UDP_BIND 直到收到回复，之后 GAME_UPDATE 改为通过 UDP 发送，服务器转发过来的 GAME_UPDATE 也从 UDP 收取，
+ * 比已经收到的更旧的数据报按序号丢弃并计数。还没有绑定的玩家照常走 TCP。
+ *
+ * -l / -j 在压测程序内部模拟有损的网络（不需要 netem），只作用于状态消息（GAME_UPDATE、GAME_SNAPSHOT、
+ * GAME_SNAPSHOT_DELTA），收发两个方向都生效，握手、PING / PONG 等控制消息不受影响：
+ * - 每条状态消息以 -l 的概率丢失：UDP 上直接丢弃；TCP 会重传，丢失变成晚到 LOADGEN_RTO_NS（Linux 的最小 RTO），
+ *   排在它后面的消息也要等它送达（队头阻塞）；
+ * - 每条状态消息再随机延迟 [0, -j] 毫秒：UDP 上的数据报因此可能乱序，变成过期的数据报；TCP 上仍然按顺序送达。
+ * 发送方向的消息在压测程序中暂存到送达时刻再写入套接字；接收方向的 TCP 帧按模拟的送达时刻计算转发延迟，
+ * UDP 数据报暂存到送达时刻再按序号检查。
+ *
+ * 前 -w 秒为预热，不计入统计；之后的 -d 秒中每秒输出一次收发速率，结束时输出握手耗时、转发延迟的分位数和吞吐量。
+ *
+ * 用法：squash_loadgen <port> [-h host] [-c clients] [-t threads] [-g rooms] [-r rate_hz] [-d seconds] [-w seconds]
+ *                      [-x world_size] [-C] [-U]
+ *                      [-l loss_pct] [-j delay_ms]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include "binary_protocol.h"
+#include "config.h"
+#include "stats.h"
+#include "snapshot.h"
+
+#define LOADGEN_MAX_THREAD_NUM 64
+#define LOADGEN_OUT_BUFFER_SIZE 4096
+#define LOADGEN_IN_BUFFER_SIZE 4096
+#define LOADGEN_TRANSFORM_TYPE 18 /*Godot 4 中 Variant::TRANSFORM3D 的类型号*/
+#define LOADGEN_STAMP_OFFSET 4    /*Transform3D 中存放发送时刻的偏移，紧跟在类型号之后*/
+#define LOADGEN_ORIGIN_OFFSET (TRANSFORM_LEN - 3 * sizeof(float))
+#define LOADGEN_BIND_INTERVAL_NS 100000000ull /*没有收到回复时重发 UDP_BIND 的间隔*/
+#define LOADGEN_UDP_TAG 1ull /*UDP 套接字的 epoll 事件携带的 client 指针打上最低位，和 TCP 连接区分*/
+#define LOADGEN_RTO_NS 200000000ull /*模拟的 TCP 丢包重传超时，取 Linux 的最小 RTO（200 ms）*/
+#define LOADGEN_DELAYED_SIZE (UDP_HEADER_SIZE + sizeof(MessageHeader) + GAME_UPDATE_LEN) /*暂存的一条消息的最大长度*/
+
+typedef enum
+{
+    CLIENT_CONNECTING,
+    CLIENT_WAIT_UUID,
+    CLIENT_WAIT_INFO,
+    CLIENT_READY_STATE,
+    CLIENT_FAILED,
+} client_state_t;
+
+typedef struct
+{
+    int index;                      // 玩家编号
+    int sockfd;
+    client_state_t state;
+    uint64_t connect_ns;            // 发起连接的时刻
+    char id[PLAYER_ID_LEN];
+    float x, z;                     // 当前位置
+    char *in;                       // 接收缓冲区，一个帧放不下时扩大到帧的长度
+    size_t in_cap;
+    size_t in_len;
+    char out[LOADGEN_OUT_BUFFER_SIZE]; // 没有写出去的数据
+    size_t out_len;
+    int udp_fd;                     // UDP 通道的套接字（-U），-1 表示没有
+    uint32_t udp_token;             // RESPONSE_UUID 中下发的令牌
+    uint16_t slot;                  // RESPONSE_UUID 中下发的 slot id
+    bool udp_bound;                 // 已经收到 UDP_BIND 的回复
+    uint64_t udp_bind_ns;           // 最近一次发送 UDP_BIND 的时刻
+    uint32_t udp_send_seq;
+    uint32_t udp_recv_seq;          // 最近一次收到的数据报序号，0 表示还没有收到过
+    uint64_t tcp_send_due;          // TCP 上最近一条状态消息模拟的送达时刻（-l / -j），之后的消息不早于它送达
+    uint64_t tcp_recv_due;
+} client_t;
+
+typedef enum
+{
+    DELAYED_SEND_TCP,               // 暂存的上行 GAME_UPDATE 消息体，送达时刻写入 TCP 连接
+    DELAYED_SEND_UDP,               // 暂存的上行数据报（已经分配好序号），送达时刻发出
+    DELAYED_RECV_UDP,               // 暂存的下行数据报，送达时刻再按序号检查、处理
+} delayed_kind_t;
+
+/* 模拟延迟中的一条消息，按 (due_ns, order) 放在每个线程的小根堆中 */
+typedef struct
+{
+    uint64_t due_ns;
+    uint64_t order;                 // 暂存的先后顺序，送达时刻相同时保持顺序
+    client_t *client;
+    delayed_kind_t kind;
+    uint16_t len;
+    char data[LOADGEN_DELAYED_SIZE];
+} delayed_t;
+
+typedef struct
+{
+    int id;
+    pthread_t pid;
+    int epoll_fd;
+    client_t *clients;
+    int client_num;
+    int ready_num;                  // 已经完成握手的玩家数
+    int failed_num;
+    uint64_t handshake_hist[STATS_HIST_BUCKET_NUM];
+    uint64_t latency_hist[STATS_HIST_BUCKET_NUM];
+    uint64_t latency_sum;
+    atomic_uint_fast64_t sent;      // 测量期间发出的 GAME_UPDATE 数
+    atomic_uint_fast64_t dropped;   // 发送缓冲区满而没有发出去的 GAME_UPDATE 数
+    atomic_uint_fast64_t received;  // 测量期间收到的更新记录数
+    atomic_uint_fast64_t frames;    // 测量期间收到的帧数
+    atomic_uint_fast64_t bytes;     // 测量期间收到的字节数
+    atomic_uint_fast64_t disconnects;
+    atomic_uint_fast64_t udp_bound; // 绑定了 UDP 通道的玩家数
+    atomic_uint_fast64_t udp_stale; // 测量期间因为序号更旧而丢弃的数据报数
+    atomic_uint_fast64_t lost;      // 测量期间模拟丢失的状态消息数（TCP 上为重传的消息数）
+    unsigned impair_seed;
+    delayed_t *delayed;             // 模拟延迟中的消息，小根堆
+    int delayed_num;
+    int delayed_cap;
+    uint64_t delayed_order;
+} loadgen_thread_t;
+
+static const char *loadgen_host = "127.0.0.1";
+static uint16_t loadgen_port = 0;
+static int loadgen_client_num = 100;
+static int loadgen_thread_num = 1;
+static int loadgen_room_num = 1;
+static int loadgen_rate = 20;
+static int loadgen_duration = 10;
+static int loadgen_warmup = 1;
+static float loadgen_world = 100;
+static bool loadgen_compact = false;
+static bool loadgen_udp = false;
+static double loadgen_loss = 0;     // 状态消息的丢失率（百分比）
+static int loadgen_delay_ms = 0;    // 状态消息的最大随机延迟
+
+static loadgen_thread_t loadgen_threads[LOADGEN_MAX_THREAD_NUM];
+static atomic_int loadgen_ready_threads = 0;
+static atomic_bool loadgen_sending = false;     // 全部玩家就绪之后开始发送
+static atomic_bool loadgen_measuring = false;   // 预热结束之后开始统计
+static atomic_bool loadgen_over = false;
+
+static void hist_add(uint64_t *hist, uint64_t ns)
+{
+    hist[stats_bucket(ns)]++;
+}
+
+/* 直方图的第 q 分位数，在所在桶的上下界之间线性插值 */
+static double hist_quantile(const uint64_t *hist, uint64_t count, double q)
+{
+    double rank = q * count;
+    uint64_t seen = 0;
+    for (int b = 0; b < STATS_HIST_BUCKET_NUM; b++)
+    {
+        if (0 == hist[b])
+            continue;
+        if (seen + hist[b] >= rank)
+        {
+            double lower = stats_bucket_lower(b);
+            double upper = b + 1 < STATS_HIST_BUCKET_NUM ? stats_bucket_lower(b + 1) : lower;
+            return lower + (upper - lower) * (rank - seen) / hist[b];
+        }
+        seen += hist[b];
+    }
+    return 0;
+}
+
+static void print_hist(const char *name, const uint64_t *hist)
+{
+    uint64_t count = 0;
+    for (int b = 0; b < STATS_HIST_BUCKET_NUM; b++)
+        count += hist[b];
+    printf("  %-10s count=%" PRIu64, name, count);
+    if (0 != count)
+        printf(" p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus", hist_quantile(hist, count, 0.5) / 1e3,
+               hist_quantile(hist, count, 0.9) / 1e3, hist_quantile(hist, count, 0.99) / 1e3,
+               hist_quantile(hist, count, 0.999) / 1e3);
+    printf("\n");
+}
+
+/* 尽量写出发送缓冲区中的数据，连接出错时返回 -1 */
+static int client_flush(client_t *client)
+{
+    size_t have_write = 0;
+    while (have_write < client->out_len)
+    {
+        ssize_t n = write(client->sockfd, client->out + have_write, client->out_len - have_write);
+        if (n < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+                break;
+            return -1;
+        }
+        have_write += n;
+    }
+    memmove(client->out, client->out + have_write, client->out_len - have_write);
+    client->out_len -= have_write;
+    return 0;
+}
+
+/* 按照上行格式（消息头中的长度只包含消息体）追加一个消息，发送缓冲区放不下时返回 -1 */
+static int client_send(client_t *client, MessageType type, const void *body, uint16_t body_len)
+{
+    if (client->out_len + sizeof(MessageHeader) + body_len > LOADGEN_OUT_BUFFER_SIZE)
+        return -1;
+    MessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = type;
+    header.length = body_len;
+    memcpy(client->out + client->out_len, &header, sizeof(header));
+    memcpy(client->out + client->out_len + sizeof(header), body, body_len);
+    client->out_len += sizeof(header) + body_len;
+    return client_flush(client);
+}
+
+static void client_fail(loadgen_thread_t *thread, client_t *client)
+{
+    if (CLIENT_FAILED == client->state)
+        return;
+    if (CLIENT_READY_STATE == client->state)
+        atomic_fetch_add_explicit(&thread->disconnects, 1, memory_order_relaxed);
+    else
+        thread->failed_num++;
+    client->state = CLIENT_FAILED;
+    epoll_ctl(thread->epoll_fd, EPOLL_CTL_DEL, client->sockfd, NULL);
+    close(client->sockfd);
+    client->sockfd = -1;
+    if (0 <= client->udp_fd)
+    {
+        close(client->udp_fd);
+        client->udp_fd = -1;
+    }
+}
+
+/* 按 UdpHeader + 上行格式的消息组装一个数据报，分配下一个序号，返回数据报的长度 */
+static int client_pack_udp(client_t *client, MessageType type, const void *body, uint16_t body_len, char *datagram)
+{
+    UdpHeader udp = {.token = client->udp_token, .slot = client->slot, .reserved = 0, .seq = ++client->udp_send_seq};
+    MessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = type;
+    header.length = body_len;
+    memcpy(datagram, &udp, UDP_HEADER_SIZE);
+    memcpy(datagram + UDP_HEADER_SIZE, &header, sizeof(header));
+    memcpy(datagram + UDP_HEADER_SIZE + sizeof(header), body, body_len);
+    return UDP_HEADER_SIZE + sizeof(header) + body_len;
+}
+
+/* 通过 UDP 通道发送一条消息，发送缓冲区满时返回 -1 */
+static int client_send_udp(client_t *client, MessageType type, const void *body, uint16_t body_len)
+{
+    char datagram[LOADGEN_DELAYED_SIZE];
+    if (body_len > GAME_UPDATE_LEN)
+        return -1;
+    int len = client_pack_udp(client, type, body, body_len, datagram);
+    return 0 > send(client->udp_fd, datagram, len, MSG_DONTWAIT) ? -1 : 0;
+}
+
+static bool impair_enabled(void)
+{
+    return loadgen_loss > 0 || loadgen_delay_ms > 0;
+}
+
+/*
+ * 为一条状态消息抽取模拟的额外延迟：以 -l 的概率丢失，另外随机延迟 [0, -j] 毫秒。
+ * 可靠的（TCP）消息丢失之后等一个 RTO 重传；不可靠的（UDP）消息丢失时返回 -1。
+ */
+static int64_t impair_delay_ns(loadgen_thread_t *thread, bool reliable)
+{
+    int64_t delay = (int64_t)((double)rand_r(&thread->impair_seed) / RAND_MAX * loadgen_delay_ms * 1000000);
+    if ((double)rand_r(&thread->impair_seed) / RAND_MAX * 100 >= loadgen_loss)
+        return delay;
+    if (atomic_load_explicit(&loadgen_measuring, memory_order_relaxed))
+        atomic_fetch_add_explicit(&thread->lost, 1, memory_order_relaxed);
+    return reliable ? (int64_t)LOADGEN_RTO_NS + delay : -1;
+}
+
+/* TCP 上的消息按顺序送达：模拟的送达时刻不早于同一个方向上一条消息的送达时刻 */
+static uint64_t impair_tcp_due(uint64_t *last_due, uint64_t now, int64_t delay)
+{
+    uint64_t due = now + delay;
+    if (due < *last_due)
+        due = *last_due;
+    *last_due = due;
+    return due;
+}
+
+static bool delayed_before(const delayed_t *a, const delayed_t *b)
+{
+    return a->due_ns < b->due_ns || (a->due_ns == b->due_ns && a->order < b->order);
+}
+
+/* 把一条消息放入模拟延迟的小根堆，内存不足时丢弃并返回 -1 */
+static int delayed_push(loadgen_thread_t *thread, client_t *client, delayed_kind_t kind, uint64_t due_ns,
+                        const void *data, int len)
+{
+    if (thread->delayed_num == thread->delayed_cap)
+    {
+        int cap = thread->delayed_cap ? 2 * thread->delayed_cap : 1024;
+        delayed_t *delayed = (delayed_t *)realloc(thread->delayed, cap * sizeof(delayed_t));
+        if (NULL == delayed)
+            return -1;
+        thread->delayed = delayed;
+        thread->delayed_cap = cap;
+    }
+    delayed_t item = {.due_ns = due_ns, .order = thread->delayed_order++, .client = client, .kind = kind, .len = len};
+    memcpy(item.data, data, len);
+    int i = thread->delayed_num++;
+    while (0 < i && delayed_before(&item, &thread->delayed[(i - 1) / 2]))
+    {
+        thread->delayed[i] = thread->delayed[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    thread->delayed[i] = item;
+    return 0;
+}
+
+static void delayed_pop(loadgen_thread_t *thread, delayed_t *top)
+{
+    *top = thread->delayed[0];
+    delayed_t last = thread->delayed[--thread->delayed_num];
+    int i = 0;
+    while (2 * i + 1 < thread->delayed_num)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < thread->delayed_num && delayed_before(&thread->delayed[child + 1], &thread->delayed[child]))
+            child++;
+        if (!delayed_before(&thread->delayed[child], &last))
+            break;
+        thread->delayed[i] = thread->delayed[child];
+        i = child;
+    }
+    thread->delayed[i] = last;
+}
+
+/* 为玩家创建连接到服务器的 UDP 套接字并发送第一个 UDP_BIND，失败时玩家继续只用 TCP */
+static void client_open_udp(loadgen_thread_t *thread, client_t *client)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(loadgen_port);
+    inet_pton(AF_INET, loadgen_host, &addr.sin_addr);
+
+    client->udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (0 > client->udp_fd)
+        return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.u64 = (uint64_t)(uintptr_t)client | LOADGEN_UDP_TAG;
+    if (0 > connect(client->udp_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        0 > epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, client->udp_fd, &ev))
+    {
+        close(client->udp_fd);
+        client->udp_fd = -1;
+        return;
+    }
+    client->udp_bind_ns = stats_now_ns();
+    client_send_udp(client, UDP_BIND, NULL, 0);
+}
+
+static void client_connect(loadgen_thread_t *thread, client_t *client)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(loadgen_port);
+    inet_pton(AF_INET, loadgen_host, &addr.sin_addr);
+
+    client->state = CLIENT_CONNECTING;
+    client->connect_ns = stats_now_ns();
+    client->sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (0 > client->sockfd)
+    {
+        thread->failed_num++;
+        client->state = CLIENT_FAILED;
+        return;
+    }
+    int one = 1;
+    setsockopt(client->sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+    ev.data.ptr = client;
+    if ((0 > connect(client->sockfd, (struct sockaddr *)&addr, sizeof(addr)) && EINPROGRESS != errno) ||
+        0 > epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, client->sockfd, &ev))
+    {
+        thread->failed_num++;
+        client->state = CLIENT_FAILED;
+        close(client->sockfd);
+        client->sockfd = -1;
+    }
+}
+
+/* 一条 Transform3D 记录：发送时刻之后是发送方的编号，统计期间记录转发延迟 */
+static void handle_transform(loadgen_thread_t *thread, const char *transform, uint64_t now, bool measuring)
+{
+    uint64_t sent_ns;
+    memcpy(&sent_ns, transform + LOADGEN_STAMP_OFFSET, sizeof(sent_ns));
+    if (!measuring || 0 == sent_ns || sent_ns > now)
+        return;
+    hist_add(thread->latency_hist, now - sent_ns);
+    thread->latency_sum += now - sent_ns;
+    atomic_fetch_add_explicit(&thread->received, 1, memory_order_relaxed);
+}
+
+/* 逐条取出 GAME_SNAPSHOT_DELTA 中的完整记录，其余两种记录只跳过 */
+static void handle_delta(loadgen_thread_t *thread, const char *body, size_t len, uint64_t now, bool measuring)
+{
+    size_t id_len = loadgen_compact ? SLOT_ID_LEN : PLAYER_ID_LEN;
+    size_t p = 2 * sizeof(uint32_t);
+    while (p < len)
+    {
+        uint8_t tag = (uint8_t)body[p++];
+        if (SNAPSHOT_RECORD_FULL == tag && p + id_len + TRANSFORM_LEN <= len)
+        {
+            handle_transform(thread, body + p + id_len, now, measuring);
+            p += id_len + TRANSFORM_LEN;
+        }
+        else if (SNAPSHOT_RECORD_DELTA == tag && p + 4 <= len)
+        {
+            uint16_t mask;
+            memcpy(&mask, body + p + 2, sizeof(mask));
+            p += 4 + 4 * __builtin_popcount(mask);
+        }
+        else
+            p += 4;
+    }
+}
+
+/* 处理一个完整的下行帧（消息头中的长度包含消息头），now 为帧送达的时刻 */
+static void handle_frame(loadgen_thread_t *thread, client_t *client, const MessageHeader *header, const char *body,
+                         size_t len, uint64_t now)
+{
+    bool measuring = atomic_load_explicit(&loadgen_measuring, memory_order_relaxed);
+    if (measuring)
+    {
+        atomic_fetch_add_explicit(&thread->frames, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&thread->bytes, header->length, memory_order_relaxed);
+    }
+    switch (header->type)
+    {
+    case RESPONSE_UUID:
+        if (CLIENT_WAIT_UUID == client->state && len >= PLAYER_ID_LEN)
+        {
+            memcpy(client->id, body, PLAYER_ID_LEN);
+            // '\0' 之后是 slot id，服务器开启了 UDP 通道时再跟上令牌
+            if (loadgen_udp && len >= PLAYER_ID_LEN + 1 + SLOT_ID_LEN + UDP_TOKEN_LEN)
+            {
+                memcpy(&client->slot, body + PLAYER_ID_LEN + 1, SLOT_ID_LEN);
+                memcpy(&client->udp_token, body + PLAYER_ID_LEN + 1 + SLOT_ID_LEN, UDP_TOKEN_LEN);
+                client_open_udp(thread, client);
+            }
+            uint32_t cert[2] = {(uint32_t)(client->index % loadgen_room_num), loadgen_compact ? PROTOCOL_FLAG_COMPACT_ID : 0};
+            client->state = CLIENT_WAIT_INFO;
+            if (0 > client_send(client, PLAYER_INFO_CERT, cert, sizeof(cert)))
+                client_fail(thread, client);
+        }
+        break;
+    case GLOBAL_PLAYER_INFO:
+        if (CLIENT_WAIT_INFO == client->state)
+        {
+            char ready[PLAYER_ID_LEN + MAX_PLAYER_NAME_LEN + 1];
+            memcpy(ready, client->id, PLAYER_ID_LEN);
+            int name_len = snprintf(ready + PLAYER_ID_LEN, MAX_PLAYER_NAME_LEN, "bot%d@", client->index);
+            client->state = CLIENT_READY_STATE;
+            thread->ready_num++;
+            hist_add(thread->handshake_hist, now - client->connect_ns);
+            if (0 > client_send(client, CLIENT_READY, ready, PLAYER_ID_LEN + name_len))
+                client_fail(thread, client);
+        }
+        break;
+    case GAME_UPDATE:
+        if (len == GAME_UPDATE_LEN || len == COMPACT_UPDATE_LEN)
+            handle_transform(thread, body + len - TRANSFORM_LEN, now, measuring);
+        break;
+    case GAME_SNAPSHOT:
+    {
+        size_t record_len = loadgen_compact ? COMPACT_UPDATE_LEN : GAME_UPDATE_LEN;
+        for (size_t p = 0; p + record_len <= len; p += record_len)
+            handle_transform(thread, body + p + record_len - TRANSFORM_LEN, now, measuring);
+        break;
+    }
+    case GAME_SNAPSHOT_DELTA:
+        handle_delta(thread, body, len, now, measuring);
+        break;
+    case PING:
+        // 发送缓冲区满时不回复，服务器只是少一个样本
+        if (PING_LEN == len)
+            client_send(client, PONG, body, PING_LEN);
+        break;
+    default:
+        break;
+    }
+}
+
+/* 读空套接字并处理其中所有完整的帧 */
+static void client_read(loadgen_thread_t *thread, client_t *client)
+{
+    while (CLIENT_FAILED != client->state)
+    {
+        if (client->in_len == client->in_cap)
+        {
+            client_fail(thread, client);
+            return;
+        }
+        ssize_t n = read(client->sockfd, client->in + client->in_len, client->in_cap - client->in_len);
+        if (n <= 0)
+        {
+            if (n < 0 && EINTR == errno)
+                continue;
+            if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+                return;
+            client_fail(thread, client);
+            return;
+        }
+        client->in_len += n;
+
+        size_t p = 0;
+        while (client->in_len - p >= sizeof(MessageHeader) && CLIENT_FAILED != client->state)
+        {
+            MessageHeader header;
+            memcpy(&header, client->in + p, sizeof(header));
+            if (header.length < sizeof(header))
+            {
+                client_fail(thread, client);
+                return;
+            }
+            if (client->in_len - p < header.length)
+            {
+                // 帧比缓冲区还大时扩大缓冲区，之后继续读
+                if (header.length > client->in_cap)
+                {
+                    char *in = (char *)realloc(client->in, header.length);
+                    if (NULL == in)
+                    {
+                        client_fail(thread, client);
+                        return;
+                    }
+                    client->in = in;
+                    client->in_cap = header.length;
+                }
+                break;
+            }
+            // 模拟有损网络时，状态帧按模拟的送达时刻计算转发延迟
+            uint64_t now = stats_now_ns();
+            if (impair_enabled() &&
+                (GAME_UPDATE == header.type || GAME_SNAPSHOT == header.type || GAME_SNAPSHOT_DELTA == header.type))
+                now = impair_tcp_due(&client->tcp_recv_due, now, impair_delay_ns(thread, true));
+            handle_frame(thread, client, &header, client->in + p + sizeof(header), header.length - sizeof(header), now);
+            p += header.length;
+        }
+        memmove(client->in, client->in + p, client->in_len - p);
+        client->in_len -= p;
+    }
+}
+
+/* 处理一个送达的下行数据报：按序号丢弃更旧的，之后和 TCP 上收到的一样处理 */
+static void client_deliver_udp(loadgen_thread_t *thread, client_t *client, const char *datagram, uint64_t now)
+{
+    UdpHeader udp;
+    MessageHeader header;
+    memcpy(&udp, datagram, UDP_HEADER_SIZE);
+    memcpy(&header, datagram + UDP_HEADER_SIZE, sizeof(header));
+    if (0 != client->udp_recv_seq && 0 >= (int32_t)(udp.seq - client->udp_recv_seq))
+    {
+        if (atomic_load_explicit(&loadgen_measuring, memory_order_relaxed))
+            atomic_fetch_add_explicit(&thread->udp_stale, 1, memory_order_relaxed);
+        return;
+    }
+    client->udp_recv_seq = udp.seq;
+    if (CLIENT_READY_STATE == client->state)
+        handle_frame(thread, client, &header, datagram + UDP_HEADER_SIZE + sizeof(header),
+                     header.length - sizeof(header), now);
+}
+
+/* 读空 UDP 套接字：UDP_BIND 的回复完成绑定，GAME_UPDATE 经过模拟的丢失和延迟之后送达 */
+static void client_read_udp(loadgen_thread_t *thread, client_t *client)
+{
+    char datagram[UDP_DATAGRAM_SIZE];
+    while (0 <= client->udp_fd)
+    {
+        ssize_t n = recv(client->udp_fd, datagram, sizeof(datagram), 0);
+        if (n < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            return;
+        }
+        if (n < UDP_HEADER_SIZE + (ssize_t)sizeof(MessageHeader))
+            continue;
+        UdpHeader udp;
+        MessageHeader header;
+        memcpy(&udp, datagram, UDP_HEADER_SIZE);
+        memcpy(&header, datagram + UDP_HEADER_SIZE, sizeof(header));
+        // 下行的消息头中的长度包含消息头
+        if (udp.token != client->udp_token || header.length != n - UDP_HEADER_SIZE)
+            continue;
+        if (UDP_BIND == header.type)
+        {
+            if (!client->udp_bound)
+                atomic_fetch_add_explicit(&thread->udp_bound, 1, memory_order_relaxed);
+            client->udp_bound = true;
+            continue;
+        }
+        uint64_t now = stats_now_ns();
+        if (impair_enabled() && GAME_UPDATE == header.type)
+        {
+            int64_t delay = impair_delay_ns(thread, false);
+            if (0 > delay)
+                continue;
+            if (0 < delay && n <= (ssize_t)LOADGEN_DELAYED_SIZE &&
+                0 == delayed_push(thread, client, DELAYED_RECV_UDP, now + delay, datagram, n))
+                continue;
+        }
+        client_deliver_udp(thread, client, datagram, now);
+    }
+}
+
+/* 发送一条 GAME_UPDATE，位置在世界中随机游走 */
+static void client_update(loadgen_thread_t *thread, client_t *client, unsigned *seed)
+{
+    client->x += ((float)rand_r(seed) / RAND_MAX - 0.5f) * loadgen_world * 0.01f;
+    client->z += ((float)rand_r(seed) / RAND_MAX - 0.5f) * loadgen_world * 0.01f;
+    client->x = client->x < 0 ? 0 : (client->x > loadgen_world ? loadgen_world : client->x);
+    client->z = client->z < 0 ? 0 : (client->z > loadgen_world ? loadgen_world : client->z);
+
+    char body[GAME_UPDATE_LEN];
+    char *transform = body + (loadgen_compact ? 0 : PLAYER_ID_LEN);
+    memcpy(body, client->id, PLAYER_ID_LEN);
+    memset(transform, 0, TRANSFORM_LEN);
+    uint32_t type = LOADGEN_TRANSFORM_TYPE;
+    memcpy(transform, &type, sizeof(type));
+    uint64_t now = stats_now_ns();
+    memcpy(transform + LOADGEN_STAMP_OFFSET, &now, sizeof(now));
+    uint32_t index = client->index;
+    memcpy(transform + LOADGEN_STAMP_OFFSET + sizeof(now), &index, sizeof(index));
+    float origin[3] = {client->x, 0, client->z};
+    memcpy(transform + LOADGEN_ORIGIN_OFFSET, origin, sizeof(origin));
+
+    bool measuring = atomic_load_explicit(&loadgen_measuring, memory_order_relaxed);
+    uint16_t body_len = loadgen_compact ? TRANSFORM_LEN : GAME_UPDATE_LEN;
+    int result;
+    if (client->udp_bound)
+    {
+        if (!impair_enabled())
+            result = client_send_udp(client, GAME_UPDATE, transform, TRANSFORM_LEN);
+        else
+        {
+            // 序号在发出时就分配好，晚到的数据报在服务器一侧同样会被当作过期的丢弃
+            char datagram[LOADGEN_DELAYED_SIZE];
+            int len = client_pack_udp(client, GAME_UPDATE, transform, TRANSFORM_LEN, datagram);
+            int64_t delay = impair_delay_ns(thread, false);
+            if (0 > delay)
+                result = 0;
+            else if (0 == delay)
+                result = 0 > send(client->udp_fd, datagram, len, MSG_DONTWAIT) ? -1 : 0;
+            else
+                result = delayed_push(thread, client, DELAYED_SEND_UDP, now + delay, datagram, len);
+        }
+    }
+    else
+    {
+        // UDP_BIND 的请求或回复可能丢失，绑定之前定期重发，GAME_UPDATE 先走 TCP
+        if (0 <= client->udp_fd && now - client->udp_bind_ns >= LOADGEN_BIND_INTERVAL_NS)
+        {
+            client->udp_bind_ns = now;
+            client_send_udp(client, UDP_BIND, NULL, 0);
+        }
+        uint64_t due = impair_enabled() ? impair_tcp_due(&client->tcp_send_due, now, impair_delay_ns(thread, true)) : now;
+        if (due <= now)
+            result = client_send(client, GAME_UPDATE, body, body_len);
+        else
+            result = delayed_push(thread, client, DELAYED_SEND_TCP, due, body, body_len);
+    }
+    if (0 > result)
+    {
+        if (measuring)
+            atomic_fetch_add_explicit(&thread->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    if (measuring)
+        atomic_fetch_add_explicit(&thread->sent, 1, memory_order_relaxed);
+}
+
+/* 发出（或者处理）所有已经到了模拟送达时刻的消息，返回下一条消息的送达时刻，没有时返回 UINT64_MAX */
+static uint64_t release_delayed(loadgen_thread_t *thread, uint64_t now)
+{
+    while (0 < thread->delayed_num && thread->delayed[0].due_ns <= now)
+    {
+        delayed_t item;
+        delayed_pop(thread, &item);
+        client_t *client = item.client;
+        if (CLIENT_FAILED == client->state)
+            continue;
+        int result = 0;
+        if (DELAYED_SEND_TCP == item.kind)
+            result = client_send(client, GAME_UPDATE, item.data, item.len);
+        else if (DELAYED_SEND_UDP == item.kind)
+            result = 0 > send(client->udp_fd, item.data, item.len, MSG_DONTWAIT) ? -1 : 0;
+        else
+            client_deliver_udp(thread, client, item.data, now);
+        if (0 > result && atomic_load_explicit(&loadgen_measuring, memory_order_relaxed))
+            atomic_fetch_add_explicit(&thread->dropped, 1, memory_order_relaxed);
+    }
+    return 0 < thread->delayed_num ? thread->delayed[0].due_ns : UINT64_MAX;
+}
+
+static void handle_event(loadgen_thread_t *thread, client_t *client, uint32_t events)
+{
+    if (CLIENT_FAILED == client->state)
+        return;
+    if (CLIENT_CONNECTING == client->state)
+    {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (0 > getsockopt(client->sockfd, SOL_SOCKET, SO_ERROR, &error, &len) || 0 != error)
+        {
+            client_fail(thread, client);
+            return;
+        }
+        client->state = CLIENT_WAIT_UUID;
+    }
+    if ((events & EPOLLOUT) && 0 < client->out_len && 0 > client_flush(client))
+    {
+        client_fail(thread, client);
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        client_read(thread, client);
+}
+
+/* 处理 timeout_ms 以内的网络事件 */
+static void poll_events(loadgen_thread_t *thread, int timeout_ms)
+{
+    struct epoll_event events[MAX_EPOLL_EVENT];
+    int ready_num = epoll_wait(thread->epoll_fd, events, MAX_EPOLL_EVENT, timeout_ms);
+    for (int i = 0; i < ready_num; i++)
+    {
+        uint64_t data = events[i].data.u64;
+        client_t *client = (client_t *)(uintptr_t)(data & ~LOADGEN_UDP_TAG);
+        if (data & LOADGEN_UDP_TAG)
+            client_read_udp(thread, client);
+        else
+            handle_event(thread, client, events[i].events);
+    }
+}
+
+static void *loadgen_main(void *arg)
+{
+    loadgen_thread_t *thread = (loadgen_thread_t *)arg;
+    unsigned seed = thread->id * 7919 + 1;
+    thread->impair_seed = seed ^ 0x5bd1e995;
+
+    // 连接并完成握手
+    for (int i = 0; i < thread->client_num; i++)
+    {
+        client_t *client = &thread->clients[i];
+        client->x = (float)rand_r(&seed) / RAND_MAX * loadgen_world;
+        client->z = (float)rand_r(&seed) / RAND_MAX * loadgen_world;
+        client_connect(thread, client);
+        // 边连接边处理握手，避免服务器的 accept 队列溢出
+        poll_events(thread, 0);
+    }
+    while (thread->ready_num + thread->failed_num < thread->client_num && !atomic_load(&loadgen_over))
+        poll_events(thread, 10);
+    atomic_fetch_add(&loadgen_ready_threads, 1);
+    while (!atomic_load(&loadgen_sending) && !atomic_load(&loadgen_over))
+        poll_events(thread, 10);
+
+    // 每个玩家每 interval_ns 发送一次，线程内的玩家在周期内均匀错开
+    uint64_t interval_ns = 1000000000ull / loadgen_rate;
+    uint64_t start_ns = stats_now_ns();
+    uint64_t step_ns = interval_ns / (thread->client_num > 0 ? thread->client_num : 1);
+    uint64_t step = 0;
+    while (!atomic_load_explicit(&loadgen_over, memory_order_relaxed))
+    {
+        uint64_t now = stats_now_ns();
+        while (0 < thread->client_num && start_ns + step * step_ns <= now)
+        {
+            client_t *client = &thread->clients[step % thread->client_num];
+            if (CLIENT_READY_STATE == client->state)
+                client_update(thread, client, &seed);
+            step++;
+        }
+        uint64_t next_ns = start_ns + step * step_ns;
+        now = stats_now_ns();
+        uint64_t due_ns = release_delayed(thread, now);
+        if (due_ns < next_ns)
+            next_ns = due_ns;
+        poll_events(thread, next_ns > now ? (int)((next_ns - now) / 1000000) : 0);
+    }
+
+    for (int i = 0; i < thread->client_num; i++)
+    {
+        if (0 <= thread->clients[i].sockfd)
+            close(thread->clients[i].sockfd);
+        if (0 <= thread->clients[i].udp_fd)
+            close(thread->clients[i].udp_fd);
+    }
+    free(thread->delayed);
+    return NULL;
+}
+
+static uint64_t sum_counter(size_t offset)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < loadgen_thread_num; i++)
+        sum += atomic_load_explicit((atomic_uint_fast64_t *)((char *)&loadgen_threads[i] + offset), memory_order_relaxed);
+    return sum;
+}
+
+#define SUM(field) sum_counter(offsetof(loadgen_thread_t, field))
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "h:c:t:g:r:d:w:x:CUl:j:")))
+    {
+        switch (opt)
+        {
+        case 'h':
+            loadgen_host = optarg;
+            break;
+        case 'c':
+            loadgen_client_num = atoi(optarg);
+            break;
+        case 't':
+            loadgen_thread_num = atoi(optarg);
+            break;
+        case 'g':
+            loadgen_room_num = atoi(optarg);
+            break;
+        case 'r':
+            loadgen_rate = atoi(optarg);
+            break;
+        case 'd':
+            loadgen_duration = atoi(optarg);
+            break;
+        case 'w':
+            loadgen_warmup = atoi(optarg);
+            break;
+        case 'x':
+            loadgen_world = atof(optarg);
+            break;
+        case 'C':
+            loadgen_compact = true;
+            break;
+        case 'U':
+            loadgen_udp = true;
+            break;
+        case 'l':
+            loadgen_loss = atof(optarg);
+            break;
+        case 'j':
+            loadgen_delay_ms = atoi(optarg);
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+    struct in_addr host;
+    if (optind != argc - 1 || loadgen_client_num < 1 || loadgen_thread_num < 1 ||
+        loadgen_thread_num > LOADGEN_MAX_THREAD_NUM || loadgen_room_num < 1 || loadgen_room_num > MAX_ROOM_NUM ||
+        loadgen_rate < 1 || loadgen_duration < 1 || loadgen_warmup < 0 || !(loadgen_world > 0) ||
+        !(loadgen_loss >= 0 && loadgen_loss <= 100) || loadgen_delay_ms < 0 ||
+        1 != inet_pton(AF_INET, loadgen_host, &host))
+    {
+        fprintf(stderr, "Usage: %s <port> [-h host] [-c clients] [-t threads] [-g rooms] [-r rate_hz] [-d seconds] "
+                        "[-w seconds] [-x world_size] [-C] [-U] [-l loss_pct] [-j delay_ms]\n", argv[0]);
+        return -1;
+    }
+    loadgen_port = atoi(argv[optind]);
+
+    // 每个玩家一个套接字，把文件描述符上限提高到硬上限
+    struct rlimit limit;
+    if (0 == getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    client_t *clients = (client_t *)calloc(loadgen_client_num, sizeof(client_t));
+    if (NULL == clients)
+        return -1;
+    // 玩家 i 由第 i % threads 个线程负责，线程内连续存放
+    int next = 0;
+    for (int t = 0; t < loadgen_thread_num; t++)
+    {
+        loadgen_thread_t *thread = &loadgen_threads[t];
+        thread->id = t;
+        thread->clients = clients + next;
+        thread->client_num = loadgen_client_num / loadgen_thread_num + (t < loadgen_client_num % loadgen_thread_num);
+        for (int i = 0; i < thread->client_num; i++)
+        {
+            client_t *client = &thread->clients[i];
+            client->index = t + i * loadgen_thread_num;
+            client->sockfd = -1;
+            client->udp_fd = -1;
+            client->in_cap = LOADGEN_IN_BUFFER_SIZE;
+            if (NULL == (client->in = (char *)malloc(client->in_cap)))
+                return -1;
+        }
+        next += thread->client_num;
+        if (0 > (thread->epoll_fd = epoll_create1(0)))
+            return -1;
+    }
+
+    printf("clients=%d threads=%d rooms=%d rate=%dHz duration=%ds warmup=%ds compact=%s udp=%s loss=%.1f%% "
+           "delay<=%dms\n", loadgen_client_num, loadgen_thread_num, loadgen_room_num, loadgen_rate, loadgen_duration,
+           loadgen_warmup, loadgen_compact ? "yes" : "no", loadgen_udp ? "yes" : "no", loadgen_loss, loadgen_delay_ms);
+    uint64_t connect_begin = stats_now_ns();
+    for (int t = 0; t < loadgen_thread_num; t++)
+        pthread_create(&loadgen_threads[t].pid, NULL, loadgen_main, &loadgen_threads[t]);
+    while (atomic_load(&loadgen_ready_threads) < loadgen_thread_num)
+        usleep(1000);
+    double connect_s = (stats_now_ns() - connect_begin) / 1e9;
+
+    uint64_t handshake_hist[STATS_HIST_BUCKET_NUM] = {0};
+    int ready_num = 0, failed_num = 0;
+    for (int t = 0; t < loadgen_thread_num; t++)
+    {
+        ready_num += loadgen_threads[t].ready_num;
+        failed_num += loadgen_threads[t].failed_num;
+        for (int b = 0; b < STATS_HIST_BUCKET_NUM; b++)
+            handshake_hist[b] += loadgen_threads[t].handshake_hist[b];
+    }
+    printf("connect: ready=%d failed=%d in %.2fs (%.0f conn/s)\n", ready_num, failed_num, connect_s,
+           ready_num / connect_s);
+    print_hist("handshake", handshake_hist);
+    fflush(stdout);
+
+    atomic_store(&loadgen_sending, true);
+    sleep(loadgen_warmup);
+    atomic_store(&loadgen_measuring, true);
+    uint64_t measure_begin = stats_now_ns();
+    uint64_t last_sent = 0, last_received = 0;
+    for (int s = 1; s <= loadgen_duration; s++)
+    {
+        sleep(1);
+        uint64_t sent = SUM(sent), received = SUM(received);
+        printf("[%3ds] sent %" PRIu64 "/s received %" PRIu64 "/s\n", s, sent - last_sent, received - last_received);
+        fflush(stdout);
+        last_sent = sent;
+        last_received = received;
+    }
+    atomic_store(&loadgen_measuring, false);
+    double measure_s = (stats_now_ns() - measure_begin) / 1e9;
+    atomic_store(&loadgen_over, true);
+
+    uint64_t latency_hist[STATS_HIST_BUCKET_NUM] = {0};
+    uint64_t latency_sum = 0;
+    for (int t = 0; t < loadgen_thread_num; t++)
+    {
+        pthread_join(loadgen_threads[t].pid, NULL);
+        for (int b = 0; b < STATS_HIST_BUCKET_NUM; b++)
+            latency_hist[b] += loadgen_threads[t].latency_hist[b];
+        latency_sum += loadgen_threads[t].latency_sum;
+    }
+
+    uint64_t sent = SUM(sent), received = SUM(received);
+    printf("throughput: sent %.0f msg/s (dropped %" PRIu64 ") received %.0f updates/s %.0f frames/s %.2f MB/s "
+           "disconnects %" PRIu64 "\n", sent / measure_s, SUM(dropped), received / measure_s, SUM(frames) / measure_s,
+           SUM(bytes) / measure_s / 1e6, SUM(disconnects));
+    if (loadgen_udp)
+        printf("udp: bound %" PRIu64 "/%d stale %" PRIu64 "\n", SUM(udp_bound), ready_num, SUM(udp_stale));
+    if (impair_enabled())
+        printf("impair: lost %" PRIu64 " (retransmitted on tcp, dropped on udp)\n", SUM(lost));
+    print_hist("fan-out", latency_hist);
+    if (0 != received)
+        printf("  fan-out avg=%.1fus\n", (double)latency_sum / received / 1e3);
+    return 0;
+}
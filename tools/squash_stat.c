@@ -0,0 +1,410 @@
+/**
+ * squash_stat：读取服务器的统计共享内存段，按固定间隔输出速率、队列深度和各阶段耗时的分位数。
+ *
+ * 只以只读方式映射 `/dev/shm/squash_stats.<port>`，不和服务器进行任何交互，服务器的热路径上没有额外开销。
+ * 每个间隔输出：
+ * - 收发的消息数、字节数和 EAGAIN 次数的速率，当前连接数；
+ * - handler 的 ready 队列和每个 worker 的 work 队列最近一次的深度及最大深度；
+ * - recv->ready、ready->handled、handled->written、end-to-end 四个阶段以及 PING 往返时间在这个间隔内的分布（-c 时为启动以来）；
+ * - 按消息类型统计的收发速率；
+ * - 发送队列背压策略替换、丢弃的帧数和断开的连接数，-q 时再列出发送队列积压最多、以及往返时间最长的若干个连接。
+ *
+ * 用法：squash_stat <port> [-i interval_ms] [-n count] [-c] [-q top_num]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "stats.h"
+
+// 所有线程的数据加起来之后的一份快照
+typedef struct
+{
+    uint64_t hist[STATS_STAGE_NUM][STATS_HIST_BUCKET_NUM];
+    uint64_t hist_sum[STATS_STAGE_NUM];
+    uint64_t recv_msgs[STATS_TYPE_NUM];
+    uint64_t recv_type_bytes[STATS_TYPE_NUM];
+    uint64_t send_msgs[STATS_TYPE_NUM];
+    uint64_t send_type_bytes[STATS_TYPE_NUM];
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    uint64_t read_eagain;
+    uint64_t write_eagain;
+    uint64_t accepts;
+    uint64_t closes;
+    uint64_t evictions;
+    uint64_t send_superseded;
+    uint64_t send_dropped;
+    uint64_t send_kicks;
+    uint64_t udp_recv;
+    uint64_t udp_recv_dropped;
+    uint64_t udp_sent;
+    uint64_t udp_send_dropped;
+    uint64_t time_ns;
+} stat_view_t;
+
+static const char *stage_names[STATS_STAGE_NUM] = {"recv->ready", "ready->handled", "handled->written", "end-to-end",
+                                                     "ping rtt"};
+static const char *type_names[STATS_TYPE_NUM] = {
+    "OTHER", "UNKWON_TYPE", "RESPONSE_UUID", "GLOBAL_PLAYER_INFO", "SOME_ONE_JOIN", "SOME_ONE_QUIT",
+    "GAME_UPDATE", "PLAYER_INFO_CERT", "CLIENT_READY", "GAME_SNAPSHOT", "GAME_SNAPSHOT_DELTA", "SNAPSHOT_ACK",
+    "UDP_BIND", "PING", "PONG"};
+
+#define LOAD(x) atomic_load_explicit(&(x), memory_order_relaxed)
+
+/* 映射端口对应的统计段，失败时返回 NULL */
+static const stats_segment_t *stat_attach(unsigned port)
+{
+    char name[32];
+    snprintf(name, sizeof(name), STATS_SHM_NAME_FORMAT, port);
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (0 > fd)
+    {
+        fprintf(stderr, "can't open /dev/shm%s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+    void *addr = mmap(NULL, sizeof(stats_segment_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == addr)
+    {
+        fprintf(stderr, "can't map %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+    const stats_segment_t *stats = (const stats_segment_t *)addr;
+    if (STATS_MAGIC != atomic_load_explicit(&stats->magic, memory_order_acquire) || STATS_VERSION != stats->version ||
+        sizeof(stats_segment_t) != stats->size)
+    {
+        fprintf(stderr, "%s is not a stats segment of this version.\n", name);
+        return NULL;
+    }
+    return stats;
+}
+
+static void stat_take(const stats_segment_t *stats, stat_view_t *view)
+{
+    memset(view, 0, sizeof(*view));
+    view->time_ns = stats_now_ns();
+    int thread_num = atomic_load_explicit(&stats->thread_num, memory_order_acquire);
+    for (int t = 0; t < thread_num; t++)
+    {
+        const stats_thread_t *thread = &stats->threads[t];
+        for (int s = 0; s < STATS_STAGE_NUM; s++)
+        {
+            for (int b = 0; b < STATS_HIST_BUCKET_NUM; b++)
+                view->hist[s][b] += LOAD(thread->hist[s][b]);
+            view->hist_sum[s] += LOAD(thread->hist_sum[s]);
+        }
+        for (int i = 0; i < STATS_TYPE_NUM; i++)
+        {
+            view->recv_msgs[i] += LOAD(thread->recv_msgs[i]);
+            view->recv_type_bytes[i] += LOAD(thread->recv_type_bytes[i]);
+            view->send_msgs[i] += LOAD(thread->send_msgs[i]);
+            view->send_type_bytes[i] += LOAD(thread->send_type_bytes[i]);
+        }
+        view->read_bytes += LOAD(thread->read_bytes);
+        view->write_bytes += LOAD(thread->write_bytes);
+        view->read_eagain += LOAD(thread->read_eagain);
+        view->write_eagain += LOAD(thread->write_eagain);
+        view->accepts += LOAD(thread->accepts);
+        view->closes += LOAD(thread->closes);
+        view->evictions += LOAD(thread->evictions);
+        view->send_superseded += LOAD(thread->send_superseded);
+        view->send_dropped += LOAD(thread->send_dropped);
+        view->send_kicks += LOAD(thread->send_kicks);
+        view->udp_recv += LOAD(thread->udp_recv);
+        view->udp_recv_dropped += LOAD(thread->udp_recv_dropped);
+        view->udp_sent += LOAD(thread->udp_sent);
+        view->udp_send_dropped += LOAD(thread->udp_send_dropped);
+    }
+}
+
+/* 两份快照之差，计数器单调递增，差值就是这个间隔内的增量 */
+static void stat_diff(const stat_view_t *now, const stat_view_t *prev, stat_view_t *delta)
+{
+    const uint64_t *a = (const uint64_t *)now;
+    const uint64_t *b = (const uint64_t *)prev;
+    uint64_t *d = (uint64_t *)delta;
+    for (size_t i = 0; i < sizeof(stat_view_t) / sizeof(uint64_t); i++)
+        d[i] = a[i] - b[i];
+}
+
+/* 直方图的第 q 分位数，在所在桶的上下界之间线性插值 */
+static double hist_quantile(const uint64_t *hist, uint64_t count, double q)
+{
+    double rank = q * count;
+    uint64_t seen = 0;
+    for (int b = 0; b < STATS_HIST_BUCKET_NUM; b++)
+    {
+        if (0 == hist[b])
+            continue;
+        if (seen + hist[b] >= rank)
+        {
+            double lower = stats_bucket_lower(b);
+            double upper = b + 1 < STATS_HIST_BUCKET_NUM ? stats_bucket_lower(b + 1) : lower;
+            return lower + (upper - lower) * (rank - seen) / hist[b];
+        }
+        seen += hist[b];
+    }
+    return 0;
+}
+
+/* 直方图中最大值所在桶的上界 */
+static double hist_max(const uint64_t *hist)
+{
+    for (int b = STATS_HIST_BUCKET_NUM - 1; b >= 0; b--)
+        if (0 != hist[b])
+            return b + 1 < STATS_HIST_BUCKET_NUM ? stats_bucket_lower(b + 1) : stats_bucket_lower(b);
+    return 0;
+}
+
+static const char *format_ns(double ns, char *buffer, size_t len)
+{
+    if (ns < 1e3)
+        snprintf(buffer, len, "%.0fns", ns);
+    else if (ns < 1e6)
+        snprintf(buffer, len, "%.1fus", ns / 1e3);
+    else if (ns < 1e9)
+        snprintf(buffer, len, "%.2fms", ns / 1e6);
+    else
+        snprintf(buffer, len, "%.2fs", ns / 1e9);
+    return buffer;
+}
+
+static const char *format_rate(double value, char *buffer, size_t len)
+{
+    if (value < 1e4)
+        snprintf(buffer, len, "%.0f", value);
+    else if (value < 1e6)
+        snprintf(buffer, len, "%.1fK", value / 1e3);
+    else
+        snprintf(buffer, len, "%.1fM", value / 1e6);
+    return buffer;
+}
+
+/* 按积压的字节数从大到小列出发送队列非空的前 top_num 个连接 */
+static void print_client_queues(const stats_segment_t *stats, uint64_t now_ns, int top_num)
+{
+    static int slots[MAX_CONNECTION_NUM];
+    static uint32_t bytes[MAX_CONNECTION_NUM];
+    int num = 0;
+    for (int s = 0; s < MAX_CONNECTION_NUM; s++)
+    {
+        if (0 == LOAD(stats->clients[s].queue_frames))
+            continue;
+        // 插入排序，只保留前 top_num 个
+        uint32_t b = LOAD(stats->clients[s].queue_bytes);
+        int i = num < top_num ? num++ : top_num;
+        while (i > 0 && bytes[i - 1] < b)
+        {
+            if (i < top_num)
+            {
+                slots[i] = slots[i - 1];
+                bytes[i] = bytes[i - 1];
+            }
+            i--;
+        }
+        if (i < top_num)
+        {
+            slots[i] = s;
+            bytes[i] = b;
+        }
+    }
+    printf("  %-8s %10s %10s %10s %10s %10s\n", "slot", "frames", "bytes", "backlog", "rtt", "jitter");
+    for (int i = 0; i < num; i++)
+    {
+        const stats_client_t *client = &stats->clients[slots[i]];
+        uint64_t backlog_ns = LOAD(client->backlog_ns);
+        char a[16], b[16], c[16];
+        printf("  %-8d %10u %10u %10s %10s %10s\n", slots[i], LOAD(client->queue_frames), bytes[i],
+               format_ns(now_ns > backlog_ns ? now_ns - backlog_ns : 0, a, sizeof(a)),
+               format_ns(LOAD(client->rtt_us) * 1000.0, b, sizeof(b)),
+               format_ns(LOAD(client->rtt_jitter_us) * 1000.0, c, sizeof(c)));
+    }
+}
+
+/* 按平滑后的往返时间从大到小列出前 top_num 个连接，还没有样本的连接不列出 */
+static void print_client_rtts(const stats_segment_t *stats, int top_num)
+{
+    static int slots[MAX_CONNECTION_NUM];
+    static uint32_t rtts[MAX_CONNECTION_NUM];
+    int num = 0;
+    for (int s = 0; s < MAX_CONNECTION_NUM; s++)
+    {
+        uint32_t rtt = LOAD(stats->clients[s].rtt_us);
+        if (0 == rtt)
+            continue;
+        int i = num < top_num ? num++ : top_num;
+        while (i > 0 && rtts[i - 1] < rtt)
+        {
+            if (i < top_num)
+            {
+                slots[i] = slots[i - 1];
+                rtts[i] = rtts[i - 1];
+            }
+            i--;
+        }
+        if (i < top_num)
+        {
+            slots[i] = s;
+            rtts[i] = rtt;
+        }
+    }
+    if (0 == num)
+        return;
+    printf("  %-8s %10s %10s\n", "slot", "rtt", "jitter");
+    for (int i = 0; i < num; i++)
+    {
+        char a[16], b[16];
+        printf("  %-8d %10s %10s\n", slots[i], format_ns(rtts[i] * 1000.0, a, sizeof(a)),
+               format_ns(LOAD(stats->clients[slots[i]].rtt_jitter_us) * 1000.0, b, sizeof(b)));
+    }
+}
+
+static void stat_print(const stats_segment_t *stats, const stat_view_t *now, const stat_view_t *delta, bool cumulative,
+                       int top_num)
+{
+    double seconds = delta->time_ns / 1e9;
+    char a[16], b[16], c[16], d[16], e[16], f[16];
+    printf("pid %d port %u uptime %.1fs threads %d conns %" PRIu64 " evicted %" PRIu64 " interval %.2fs\n", stats->pid, stats->port,
+           (now->time_ns - stats->start_ns) / 1e9, atomic_load_explicit(&stats->thread_num, memory_order_acquire),
+           now->accepts - now->closes, now->evictions, seconds);
+
+    uint64_t recv_msgs = 0, send_msgs = 0;
+    for (int i = 0; i < STATS_TYPE_NUM; i++)
+    {
+        recv_msgs += delta->recv_msgs[i];
+        send_msgs += delta->send_msgs[i];
+    }
+    printf("  recv %s msg/s %s B/s  send %s msg/s %s B/s  EAGAIN read %s/s write %s/s\n",
+           format_rate(recv_msgs / seconds, a, sizeof(a)), format_rate(delta->read_bytes / seconds, b, sizeof(b)),
+           format_rate(send_msgs / seconds, c, sizeof(c)), format_rate(delta->write_bytes / seconds, d, sizeof(d)),
+           format_rate(delta->read_eagain / seconds, e, sizeof(e)), format_rate(delta->write_eagain / seconds, f, sizeof(f)));
+    printf("  send queues: superseded %s/s dropped %s/s kicked %" PRIu64 "\n",
+           format_rate(delta->send_superseded / seconds, a, sizeof(a)),
+           format_rate(delta->send_dropped / seconds, b, sizeof(b)), now->send_kicks);
+    // 没有开启 UDP 通道（或者还没有客户端使用）时不显示
+    if (0 != now->udp_recv + now->udp_recv_dropped + now->udp_sent + now->udp_send_dropped)
+        printf("  udp: in %s dgram/s dropped %s/s  out %s dgram/s dropped %s/s\n",
+               format_rate(delta->udp_recv / seconds, a, sizeof(a)),
+               format_rate(delta->udp_recv_dropped / seconds, b, sizeof(b)),
+               format_rate(delta->udp_sent / seconds, c, sizeof(c)),
+               format_rate(delta->udp_send_dropped / seconds, d, sizeof(d)));
+    if (0 < top_num)
+    {
+        print_client_queues(stats, now->time_ns, top_num);
+        print_client_rtts(stats, top_num);
+    }
+
+    printf("  queues");
+    int thread_num = atomic_load_explicit(&stats->thread_num, memory_order_acquire);
+    for (int t = 0; t < thread_num; t++)
+    {
+        const stats_thread_t *thread = &stats->threads[t];
+        int kind = LOAD(thread->kind);
+        if (STATS_THREAD_HANDLER == kind)
+            printf("  ready %" PRIu64 " (max %" PRIu64 ")", LOAD(thread->queue_depth), LOAD(thread->queue_depth_max));
+        else if (STATS_THREAD_WORKER == kind)
+            printf("  work[%d] %" PRIu64 " (max %" PRIu64 ")", LOAD(thread->id), LOAD(thread->queue_depth),
+                   LOAD(thread->queue_depth_max));
+    }
+    printf("\n");
+
+    const stat_view_t *latency = cumulative ? now : delta;
+    printf("  %-18s %10s %9s %9s %9s %9s %9s %9s\n", "stage", "count", "avg", "p50", "p90", "p99", "p99.9", "max");
+    for (int s = 0; s < STATS_STAGE_NUM; s++)
+    {
+        uint64_t count = 0;
+        for (int i = 0; i < STATS_HIST_BUCKET_NUM; i++)
+            count += latency->hist[s][i];
+        if (0 == count)
+        {
+            printf("  %-18s %10d %9s %9s %9s %9s %9s %9s\n", stage_names[s], 0, "-", "-", "-", "-", "-", "-");
+            continue;
+        }
+        char p[6][16];
+        printf("  %-18s %10" PRIu64 " %9s %9s %9s %9s %9s %9s\n", stage_names[s], count,
+               format_ns((double)latency->hist_sum[s] / count, p[0], sizeof(p[0])),
+               format_ns(hist_quantile(latency->hist[s], count, 0.5), p[1], sizeof(p[1])),
+               format_ns(hist_quantile(latency->hist[s], count, 0.9), p[2], sizeof(p[2])),
+               format_ns(hist_quantile(latency->hist[s], count, 0.99), p[3], sizeof(p[3])),
+               format_ns(hist_quantile(latency->hist[s], count, 0.999), p[4], sizeof(p[4])),
+               format_ns(hist_max(latency->hist[s]), p[5], sizeof(p[5])));
+    }
+
+    printf("  %-20s %10s %10s %10s %10s\n", "type", "in msg/s", "in B/s", "out msg/s", "out B/s");
+    for (int i = 0; i < STATS_TYPE_NUM; i++)
+    {
+        if (0 == now->recv_msgs[i] && 0 == now->send_msgs[i])
+            continue;
+        printf("  %-20s %10s %10s %10s %10s\n", NULL != type_names[i] ? type_names[i] : "?",
+               format_rate(delta->recv_msgs[i] / seconds, a, sizeof(a)),
+               format_rate(delta->recv_type_bytes[i] / seconds, b, sizeof(b)),
+               format_rate(delta->send_msgs[i] / seconds, c, sizeof(c)),
+               format_rate(delta->send_type_bytes[i] / seconds, d, sizeof(d)));
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    int interval_ms = 1000;
+    int count = 0;
+    bool cumulative = false;
+    int top_num = 0;
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "i:n:cq:")))
+    {
+        switch (opt)
+        {
+        case 'i':
+            interval_ms = atoi(optarg);
+            break;
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'c':
+            cumulative = true;
+            break;
+        case 'q':
+            top_num = atoi(optarg);
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind != argc - 1 || interval_ms < 1 || count < 0 || top_num < 0 || top_num > MAX_CONNECTION_NUM)
+    {
+        fprintf(stderr, "Usage: %s <port> [-i interval_ms] [-n count] [-c] [-q top_num]\n", argv[0]);
+        return -1;
+    }
+
+    const stats_segment_t *stats = stat_attach((unsigned)atoi(argv[optind]));
+    if (NULL == stats)
+        return -1;
+
+    static stat_view_t views[2], delta;
+    int cur = 0;
+    stat_take(stats, &views[cur]);
+    for (int i = 0; 0 == count || i < count; i++)
+    {
+        usleep(interval_ms * 1000);
+        cur ^= 1;
+        stat_take(stats, &views[cur]);
+        stat_diff(&views[cur], &views[cur ^ 1], &delta);
+        stat_print(stats, &views[cur], &delta, cumulative, top_num);
+        if (0 != kill(stats->pid, 0) && ESRCH == errno)
+        {
+            printf("server %d has exited.\n", stats->pid);
+            break;
+        }
+    }
+    return 0;
+}